@@ -0,0 +1,245 @@
+#include <bench.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+namespace bench {
+
+struct Benchmark {
+    std::string name;
+    BenchmarkFunction function;
+    size_t minSize;
+    size_t maxSize;
+};
+
+struct Result {
+    std::string name;
+    uint64_t iterations;
+    double nsPerIteration;
+    double cpuNsPerIteration;
+    double itemsPerSecond;
+    double bytesPerSecond;
+    std::vector<std::pair<std::string, double>> counters;
+    std::string skipReason;
+};
+
+//function local so registration from other translation units never runs before it is constructed
+static std::vector<Benchmark>& registry()
+{
+    static std::vector<Benchmark> benchmarks;
+    return benchmarks;
+}
+
+bool register_benchmark(const char* name, BenchmarkFunction function, size_t minSize, size_t maxSize)
+{
+    registry().push_back(Benchmark{name, std::move(function), minSize, maxSize});
+    return true;
+}
+
+static Result run_size(const Benchmark& benchmark, size_t size, double minTime)
+{
+    Result result{};
+    result.name = benchmark.name + "/" + std::to_string(size);
+
+    //same approach as Google Benchmark: grow the iteration count until one run is long enough,
+    //the last run is the one reported
+    uint64_t iterations = 1;
+    while (true) {
+        State state{size, iterations};
+        benchmark.function(state);
+
+        if (!state.skip_reason().empty()) {
+            result.skipReason = state.skip_reason();
+            return result;
+        }
+
+        const double elapsed = state.elapsed_seconds();
+        if (elapsed >= minTime || iterations >= 1000000000) {
+            result.iterations = iterations;
+            result.nsPerIteration = elapsed * 1e9 / iterations;
+            result.cpuNsPerIteration = state.cpu_seconds() * 1e9 / iterations;
+            result.itemsPerSecond = elapsed > 0 ? state.items_processed() / elapsed : 0;
+            result.bytesPerSecond = elapsed > 0 ? state.bytes_processed() / elapsed : 0;
+            result.counters = state.counters();
+            return result;
+        }
+
+        //aim a bit past minTime so the next run usually is the last, but never grow more than 10x at once
+        const double multiplier = std::min(10.0, minTime * 1.4 / std::max(elapsed, 1e-9));
+        iterations = std::max(iterations + 1, static_cast<uint64_t>(iterations * multiplier));
+    }
+}
+
+static std::string format_time(double ns)
+{
+    char text[32];
+    if (ns < 1e4) {
+        snprintf(text, sizeof(text), "%.1f ns", ns);
+    } else if (ns < 1e7) {
+        snprintf(text, sizeof(text), "%.1f us", ns / 1e3);
+    } else if (ns < 1e10) {
+        snprintf(text, sizeof(text), "%.1f ms", ns / 1e6);
+    } else {
+        snprintf(text, sizeof(text), "%.2f s", ns / 1e9);
+    }
+    return text;
+}
+
+static std::string format_rate(double perSecond, const char* unit)
+{
+    char text[32];
+    if (perSecond >= 1e9) {
+        snprintf(text, sizeof(text), "%.2f G%s/s", perSecond / 1e9, unit);
+    } else if (perSecond >= 1e6) {
+        snprintf(text, sizeof(text), "%.2f M%s/s", perSecond / 1e6, unit);
+    } else {
+        snprintf(text, sizeof(text), "%.2f k%s/s", perSecond / 1e3, unit);
+    }
+    return text;
+}
+
+static void print_result(const Result& result)
+{
+    char line[256];
+    if (!result.skipReason.empty()) {
+        snprintf(line, sizeof(line), "%-36s skipped: %s", result.name.c_str(), result.skipReason.c_str());
+        std::cout << line << std::endl;
+        return;
+    }
+
+    snprintf(line, sizeof(line), "%-36s %14s %12llu", result.name.c_str(), format_time(result.nsPerIteration).c_str(),
+        static_cast<unsigned long long>(result.iterations));
+    std::cout << line;
+    if (result.itemsPerSecond > 0) {
+        std::cout << "  " << format_rate(result.itemsPerSecond, "items");
+    }
+    if (result.bytesPerSecond > 0) {
+        std::cout << "  " << format_rate(result.bytesPerSecond, "B");
+    }
+    for (const auto& [name, value] : result.counters) {
+        std::cout << "  " << name << "=" << value;
+    }
+    std::cout << std::endl;
+}
+
+static std::string json_escape(const std::string& text)
+{
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+//same layout as Google Benchmark's --benchmark_format=json, so its compare.py and other tooling can read it
+static bool write_json(const std::string& path, const std::vector<Result>& results)
+{
+    std::ofstream file(path, std::ios::trunc);
+    if (!file.is_open()) {
+        std::cout << "Failed to write " << path << std::endl;
+        return false;
+    }
+
+    char date[64];
+    const std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+    file << "{\n  \"context\": {\n";
+    file << "    \"date\": \"" << date << "\",\n";
+    file << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n";
+#ifdef NDEBUG
+    file << "    \"library_build_type\": \"release\"\n";
+#else
+    file << "    \"library_build_type\": \"debug\"\n";
+#endif
+    file << "  },\n  \"benchmarks\": [";
+
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& result = results[i];
+        file << (i == 0 ? "\n" : ",\n") << "    {\n";
+        file << "      \"name\": \"" << json_escape(result.name) << "\",\n";
+        file << "      \"run_type\": \"iteration\",\n";
+        if (!result.skipReason.empty()) {
+            file << "      \"error_occurred\": true,\n";
+            file << "      \"error_message\": \"" << json_escape(result.skipReason) << "\",\n";
+            file << "      \"iterations\": 0,\n";
+            file << "      \"real_time\": 0,\n";
+            file << "      \"cpu_time\": 0,\n";
+            file << "      \"time_unit\": \"ns\"\n    }";
+            continue;
+        }
+        file << "      \"iterations\": " << result.iterations << ",\n";
+        file << "      \"real_time\": " << result.nsPerIteration << ",\n";
+        file << "      \"cpu_time\": " << result.cpuNsPerIteration << ",\n";
+        if (result.itemsPerSecond > 0) {
+            file << "      \"items_per_second\": " << result.itemsPerSecond << ",\n";
+        }
+        if (result.bytesPerSecond > 0) {
+            file << "      \"bytes_per_second\": " << result.bytesPerSecond << ",\n";
+        }
+        for (const auto& [name, value] : result.counters) {
+            file << "      \"" << json_escape(name) << "\": " << value << ",\n";
+        }
+        file << "      \"time_unit\": \"ns\"\n    }";
+    }
+    file << "\n  ]\n}\n";
+
+    return file.good();
+}
+
+int run(int argc, char* argv[])
+{
+    std::string filter;
+    std::string jsonPath;
+    size_t maxSize = 10000000;
+    double minTime = 0.5;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            jsonPath = argv[++i];
+        } else if (strcmp(argv[i], "--max-size") == 0 && i + 1 < argc) {
+            maxSize = std::strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            minTime = std::atof(argv[++i]);
+        } else {
+            std::cout << "usage: " << argv[0] << " [--filter substring] [--max-size elements] [--min-time seconds] [--json path]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<Result> results;
+    for (const Benchmark& benchmark : registry()) {
+        for (size_t size = benchmark.minSize; size <= std::min(benchmark.maxSize, maxSize); size *= 10) {
+            const std::string name = benchmark.name + "/" + std::to_string(size);
+            if (!filter.empty() && name.find(filter) == std::string::npos) {
+                continue;
+            }
+
+            results.push_back(run_size(benchmark, size, minTime));
+            print_result(results.back());
+        }
+    }
+
+    if (!jsonPath.empty() && !write_json(jsonPath, results)) {
+        return 1;
+    }
+    return 0;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    return bench::run(argc, argv);
+}
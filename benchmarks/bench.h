@@ -0,0 +1,127 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+//a small harness in the style of Google Benchmark: every registered benchmark runs once per problem size,
+//with the iteration count grown until the timed loop lasts long enough to trust
+namespace bench {
+
+class State {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    State(size_t size, uint64_t iterations) : _size(size), _iterations(iterations) {}
+
+    //the problem size of this run, in elements
+    size_t size() const { return _size; }
+    uint64_t iterations() const { return _iterations; }
+
+    //for (auto _ : state) { ... } runs the body iterations() times, timing only the loop
+    struct [[maybe_unused]] Value {};
+
+    struct Iterator {
+        State* state;
+        uint64_t remaining;
+
+        bool operator!=(const Iterator&) const
+        {
+            if (remaining != 0) {
+                return true;
+            }
+            state->stop_timing();
+            return false;
+        }
+        void operator++() { --remaining; }
+        Value operator*() const { return Value{}; }
+    };
+
+    Iterator begin()
+    {
+        start_timing();
+        return Iterator{this, _iterations};
+    }
+    Iterator end() { return Iterator{this, 0}; }
+
+    //excludes per iteration setup from the measurement
+    void pause_timing() { stop_timing(); }
+    void resume_timing() { start_timing(); }
+
+    //throughput reported next to the time, per second of measured time
+    void set_items_processed(uint64_t items) { _items = items; }
+    void set_bytes_processed(uint64_t bytes) { _bytes = bytes; }
+
+    //extra value written with the results, e.g. how many objects survived culling
+    void set_counter(const std::string& name, double value) { _counters.emplace_back(name, value); }
+
+    //marks the run as not measured, e.g. no Vulkan device to benchmark against
+    void skip(const std::string& reason) { _skipReason = reason; }
+
+    double elapsed_seconds() const { return _elapsed; }
+    //processor time of the whole process over the timed loop, job threads included
+    double cpu_seconds() const { return _cpuElapsed; }
+    uint64_t items_processed() const { return _items; }
+    uint64_t bytes_processed() const { return _bytes; }
+    const std::vector<std::pair<std::string, double>>& counters() const { return _counters; }
+    const std::string& skip_reason() const { return _skipReason; }
+
+private:
+    void start_timing()
+    {
+        _running = true;
+        _start = Clock::now();
+        _cpuStart = std::clock();
+    }
+
+    void stop_timing()
+    {
+        if (_running) {
+            _elapsed += std::chrono::duration<double>(Clock::now() - _start).count();
+            _cpuElapsed += static_cast<double>(std::clock() - _cpuStart) / CLOCKS_PER_SEC;
+            _running = false;
+        }
+    }
+
+    size_t _size;
+    uint64_t _iterations;
+
+    bool _running{false};
+    Clock::time_point _start;
+    double _elapsed{0};
+    std::clock_t _cpuStart{0};
+    double _cpuElapsed{0};
+
+    uint64_t _items{0};
+    uint64_t _bytes{0};
+    std::vector<std::pair<std::string, double>> _counters;
+    std::string _skipReason;
+};
+
+using BenchmarkFunction = std::function<void(State&)>;
+
+//runs function for every power of ten from minSize to maxSize, both included
+bool register_benchmark(const char* name, BenchmarkFunction function, size_t minSize, size_t maxSize);
+
+//keeps the optimizer from removing a computation whose result is otherwise unused
+template<typename T>
+inline void do_not_optimize(const T& value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "g"(&value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+int run(int argc, char* argv[]);
+
+}
+
+#define ENGINE_BENCHMARK(function, minSize, maxSize) \
+    static const bool function##_registered = bench::register_benchmark(#function, function, minSize, maxSize)
@@ -0,0 +1,180 @@
+#include <bench.h>
+
+#include <vk_bvh.h>
+
+#include <cmath>
+#include <fstream>
+#include <random>
+
+//the engine's biggest asset, loaded once. Benchmarks run from bin/ like the engine, missing assets skip the run
+class AssetBvh {
+public:
+    bool init()
+    {
+        if (_tried) {
+            return !_positions.empty();
+        }
+        _tried = true;
+
+        const char* path = "../assets/lost_empire.obj";
+        if (!std::ifstream(path).good()) {
+            return false;
+        }
+
+        Mesh mesh;
+        mesh.load_from_obj(path);
+        _positions.resize(mesh._vertices.size());
+        for (size_t i = 0; i < _positions.size(); i++) {
+            _positions[i] = mesh._vertices[i].position;
+        }
+        _bvh.build(_positions);
+        return !_positions.empty();
+    }
+
+    const std::vector<glm::vec3>& positions() const { return _positions; }
+    const vkutil::TriangleBvh& bvh() const { return _bvh; }
+
+private:
+    bool _tried{false};
+    std::vector<glm::vec3> _positions;
+    vkutil::TriangleBvh _bvh;
+};
+
+static AssetBvh lostEmpire;
+
+//a rolling heightfield of triangleCount triangles, shaped like terrain rather than a random soup
+static std::vector<glm::vec3> make_terrain(size_t triangleCount)
+{
+    const size_t quadsPerRow = 256;
+    const size_t rows = (triangleCount / 2 + quadsPerRow - 1) / quadsPerRow;
+    auto height = [](size_t x, size_t y) { return std::sin(x * 0.1f) * std::cos(y * 0.13f) * 8.f; };
+
+    std::vector<glm::vec3> positions;
+    positions.reserve(rows * quadsPerRow * 6);
+    for (size_t y = 0; y < rows; y++) {
+        for (size_t x = 0; x < quadsPerRow; x++) {
+            const glm::vec3 a{x, height(x, y), y};
+            const glm::vec3 b{x + 1, height(x + 1, y), y};
+            const glm::vec3 c{x, height(x, y + 1), y + 1};
+            const glm::vec3 d{x + 1, height(x + 1, y + 1), y + 1};
+            positions.insert(positions.end(), {a, c, b, b, c, d});
+        }
+    }
+    return positions;
+}
+
+static void build_bvh(bench::State& state, bool parallel)
+{
+    const std::vector<glm::vec3> positions = make_terrain(state.size());
+
+    vkutil::JobSystem jobs;
+    if (parallel) {
+        jobs.start();
+    }
+
+    vkutil::TriangleBvh bvh;
+    for (auto _ : state) {
+        bvh.build(positions, parallel ? &jobs : nullptr);
+    }
+
+    state.set_items_processed(state.iterations() * (positions.size() / 3));
+    state.set_counter("nodes", static_cast<double>(bvh.node_count()));
+}
+
+static void build_bvh_serial(bench::State& state)
+{
+    build_bvh(state, false);
+}
+ENGINE_BENCHMARK(build_bvh_serial, 1000, 1000000);
+
+static void build_bvh_jobs(bench::State& state)
+{
+    build_bvh(state, true);
+}
+ENGINE_BENCHMARK(build_bvh_jobs, 1000, 1000000);
+
+static void build_bvh_lost_empire(bench::State& state)
+{
+    if (!lostEmpire.init()) {
+        state.skip("../assets/lost_empire.obj not found");
+        return;
+    }
+
+    vkutil::JobSystem jobs;
+    jobs.start();
+
+    vkutil::TriangleBvh bvh;
+    for (auto _ : state) {
+        bvh.build(lostEmpire.positions(), &jobs);
+    }
+
+    state.set_items_processed(state.iterations() * (lostEmpire.positions().size() / 3));
+}
+ENGINE_BENCHMARK(build_bvh_lost_empire, 1, 1);
+
+//size rays from random points inside the map in random directions, closest hit each
+static void raycast_lost_empire(bench::State& state)
+{
+    if (!lostEmpire.init()) {
+        state.skip("../assets/lost_empire.obj not found");
+        return;
+    }
+
+    const vkutil::TriangleBvh& bvh = lostEmpire.bvh();
+    std::mt19937 random{11};
+    std::uniform_real_distribution<float> unit{0.f, 1.f};
+    std::vector<std::pair<glm::vec3, glm::vec3>> rays(state.size());
+    for (auto& [origin, direction] : rays) {
+        origin = bvh.bounds().min + (bvh.bounds().max - bvh.bounds().min) * glm::vec3(unit(random), unit(random), unit(random));
+        direction = glm::normalize(glm::vec3(unit(random), unit(random), unit(random)) - 0.5f);
+    }
+
+    uint32_t hits = 0;
+    for (auto _ : state) {
+        hits = 0;
+        for (const auto& [origin, direction] : rays) {
+            vkutil::RayHit hit;
+            hits += bvh.raycast(origin, direction, 1e30f, hit) ? 1 : 0;
+        }
+        bench::do_not_optimize(hits);
+    }
+
+    state.set_items_processed(state.iterations() * state.size());
+    state.set_counter("hits", hits);
+}
+ENGINE_BENCHMARK(raycast_lost_empire, 100, 10000);
+
+//size boxes of 4 units around random points of the map, like a character's overlap query
+static void query_box_lost_empire(bench::State& state)
+{
+    if (!lostEmpire.init()) {
+        state.skip("../assets/lost_empire.obj not found");
+        return;
+    }
+
+    const vkutil::TriangleBvh& bvh = lostEmpire.bvh();
+    std::mt19937 random{13};
+    std::uniform_real_distribution<float> unit{0.f, 1.f};
+    std::vector<AABB> boxes(state.size());
+    for (AABB& box : boxes) {
+        const glm::vec3 center = bvh.bounds().min + (bvh.bounds().max - bvh.bounds().min) * glm::vec3(unit(random), unit(random), unit(random));
+        box.min = center - glm::vec3(2.f);
+        box.max = center + glm::vec3(2.f);
+    }
+
+    std::vector<uint32_t> triangles;
+    size_t found = 0;
+    for (auto _ : state) {
+        found = 0;
+        for (const AABB& box : boxes) {
+            triangles.clear();
+            bvh.query_box(box, triangles);
+            found += triangles.size();
+        }
+        bench::do_not_optimize(triangles.data());
+    }
+
+    state.set_items_processed(state.iterations() * state.size());
+    state.set_counter("triangles", static_cast<double>(found));
+}
+ENGINE_BENCHMARK(query_box_lost_empire, 100, 10000);
@@ -0,0 +1,145 @@
+#include <bench.h>
+
+#include <vk_initializers.h>
+
+#include <VkBootstrap.h>
+
+//a headless device with the engine's object set layout, made on first use. Machines without a Vulkan driver skip
+//the descriptor benchmarks instead of failing the whole run
+class DescriptorDevice {
+public:
+    ~DescriptorDevice()
+    {
+        if (_device != VK_NULL_HANDLE) {
+            vkDestroyDescriptorSetLayout(_device, _objectSetLayout, nullptr);
+            vkb::destroy_device(_vkbDevice);
+        }
+        if (_instance.instance != VK_NULL_HANDLE) {
+            vkb::destroy_instance(_instance);
+        }
+    }
+
+    bool init()
+    {
+        if (_tried) {
+            return _device != VK_NULL_HANDLE;
+        }
+        _tried = true;
+
+        auto instance = vkb::InstanceBuilder{}
+            .set_app_name("engine_benchmarks")
+            .require_api_version(1, 1, 0)
+            .set_headless(true)
+            .build();
+        if (!instance) {
+            return false;
+        }
+        _instance = instance.value();
+
+        auto physicalDevice = vkb::PhysicalDeviceSelector{_instance}
+            .set_minimum_version(1, 1)
+            .require_present(false)
+            .select();
+        if (!physicalDevice) {
+            return false;
+        }
+
+        auto device = vkb::DeviceBuilder{physicalDevice.value()}.build();
+        if (!device) {
+            return false;
+        }
+        _vkbDevice = device.value();
+        _device = _vkbDevice.device;
+
+        //same bindings as set 1 in VulkanEngine::init_descriptors: object buffer and geometry arena
+        const std::vector<VkDescriptorSetLayoutBinding> bindings = {
+            vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0),
+            vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 1),
+        };
+        const VkDescriptorSetLayoutCreateInfo layoutInfo = vkinit::descriptorset_layout_create_info(bindings);
+        vkCreateDescriptorSetLayout(_device, &layoutInfo, nullptr, &_objectSetLayout);
+        return true;
+    }
+
+    VkDevice device() const { return _device; }
+    VkDescriptorSetLayout object_set_layout() const { return _objectSetLayout; }
+
+private:
+    bool _tried{false};
+    vkb::Instance _instance;
+    vkb::Device _vkbDevice;
+    VkDevice _device{VK_NULL_HANDLE};
+    VkDescriptorSetLayout _objectSetLayout{VK_NULL_HANDLE};
+};
+
+static DescriptorDevice descriptorDevice;
+
+static VkDescriptorPool create_pool(VkDevice device, uint32_t maxSets, VkDescriptorPoolCreateFlags flags)
+{
+    const VkDescriptorPoolSize size{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, maxSets * 2};
+
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = flags;
+    poolInfo.maxSets = maxSets;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &size;
+
+    VkDescriptorPool pool = VK_NULL_HANDLE;
+    vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool);
+    return pool;
+}
+
+//size sets allocated one call each, then released together with a pool reset
+static void allocate_descriptor_sets(bench::State& state)
+{
+    if (!descriptorDevice.init()) {
+        state.skip("no Vulkan device");
+        return;
+    }
+
+    const VkDevice device = descriptorDevice.device();
+    const VkDescriptorPool pool = create_pool(device, static_cast<uint32_t>(state.size()), 0);
+    const std::vector<VkDescriptorSetLayout> layouts = {descriptorDevice.object_set_layout()};
+    const VkDescriptorSetAllocateInfo allocInfo = vkinit::descriptorset_allocate_info(pool, layouts);
+
+    std::vector<VkDescriptorSet> sets(state.size());
+    for (auto _ : state) {
+        for (VkDescriptorSet& set : sets) {
+            vkAllocateDescriptorSets(device, &allocInfo, &set);
+        }
+        vkResetDescriptorPool(device, pool, 0);
+    }
+
+    vkDestroyDescriptorPool(device, pool, nullptr);
+    state.set_items_processed(state.iterations() * state.size());
+}
+ENGINE_BENCHMARK(allocate_descriptor_sets, 1000, 100000);
+
+//the same sets freed one by one, what a pool created with FREE_DESCRIPTOR_SET_BIT allows
+static void allocate_free_descriptor_sets(bench::State& state)
+{
+    if (!descriptorDevice.init()) {
+        state.skip("no Vulkan device");
+        return;
+    }
+
+    const VkDevice device = descriptorDevice.device();
+    const VkDescriptorPool pool = create_pool(device, static_cast<uint32_t>(state.size()), VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT);
+    const std::vector<VkDescriptorSetLayout> layouts = {descriptorDevice.object_set_layout()};
+    const VkDescriptorSetAllocateInfo allocInfo = vkinit::descriptorset_allocate_info(pool, layouts);
+
+    std::vector<VkDescriptorSet> sets(state.size());
+    for (auto _ : state) {
+        for (VkDescriptorSet& set : sets) {
+            vkAllocateDescriptorSets(device, &allocInfo, &set);
+        }
+        for (VkDescriptorSet set : sets) {
+            vkFreeDescriptorSets(device, pool, 1, &set);
+        }
+    }
+
+    vkDestroyDescriptorPool(device, pool, nullptr);
+    state.set_items_processed(state.iterations() * state.size());
+}
+ENGINE_BENCHMARK(allocate_free_descriptor_sets, 1000, 100000);
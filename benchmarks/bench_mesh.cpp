@@ -0,0 +1,150 @@
+#include <bench.h>
+
+#include <vk_mesh.h>
+
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <random>
+
+//OBJ files are generated once per size and removed when the process exits
+class ObjFiles {
+public:
+    ~ObjFiles()
+    {
+        for (const auto& [triangles, path] : _paths) {
+            std::error_code ignored;
+            std::filesystem::remove(path, ignored);
+        }
+    }
+
+    //a grid of quads with normals and uvs, triangleCount rounded up to a whole row
+    const std::string& get(size_t triangleCount)
+    {
+        auto it = _paths.find(triangleCount);
+        if (it != _paths.end()) {
+            return it->second;
+        }
+
+        const std::filesystem::path path = std::filesystem::temp_directory_path() / ("engine_benchmarks_" + std::to_string(triangleCount) + ".obj");
+        std::ofstream file(path, std::ios::trunc);
+
+        const size_t quadsPerRow = 256;
+        const size_t rows = (triangleCount / 2 + quadsPerRow - 1) / quadsPerRow;
+        for (size_t y = 0; y <= rows; y++) {
+            for (size_t x = 0; x <= quadsPerRow; x++) {
+                file << "v " << x * 0.5f << " " << ((x * 7 + y * 13) % 17) * 0.1f << " " << y * 0.5f << "\n";
+                file << "vn 0 1 0\n";
+                file << "vt " << float(x) / quadsPerRow << " " << float(y) / rows << "\n";
+            }
+        }
+        for (size_t y = 0; y < rows; y++) {
+            for (size_t x = 0; x < quadsPerRow; x++) {
+                //obj indices start at 1
+                const size_t a = y * (quadsPerRow + 1) + x + 1;
+                const size_t b = a + 1;
+                const size_t c = a + quadsPerRow + 1;
+                const size_t d = c + 1;
+                file << "f " << a << "/" << a << "/" << a << " " << c << "/" << c << "/" << c << " " << b << "/" << b << "/" << b << "\n";
+                file << "f " << b << "/" << b << "/" << b << " " << c << "/" << c << "/" << c << " " << d << "/" << d << "/" << d << "\n";
+            }
+        }
+
+        return _paths[triangleCount] = path.string();
+    }
+
+private:
+    std::map<size_t, std::string> _paths;
+};
+
+static ObjFiles objFiles;
+
+//a triangle soup spread over a box, with the attributes the obj loader fills
+static Mesh make_mesh(size_t triangleCount)
+{
+    std::mt19937 random{1234};
+    std::uniform_real_distribution<float> position{-100.f, 100.f};
+    std::uniform_real_distribution<float> offset{-1.f, 1.f};
+
+    Mesh mesh;
+    mesh._vertices.resize(triangleCount * 3);
+    for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+        const glm::vec3 center{position(random), position(random), position(random)};
+        for (size_t corner = 0; corner < 3; corner++) {
+            Vertex& vertex = mesh._vertices[triangle * 3 + corner];
+            vertex.position = center + glm::vec3{offset(random), offset(random), offset(random)};
+            vertex.normal = glm::normalize(glm::vec3{offset(random), offset(random), 0.5f});
+            vertex.color = vertex.normal;
+            vertex.uv = glm::vec2{offset(random), offset(random)} * 0.5f + 0.5f;
+        }
+    }
+    mesh.compute_bounds();
+    return mesh;
+}
+
+static void load_obj(bench::State& state)
+{
+    const std::string& path = objFiles.get(state.size());
+
+    size_t vertexCount = 0;
+    for (auto _ : state) {
+        Mesh mesh;
+        mesh.load_from_obj(path.c_str());
+        vertexCount = mesh._vertices.size();
+        bench::do_not_optimize(mesh._vertices.data());
+    }
+
+    state.set_items_processed(state.iterations() * (vertexCount / 3));
+    state.set_bytes_processed(state.iterations() * std::filesystem::file_size(path));
+}
+ENGINE_BENCHMARK(load_obj, 1000, 1000000);
+
+static void pack_vertices_full(bench::State& state)
+{
+    const Mesh mesh = make_mesh(state.size());
+
+    std::vector<uint32_t> packed;
+    for (auto _ : state) {
+        packed.clear();
+        mesh.pack_vertices(packed);
+        bench::do_not_optimize(packed.data());
+    }
+
+    state.set_items_processed(state.iterations() * mesh._vertices.size());
+}
+ENGINE_BENCHMARK(pack_vertices_full, 1000, 1000000);
+
+static void pack_vertices_packed(bench::State& state)
+{
+    Mesh mesh = make_mesh(state.size());
+    mesh._vertexFormat = VertexFormat::Packed;
+
+    std::vector<uint32_t> packed;
+    for (auto _ : state) {
+        packed.clear();
+        mesh.pack_vertices(packed);
+        bench::do_not_optimize(packed.data());
+    }
+
+    state.set_items_processed(state.iterations() * mesh._vertices.size());
+}
+ENGINE_BENCHMARK(pack_vertices_packed, 1000, 1000000);
+
+static void build_chunks(bench::State& state)
+{
+    const Mesh source = make_mesh(state.size());
+
+    size_t chunkCount = 0;
+    for (auto _ : state) {
+        state.pause_timing();
+        Mesh mesh = source;
+        state.resume_timing();
+
+        mesh.build_chunks(16.f);
+        chunkCount = mesh._chunks.size();
+    }
+
+    state.set_items_processed(state.iterations() * state.size());
+    state.set_counter("chunks", static_cast<double>(chunkCount));
+}
+ENGINE_BENCHMARK(build_chunks, 1000, 1000000);
@@ -0,0 +1,113 @@
+#include <bench.h>
+
+#include <vk_occlusion.h>
+
+#include <random>
+
+#include <glm/gtx/transform.hpp>
+
+static glm::mat4 camera_viewproj()
+{
+    const glm::mat4 view = glm::lookAt(glm::vec3{0.f}, glm::vec3{0.f, 0.f, -1.f}, glm::vec3{0.f, 1.f, 0.f});
+    glm::mat4 projection = glm::perspective(glm::radians(70.f), 1700.f / 900.f, 0.1f, 1000.f);
+    projection[1][1] *= -1;
+    return projection * view;
+}
+
+//wall sized triangles in front of the camera, grouped in occluders of 256 like the engine's chunks
+static std::vector<vkutil::Occluder> make_occluders(size_t triangleCount)
+{
+    std::mt19937 random{7};
+    std::uniform_real_distribution<float> position{-60.f, 60.f};
+    std::uniform_real_distribution<float> depth{-200.f, -5.f};
+    std::uniform_real_distribution<float> offset{-4.f, 4.f};
+
+    std::vector<vkutil::Occluder> occluders((triangleCount + 255) / 256);
+    for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+        vkutil::Occluder& occluder = occluders[triangle / 256];
+        const glm::vec3 center{position(random), position(random) * 0.5f, depth(random)};
+        for (int corner = 0; corner < 3; corner++) {
+            const glm::vec3 cornerPosition = center + glm::vec3{offset(random), offset(random), offset(random) * 0.1f};
+            occluder.positions.push_back(cornerPosition);
+            occluder.bounds.expand(cornerPosition);
+        }
+    }
+    return occluders;
+}
+
+static void rasterize_occluders(bench::State& state, bool scalar, bool parallel)
+{
+    const std::vector<vkutil::Occluder> occluders = make_occluders(state.size());
+
+    vkutil::JobSystem jobs;
+    if (parallel) {
+        jobs.start();
+    }
+
+    vkutil::OcclusionRasterizer rasterizer;
+    rasterizer.resize(256, 128);
+    rasterizer.set_force_scalar(scalar);
+    if (!scalar && !rasterizer.uses_avx2()) {
+        state.skip("no AVX2");
+        return;
+    }
+
+    for (auto _ : state) {
+        rasterizer.clear();
+        rasterizer.rasterize(camera_viewproj(), occluders.data(), occluders.size(), parallel ? &jobs : nullptr);
+    }
+
+    state.set_items_processed(state.iterations() * state.size());
+    state.set_counter("rasterized", rasterizer.stats().trianglesRasterized);
+}
+
+static void rasterize_occluders_scalar(bench::State& state)
+{
+    rasterize_occluders(state, true, false);
+}
+ENGINE_BENCHMARK(rasterize_occluders_scalar, 1000, 100000);
+
+static void rasterize_occluders_avx2(bench::State& state)
+{
+    rasterize_occluders(state, false, false);
+}
+ENGINE_BENCHMARK(rasterize_occluders_avx2, 1000, 100000);
+
+static void rasterize_occluders_avx2_jobs(bench::State& state)
+{
+    rasterize_occluders(state, false, true);
+}
+ENGINE_BENCHMARK(rasterize_occluders_avx2_jobs, 1000, 100000);
+
+//boxes tested against a buffer holding 10000 occluder triangles
+static void test_occludees(bench::State& state)
+{
+    const std::vector<vkutil::Occluder> occluders = make_occluders(10000);
+
+    vkutil::OcclusionRasterizer rasterizer;
+    rasterizer.resize(256, 128);
+    rasterizer.rasterize(camera_viewproj(), occluders.data(), occluders.size(), nullptr);
+
+    std::mt19937 random{11};
+    std::uniform_real_distribution<float> position{-100.f, 100.f};
+    std::uniform_real_distribution<float> depth{-300.f, -1.f};
+    std::vector<AABB> boxes(state.size());
+    for (AABB& box : boxes) {
+        const glm::vec3 center{position(random), position(random) * 0.5f, depth(random)};
+        box.expand(center - glm::vec3{1.f});
+        box.expand(center + glm::vec3{1.f});
+    }
+
+    size_t occluded = 0;
+    for (auto _ : state) {
+        occluded = 0;
+        for (const AABB& box : boxes) {
+            occluded += rasterizer.is_occluded(box);
+        }
+        bench::do_not_optimize(occluded);
+    }
+
+    state.set_items_processed(state.iterations() * state.size());
+    state.set_counter("occluded", static_cast<double>(occluded));
+}
+ENGINE_BENCHMARK(test_occludees, 1000, 1000000);
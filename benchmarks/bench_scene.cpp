@@ -0,0 +1,310 @@
+#include <bench.h>
+
+#include <vk_culling.h>
+#include <vk_draw.h>
+#include <vk_spatial.h>
+
+#include <algorithm>
+#include <random>
+
+#include <glm/gtx/transform.hpp>
+
+//handles the null backend only compares, never dereferences
+template<typename T>
+static T fake_handle(uint64_t value)
+{
+    return (T)(uintptr_t)value;
+}
+
+//objects spread over a cube around the origin, sharing a handful of meshes and materials like the real scene does
+struct SyntheticScene {
+    static constexpr int MESH_COUNT = 16;
+    static constexpr int MATERIAL_COUNT = 8;
+
+    std::vector<Mesh> meshes;
+    std::vector<Material> materials;
+    std::vector<RenderObject> objects;
+    std::vector<glm::vec3> positions;
+
+    explicit SyntheticScene(size_t count)
+    {
+        meshes.resize(MESH_COUNT);
+        for (int i = 0; i < MESH_COUNT; i++) {
+            meshes[i]._bounds.expand(glm::vec3{-1.f - i * 0.1f});
+            meshes[i]._bounds.expand(glm::vec3{1.f + i * 0.1f});
+            meshes[i]._vertexBuffer._buffer = fake_handle<VkBuffer>(0x1000 + i);
+            meshes[i]._arenaOffset = i * 4096;
+        }
+
+        materials.resize(MATERIAL_COUNT);
+        for (int i = 0; i < MATERIAL_COUNT; i++) {
+            materials[i].pipeline = fake_handle<VkPipeline>(0x2000 + i);
+            materials[i].pullingPipeline = fake_handle<VkPipeline>(0x3000 + i);
+            materials[i].pipelineLayout = fake_handle<VkPipelineLayout>(0x4000);
+            materials[i].shadingModel = i % 2;
+        }
+
+        std::mt19937 random{42};
+        std::uniform_real_distribution<float> coordinate{-1000.f, 1000.f};
+        std::uniform_int_distribution<int> mesh{0, MESH_COUNT - 1};
+        std::uniform_int_distribution<int> material{0, MATERIAL_COUNT - 1};
+
+        objects.resize(count);
+        positions.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            positions[i] = glm::vec3{coordinate(random), coordinate(random), coordinate(random)};
+
+            RenderObject& object = objects[i];
+            object.mesh = &meshes[mesh(random)];
+            object.material = &materials[material(random)];
+            object.transformMatrix = glm::translate(positions[i]);
+            object.vertexCount = 36;
+            object.worldBounds = object.mesh->_bounds.transformed(object.transformMatrix);
+        }
+    }
+};
+
+//what the engine's camera builds, looking down -z from the origin
+static glm::mat4 camera_viewproj()
+{
+    const glm::mat4 view = glm::lookAt(glm::vec3{0.f}, glm::vec3{0.f, 0.f, -1.f}, glm::vec3{0.f, 1.f, 0.f});
+    glm::mat4 projection = glm::perspective(glm::radians(70.f), 1700.f / 900.f, 0.1f, 1000.f);
+    projection[1][1] *= -1;
+    return projection * view;
+}
+
+static vkutil::FrameBindings fake_bindings()
+{
+    return vkutil::FrameBindings{fake_handle<VkDescriptorSet>(0x5000), fake_handle<VkDescriptorSet>(0x5001), 0};
+}
+
+//rebuilding every object's matrix and world bounds, as a fully animated scene would each frame
+static void update_transforms(bench::State& state)
+{
+    SyntheticScene scene{state.size()};
+
+    float angle = 0.f;
+    for (auto _ : state) {
+        angle += 0.01f;
+        for (size_t i = 0; i < scene.objects.size(); i++) {
+            RenderObject& object = scene.objects[i];
+            object.transformMatrix = glm::translate(scene.positions[i]) * glm::rotate(angle, glm::vec3{0.f, 1.f, 0.f}) * glm::scale(glm::vec3{1.5f});
+            object.worldBounds = object.mesh->_bounds.transformed(object.transformMatrix);
+        }
+        bench::do_not_optimize(scene.objects.data());
+    }
+
+    state.set_items_processed(state.iterations() * state.size());
+}
+ENGINE_BENCHMARK(update_transforms, 1000, 10000000);
+
+static void cull_objects(bench::State& state)
+{
+    const SyntheticScene scene{state.size()};
+    const vkutil::Frustum frustum = vkutil::extract_frustum(camera_viewproj());
+
+    std::vector<uint32_t> visible;
+    visible.reserve(scene.objects.size());
+    for (auto _ : state) {
+        vkutil::cull_objects(frustum, scene.objects.data(), scene.objects.size(), visible);
+        bench::do_not_optimize(visible.data());
+    }
+
+    state.set_items_processed(state.iterations() * state.size());
+    state.set_counter("visible", static_cast<double>(visible.size()));
+}
+ENGINE_BENCHMARK(cull_objects, 1000, 10000000);
+
+static vkutil::ObjectTree build_tree(const SyntheticScene& scene, std::vector<uint32_t>& outProxies)
+{
+    std::vector<AABB> bounds(scene.objects.size());
+    for (size_t i = 0; i < scene.objects.size(); i++) {
+        bounds[i] = scene.objects[i].worldBounds;
+    }
+
+    vkutil::ObjectTree tree;
+    tree.build(bounds, outProxies);
+    return tree;
+}
+
+static void build_object_tree(bench::State& state)
+{
+    const SyntheticScene scene{state.size()};
+
+    std::vector<uint32_t> proxies;
+    int32_t height = 0;
+    for (auto _ : state) {
+        const vkutil::ObjectTree tree = build_tree(scene, proxies);
+        height = tree.height();
+    }
+
+    state.set_items_processed(state.iterations() * state.size());
+    state.set_counter("height", height);
+}
+ENGINE_BENCHMARK(build_object_tree, 1000, 1000000);
+
+//the same tree from one insert per object, what streaming in objects one at a time costs
+static void insert_object_tree(bench::State& state)
+{
+    const SyntheticScene scene{state.size()};
+
+    int32_t height = 0;
+    for (auto _ : state) {
+        vkutil::ObjectTree tree;
+        for (size_t i = 0; i < scene.objects.size(); i++) {
+            tree.insert(scene.objects[i].worldBounds, static_cast<uint32_t>(i));
+        }
+        height = tree.height();
+    }
+
+    state.set_items_processed(state.iterations() * state.size());
+    state.set_counter("height", height);
+}
+ENGINE_BENCHMARK(insert_object_tree, 1000, 1000000);
+
+//what cull_renderables does with the tree: fattened candidates, sorted back into draw order, then the exact test
+static void cull_objects_tree(bench::State& state)
+{
+    const SyntheticScene scene{state.size()};
+    const vkutil::Frustum frustum = vkutil::extract_frustum(camera_viewproj());
+    std::vector<uint32_t> proxies;
+    const vkutil::ObjectTree tree = build_tree(scene, proxies);
+
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> visible;
+    for (auto _ : state) {
+        tree.query_frustum(frustum, candidates);
+        std::sort(candidates.begin(), candidates.end());
+        vkutil::cull_objects(frustum, scene.objects.data(), candidates, visible);
+        bench::do_not_optimize(visible.data());
+    }
+
+    state.set_items_processed(state.iterations() * state.size());
+    state.set_counter("visible", static_cast<double>(visible.size()));
+}
+ENGINE_BENCHMARK(cull_objects_tree, 1000, 10000000);
+
+//one object in a hundred moves far enough each frame to leave its fattened box
+static void move_objects_tree(bench::State& state)
+{
+    SyntheticScene scene{state.size()};
+    std::vector<uint32_t> proxies;
+    vkutil::ObjectTree tree = build_tree(scene, proxies);
+
+    const size_t movingCount = std::max<size_t>(scene.objects.size() / 100, 1);
+    float offset = 0.f;
+    for (auto _ : state) {
+        offset = offset > 0.f ? -2.f : 2.f;
+        for (size_t i = 0; i < movingCount; i++) {
+            const size_t index = i * 100 % scene.objects.size();
+            scene.objects[index].worldBounds.min.x += offset;
+            scene.objects[index].worldBounds.max.x += offset;
+            tree.move(proxies[index], scene.objects[index].worldBounds);
+        }
+    }
+
+    state.set_items_processed(state.iterations() * movingCount);
+    state.set_counter("height", tree.height());
+}
+ENGINE_BENCHMARK(move_objects_tree, 1000, 1000000);
+
+//what update_object_tree costs on a frame where nothing moved: the marks are empty, so however many objects could
+//move, no proxy is visited
+static void update_object_tree_static(bench::State& state)
+{
+    const SyntheticScene scene{state.size()};
+    std::vector<uint32_t> proxies;
+    vkutil::ObjectTree tree = build_tree(scene, proxies);
+
+    vkutil::MovedObjects moved;
+    uint32_t changed = 0;
+    for (auto _ : state) {
+        changed += moved.update(tree, proxies, scene.objects.data());
+    }
+
+    //the time per frame stays flat whatever the size
+    state.set_counter("changed", changed);
+}
+ENGINE_BENCHMARK(update_object_tree_static, 1000, 1000000);
+
+static void sort_for_drawing(bench::State& state)
+{
+    const SyntheticScene scene{state.size()};
+
+    std::vector<RenderObject> objects;
+    for (auto _ : state) {
+        state.pause_timing();
+        objects = scene.objects;
+        state.resume_timing();
+
+        vkutil::sort_for_drawing(objects);
+    }
+
+    state.set_items_processed(state.iterations() * state.size());
+}
+ENGINE_BENCHMARK(sort_for_drawing, 1000, 10000000);
+
+static void write_object_data(bench::State& state)
+{
+    const SyntheticScene scene{state.size()};
+
+    std::vector<GPUObjectData> objectBuffer(scene.objects.size());
+    for (auto _ : state) {
+        vkutil::write_object_data(scene.objects.data(), static_cast<int>(scene.objects.size()), objectBuffer.data());
+        bench::do_not_optimize(objectBuffer.data());
+    }
+
+    state.set_items_processed(state.iterations() * state.size());
+    state.set_bytes_processed(state.iterations() * state.size() * sizeof(GPUObjectData));
+}
+ENGINE_BENCHMARK(write_object_data, 1000, 10000000);
+
+//the cost of the draw loops themselves, recorded into the null backend so the driver is left out
+static void record_forward_draws(bench::State& state)
+{
+    SyntheticScene scene{state.size()};
+    vkutil::sort_for_drawing(scene.objects);
+
+    std::vector<uint32_t> visible(scene.objects.size());
+    for (size_t i = 0; i < visible.size(); i++) {
+        visible[i] = static_cast<uint32_t>(i);
+    }
+
+    vkutil::NullCommandBackend commands;
+    for (auto _ : state) {
+        commands.reset();
+        vkutil::record_forward_draws(commands, fake_bindings(), scene.objects.data(), visible);
+    }
+
+    if (!commands.errors().empty()) {
+        state.skip(commands.errors().front());
+    }
+    state.set_items_processed(state.iterations() * state.size());
+    state.set_counter("pipeline_binds", commands.counts().pipelineBinds);
+}
+ENGINE_BENCHMARK(record_forward_draws, 1000, 10000000);
+
+static void record_pulled_draws(bench::State& state)
+{
+    SyntheticScene scene{state.size()};
+    vkutil::sort_for_drawing(scene.objects);
+
+    std::vector<uint32_t> visible(scene.objects.size());
+    for (size_t i = 0; i < visible.size(); i++) {
+        visible[i] = static_cast<uint32_t>(i);
+    }
+
+    std::vector<VkDrawIndirectCommand> drawCommands(visible.size());
+    vkutil::NullCommandBackend commands;
+    for (auto _ : state) {
+        commands.reset();
+        vkutil::record_pulled_draws(commands, fake_bindings(), scene.objects.data(), visible, drawCommands.data(), fake_handle<VkBuffer>(0x6000), true);
+    }
+
+    if (!commands.errors().empty()) {
+        state.skip(commands.errors().front());
+    }
+    state.set_items_processed(state.iterations() * state.size());
+    state.set_counter("indirect_draws", commands.counts().indirectDraws);
+}
+ENGINE_BENCHMARK(record_pulled_draws, 1000, 10000000);
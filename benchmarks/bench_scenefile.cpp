@@ -0,0 +1,132 @@
+#include <bench.h>
+
+#include <vk_scenefile.h>
+
+#include <filesystem>
+#include <map>
+#include <random>
+
+#include <glm/gtx/transform.hpp>
+
+//scene files are written once per size and removed when the process exits
+class SceneFiles {
+public:
+    static constexpr uint32_t MESH_COUNT = 16;
+    static constexpr uint32_t MATERIAL_COUNT = 8;
+
+    ~SceneFiles()
+    {
+        for (const auto& [entities, path] : _paths) {
+            std::error_code ignored;
+            std::filesystem::remove(path, ignored);
+        }
+    }
+
+    //entityCount objects spread over a square kilometre, sharing a handful of meshes and materials
+    const std::string& get(size_t entityCount)
+    {
+        auto it = _paths.find(entityCount);
+        if (it != _paths.end()) {
+            return it->second;
+        }
+
+        vkutil::SceneDescription scene;
+        for (uint32_t i = 0; i < MESH_COUNT; i++) {
+            scene.meshes.push_back("mesh_" + std::to_string(i));
+        }
+        for (uint32_t i = 0; i < MATERIAL_COUNT; i++) {
+            scene.materials.push_back("material_" + std::to_string(i));
+        }
+
+        std::mt19937 random{21};
+        std::uniform_real_distribution<float> coordinate{-500.f, 500.f};
+        scene.entities.resize(entityCount);
+        for (size_t i = 0; i < entityCount; i++) {
+            vkutil::SceneEntity& entity = scene.entities[i];
+            entity.transform = glm::translate(glm::vec3{coordinate(random), 0.f, coordinate(random)});
+            entity.mesh = static_cast<uint32_t>(i % MESH_COUNT);
+            entity.material = static_cast<uint32_t>(i % MATERIAL_COUNT);
+            entity.flags = vkutil::SCENE_ENTITY_STATIC;
+        }
+
+        const std::filesystem::path path = std::filesystem::temp_directory_path() / ("engine_benchmarks_" + std::to_string(entityCount) + ".bscene");
+        vkutil::save_scene(path.string(), scene);
+        return _paths[entityCount] = path.string();
+    }
+
+private:
+    std::map<size_t, std::string> _paths;
+};
+
+static SceneFiles sceneFiles;
+
+//names resolved once per table entry, like the engine's get_mesh and get_material lookups
+static void resolve_names(const vkutil::SceneFile& scene, std::vector<Mesh>& meshes, std::vector<Material>& materials,
+    std::vector<Mesh*>& meshTable, std::vector<Material*>& materialTable)
+{
+    meshTable.resize(scene.mesh_count());
+    for (uint32_t i = 0; i < scene.mesh_count(); i++) {
+        meshTable[i] = &meshes[std::stoi(std::string(scene.mesh_name(i).substr(5)))];
+    }
+    materialTable.resize(scene.material_count());
+    for (uint32_t i = 0; i < scene.material_count(); i++) {
+        materialTable[i] = &materials[std::stoi(std::string(scene.material_name(i).substr(9)))];
+    }
+}
+
+//mapping the file and resolving its names, what VulkanEngine::load_scene does. The entities stay in the mapping
+static void load_scene_file(bench::State& state)
+{
+    const std::string& path = sceneFiles.get(state.size());
+
+    std::vector<Mesh> meshes(SceneFiles::MESH_COUNT);
+    std::vector<Material> materials(SceneFiles::MATERIAL_COUNT);
+
+    std::vector<Mesh*> meshTable;
+    std::vector<Material*> materialTable;
+    for (auto _ : state) {
+        vkutil::SceneFile scene;
+        if (!scene.open(path)) {
+            state.skip("failed to write " + path);
+            return;
+        }
+        resolve_names(scene, meshes, materials, meshTable, materialTable);
+        bench::do_not_optimize(scene.entities());
+    }
+
+    state.set_items_processed(state.iterations() * state.size());
+}
+ENGINE_BENCHMARK(load_scene_file, 1000, 1000000);
+
+//building the draw objects from the mapped entities, what VulkanEngine::instantiate_scene does on one thread
+static void instantiate_scene_entities(bench::State& state)
+{
+    const std::string& path = sceneFiles.get(state.size());
+
+    std::vector<Mesh> meshes(SceneFiles::MESH_COUNT);
+    std::vector<Material> materials(SceneFiles::MATERIAL_COUNT);
+    for (Mesh& mesh : meshes) {
+        mesh._vertices.resize(36);
+        mesh._bounds.expand(glm::vec3{-1.f});
+        mesh._bounds.expand(glm::vec3{1.f});
+    }
+
+    vkutil::SceneFile scene;
+    if (!scene.open(path)) {
+        state.skip("failed to write " + path);
+        return;
+    }
+    std::vector<Mesh*> meshTable;
+    std::vector<Material*> materialTable;
+    resolve_names(scene, meshes, materials, meshTable, materialTable);
+
+    std::vector<RenderObject> objects(vkutil::count_entity_objects(scene.entities(), scene.entity_count(), meshTable, materialTable));
+    for (auto _ : state) {
+        vkutil::instantiate_entities(scene.entities(), scene.entity_count(), meshTable, materialTable, objects.data());
+        bench::do_not_optimize(objects.data());
+    }
+
+    state.set_items_processed(state.iterations() * state.size());
+    state.set_bytes_processed(state.iterations() * state.size() * sizeof(vkutil::SceneEntity));
+}
+ENGINE_BENCHMARK(instantiate_scene_entities, 1000, 1000000);
@@ -0,0 +1,247 @@
+//CPU checks of engine code that runs without a device, each one a fixed scene with known answers.
+//Prints one line per failed check and exits with 1 when any failed
+#include <vk_draw.h>
+#include <vk_occlusion.h>
+#include <vk_spatial.h>
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+#include <glm/gtx/transform.hpp>
+
+static int failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            failures++; \
+        } \
+    } while (0)
+
+//what the engine's camera builds, looking down -z from the origin
+static glm::mat4 camera_viewproj()
+{
+    const glm::mat4 view = glm::lookAt(glm::vec3{0.f}, glm::vec3{0.f, 0.f, -1.f}, glm::vec3{0.f, 1.f, 0.f});
+    glm::mat4 projection = glm::perspective(glm::radians(70.f), 2.f, 0.1f, 1000.f);
+    projection[1][1] *= -1;
+    return projection * view;
+}
+
+static AABB box(const glm::vec3& center, float halfSize)
+{
+    AABB bounds;
+    bounds.expand(center - glm::vec3{halfSize});
+    bounds.expand(center + glm::vec3{halfSize});
+    return bounds;
+}
+
+//a square wall facing the camera, two triangles
+static vkutil::Occluder wall(float z, float halfSize)
+{
+    const glm::vec3 corners[4] = {
+        {-halfSize, -halfSize, z}, {halfSize, -halfSize, z}, {halfSize, halfSize, z}, {-halfSize, halfSize, z}};
+
+    vkutil::Occluder occluder;
+    for (int index : {0, 1, 2, 0, 2, 3}) {
+        occluder.positions.push_back(corners[index]);
+        occluder.bounds.expand(corners[index]);
+    }
+    return occluder;
+}
+
+static void check_occlusion_wall()
+{
+    const vkutil::Occluder occluder = wall(-10.f, 5.f);
+
+    vkutil::OcclusionRasterizer rasterizer;
+    rasterizer.resize(256, 128);
+    rasterizer.rasterize(camera_viewproj(), &occluder, 1, nullptr);
+
+    //the wall covers the middle of the screen at depth 1/10, the corners see nothing
+    CHECK(std::abs(rasterizer.pixel_depth(128, 64) - 0.1f) < 1e-4f);
+    CHECK(rasterizer.pixel_depth(0, 0) == 0.f);
+    CHECK(rasterizer.pixel_depth(255, 127) == 0.f);
+
+    CHECK(rasterizer.is_occluded(box({0.f, 0.f, -20.f}, 1.f)));
+    //in front of the wall, crossing it, and beside it behind the wall
+    CHECK(!rasterizer.is_occluded(box({0.f, 0.f, -5.f}, 1.f)));
+    CHECK(!rasterizer.is_occluded(box({0.f, 0.f, -10.f}, 1.f)));
+    CHECK(!rasterizer.is_occluded(box({20.f, 0.f, -20.f}, 1.f)));
+}
+
+//the AVX2 coverage must match the scalar one bit for bit, compared through the depths both leave behind
+static void check_occlusion_avx2_matches_scalar()
+{
+    std::mt19937 random{7};
+    std::uniform_real_distribution<float> position{-60.f, 60.f};
+    std::uniform_real_distribution<float> depth{-200.f, -5.f};
+    std::uniform_real_distribution<float> offset{-4.f, 4.f};
+
+    std::vector<vkutil::Occluder> occluders(8);
+    for (size_t triangle = 0; triangle < 2048; triangle++) {
+        vkutil::Occluder& occluder = occluders[triangle % occluders.size()];
+        const glm::vec3 center{position(random), position(random) * 0.5f, depth(random)};
+        for (int corner = 0; corner < 3; corner++) {
+            const glm::vec3 cornerPosition = center + glm::vec3{offset(random), offset(random), offset(random)};
+            occluder.positions.push_back(cornerPosition);
+            occluder.bounds.expand(cornerPosition);
+        }
+    }
+
+    vkutil::OcclusionRasterizer avx2;
+    avx2.resize(256, 128);
+    if (!avx2.uses_avx2()) {
+        std::printf("occlusion avx2 check skipped, no AVX2\n");
+        return;
+    }
+    vkutil::OcclusionRasterizer scalar;
+    scalar.resize(256, 128);
+    scalar.set_force_scalar(true);
+
+    avx2.rasterize(camera_viewproj(), occluders.data(), occluders.size(), nullptr);
+    scalar.rasterize(camera_viewproj(), occluders.data(), occluders.size(), nullptr);
+
+    uint32_t covered = 0;
+    uint32_t mismatches = 0;
+    for (uint32_t y = 0; y < scalar.height(); y++) {
+        for (uint32_t x = 0; x < scalar.width(); x++) {
+            covered += scalar.pixel_depth(x, y) != 0.f;
+            mismatches += avx2.pixel_depth(x, y) != scalar.pixel_depth(x, y);
+        }
+    }
+    CHECK(covered > 0);
+    CHECK(mismatches == 0);
+}
+
+//handles the null backend only compares, never dereferences
+template<typename T>
+static T fake_handle(uint64_t value)
+{
+    return (T)(uintptr_t)value;
+}
+
+//two materials, the second textured, over two meshes. Sorted, the draw loop has to rebind the pipeline once per
+//material and the vertex buffer whenever the mesh changes, material boundaries included
+static void check_forward_draw_binds()
+{
+    Mesh meshes[2];
+    meshes[0]._vertexBuffer._buffer = fake_handle<VkBuffer>(0x1000);
+    meshes[1]._vertexBuffer._buffer = fake_handle<VkBuffer>(0x1001);
+
+    Material materials[2];
+    materials[0].pipeline = fake_handle<VkPipeline>(0x2000);
+    materials[0].pipelineLayout = fake_handle<VkPipelineLayout>(0x4000);
+    materials[1].pipeline = fake_handle<VkPipeline>(0x2001);
+    materials[1].pipelineLayout = fake_handle<VkPipelineLayout>(0x4000);
+    materials[1].textureSet = fake_handle<VkDescriptorSet>(0x5002);
+
+    const int placement[6][2] = {{1, 1}, {0, 0}, {0, 1}, {1, 0}, {0, 0}, {1, 1}};
+    std::vector<RenderObject> objects(6);
+    for (size_t i = 0; i < objects.size(); i++) {
+        objects[i].material = &materials[placement[i][0]];
+        objects[i].mesh = &meshes[placement[i][1]];
+        objects[i].vertexCount = 36;
+    }
+    //material 0 draws mesh 0, 0, 1 and material 1 draws mesh 0, 1, 1
+    vkutil::sort_for_drawing(objects);
+
+    const vkutil::FrameBindings bindings{fake_handle<VkDescriptorSet>(0x5000), fake_handle<VkDescriptorSet>(0x5001), 0};
+
+    vkutil::NullCommandBackend commands;
+    commands._recordDraws = true;
+    vkutil::record_forward_draws(commands, bindings, objects.data(), {0, 1, 2, 3, 4, 5});
+
+    CHECK(commands.errors().empty());
+    CHECK(commands.counts().pipelineBinds == 2);
+    //global and object sets per material, plus the texture of the second
+    CHECK(commands.counts().descriptorSetBinds == 5);
+    CHECK(commands.counts().vertexBufferBinds == 4);
+    CHECK(commands.counts().pushConstants == 6);
+    CHECK(commands.counts().draws == 6);
+    CHECK(commands.draws().size() == 6);
+    for (size_t i = 0; i < commands.draws().size(); i++) {
+        const vkutil::RecordedDraw& draw = commands.draws()[i];
+        CHECK(draw.pipeline == objects[i].material->pipeline);
+        CHECK(draw.vertexBuffer == objects[i].mesh->_vertexBuffer._buffer);
+        //every mesh has a buffer of its own, its vertices start at the beginning
+        CHECK(draw.vertexBufferOffset == 0);
+        CHECK(draw.firstInstance == i);
+    }
+
+    //with objects culled, the mesh bound last by material 0 is kept for material 1
+    commands.reset();
+    vkutil::record_forward_draws(commands, bindings, objects.data(), {0, 2, 5});
+
+    CHECK(commands.errors().empty());
+    CHECK(commands.counts().pipelineBinds == 2);
+    CHECK(commands.counts().vertexBufferBinds == 2);
+    CHECK(commands.counts().draws == 3);
+    CHECK(commands.draws().back().firstInstance == 5);
+}
+
+//a row of unit boxes. A frame without marks must leave every proxy as it was, a marked object that moved away must be
+//found at its new place and no longer at its old one
+static void check_object_tree_moves()
+{
+    Mesh mesh;
+    mesh._bounds = box(glm::vec3{0.f}, 0.5f);
+
+    std::vector<RenderObject> objects(64);
+    std::vector<AABB> bounds(objects.size());
+    for (size_t i = 0; i < objects.size(); i++) {
+        objects[i].mesh = &mesh;
+        objects[i].worldBounds = box(glm::vec3{i * 2.f, 0.f, 0.f}, 0.5f);
+        bounds[i] = objects[i].worldBounds;
+    }
+
+    vkutil::ObjectTree tree;
+    std::vector<uint32_t> proxies;
+    tree.build(bounds, proxies);
+
+    std::vector<AABB> fatBounds(objects.size());
+    for (size_t i = 0; i < objects.size(); i++) {
+        fatBounds[i] = tree.fat_bounds(proxies[i]);
+    }
+    const int32_t height = tree.height();
+
+    vkutil::MovedObjects moved;
+    CHECK(moved.update(tree, proxies, objects.data()) == 0);
+    CHECK(tree.height() == height);
+    uint32_t unchanged = 0;
+    for (size_t i = 0; i < objects.size(); i++) {
+        const AABB& fat = tree.fat_bounds(proxies[i]);
+        unchanged += fat.min == fatBounds[i].min && fat.max == fatBounds[i].max;
+    }
+    CHECK(unchanged == objects.size());
+
+    //one object leaves its fattened box, the other stays inside it
+    objects[10].worldBounds = box(glm::vec3{20.f, 50.f, 0.f}, 0.5f);
+    objects[20].worldBounds = box(glm::vec3{40.1f, 0.f, 0.f}, 0.5f);
+    moved.mark(10);
+    moved.mark(20);
+    CHECK(moved.update(tree, proxies, objects.data()) == 1);
+    CHECK(moved.size() == 0);
+
+    std::vector<uint32_t> found;
+    tree.query_sphere(glm::vec3{20.f, 50.f, 0.f}, 1.f, found);
+    CHECK(found.size() == 1 && found[0] == 10);
+    tree.query_sphere(glm::vec3{20.f, 0.f, 0.f}, 0.6f, found);
+    CHECK(found.empty());
+}
+
+int main()
+{
+    check_occlusion_wall();
+    check_occlusion_avx2_matches_scalar();
+    check_forward_draw_binds();
+    check_object_tree_moves();
+
+    if (failures != 0) {
+        std::printf("%d checks failed\n", failures);
+        return 1;
+    }
+    std::printf("all checks passed\n");
+    return 0;
+}
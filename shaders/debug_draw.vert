@@ -0,0 +1,19 @@
+#version 450
+
+layout (location = 0) in vec3 vPosition;
+layout (location = 1) in vec4 vColor;
+
+layout (location = 0) out vec4 outColor;
+
+layout(set = 0, binding = 0) uniform  CameraBuffer{
+	mat4 view;
+	mat4 proj;
+	mat4 viewproj;
+} cameraData;
+
+void main()
+{
+	//debug lines are given in world space
+	gl_Position = cameraData.viewproj * vec4(vPosition, 1.0f);
+	outColor = vColor;
+}
@@ -0,0 +1,46 @@
+#version 450
+
+//which debug view this pipeline variant draws, must match vkutil::DebugView
+layout (constant_id = 0) const uint DEBUG_VIEW = 1;
+
+const uint DEBUG_VIEW_OVERDRAW = 1;
+const uint DEBUG_VIEW_TRIANGLE_DENSITY = 2;
+const uint DEBUG_VIEW_LOD_LEVEL = 3;
+const uint DEBUG_VIEW_CULL_CLUSTER = 4;
+const uint DEBUG_VIEW_MATERIAL_COST = 5;
+
+//each fragment of the overdraw view adds this much, upscale.frag turns it back into a layer count
+const float OVERDRAW_STEP = 1.0f / 32.0f;
+
+layout (location = 0) flat in vec4 inDebugData;
+layout (location = 1) flat in float inTriangleArea;
+layout (location = 2) flat in uint inClusterId;
+
+//output write
+layout (location = 0) out vec4 outFragColor;
+
+//blue to red through green
+vec3 heat(float t)
+{
+	t = clamp(t, 0.0f, 1.0f);
+	return clamp(vec3(4.0f * t - 2.0f, 2.0f - abs(4.0f * t - 2.0f), 2.0f - 4.0f * t), 0.0f, 1.0f);
+}
+
+void main()
+{
+	if (DEBUG_VIEW == DEBUG_VIEW_OVERDRAW) {
+		outFragColor = vec4(OVERDRAW_STEP, OVERDRAW_STEP, OVERDRAW_STEP, 1.0f);
+	} else if (DEBUG_VIEW == DEBUG_VIEW_TRIANGLE_DENSITY) {
+		//one pixel triangles are red, anything covering 1024 pixels or more is blue
+		outFragColor = vec4(heat(1.0f - log2(max(inTriangleArea, 1.0f)) / 10.0f), 1.0f);
+	} else if (DEBUG_VIEW == DEBUG_VIEW_LOD_LEVEL) {
+		const vec3 levels[4] = vec3[](vec3(0.2f, 0.9f, 0.2f), vec3(0.2f, 0.5f, 1.0f), vec3(1.0f, 0.8f, 0.1f), vec3(1.0f, 0.2f, 0.2f));
+		outFragColor = vec4(levels[min(uint(inDebugData.x), 3u)], 1.0f);
+	} else if (DEBUG_VIEW == DEBUG_VIEW_CULL_CLUSTER) {
+		vec3 color = vec3(uvec3(inClusterId, inClusterId >> 8, inClusterId >> 16) & 255u) / 255.0f;
+		outFragColor = vec4(0.25f + 0.75f * color, 1.0f);
+	} else {
+		//multiplied over the shaded scene
+		outFragColor = vec4(mix(vec3(0.4f, 1.0f, 0.4f), vec3(1.0f, 0.3f, 0.3f), inDebugData.y), 1.0f);
+	}
+}
@@ -0,0 +1,82 @@
+#version 460
+#extension GL_GOOGLE_include_directive : require
+
+//x: LOD level, y: relative material cost, zw: render resolution
+layout (location = 0) flat out vec4 outDebugData;
+//triangle area in pixels
+layout (location = 1) flat out float outTriangleArea;
+layout (location = 2) flat out uint outClusterId;
+
+layout(set = 0, binding = 0) uniform  CameraBuffer{
+	mat4 view;
+	mat4 proj;
+	mat4 viewproj;
+} cameraData;
+
+struct ObjectData{
+	mat4 model;
+	uvec4 meshInfo; //x: arena offset, y: shading model, z: vertex format
+};
+
+//all object matrices
+layout (std140, set = 1, binding = 0) readonly buffer ObjectBuffer {
+
+	ObjectData objects[];
+} objectBuffer;
+
+//push constants block
+layout ( push_constant ) uniform constants
+{
+	vec4 data;
+	mat4 render_matrix;
+} PushConstants;
+
+#include "vertex_fetch.glsl"
+
+vec4 project(ObjectData object, uint vertexIndex)
+{
+	PulledVertex vertex = fetch_vertex(object.meshInfo.x, object.meshInfo.z, vertexIndex);
+	//same expression as triangle_mesh.vert, so the material cost tint lands on the same depth
+	mat4 transformMatrix = (cameraData.viewproj * object.model);
+	return transformMatrix * vec4(vertex.position, 1.0f);
+}
+
+uint hash(uint x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return x;
+}
+
+void main()
+{
+	ObjectData object = objectBuffer.objects[gl_BaseInstance];
+	uint vertexIndex = uint(gl_VertexIndex);
+	gl_Position = project(object, vertexIndex);
+
+	//meshes are not indexed, so every 3 consecutive vertices form a triangle
+	uint firstCorner = vertexIndex - vertexIndex % 3;
+	vec4 a = project(object, firstCorner);
+	vec4 b = project(object, firstCorner + 1);
+	vec4 c = project(object, firstCorner + 2);
+
+	//triangles crossing the camera plane are big on screen whatever their size
+	if (min(a.w, min(b.w, c.w)) <= 0.0f) {
+		outTriangleArea = 1e9f;
+	} else {
+		vec2 halfResolution = 0.5f * PushConstants.data.zw;
+		vec2 pa = a.xy / a.w * halfResolution;
+		vec2 pb = b.xy / b.w * halfResolution;
+		vec2 pc = c.xy / c.w * halfResolution;
+		vec2 ab = pb - pa;
+		vec2 ac = pc - pa;
+		outTriangleArea = 0.5f * abs(ab.x * ac.y - ab.y * ac.x);
+	}
+
+	//a chunk is a range of its mesh, so the mesh and the first vertex of the draw identify it
+	outClusterId = hash(object.meshInfo.x * 31u + uint(gl_BaseVertex));
+	outDebugData = PushConstants.data;
+}
@@ -0,0 +1,27 @@
+#version 450
+
+layout (location = 0) out vec4 outColor;
+
+layout(set = 0, binding = 0) uniform  CameraBuffer{
+	mat4 view;
+	mat4 proj;
+	mat4 viewproj;
+} cameraData;
+
+struct Particle {
+	vec4 position;
+	vec4 color;
+};
+
+//written by particles.comp earlier in the frame
+layout (std430, set = 1, binding = 0) readonly buffer ParticleBuffer {
+	Particle particles[];
+} particleBuffer;
+
+void main()
+{
+	Particle particle = particleBuffer.particles[gl_VertexIndex];
+	gl_Position = cameraData.viewproj * particle.position;
+	gl_PointSize = 1.0;
+	outColor = particle.color;
+}
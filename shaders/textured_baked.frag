@@ -0,0 +1,16 @@
+//glsl version 4.5
+#version 450
+
+//shader input, the vertex color holds the light baked with bake_lighting
+layout (location = 0) in vec3 inColor;
+layout (location = 1) in vec2 texCoord;
+//output write
+layout (location = 0) out vec4 outFragColor;
+
+layout (set = 2, binding = 0) uniform sampler2D tex1;
+
+void main()
+{
+    vec3 color = texture(tex1, texCoord).xyz;
+    outFragColor = vec4(color * inColor, 1.0f);
+}
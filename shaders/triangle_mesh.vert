@@ -16,6 +16,7 @@ layout(set = 0, binding = 0) uniform  CameraBuffer{
 
 struct ObjectData{
 	mat4 model;
+	uvec4 meshInfo;
 };
 
 //all object matrices
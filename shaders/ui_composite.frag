@@ -0,0 +1,12 @@
+#version 450
+
+//output write
+layout (location = 0) out vec4 outFragColor;
+
+//the cached UI layer, same size as the window. ImGui blended it over a transparent clear, so its color is premultiplied
+layout(set = 0, binding = 0) uniform sampler2D uiLayer;
+
+void main()
+{
+	outFragColor = texelFetch(uiLayer, ivec2(gl_FragCoord.xy), 0);
+}
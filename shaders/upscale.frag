@@ -0,0 +1,38 @@
+#version 450
+
+//output write
+layout (location = 0) out vec4 outFragColor;
+
+//the scene image, only its top left corner was rendered to when the render scale is below 1
+layout(set = 0, binding = 0) uniform sampler2D sceneImage;
+
+layout( push_constant ) uniform constants
+{
+	vec4 data; //xy: fraction of the scene image that holds this frame, zw: window size in pixels
+	vec4 view; //x: layers per unit of red when the scene image holds overdraw counts, 0 otherwise
+} PushConstants;
+
+//blue to red through green
+vec3 heat(float t)
+{
+	t = clamp(t, 0.0f, 1.0f);
+	return clamp(vec3(4.0f * t - 2.0f, 2.0f - abs(4.0f * t - 2.0f), 2.0f - 4.0f * t), 0.0f, 1.0f);
+}
+
+void main()
+{
+	vec2 uv = gl_FragCoord.xy / PushConstants.data.zw * PushConstants.data.xy;
+
+	//keep the bilinear footprint inside the rendered area
+	vec2 texelSize = 1.0f / vec2(textureSize(sceneImage, 0));
+	uv = min(uv, PushConstants.data.xy - 0.5f * texelSize);
+
+	vec3 color = texture(sceneImage, uv).rgb;
+	if (PushConstants.view.x > 0.0f) {
+		//black where nothing was drawn, red from 8 layers on
+		float layers = color.r * PushConstants.view.x;
+		color = layers < 0.5f ? vec3(0.0f) : heat((layers - 1.0f) / 7.0f);
+	}
+
+	outFragColor = vec4(color, 1.0f);
+}
@@ -0,0 +1,62 @@
+//vertex fetching from the geometry arena, shared by the vertex pulling and visibility resolve shaders
+//must match VertexFormat and Mesh::pack_vertices in vk_mesh
+
+//every mesh, back to back, each in its own vertex format
+layout (std430, set = 1, binding = 1) readonly buffer GeometryArena {
+
+	uint data[];
+} arena;
+
+const uint VERTEX_FORMAT_FULL = 0;
+const uint VERTEX_FORMAT_PACKED = 1;
+
+struct PulledVertex {
+	vec3 position;
+	vec3 normal;
+	vec3 color;
+	vec2 uv;
+};
+
+uint vertex_stride(uint format)
+{
+	return format == VERTEX_FORMAT_PACKED ? 5 : 11;
+}
+
+vec3 fetch_vec3(uint offset)
+{
+	return uintBitsToFloat(uvec3(arena.data[offset], arena.data[offset + 1], arena.data[offset + 2]));
+}
+
+vec2 fetch_vec2(uint offset)
+{
+	return uintBitsToFloat(uvec2(arena.data[offset], arena.data[offset + 1]));
+}
+
+vec3 oct_decode(vec2 e)
+{
+	vec3 v = vec3(e.xy, 1.0f - abs(e.x) - abs(e.y));
+	if (v.z < 0.0f) {
+		v.xy = (1.0f - abs(v.yx)) * mix(vec2(-1.0f), vec2(1.0f), greaterThanEqual(v.xy, vec2(0.0f)));
+	}
+	return normalize(v);
+}
+
+//arenaOffset in words, vertexIndex relative to the start of the mesh
+PulledVertex fetch_vertex(uint arenaOffset, uint format, uint vertexIndex)
+{
+	uint offset = arenaOffset + vertexIndex * vertex_stride(format);
+
+	PulledVertex vertex;
+	vertex.position = fetch_vec3(offset);
+	if (format == VERTEX_FORMAT_PACKED) {
+		vertex.normal = oct_decode(unpackSnorm2x16(arena.data[offset + 3]));
+		//the obj loader sets the color to the normal as well
+		vertex.color = vertex.normal;
+		vertex.uv = unpackHalf2x16(arena.data[offset + 4]);
+	} else {
+		vertex.normal = fetch_vec3(offset + 3);
+		vertex.color = fetch_vec3(offset + 6);
+		vertex.uv = fetch_vec2(offset + 9);
+	}
+	return vertex;
+}
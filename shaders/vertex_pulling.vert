@@ -0,0 +1,34 @@
+#version 460
+#extension GL_GOOGLE_include_directive : require
+
+layout (location = 0) out vec3 outColor;
+layout (location = 1) out vec2 texCoord;
+
+layout(set = 0, binding = 0) uniform  CameraBuffer{
+	mat4 view;
+	mat4 proj;
+	mat4 viewproj;
+} cameraData;
+
+struct ObjectData{
+	mat4 model;
+	uvec4 meshInfo; //x: arena offset, y: shading model, z: vertex format
+};
+
+//all object matrices
+layout (std140, set = 1, binding = 0) readonly buffer ObjectBuffer {
+
+	ObjectData objects[];
+} objectBuffer;
+
+#include "vertex_fetch.glsl"
+
+void main()
+{
+	ObjectData object = objectBuffer.objects[gl_BaseInstance];
+	PulledVertex vertex = fetch_vertex(object.meshInfo.x, object.meshInfo.z, gl_VertexIndex);
+
+	gl_Position = cameraData.viewproj * object.model * vec4(vertex.position, 1.0f);
+	outColor = vertex.color;
+	texCoord = vertex.uv;
+}
@@ -0,0 +1,13 @@
+#version 450
+
+layout (location = 0) flat in uint inObjectId;
+layout (location = 1) flat in uint inTriangleId;
+
+//output write
+layout (location = 0) out uvec2 outVisibility;
+
+void main()
+{
+	//object id is offset by one so a cleared texel reads as empty
+	outVisibility = uvec2(inObjectId + 1, inTriangleId);
+}
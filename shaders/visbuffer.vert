@@ -0,0 +1,33 @@
+#version 460
+
+layout (location = 0) in vec3 vPosition;
+
+layout (location = 0) flat out uint outObjectId;
+layout (location = 1) flat out uint outTriangleId;
+
+layout(set = 0, binding = 0) uniform  CameraBuffer{
+	mat4 view;
+	mat4 proj;
+	mat4 viewproj;
+} cameraData;
+
+struct ObjectData{
+	mat4 model;
+	uvec4 meshInfo;
+};
+
+//all object matrices
+layout (std140, set = 1, binding = 0) readonly buffer ObjectBuffer {
+
+	ObjectData objects[];
+} objectBuffer;
+
+void main()
+{
+	mat4 modelMatrix = objectBuffer.objects[gl_BaseInstance].model;
+	gl_Position = cameraData.viewproj * modelMatrix * vec4(vPosition, 1.0f);
+
+	//meshes are not indexed, so every 3 consecutive vertices form a triangle
+	outObjectId = gl_BaseInstance;
+	outTriangleId = gl_VertexIndex / 3;
+}
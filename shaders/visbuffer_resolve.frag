@@ -0,0 +1,107 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+//output write
+layout (location = 0) out vec4 outFragColor;
+
+layout(set = 0, binding = 0) uniform  CameraBuffer{
+	mat4 view;
+	mat4 proj;
+	mat4 viewproj;
+} cameraData;
+
+layout(set = 0, binding = 1) uniform  SceneData{
+	vec4 fogColor; // w is for exponent
+	vec4 fogDistances; //x for min, y for max, zw unused.
+	vec4 ambientColor;
+	vec4 sunlightDirection; //w for sun power
+	vec4 sunlightColor;
+} sceneData;
+
+struct ObjectData{
+	mat4 model;
+	uvec4 meshInfo; //x: arena offset, y: shading model, z: vertex format
+};
+
+layout (std140, set = 1, binding = 0) readonly buffer ObjectBuffer {
+
+	ObjectData objects[];
+} objectBuffer;
+
+#include "vertex_fetch.glsl"
+
+layout (set = 2, binding = 0) uniform usampler2D visibilityBuffer;
+
+layout (set = 3, binding = 0) uniform sampler2D tex1;
+
+layout( push_constant ) uniform constants
+{
+	vec4 renderExtent; //xy: size in pixels of the region the scene was rendered to, zw unused
+} PushConstants;
+
+//perspective correct barycentrics of a pixel, from the clip space positions of the triangle
+vec3 compute_barycentrics(vec4 pos0, vec4 pos1, vec4 pos2, vec2 ndc)
+{
+	vec3 invW = 1.0f / vec3(pos0.w, pos1.w, pos2.w);
+
+	vec2 ndc0 = pos0.xy * invW.x;
+	vec2 ndc1 = pos1.xy * invW.y;
+	vec2 ndc2 = pos2.xy * invW.z;
+
+	float invDet = 1.0f / determinant(mat2(ndc2 - ndc1, ndc0 - ndc1));
+	vec3 ddx = vec3(ndc1.y - ndc2.y, ndc2.y - ndc0.y, ndc0.y - ndc1.y) * invDet * invW;
+	vec3 ddy = vec3(ndc2.x - ndc1.x, ndc0.x - ndc2.x, ndc1.x - ndc0.x) * invDet * invW;
+	float ddxSum = dot(ddx, vec3(1.0f));
+	float ddySum = dot(ddy, vec3(1.0f));
+
+	vec2 delta = ndc - ndc0;
+	float interpInvW = invW.x + delta.x * ddxSum + delta.y * ddySum;
+	float interpW = 1.0f / interpInvW;
+
+	vec3 barycentrics;
+	barycentrics.x = interpW * (invW.x + delta.x * ddx.x + delta.y * ddy.x);
+	barycentrics.y = interpW * (delta.x * ddx.y + delta.y * ddy.y);
+	barycentrics.z = interpW * (delta.x * ddx.z + delta.y * ddy.z);
+	return barycentrics;
+}
+
+void main()
+{
+	uvec2 visibility = texelFetch(visibilityBuffer, ivec2(gl_FragCoord.xy), 0).xy;
+
+	//nothing was drawn here, keep the clear color
+	if (visibility.x == 0) {
+		discard;
+	}
+
+	ObjectData object = objectBuffer.objects[visibility.x - 1];
+	uint firstVertex = visibility.y * 3;
+
+	mat4 transformMatrix = cameraData.viewproj * object.model;
+
+	vec4 clipPos[3];
+	vec3 colors[3];
+	vec2 uvs[3];
+	for (uint i = 0; i < 3; i++) {
+		PulledVertex vertex = fetch_vertex(object.meshInfo.x, object.meshInfo.z, firstVertex + i);
+		clipPos[i] = transformMatrix * vec4(vertex.position, 1.0f);
+		colors[i] = vertex.color;
+		uvs[i] = vertex.uv;
+	}
+
+	//the visibility buffer is window sized, only its render extent corner holds this frame
+	vec2 ndc = gl_FragCoord.xy / PushConstants.renderExtent.xy * 2.0f - 1.0f;
+	vec3 bary = compute_barycentrics(clipPos[0], clipPos[1], clipPos[2], ndc);
+
+	vec3 color = colors[0] * bary.x + colors[1] * bary.y + colors[2] * bary.z;
+	vec2 texCoord = uvs[0] * bary.x + uvs[1] * bary.y + uvs[2] * bary.z;
+
+	//same shading as default_lit, textured_lit and textured_baked
+	if (object.meshInfo.y == 1) {
+		outFragColor = vec4(textureLod(tex1, texCoord, 0.0f).xyz, 1.0f);
+	} else if (object.meshInfo.y == 2) {
+		outFragColor = vec4(textureLod(tex1, texCoord, 0.0f).xyz * color, 1.0f);
+	} else {
+		outFragColor = vec4(color + sceneData.ambientColor.xyz, 1.0f);
+	}
+}
@@ -1,9 +1,71 @@
 #include <vk_engine.h>
 
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+
 int main(int argc, char* argv[])
 {
 	VulkanEngine engine;
 
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--static-batching") == 0) {
+			engine._enableStaticBatching = true;
+		} else if (strcmp(argv[i], "--world") == 0 && i + 1 < argc) {
+			engine._worldManifestPath = argv[++i];
+		} else if (strcmp(argv[i], "--no-animation") == 0) {
+			engine._animateScene = false;
+		} else if (strcmp(argv[i], "--target-fps") == 0 && i + 1 < argc) {
+			engine._governorSettings.targetFrameMs = 1000.f / static_cast<float>(atof(argv[++i]));
+		} else if (strcmp(argv[i], "--fps-limit") == 0 && i + 1 < argc) {
+			engine._frameRateLimit = static_cast<float>(atof(argv[++i]));
+		} else if (strcmp(argv[i], "--vsync") == 0) {
+			engine._vsync = true;
+		} else if (strcmp(argv[i], "--early-acquire") == 0) {
+			engine._lateAcquire = false;
+		} else if (strcmp(argv[i], "--headless") == 0) {
+			engine._headless = true;
+		} else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+			engine._headlessFrames = static_cast<uint32_t>(atoi(argv[++i]));
+		} else if (strcmp(argv[i], "--hitch-ms") == 0 && i + 1 < argc) {
+			engine._hitchSettings.thresholdMs = static_cast<float>(atof(argv[++i]));
+		} else if (strcmp(argv[i], "--hitch-dir") == 0 && i + 1 < argc) {
+			engine._hitchSettings.outputDirectory = argv[++i];
+		} else if (strcmp(argv[i], "--no-hitch-dumps") == 0) {
+			engine._hitchSettings.enabled = false;
+		} else if (strcmp(argv[i], "--metrics-file") == 0 && i + 1 < argc) {
+			engine._metricsSettings.path = argv[++i];
+		} else if (strcmp(argv[i], "--metrics-interval") == 0 && i + 1 < argc) {
+			engine._metricsSettings.intervalSeconds = static_cast<float>(atof(argv[++i]));
+		} else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+			engine._capturePath = argv[++i];
+		} else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+			engine._replayPath = argv[++i];
+		} else if (strcmp(argv[i], "--occlusion-culling") == 0) {
+			engine._enableOcclusionCulling = true;
+		} else if (strcmp(argv[i], "--pvs") == 0 && i + 1 < argc) {
+			engine._pvsPath = argv[++i];
+		} else if (strcmp(argv[i], "--no-pvs") == 0) {
+			engine._enablePvs = false;
+		} else if (strcmp(argv[i], "--baked-lighting") == 0 && i + 1 < argc) {
+			engine._bakedLightingPath = argv[++i];
+		} else if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc) {
+			engine._scenePath = argv[++i];
+		} else if (strcmp(argv[i], "--no-split-submission") == 0) {
+			engine._splitSubmission = false;
+		} else if (strcmp(argv[i], "--scene-submits") == 0 && i + 1 < argc) {
+			engine._sceneSubmits = static_cast<uint32_t>(atoi(argv[++i]));
+		} else if (strcmp(argv[i], "--no-async-compute") == 0) {
+			engine._useAsyncCompute = false;
+		} else if (strcmp(argv[i], "--no-particles") == 0) {
+			engine._enableParticles = false;
+		} else if (strcmp(argv[i], "--debug-view") == 0 && i + 1 < argc) {
+			if (!vkutil::parse_debug_view(argv[++i], engine._debugView)) {
+				std::cout << "Unknown debug view " << argv[i] << std::endl;
+			}
+		}
+	}
+
 	engine.init();	
 	
 	engine.run();	
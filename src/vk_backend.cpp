@@ -0,0 +1,144 @@
+#include <vk_backend.h>
+
+namespace vkutil {
+
+void VulkanCommandBackend::bind_pipeline(VkPipeline pipeline)
+{
+    vkCmdBindPipeline(_cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+}
+
+void VulkanCommandBackend::bind_descriptor_sets(VkPipelineLayout layout, uint32_t firstSet, uint32_t setCount, const VkDescriptorSet* sets,
+    uint32_t dynamicOffsetCount, const uint32_t* dynamicOffsets)
+{
+    vkCmdBindDescriptorSets(_cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, firstSet, setCount, sets, dynamicOffsetCount, dynamicOffsets);
+}
+
+void VulkanCommandBackend::push_constants(VkPipelineLayout layout, VkShaderStageFlags stages, uint32_t offset, uint32_t size, const void* data)
+{
+    vkCmdPushConstants(_cmd, layout, stages, offset, size, data);
+}
+
+void VulkanCommandBackend::bind_vertex_buffer(VkBuffer buffer, VkDeviceSize offset)
+{
+    vkCmdBindVertexBuffers(_cmd, 0, 1, &buffer, &offset);
+}
+
+void VulkanCommandBackend::draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance)
+{
+    vkCmdDraw(_cmd, vertexCount, instanceCount, firstVertex, firstInstance);
+}
+
+void VulkanCommandBackend::draw_indirect(VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount, uint32_t stride)
+{
+    vkCmdDrawIndirect(_cmd, buffer, offset, drawCount, stride);
+}
+
+void NullCommandBackend::reset()
+{
+    _counts = CommandCounts{};
+    _errors.clear();
+    _draws.clear();
+    _pipeline = VK_NULL_HANDLE;
+    _vertexBuffer = VK_NULL_HANDLE;
+    _vertexBufferOffset = 0;
+    _boundSets = 0;
+}
+
+void NullCommandBackend::error(const std::string& message)
+{
+    //a broken loop would report the same thing for every object
+    if (_errors.size() < 100) {
+        _errors.push_back(message);
+    }
+}
+
+void NullCommandBackend::check_draw_state(const char* command)
+{
+    if (_pipeline == VK_NULL_HANDLE) {
+        error(std::string(command) + " without a bound pipeline");
+    }
+    //every scene pipeline reads the global (0) and object (1) sets
+    if ((_boundSets & 0b11) != 0b11) {
+        error(std::string(command) + " without the global and object descriptor sets bound");
+    }
+}
+
+void NullCommandBackend::bind_pipeline(VkPipeline pipeline)
+{
+    ++_counts.pipelineBinds;
+    if (pipeline == VK_NULL_HANDLE) {
+        error("binding a null pipeline");
+    }
+    _pipeline = pipeline;
+}
+
+void NullCommandBackend::bind_descriptor_sets(VkPipelineLayout layout, uint32_t firstSet, uint32_t setCount, const VkDescriptorSet* sets,
+    uint32_t dynamicOffsetCount, const uint32_t* dynamicOffsets)
+{
+    ++_counts.descriptorSetBinds;
+    if (layout == VK_NULL_HANDLE) {
+        error("binding descriptor sets with a null layout");
+    }
+    if (dynamicOffsetCount > 0 && dynamicOffsets == nullptr) {
+        error("dynamic offsets missing");
+    }
+    for (uint32_t i = 0; i < setCount; i++) {
+        if (sets[i] == VK_NULL_HANDLE) {
+            error("binding a null descriptor set to set " + std::to_string(firstSet + i));
+        }
+        _boundSets |= 1u << (firstSet + i);
+    }
+}
+
+void NullCommandBackend::push_constants(VkPipelineLayout layout, VkShaderStageFlags stages, uint32_t offset, uint32_t size, const void* data)
+{
+    ++_counts.pushConstants;
+    if (offset + size > MAX_PUSH_CONSTANT_BYTES) {
+        error("push constants past " + std::to_string(MAX_PUSH_CONSTANT_BYTES) + " bytes");
+    }
+    if (layout == VK_NULL_HANDLE || stages == 0 || data == nullptr) {
+        error("incomplete push constants");
+    }
+}
+
+void NullCommandBackend::bind_vertex_buffer(VkBuffer buffer, VkDeviceSize offset)
+{
+    ++_counts.vertexBufferBinds;
+    if (buffer == VK_NULL_HANDLE) {
+        error("binding a null vertex buffer");
+    }
+    _vertexBuffer = buffer;
+    _vertexBufferOffset = offset;
+}
+
+void NullCommandBackend::draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance)
+{
+    ++_counts.draws;
+    _counts.vertices += static_cast<uint64_t>(vertexCount) * instanceCount;
+    check_draw_state("draw");
+    if (vertexCount == 0 || instanceCount == 0) {
+        error("empty draw");
+    }
+
+    if (_recordDraws) {
+        _draws.push_back(RecordedDraw{_pipeline, _vertexBuffer, _vertexBufferOffset, vertexCount, firstVertex, firstInstance});
+    }
+}
+
+void NullCommandBackend::draw_indirect(VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount, uint32_t stride)
+{
+    ++_counts.indirectDraws;
+    _counts.indirectDrawCount += drawCount;
+    check_draw_state("indirect draw");
+    if (buffer == VK_NULL_HANDLE) {
+        error("indirect draw from a null buffer");
+    }
+    if (drawCount > 1 && stride < sizeof(VkDrawIndirectCommand)) {
+        error("indirect stride smaller than VkDrawIndirectCommand");
+    }
+    if (offset % 4 != 0) {
+        error("indirect offset not a multiple of 4");
+    }
+}
+
+}
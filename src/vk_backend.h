@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <vk_types.h>
+
+namespace vkutil {
+
+//the commands the scene draws are recorded with. Going through this instead of vkCmd* lets the recording logic
+//run against NullCommandBackend, without a device
+class CommandBackend {
+public:
+    virtual ~CommandBackend() = default;
+
+    virtual void bind_pipeline(VkPipeline pipeline) = 0;
+    virtual void bind_descriptor_sets(VkPipelineLayout layout, uint32_t firstSet, uint32_t setCount, const VkDescriptorSet* sets,
+        uint32_t dynamicOffsetCount, const uint32_t* dynamicOffsets) = 0;
+    virtual void push_constants(VkPipelineLayout layout, VkShaderStageFlags stages, uint32_t offset, uint32_t size, const void* data) = 0;
+    virtual void bind_vertex_buffer(VkBuffer buffer, VkDeviceSize offset) = 0;
+    virtual void draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance) = 0;
+    virtual void draw_indirect(VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount, uint32_t stride) = 0;
+};
+
+//records into a graphics command buffer
+class VulkanCommandBackend : public CommandBackend {
+public:
+    explicit VulkanCommandBackend(VkCommandBuffer cmd) : _cmd(cmd) {}
+
+    void bind_pipeline(VkPipeline pipeline) override;
+    void bind_descriptor_sets(VkPipelineLayout layout, uint32_t firstSet, uint32_t setCount, const VkDescriptorSet* sets,
+        uint32_t dynamicOffsetCount, const uint32_t* dynamicOffsets) override;
+    void push_constants(VkPipelineLayout layout, VkShaderStageFlags stages, uint32_t offset, uint32_t size, const void* data) override;
+    void bind_vertex_buffer(VkBuffer buffer, VkDeviceSize offset) override;
+    void draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance) override;
+    void draw_indirect(VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount, uint32_t stride) override;
+
+private:
+    VkCommandBuffer _cmd;
+};
+
+struct CommandCounts {
+    uint32_t pipelineBinds;
+    uint32_t descriptorSetBinds;
+    uint32_t pushConstants;
+    uint32_t vertexBufferBinds;
+    uint32_t draws;
+    uint32_t indirectDraws;
+    //draws issued through the indirect calls
+    uint32_t indirectDrawCount;
+    uint64_t vertices;
+};
+
+//a direct draw with the state it was recorded under
+struct RecordedDraw {
+    VkPipeline pipeline;
+    VkBuffer vertexBuffer;
+    VkDeviceSize vertexBufferOffset;
+    uint32_t vertexCount;
+    uint32_t firstVertex;
+    uint32_t firstInstance;
+};
+
+//skips the GPU: counts commands, checks that draws have the state they need, and can keep the draws for comparison
+class NullCommandBackend : public CommandBackend {
+public:
+    //the smallest maxPushConstantsSize the spec allows
+    static constexpr uint32_t MAX_PUSH_CONSTANT_BYTES = 128;
+
+    void reset();
+
+    const CommandCounts& counts() const { return _counts; }
+    //one line per problem, e.g. a draw before any pipeline was bound
+    const std::vector<std::string>& errors() const { return _errors; }
+    const std::vector<RecordedDraw>& draws() const { return _draws; }
+
+    void bind_pipeline(VkPipeline pipeline) override;
+    void bind_descriptor_sets(VkPipelineLayout layout, uint32_t firstSet, uint32_t setCount, const VkDescriptorSet* sets,
+        uint32_t dynamicOffsetCount, const uint32_t* dynamicOffsets) override;
+    void push_constants(VkPipelineLayout layout, VkShaderStageFlags stages, uint32_t offset, uint32_t size, const void* data) override;
+    void bind_vertex_buffer(VkBuffer buffer, VkDeviceSize offset) override;
+    void draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance) override;
+    void draw_indirect(VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount, uint32_t stride) override;
+
+    //keep every direct draw in draws(), off by default since large scenes make a lot of them
+    bool _recordDraws{false};
+
+private:
+    void check_draw_state(const char* command);
+    void error(const std::string& message);
+
+    CommandCounts _counts{};
+    std::vector<std::string> _errors;
+    std::vector<RecordedDraw> _draws;
+
+    VkPipeline _pipeline{VK_NULL_HANDLE};
+    VkBuffer _vertexBuffer{VK_NULL_HANDLE};
+    VkDeviceSize _vertexBufferOffset{0};
+    //bit per descriptor set bound so far
+    uint32_t _boundSets{0};
+};
+
+}
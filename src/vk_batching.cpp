@@ -0,0 +1,81 @@
+#include <vk_batching.h>
+
+#include <map>
+#include <tuple>
+
+#include <glm/gtc/matrix_inverse.hpp>
+
+namespace vkutil {
+
+std::vector<StaticBatch> build_static_batches(std::vector<RenderObject>& renderables, float chunkSize)
+{
+    //group by material first and grid cell second, std::map keeps the result deterministic
+    using BatchKey = std::tuple<Material*, int, int, int>;
+    std::map<BatchKey, std::vector<size_t>> groups;
+
+    for (size_t i = 0; i < renderables.size(); i++) {
+        const RenderObject& object = renderables[i];
+        //chunks of a split mesh are already one draw per cell
+        if (!object.isStatic || !object.mesh->_chunks.empty()) {
+            continue;
+        }
+
+        const glm::ivec3 cell = glm::ivec3(glm::floor(object.worldBounds.center() / chunkSize));
+        groups[BatchKey{object.material, cell.x, cell.y, cell.z}].push_back(i);
+    }
+
+    std::vector<StaticBatch> batches;
+    std::vector<bool> merged(renderables.size(), false);
+
+    for (const auto& [key, members] : groups) {
+        if (members.size() < 2) {
+            continue;
+        }
+
+        StaticBatch batch;
+        batch.material = std::get<0>(key);
+        batch.sourceObjectCount = static_cast<uint32_t>(members.size());
+
+        size_t vertexCount = 0;
+        for (size_t index : members) {
+            vertexCount += renderables[index].vertexCount;
+        }
+        batch.mesh._vertices.reserve(vertexCount);
+
+        for (size_t index : members) {
+            const RenderObject& object = renderables[index];
+            const glm::mat4& model = object.transformMatrix;
+            const glm::mat3 normalMatrix = glm::inverseTranspose(glm::mat3(model));
+
+            for (uint32_t v = object.firstVertex; v < object.firstVertex + object.vertexCount; v++) {
+                Vertex vertex = object.mesh->_vertices[v];
+                vertex.position = glm::vec3(model * glm::vec4(vertex.position, 1.f));
+
+                //some meshes (the triangle) have no normals at all
+                const glm::vec3 normal = normalMatrix * vertex.normal;
+                if (glm::dot(normal, normal) > 0.f) {
+                    vertex.normal = glm::normalize(normal);
+                }
+
+                batch.mesh._vertices.push_back(vertex);
+            }
+            merged[index] = true;
+        }
+
+        batch.mesh.compute_bounds();
+        batches.push_back(std::move(batch));
+    }
+
+    //drop everything that went into a batch
+    size_t kept = 0;
+    for (size_t i = 0; i < renderables.size(); i++) {
+        if (!merged[i]) {
+            renderables[kept++] = renderables[i];
+        }
+    }
+    renderables.resize(kept);
+
+    return batches;
+}
+
+}
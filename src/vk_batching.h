@@ -0,0 +1,20 @@
+#pragma once
+
+#include <vector>
+
+#include <vk_scene.h>
+
+namespace vkutil {
+
+//one merged mesh, pre-transformed into world space, drawn with an identity transform
+struct StaticBatch {
+    Mesh mesh;
+    Material* material;
+    uint32_t sourceObjectCount;
+};
+
+//merges static objects that share a material and a cell of a chunkSize grid into a single mesh per cell.
+//Merged objects are removed from renderables, objects alone in their cell are left untouched.
+std::vector<StaticBatch> build_static_batches(std::vector<RenderObject>& renderables, float chunkSize);
+
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace vkutil {
+
+//the engine's binary files are flat little endian dumps of their fields in order, vectors and strings prefixed by
+//their size
+class BinaryWriter {
+public:
+    explicit BinaryWriter(std::ofstream& file) : _file(file) {}
+
+    template<typename T>
+    void value(const T& v) { _file.write(reinterpret_cast<const char*>(&v), sizeof(T)); }
+
+    void string(const std::string& s)
+    {
+        value(static_cast<uint32_t>(s.size()));
+        _file.write(s.data(), s.size());
+    }
+
+    template<typename T>
+    void array(const std::vector<T>& v)
+    {
+        value(static_cast<uint32_t>(v.size()));
+        _file.write(reinterpret_cast<const char*>(v.data()), v.size() * sizeof(T));
+    }
+
+private:
+    std::ofstream& _file;
+};
+
+class BinaryReader {
+public:
+    explicit BinaryReader(std::ifstream& file) : _file(file) {}
+
+    template<typename T>
+    void value(T& v) { _file.read(reinterpret_cast<char*>(&v), sizeof(T)); }
+
+    void string(std::string& s)
+    {
+        uint32_t size = 0;
+        value(size);
+        if (!check_size(size)) {
+            return;
+        }
+        s.resize(size);
+        _file.read(s.data(), size);
+    }
+
+    template<typename T>
+    void array(std::vector<T>& v)
+    {
+        uint32_t size = 0;
+        value(size);
+        if (!check_size(size * sizeof(T))) {
+            return;
+        }
+        v.resize(size);
+        _file.read(reinterpret_cast<char*>(v.data()), size * sizeof(T));
+    }
+
+    bool ok() const { return _file.good(); }
+
+private:
+    //a corrupt size would otherwise allocate whatever it says
+    bool check_size(size_t bytes)
+    {
+        if (bytes > (1u << 30)) {
+            _file.setstate(std::ios::failbit);
+            return false;
+        }
+        return true;
+    }
+
+    std::ifstream& _file;
+};
+
+}
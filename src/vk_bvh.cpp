@@ -0,0 +1,705 @@
+#include <vk_bvh.h>
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BVH_SSE 1
+#include <emmintrin.h>
+#else
+#define BVH_SSE 0
+#endif
+
+namespace vkutil {
+
+namespace {
+
+struct BinaryNode {
+    AABB bounds;
+    //leaves: first triangle and count. Inner nodes: index of the first child, the second follows it, and 0
+    uint32_t first;
+    uint32_t count;
+};
+
+//nodes up to this size always become leaves
+constexpr uint32_t MAX_LEAF_TRIANGLES = 4;
+//SAH bins per axis
+constexpr uint32_t BIN_COUNT = 16;
+//cost of visiting a node relative to testing one triangle
+constexpr float TRAVERSAL_COST = 1.f;
+//nodes up to this size become leaves when no split is cheaper
+constexpr uint32_t MAX_SAH_LEAF_TRIANGLES = 16;
+//keeps the traversal stacks bounded, deeper nodes become leaves whatever their size
+constexpr uint32_t MAX_DEPTH = 64;
+//ranges below this are binned on one thread, the sync costs more than it saves
+constexpr uint32_t PARALLEL_BIN_TRIANGLES = 32768;
+constexpr uint32_t PARALLEL_GRAIN = 4096;
+
+float surface_area(const AABB& box)
+{
+    if (box.empty()) {
+        return 0.f;
+    }
+    const glm::vec3 size = box.max - box.min;
+    return 2.f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+//a run of _triangleIndices under one node, with the boxes of its triangles and of their centroids
+struct BuildRange {
+    uint32_t first;
+    uint32_t count;
+    uint32_t depth;
+    AABB bounds;
+    AABB centroidBounds;
+};
+
+struct Bin {
+    AABB bounds;
+    AABB centroidBounds;
+    uint32_t count{0};
+};
+
+struct Bins {
+    Bin bins[3][BIN_COUNT];
+
+    void merge(const Bins& other)
+    {
+        for (int axis = 0; axis < 3; axis++) {
+            for (uint32_t bin = 0; bin < BIN_COUNT; bin++) {
+                bins[axis][bin].bounds.expand(other.bins[axis][bin].bounds);
+                bins[axis][bin].centroidBounds.expand(other.bins[axis][bin].centroidBounds);
+                bins[axis][bin].count += other.bins[axis][bin].count;
+            }
+        }
+    }
+};
+
+struct Split {
+    int axis;
+    //bins below this one go left
+    uint32_t bin;
+    BuildRange left;
+    BuildRange right;
+};
+
+//binned SAH splitting shared by the serial and the parallel part of the build
+class SahBuilder {
+public:
+    SahBuilder(const std::vector<AABB>& triangleBounds, const std::vector<glm::vec3>& centroids, std::vector<uint32_t>& indices)
+        : _triangleBounds(triangleBounds), _centroids(centroids), _indices(indices)
+    {
+    }
+
+    //splits range in two, or returns false when it should be a leaf. Big ranges are binned on all threads
+    bool split(const BuildRange& range, JobSystem* jobs, Split& outSplit) const
+    {
+        if (range.count <= MAX_LEAF_TRIANGLES || range.depth >= MAX_DEPTH) {
+            return false;
+        }
+
+        const glm::vec3 extent = range.centroidBounds.max - range.centroidBounds.min;
+        if (extent.x <= 0.f && extent.y <= 0.f && extent.z <= 0.f) {
+            //every centroid in the same spot, no plane separates them
+            return range.count > MAX_SAH_LEAF_TRIANGLES && split_in_half(range, outSplit);
+        }
+
+        Bins bins;
+        if (jobs && range.count >= PARALLEL_BIN_TRIANGLES) {
+            const uint32_t rangeCount = (range.count + PARALLEL_GRAIN - 1) / PARALLEL_GRAIN;
+            std::vector<Bins> partial(rangeCount);
+            jobs->parallel_for(range.count, PARALLEL_GRAIN, [&](uint32_t begin, uint32_t end) {
+                bin_triangles(range, range.first + begin, range.first + end, partial[begin / PARALLEL_GRAIN]);
+            });
+            //merged in order so the tree doesn't depend on the thread count
+            for (const Bins& part : partial) {
+                bins.merge(part);
+            }
+        } else {
+            bin_triangles(range, range.first, range.first + range.count, bins);
+        }
+
+        //sweep the bins from both sides, cost of splitting after bin i is left area * left count + right area * right count
+        float bestCost = std::numeric_limits<float>::max();
+        int bestAxis = -1;
+        uint32_t bestBin = 0;
+        for (int axis = 0; axis < 3; axis++) {
+            if (extent[axis] <= 0.f) {
+                continue;
+            }
+
+            float rightCosts[BIN_COUNT];
+            AABB rightBounds;
+            uint32_t rightCount = 0;
+            for (uint32_t bin = BIN_COUNT - 1; bin > 0; bin--) {
+                rightBounds.expand(bins.bins[axis][bin].bounds);
+                rightCount += bins.bins[axis][bin].count;
+                rightCosts[bin] = rightCount > 0 ? surface_area(rightBounds) * rightCount : -1.f;
+            }
+
+            AABB leftBounds;
+            uint32_t leftCount = 0;
+            for (uint32_t bin = 1; bin < BIN_COUNT; bin++) {
+                leftBounds.expand(bins.bins[axis][bin - 1].bounds);
+                leftCount += bins.bins[axis][bin - 1].count;
+                if (leftCount == 0 || rightCosts[bin] < 0.f) {
+                    continue;
+                }
+                const float cost = surface_area(leftBounds) * leftCount + rightCosts[bin];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestBin = bin;
+                }
+            }
+        }
+
+        if (bestAxis < 0) {
+            return range.count > MAX_SAH_LEAF_TRIANGLES && split_in_half(range, outSplit);
+        }
+
+        const float area = surface_area(range.bounds);
+        const float splitCost = TRAVERSAL_COST + (area > 0.f ? bestCost / area : 0.f);
+        if (splitCost >= static_cast<float>(range.count) && range.count <= MAX_SAH_LEAF_TRIANGLES) {
+            return false;
+        }
+
+        outSplit.axis = bestAxis;
+        outSplit.bin = bestBin;
+        outSplit.left = BuildRange{range.first, 0, range.depth + 1, AABB{}, AABB{}};
+        outSplit.right = BuildRange{0, 0, range.depth + 1, AABB{}, AABB{}};
+        for (uint32_t bin = 0; bin < BIN_COUNT; bin++) {
+            BuildRange& side = bin < bestBin ? outSplit.left : outSplit.right;
+            side.bounds.expand(bins.bins[bestAxis][bin].bounds);
+            side.centroidBounds.expand(bins.bins[bestAxis][bin].centroidBounds);
+            side.count += bins.bins[bestAxis][bin].count;
+        }
+        outSplit.right.first = range.first + outSplit.left.count;
+
+        const glm::vec3 scale = bin_scale(range);
+        std::partition(_indices.begin() + range.first, _indices.begin() + range.first + range.count,
+            [&](uint32_t triangle) { return bin_index(range, scale, triangle, bestAxis) < bestBin; });
+        return true;
+    }
+
+    //builds the whole tree under range on the calling thread, range's node is nodes[0]
+    void build_subtree(const BuildRange& range, std::vector<BinaryNode>& nodes) const
+    {
+        nodes.push_back(BinaryNode{range.bounds, range.first, range.count});
+
+        std::vector<std::pair<uint32_t, BuildRange>> pending{{0u, range}};
+        while (!pending.empty()) {
+            const auto [nodeIndex, nodeRange] = pending.back();
+            pending.pop_back();
+
+            Split split;
+            if (!this->split(nodeRange, nullptr, split)) {
+                continue;
+            }
+
+            const uint32_t childIndex = static_cast<uint32_t>(nodes.size());
+            nodes.push_back(BinaryNode{split.left.bounds, split.left.first, split.left.count});
+            nodes.push_back(BinaryNode{split.right.bounds, split.right.first, split.right.count});
+            nodes[nodeIndex].first = childIndex;
+            nodes[nodeIndex].count = 0;
+
+            pending.push_back({childIndex, split.left});
+            pending.push_back({childIndex + 1, split.right});
+        }
+    }
+
+private:
+    glm::vec3 bin_scale(const BuildRange& range) const
+    {
+        //slightly under BIN_COUNT so the largest centroid still lands in the last bin
+        const glm::vec3 extent = range.centroidBounds.max - range.centroidBounds.min;
+        glm::vec3 scale;
+        for (int axis = 0; axis < 3; axis++) {
+            scale[axis] = extent[axis] > 0.f ? (BIN_COUNT * 0.9999f) / extent[axis] : 0.f;
+        }
+        return scale;
+    }
+
+    uint32_t bin_index(const BuildRange& range, const glm::vec3& scale, uint32_t triangle, int axis) const
+    {
+        const float offset = (_centroids[triangle][axis] - range.centroidBounds.min[axis]) * scale[axis];
+        return std::min(static_cast<uint32_t>(std::max(offset, 0.f)), BIN_COUNT - 1);
+    }
+
+    void bin_triangles(const BuildRange& range, uint32_t begin, uint32_t end, Bins& bins) const
+    {
+        const glm::vec3 scale = bin_scale(range);
+        for (uint32_t i = begin; i < end; i++) {
+            const uint32_t triangle = _indices[i];
+            for (int axis = 0; axis < 3; axis++) {
+                Bin& bin = bins.bins[axis][bin_index(range, scale, triangle, axis)];
+                bin.bounds.expand(_triangleBounds[triangle]);
+                bin.centroidBounds.expand(_centroids[triangle]);
+                bin.count++;
+            }
+        }
+    }
+
+    bool split_in_half(const BuildRange& range, Split& outSplit) const
+    {
+        const uint32_t leftCount = range.count / 2;
+        outSplit.axis = -1;
+        outSplit.left = range_bounds(range.first, leftCount, range.depth + 1);
+        outSplit.right = range_bounds(range.first + leftCount, range.count - leftCount, range.depth + 1);
+        return true;
+    }
+
+    BuildRange range_bounds(uint32_t first, uint32_t count, uint32_t depth) const
+    {
+        BuildRange range{first, count, depth, AABB{}, AABB{}};
+        for (uint32_t i = first; i < first + count; i++) {
+            range.bounds.expand(_triangleBounds[_indices[i]]);
+            range.centroidBounds.expand(_centroids[_indices[i]]);
+        }
+        return range;
+    }
+
+    const std::vector<AABB>& _triangleBounds;
+    const std::vector<glm::vec3>& _centroids;
+    std::vector<uint32_t>& _indices;
+};
+
+}
+
+void TriangleBvh::build(const std::vector<glm::vec3>& positions, JobSystem* jobs)
+{
+    const uint32_t triangleCount = static_cast<uint32_t>(positions.size() / 3);
+    if (jobs && jobs->thread_count() < 2) {
+        jobs = nullptr;
+    }
+
+    _nodes.clear();
+    _positions.clear();
+    _triangleIndices.clear();
+    _bounds = AABB{};
+    if (triangleCount == 0) {
+        return;
+    }
+
+    std::vector<AABB> triangleBounds(triangleCount);
+    std::vector<glm::vec3> centroids(triangleCount);
+    auto computeBounds = [&](uint32_t begin, uint32_t end) {
+        for (uint32_t triangle = begin; triangle < end; triangle++) {
+            AABB& bounds = triangleBounds[triangle];
+            for (uint32_t corner = 0; corner < 3; corner++) {
+                bounds.expand(positions[triangle * 3 + corner]);
+            }
+            centroids[triangle] = bounds.center();
+        }
+    };
+    if (jobs) {
+        jobs->parallel_for(triangleCount, PARALLEL_GRAIN, computeBounds);
+    } else {
+        computeBounds(0, triangleCount);
+    }
+
+    _triangleIndices.resize(triangleCount);
+    std::iota(_triangleIndices.begin(), _triangleIndices.end(), 0);
+
+    BuildRange root{0, triangleCount, 0, AABB{}, AABB{}};
+    for (uint32_t triangle = 0; triangle < triangleCount; triangle++) {
+        root.bounds.expand(triangleBounds[triangle]);
+        root.centroidBounds.expand(centroids[triangle]);
+    }
+
+    const SahBuilder builder{triangleBounds, centroids, _triangleIndices};
+
+    //the top of the tree is split here, binning big nodes on all threads, until the ranges left are small enough to
+    //hand one to each job. Without jobs the root is the only subtree
+    const uint32_t subtreeTriangles = jobs ? std::max(triangleCount / (jobs->thread_count() * 4), PARALLEL_GRAIN) : triangleCount;
+    std::vector<BinaryNode> binaryNodes{BinaryNode{root.bounds, 0, triangleCount}};
+    std::vector<std::pair<uint32_t, BuildRange>> subtrees;
+    std::vector<std::pair<uint32_t, BuildRange>> pending{{0u, root}};
+    while (!pending.empty()) {
+        const auto [nodeIndex, range] = pending.back();
+        pending.pop_back();
+
+        if (range.count <= subtreeTriangles) {
+            subtrees.push_back({nodeIndex, range});
+            continue;
+        }
+
+        Split split;
+        if (!builder.split(range, jobs, split)) {
+            continue;
+        }
+
+        const uint32_t childIndex = static_cast<uint32_t>(binaryNodes.size());
+        binaryNodes.push_back(BinaryNode{split.left.bounds, split.left.first, split.left.count});
+        binaryNodes.push_back(BinaryNode{split.right.bounds, split.right.first, split.right.count});
+        binaryNodes[nodeIndex].first = childIndex;
+        binaryNodes[nodeIndex].count = 0;
+
+        pending.push_back({childIndex, split.left});
+        pending.push_back({childIndex + 1, split.right});
+    }
+
+    //subtrees touch disjoint runs of _triangleIndices, each builds into its own nodes
+    std::vector<std::vector<BinaryNode>> subtreeNodes(subtrees.size());
+    auto buildSubtrees = [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            builder.build_subtree(subtrees[i].second, subtreeNodes[i]);
+        }
+    };
+    if (jobs) {
+        jobs->parallel_for(static_cast<uint32_t>(subtrees.size()), 1, buildSubtrees);
+    } else {
+        buildSubtrees(0, static_cast<uint32_t>(subtrees.size()));
+    }
+
+    //a subtree's root replaces the node it was built for, the rest is appended after the nodes already there
+    for (size_t i = 0; i < subtrees.size(); i++) {
+        const std::vector<BinaryNode>& nodes = subtreeNodes[i];
+        const uint32_t base = static_cast<uint32_t>(binaryNodes.size()) - 1;
+        for (size_t local = 0; local < nodes.size(); local++) {
+            BinaryNode node = nodes[local];
+            if (node.count == 0) {
+                node.first += base;
+            }
+            if (local == 0) {
+                binaryNodes[subtrees[i].first] = node;
+            } else {
+                binaryNodes.push_back(node);
+            }
+        }
+    }
+
+    _positions.resize(static_cast<size_t>(triangleCount) * 3);
+    for (uint32_t i = 0; i < triangleCount; i++) {
+        const uint32_t triangle = _triangleIndices[i];
+        for (uint32_t corner = 0; corner < 3; corner++) {
+            _positions[i * 3 + corner] = positions[triangle * 3 + corner];
+        }
+    }
+
+    _bounds = binaryNodes[0].bounds;
+
+    //collapse into four wide nodes: every node takes the two children of its binary node, then keeps opening the
+    //inner child with the largest surface until it holds four
+    _nodes.emplace_back();
+    std::vector<std::pair<uint32_t, uint32_t>> collapse{{0u, 0u}};
+    while (!collapse.empty()) {
+        const auto [nodeIndex, binaryIndex] = collapse.back();
+        collapse.pop_back();
+
+        std::vector<uint32_t> children;
+        if (binaryNodes[binaryIndex].count > 0) {
+            //a root small enough to be a leaf
+            children.push_back(binaryIndex);
+        } else {
+            children = {binaryNodes[binaryIndex].first, binaryNodes[binaryIndex].first + 1};
+        }
+        while (children.size() < 4) {
+            int largest = -1;
+            for (size_t i = 0; i < children.size(); i++) {
+                if (binaryNodes[children[i]].count == 0 && (largest < 0 || surface_area(binaryNodes[children[i]].bounds) > surface_area(binaryNodes[children[largest]].bounds))) {
+                    largest = static_cast<int>(i);
+                }
+            }
+            if (largest < 0) {
+                break;
+            }
+            const uint32_t opened = children[largest];
+            children[largest] = binaryNodes[opened].first;
+            children.push_back(binaryNodes[opened].first + 1);
+        }
+
+        Node4 node{};
+        node.childCount = static_cast<uint32_t>(children.size());
+        for (uint32_t lane = 0; lane < 4; lane++) {
+            //unused lanes get an inverted box that no slab test passes
+            const AABB bounds = lane < children.size() ? binaryNodes[children[lane]].bounds : AABB{};
+            node.minX[lane] = bounds.min.x;
+            node.minY[lane] = bounds.min.y;
+            node.minZ[lane] = bounds.min.z;
+            node.maxX[lane] = bounds.max.x;
+            node.maxY[lane] = bounds.max.y;
+            node.maxZ[lane] = bounds.max.z;
+            if (lane >= children.size()) {
+                continue;
+            }
+
+            const BinaryNode& child = binaryNodes[children[lane]];
+            if (child.count > 0) {
+                node.children[lane] = LEAF_BIT | child.first;
+                node.counts[lane] = child.count;
+            } else {
+                node.children[lane] = static_cast<uint32_t>(_nodes.size());
+                _nodes.emplace_back();
+                collapse.push_back({node.children[lane], children[lane]});
+            }
+        }
+        _nodes[nodeIndex] = node;
+    }
+}
+
+namespace {
+
+//Moller-Trumbore, false when the ray misses. t is the distance along the ray, u and v the barycentrics
+bool ray_triangle(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, float& t, float& u, float& v)
+{
+    const glm::vec3 edge1 = p1 - p0;
+    const glm::vec3 edge2 = p2 - p0;
+    const glm::vec3 p = glm::cross(direction, edge2);
+    const float determinant = glm::dot(edge1, p);
+    if (std::abs(determinant) < 1e-12f) {
+        return false;
+    }
+
+    const float inverseDeterminant = 1.f / determinant;
+    const glm::vec3 s = origin - p0;
+    u = glm::dot(s, p) * inverseDeterminant;
+    if (u < 0.f || u > 1.f) {
+        return false;
+    }
+    const glm::vec3 q = glm::cross(s, edge1);
+    v = glm::dot(direction, q) * inverseDeterminant;
+    if (v < 0.f || u + v > 1.f) {
+        return false;
+    }
+    t = glm::dot(edge2, q) * inverseDeterminant;
+    return true;
+}
+
+//a ray set up once for the slab tests of every node it visits
+struct NodeRay {
+    glm::vec3 origin;
+    glm::vec3 inverseDirection;
+#if BVH_SSE
+    __m128 originX, originY, originZ;
+    __m128 inverseX, inverseY, inverseZ;
+#endif
+
+    NodeRay(const glm::vec3& rayOrigin, const glm::vec3& direction) : origin(rayOrigin)
+    {
+        //axis parallel rays would divide by zero, a tiny component keeps the slabs finite
+        for (int axis = 0; axis < 3; axis++) {
+            const float component = std::abs(direction[axis]) < 1e-20f ? 1e-20f : direction[axis];
+            inverseDirection[axis] = 1.f / component;
+        }
+#if BVH_SSE
+        originX = _mm_set1_ps(origin.x);
+        originY = _mm_set1_ps(origin.y);
+        originZ = _mm_set1_ps(origin.z);
+        inverseX = _mm_set1_ps(inverseDirection.x);
+        inverseY = _mm_set1_ps(inverseDirection.y);
+        inverseZ = _mm_set1_ps(inverseDirection.z);
+#endif
+    }
+};
+
+//slab test of four child boxes at once, bit i set when lane i is hit between minT and maxT. Writes where each lane is
+//entered
+template<typename Node>
+uint32_t intersect_children(const Node& node, const NodeRay& ray, float minT, float maxT, float outEnter[4])
+{
+    uint32_t hitMask;
+#if BVH_SSE
+    const __m128 t0x = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minX), ray.originX), ray.inverseX);
+    const __m128 t1x = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxX), ray.originX), ray.inverseX);
+    const __m128 t0y = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minY), ray.originY), ray.inverseY);
+    const __m128 t1y = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxY), ray.originY), ray.inverseY);
+    const __m128 t0z = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minZ), ray.originZ), ray.inverseZ);
+    const __m128 t1z = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxZ), ray.originZ), ray.inverseZ);
+    const __m128 enter = _mm_max_ps(_mm_max_ps(_mm_min_ps(t0x, t1x), _mm_min_ps(t0y, t1y)), _mm_max_ps(_mm_min_ps(t0z, t1z), _mm_set1_ps(minT)));
+    const __m128 exit = _mm_min_ps(_mm_min_ps(_mm_max_ps(t0x, t1x), _mm_max_ps(t0y, t1y)), _mm_min_ps(_mm_max_ps(t0z, t1z), _mm_set1_ps(maxT)));
+    hitMask = static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(enter, exit)));
+    _mm_storeu_ps(outEnter, enter);
+#else
+    hitMask = 0;
+    for (uint32_t lane = 0; lane < 4; lane++) {
+        const glm::vec3 t0 = (glm::vec3(node.minX[lane], node.minY[lane], node.minZ[lane]) - ray.origin) * ray.inverseDirection;
+        const glm::vec3 t1 = (glm::vec3(node.maxX[lane], node.maxY[lane], node.maxZ[lane]) - ray.origin) * ray.inverseDirection;
+        const glm::vec3 tNear = glm::min(t0, t1);
+        const glm::vec3 tFar = glm::max(t0, t1);
+        const float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, minT));
+        const float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxT));
+        hitMask |= (enter <= exit ? 1u : 0u) << lane;
+        outEnter[lane] = enter;
+    }
+#endif
+    //the inverted boxes of unused lanes can still pass for rays along an axis, mask them out
+    return hitMask & ((1u << node.childCount) - 1);
+}
+
+//bit i set when the box of lane i overlaps box
+template<typename Node>
+uint32_t overlap_children(const Node& node, const AABB& box)
+{
+    uint32_t overlapMask;
+#if BVH_SSE
+    const __m128 outsideX = _mm_or_ps(_mm_cmpgt_ps(_mm_loadu_ps(node.minX), _mm_set1_ps(box.max.x)), _mm_cmplt_ps(_mm_loadu_ps(node.maxX), _mm_set1_ps(box.min.x)));
+    const __m128 outsideY = _mm_or_ps(_mm_cmpgt_ps(_mm_loadu_ps(node.minY), _mm_set1_ps(box.max.y)), _mm_cmplt_ps(_mm_loadu_ps(node.maxY), _mm_set1_ps(box.min.y)));
+    const __m128 outsideZ = _mm_or_ps(_mm_cmpgt_ps(_mm_loadu_ps(node.minZ), _mm_set1_ps(box.max.z)), _mm_cmplt_ps(_mm_loadu_ps(node.maxZ), _mm_set1_ps(box.min.z)));
+    overlapMask = static_cast<uint32_t>(_mm_movemask_ps(_mm_or_ps(_mm_or_ps(outsideX, outsideY), outsideZ))) ^ 0xF;
+#else
+    overlapMask = 0;
+    for (uint32_t lane = 0; lane < 4; lane++) {
+        const bool outside = node.minX[lane] > box.max.x || node.maxX[lane] < box.min.x
+            || node.minY[lane] > box.max.y || node.maxY[lane] < box.min.y
+            || node.minZ[lane] > box.max.z || node.maxZ[lane] < box.min.z;
+        overlapMask |= (outside ? 0u : 1u) << lane;
+    }
+#endif
+    return overlapMask & ((1u << node.childCount) - 1);
+}
+
+}
+
+bool TriangleBvh::segment_blocked(const glm::vec3& from, const glm::vec3& to) const
+{
+    //t runs from 0 at from to 1 at to, the ends are left out so surfaces the segment starts or ends on don't count
+    return any_hit(from, to - from, 1e-4f, 1.f - 1e-4f);
+}
+
+bool TriangleBvh::ray_blocked(const glm::vec3& origin, const glm::vec3& direction, float minDistance, float maxDistance) const
+{
+    return any_hit(origin, direction, minDistance, maxDistance);
+}
+
+bool TriangleBvh::any_hit(const glm::vec3& origin, const glm::vec3& direction, float minT, float maxT) const
+{
+    if (_nodes.empty()) {
+        return false;
+    }
+
+    const NodeRay ray{origin, direction};
+    uint32_t stack[256];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const Node4& node = _nodes[stack[--stackSize]];
+
+        float enter[4];
+        const uint32_t hitMask = intersect_children(node, ray, minT, maxT, enter);
+        for (uint32_t lane = 0; lane < 4; lane++) {
+            if (!(hitMask & (1u << lane))) {
+                continue;
+            }
+
+            const uint32_t child = node.children[lane];
+            if (!(child & LEAF_BIT)) {
+                stack[stackSize++] = child;
+                continue;
+            }
+
+            const uint32_t first = child & ~LEAF_BIT;
+            for (uint32_t triangle = first; triangle < first + node.counts[lane]; triangle++) {
+                float t, u, v;
+                if (ray_triangle(origin, direction, _positions[triangle * 3], _positions[triangle * 3 + 1], _positions[triangle * 3 + 2], t, u, v) && t > minT && t < maxT) {
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+bool TriangleBvh::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RayHit& outHit) const
+{
+    if (_nodes.empty()) {
+        return false;
+    }
+
+    const NodeRay ray{origin, direction};
+    float closest = maxDistance;
+    bool found = false;
+
+    //nodes with the distance their box is entered at, those beyond the closest hit so far are skipped when popped
+    struct StackEntry {
+        uint32_t node;
+        float enter;
+    };
+    StackEntry stack[256];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = StackEntry{0, 0.f};
+    while (stackSize > 0) {
+        const StackEntry entry = stack[--stackSize];
+        if (entry.enter > closest) {
+            continue;
+        }
+        const Node4& node = _nodes[entry.node];
+
+        float enter[4];
+        const uint32_t hitMask = intersect_children(node, ray, 0.f, closest, enter);
+
+        //inner children pushed farthest first so the nearest is opened next
+        StackEntry inner[4];
+        uint32_t innerCount = 0;
+        for (uint32_t lane = 0; lane < 4; lane++) {
+            if (!(hitMask & (1u << lane))) {
+                continue;
+            }
+
+            const uint32_t child = node.children[lane];
+            if (!(child & LEAF_BIT)) {
+                uint32_t slot = innerCount++;
+                for (; slot > 0 && inner[slot - 1].enter < enter[lane]; slot--) {
+                    inner[slot] = inner[slot - 1];
+                }
+                inner[slot] = StackEntry{child, enter[lane]};
+                continue;
+            }
+
+            const uint32_t first = child & ~LEAF_BIT;
+            for (uint32_t triangle = first; triangle < first + node.counts[lane]; triangle++) {
+                float t, u, v;
+                if (ray_triangle(origin, direction, _positions[triangle * 3], _positions[triangle * 3 + 1], _positions[triangle * 3 + 2], t, u, v) && t >= 0.f && t < closest) {
+                    closest = t;
+                    found = true;
+                    outHit = RayHit{t, _triangleIndices[triangle], u, v};
+                }
+            }
+        }
+        for (uint32_t i = 0; i < innerCount; i++) {
+            stack[stackSize++] = inner[i];
+        }
+    }
+    return found;
+}
+
+void TriangleBvh::query_box(const AABB& box, std::vector<uint32_t>& outTriangles) const
+{
+    if (_nodes.empty()) {
+        return;
+    }
+
+    uint32_t stack[256];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const Node4& node = _nodes[stack[--stackSize]];
+
+        const uint32_t overlapMask = overlap_children(node, box);
+        for (uint32_t lane = 0; lane < 4; lane++) {
+            if (!(overlapMask & (1u << lane))) {
+                continue;
+            }
+
+            const uint32_t child = node.children[lane];
+            if (!(child & LEAF_BIT)) {
+                stack[stackSize++] = child;
+                continue;
+            }
+
+            const uint32_t first = child & ~LEAF_BIT;
+            for (uint32_t triangle = first; triangle < first + node.counts[lane]; triangle++) {
+                const glm::vec3& p0 = _positions[triangle * 3];
+                const glm::vec3& p1 = _positions[triangle * 3 + 1];
+                const glm::vec3& p2 = _positions[triangle * 3 + 2];
+                const glm::vec3 triangleMin = glm::min(glm::min(p0, p1), p2);
+                const glm::vec3 triangleMax = glm::max(glm::max(p0, p1), p2);
+                if (glm::all(glm::lessThanEqual(triangleMin, box.max)) && glm::all(glm::lessThanEqual(box.min, triangleMax))) {
+                    outTriangles.push_back(_triangleIndices[triangle]);
+                }
+            }
+        }
+    }
+}
+
+}
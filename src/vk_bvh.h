@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <vk_jobs.h>
+#include <vk_mesh.h>
+#include <glm/glm.hpp>
+
+namespace vkutil {
+
+struct RayHit {
+    //distance along the ray, in multiples of its direction's length
+    float distance;
+    //index of the triangle in the positions given to TriangleBvh::build
+    uint32_t triangle;
+    //barycentrics of the hit, weights of the triangle's second and third corner
+    float u;
+    float v;
+};
+
+//bounding volume hierarchy over a triangle soup, three positions per triangle, for ray and box queries on the CPU.
+//Built top down with binned SAH splits, then collapsed into nodes of four children whose boxes are tested together
+//with SSE
+class TriangleBvh {
+public:
+    //with jobs, big nodes are binned on all threads and the subtrees below them are built in parallel
+    void build(const std::vector<glm::vec3>& positions, JobSystem* jobs = nullptr);
+
+    //true when a triangle crosses the segment between from and to, ends excluded
+    bool segment_blocked(const glm::vec3& from, const glm::vec3& to) const;
+
+    //true when a triangle is hit at a distance between minDistance and maxDistance along direction, which must be
+    //normalized
+    bool ray_blocked(const glm::vec3& origin, const glm::vec3& direction, float minDistance, float maxDistance) const;
+
+    //closest triangle hit within maxDistance, if any. Distances are in multiples of direction's length, so a ray moved
+    //into object space keeps measuring in world units
+    bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RayHit& outHit) const;
+
+    //appends the triangles whose bounds overlap box, by their index in the build positions
+    void query_box(const AABB& box, std::vector<uint32_t>& outTriangles) const;
+
+    const AABB& bounds() const { return _bounds; }
+    size_t triangle_count() const { return _positions.size() / 3; }
+    size_t node_count() const { return _nodes.size(); }
+    uint32_t triangle_index(uint32_t triangle) const { return _triangleIndices[triangle]; }
+
+private:
+    //set in Node4::children for leaves, the rest is the first triangle
+    static constexpr uint32_t LEAF_BIT = 0x80000000u;
+
+    struct Node4 {
+        //child boxes as structure of arrays, one lane per child
+        float minX[4], minY[4], minZ[4];
+        float maxX[4], maxY[4], maxZ[4];
+        //inner children: node index. Leaves: LEAF_BIT | first triangle, with the triangle count in counts
+        uint32_t children[4];
+        uint32_t counts[4];
+        //lanes holding a child, children are packed from lane 0
+        uint32_t childCount;
+    };
+
+    //any hit along origin + t * direction for t in minT..maxT
+    bool any_hit(const glm::vec3& origin, const glm::vec3& direction, float minT, float maxT) const;
+
+    AABB _bounds;
+    std::vector<Node4> _nodes;
+    std::vector<glm::vec3> _positions;
+    std::vector<uint32_t> _triangleIndices;
+};
+
+}
@@ -0,0 +1,107 @@
+#include <vk_capture.h>
+#include <vk_binary.h>
+
+#include <fstream>
+#include <iostream>
+
+namespace vkutil {
+
+//"VKFC" and the layout version, bumped whenever a field is added
+static constexpr uint32_t CAPTURE_MAGIC = 0x43464B56;
+static constexpr uint32_t CAPTURE_VERSION = 1;
+
+bool save_capture(const std::string& path, const FrameCapture& capture)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        std::cout << "Failed to write capture " << path << std::endl;
+        return false;
+    }
+
+    BinaryWriter writer(file);
+    writer.value(CAPTURE_MAGIC);
+    writer.value(CAPTURE_VERSION);
+
+    writer.value(capture.frameNumber);
+    writer.value(capture.animationFrame);
+    writer.value(capture.camPos);
+    writer.value(capture.cameraFar);
+    writer.value(capture.renderScale);
+    writer.value(capture.drawDistanceScale);
+    writer.value(capture.flags);
+
+    writer.value(static_cast<uint32_t>(capture.objects.size()));
+    for (const CapturedObject& object : capture.objects) {
+        writer.string(object.mesh);
+        writer.string(object.material);
+        writer.value(object.transform);
+        writer.value(object.firstVertex);
+        writer.value(object.vertexCount);
+        writer.value(object.worldBounds.min);
+        writer.value(object.worldBounds.max);
+        writer.value(static_cast<uint8_t>(object.isStatic));
+    }
+
+    writer.array(capture.drawList);
+    writer.array(capture.cameraData);
+    writer.array(capture.sceneData);
+
+    return file.good();
+}
+
+bool load_capture(const std::string& path, FrameCapture& outCapture)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cout << "Failed to open capture " << path << std::endl;
+        return false;
+    }
+
+    BinaryReader reader(file);
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    reader.value(magic);
+    reader.value(version);
+    if (magic != CAPTURE_MAGIC || version != CAPTURE_VERSION) {
+        std::cout << path << " is not a version " << CAPTURE_VERSION << " frame capture" << std::endl;
+        return false;
+    }
+
+    reader.value(outCapture.frameNumber);
+    reader.value(outCapture.animationFrame);
+    reader.value(outCapture.camPos);
+    reader.value(outCapture.cameraFar);
+    reader.value(outCapture.renderScale);
+    reader.value(outCapture.drawDistanceScale);
+    reader.value(outCapture.flags);
+
+    uint32_t objectCount = 0;
+    reader.value(objectCount);
+    outCapture.objects.clear();
+    for (uint32_t i = 0; i < objectCount && reader.ok(); i++) {
+        CapturedObject object;
+        uint8_t isStatic = 0;
+        reader.string(object.mesh);
+        reader.string(object.material);
+        reader.value(object.transform);
+        reader.value(object.firstVertex);
+        reader.value(object.vertexCount);
+        reader.value(object.worldBounds.min);
+        reader.value(object.worldBounds.max);
+        reader.value(isStatic);
+        object.isStatic = isStatic != 0;
+        outCapture.objects.push_back(std::move(object));
+    }
+
+    reader.array(outCapture.drawList);
+    reader.array(outCapture.cameraData);
+    reader.array(outCapture.sceneData);
+
+    if (!reader.ok()) {
+        std::cout << path << " is truncated or corrupt" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <vk_mesh.h>
+#include <glm/glm.hpp>
+
+namespace vkutil {
+
+//a render object by name, meshes and materials are looked up again when replaying
+struct CapturedObject {
+    std::string mesh;
+    std::string material;
+    glm::mat4 transform;
+    uint32_t firstVertex;
+    uint32_t vertexCount;
+    AABB worldBounds;
+    bool isStatic;
+};
+
+enum CaptureFlags : uint32_t {
+    CAPTURE_VISIBILITY_BUFFER = 1 << 0,
+    CAPTURE_VERTEX_PULLING = 1 << 1,
+    CAPTURE_FRUSTUM_CULLING = 1 << 2,
+};
+
+//everything the engine's per frame work depends on, enough to record the same frame again
+struct FrameCapture {
+    uint64_t frameNumber;
+    uint64_t animationFrame;
+
+    glm::vec3 camPos;
+    float cameraFar;
+    float renderScale;
+    float drawDistanceScale;
+    uint32_t flags;
+
+    std::vector<CapturedObject> objects;
+    //indices into objects that survived culling, replays check their own culling against it
+    std::vector<uint32_t> drawList;
+
+    //uniform blocks as uploaded, kept opaque so this file doesn't depend on the engine's structs
+    std::vector<uint8_t> cameraData;
+    std::vector<uint8_t> sceneData;
+};
+
+bool save_capture(const std::string& path, const FrameCapture& capture);
+bool load_capture(const std::string& path, FrameCapture& outCapture);
+
+}
@@ -0,0 +1,70 @@
+#include <vk_culling.h>
+
+namespace vkutil {
+
+Frustum extract_frustum(const glm::mat4& viewproj)
+{
+    //Gribb-Hartmann, glm matrices are column major so build the rows first
+    const glm::vec4 row0{viewproj[0][0], viewproj[1][0], viewproj[2][0], viewproj[3][0]};
+    const glm::vec4 row1{viewproj[0][1], viewproj[1][1], viewproj[2][1], viewproj[3][1]};
+    const glm::vec4 row2{viewproj[0][2], viewproj[1][2], viewproj[2][2], viewproj[3][2]};
+    const glm::vec4 row3{viewproj[0][3], viewproj[1][3], viewproj[2][3], viewproj[3][3]};
+
+    Frustum frustum;
+    frustum.planes[0] = row3 + row0;
+    frustum.planes[1] = row3 - row0;
+    frustum.planes[2] = row3 + row1;
+    frustum.planes[3] = row3 - row1;
+    //glm::perspective maps depth to -1..1
+    frustum.planes[4] = row3 + row2;
+    frustum.planes[5] = row3 - row2;
+
+    for (glm::vec4& plane : frustum.planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+    return frustum;
+}
+
+void set_far_distance(Frustum& frustum, const glm::vec3& cameraPosition, float distance)
+{
+    //the near plane normal is the view direction
+    const glm::vec3 forward = glm::vec3(frustum.planes[4]);
+    frustum.planes[5] = glm::vec4(-forward, glm::dot(forward, cameraPosition) + distance);
+}
+
+bool is_visible(const Frustum& frustum, const AABB& bounds)
+{
+    const glm::vec3 center = bounds.center();
+    const glm::vec3 extents = bounds.extents();
+
+    for (const glm::vec4& plane : frustum.planes) {
+        //distance of the box corner furthest along the plane normal
+        const float radius = glm::dot(extents, glm::abs(glm::vec3(plane)));
+        if (glm::dot(glm::vec3(plane), center) + plane.w + radius < 0.f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void cull_objects(const Frustum& frustum, const RenderObject* objects, size_t count, std::vector<uint32_t>& outVisible)
+{
+    outVisible.clear();
+    for (size_t i = 0; i < count; i++) {
+        if (is_visible(frustum, objects[i].worldBounds)) {
+            outVisible.push_back(static_cast<uint32_t>(i));
+        }
+    }
+}
+
+void cull_objects(const Frustum& frustum, const RenderObject* objects, const std::vector<uint32_t>& candidates, std::vector<uint32_t>& outVisible)
+{
+    outVisible.clear();
+    for (uint32_t index : candidates) {
+        if (is_visible(frustum, objects[index].worldBounds)) {
+            outVisible.push_back(index);
+        }
+    }
+}
+
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vector>
+
+#include <vk_scene.h>
+#include <glm/glm.hpp>
+
+namespace vkutil {
+
+//six planes (xyz normal pointing inside, w distance): left, right, bottom, top, near, far
+struct Frustum {
+    glm::vec4 planes[6];
+};
+
+//planes of a view-projection matrix built with glm::perspective
+Frustum extract_frustum(const glm::mat4& viewproj);
+
+//moves the far plane to distance from the camera along the view direction
+void set_far_distance(Frustum& frustum, const glm::vec3& cameraPosition, float distance);
+
+//conservative, boxes crossing a corner of the frustum can be reported visible
+bool is_visible(const Frustum& frustum, const AABB& bounds);
+
+//fills outVisible with the indices of the objects whose world bounds intersect the frustum, in order
+void cull_objects(const Frustum& frustum, const RenderObject* objects, size_t count, std::vector<uint32_t>& outVisible);
+
+//the same for the objects listed in candidates only, e.g. what a PotentiallyVisibleSet left
+void cull_objects(const Frustum& frustum, const RenderObject* objects, const std::vector<uint32_t>& candidates, std::vector<uint32_t>& outVisible);
+
+}
@@ -0,0 +1,101 @@
+#include <vk_debugdraw.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace vkutil {
+
+uint32_t debug_color(float r, float g, float b, float a)
+{
+    auto channel = [](float value) {
+        return static_cast<uint32_t>(std::clamp(value, 0.f, 1.f) * 255.f + 0.5f);
+    };
+    return channel(r) | channel(g) << 8 | channel(b) << 16 | channel(a) << 24;
+}
+
+#if DEBUG_DRAW_ENABLED
+
+void DebugDraw::line(const glm::vec3& from, const glm::vec3& to, uint32_t color, bool overlay)
+{
+    if (_depthTested.size() + _overlay.size() + 2 > MAX_VERTICES) {
+        _dropped += 2;
+        return;
+    }
+
+    std::vector<DebugVertex>& vertices = overlay ? _overlay : _depthTested;
+    vertices.push_back(DebugVertex{from, color});
+    vertices.push_back(DebugVertex{to, color});
+}
+
+//the 12 edges of a box given its 8 corners, corner i has bit 0 for x, bit 1 for y and bit 2 for z set at max
+static void box_edges(DebugDraw& debugDraw, const glm::vec3 (&corners)[8], uint32_t color, bool overlay)
+{
+    static constexpr int EDGES[12][2] = {
+        {0, 1}, {2, 3}, {4, 5}, {6, 7},
+        {0, 2}, {1, 3}, {4, 6}, {5, 7},
+        {0, 4}, {1, 5}, {2, 6}, {3, 7},
+    };
+    for (const auto& edge : EDGES) {
+        debugDraw.line(corners[edge[0]], corners[edge[1]], color, overlay);
+    }
+}
+
+void DebugDraw::box(const AABB& bounds, uint32_t color, bool overlay)
+{
+    if (bounds.empty()) {
+        return;
+    }
+
+    glm::vec3 corners[8];
+    for (int i = 0; i < 8; i++) {
+        corners[i] = glm::vec3(i & 1 ? bounds.max.x : bounds.min.x, i & 2 ? bounds.max.y : bounds.min.y, i & 4 ? bounds.max.z : bounds.min.z);
+    }
+    box_edges(*this, corners, color, overlay);
+}
+
+void DebugDraw::frustum(const glm::mat4& viewproj, uint32_t color, bool overlay)
+{
+    //the corners of the clip volume back in world space, glm::perspective maps depth to -1..1
+    const glm::mat4 inverse = glm::inverse(viewproj);
+
+    glm::vec3 corners[8];
+    for (int i = 0; i < 8; i++) {
+        const glm::vec4 clip(i & 1 ? 1.f : -1.f, i & 2 ? 1.f : -1.f, i & 4 ? 1.f : -1.f, 1.f);
+        const glm::vec4 world = inverse * clip;
+        corners[i] = glm::vec3(world) / world.w;
+    }
+    box_edges(*this, corners, color, overlay);
+}
+
+void DebugDraw::grid(const glm::vec3& center, float cellSize, uint32_t cells, uint32_t color, bool overlay)
+{
+    //snapped so the lines stay on the cell boundaries as the center moves
+    const glm::vec3 origin = glm::floor(center / cellSize) * cellSize;
+    const float halfExtent = cells * cellSize * 0.5f;
+
+    for (uint32_t i = 0; i <= cells; i++) {
+        const float offset = i * cellSize - halfExtent;
+        line(origin + glm::vec3(offset, 0.f, -halfExtent), origin + glm::vec3(offset, 0.f, halfExtent), color, overlay);
+        line(origin + glm::vec3(-halfExtent, 0.f, offset), origin + glm::vec3(halfExtent, 0.f, offset), color, overlay);
+    }
+}
+
+DebugDrawCounts DebugDraw::flush(DebugVertex* out, uint32_t capacity)
+{
+    DebugDrawCounts counts;
+    counts.depthTested = std::min(capacity, static_cast<uint32_t>(_depthTested.size()));
+    counts.overlay = std::min(capacity - counts.depthTested, static_cast<uint32_t>(_overlay.size()));
+
+    memcpy(out, _depthTested.data(), counts.depthTested * sizeof(DebugVertex));
+    memcpy(out + counts.depthTested, _overlay.data(), counts.overlay * sizeof(DebugVertex));
+
+    _depthTested.clear();
+    _overlay.clear();
+    _lastDropped = _dropped;
+    _dropped = 0;
+    return counts;
+}
+
+#endif
+
+}
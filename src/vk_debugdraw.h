@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <vk_mesh.h>
+#include <glm/glm.hpp>
+
+//debug drawing is compiled out of release builds, define DEBUG_DRAW_ENABLED to 1 to keep it there
+#ifndef DEBUG_DRAW_ENABLED
+#ifdef NDEBUG
+#define DEBUG_DRAW_ENABLED 0
+#else
+#define DEBUG_DRAW_ENABLED 1
+#endif
+#endif
+
+namespace vkutil {
+
+//one end of a line, color is RGBA8 with red in the low byte
+struct DebugVertex {
+    glm::vec3 position;
+    uint32_t color;
+};
+
+uint32_t debug_color(float r, float g, float b, float a = 1.f);
+
+//line vertex counts of the two kinds of debug primitives, depth tested ones first in the vertex buffer
+struct DebugDrawCounts {
+    uint32_t depthTested;
+    uint32_t overlay;
+};
+
+//immediate mode: primitives are added during the frame, copied into the frame's vertex buffer when it is recorded,
+//then cleared. Everything is drawn as lines, in one draw for the depth tested primitives and one for the overlay ones.
+//In release builds every call is an empty inline function
+class DebugDraw {
+public:
+    //per frame, anything past it is dropped
+    static constexpr uint32_t MAX_VERTICES = 1 << 18;
+
+#if DEBUG_DRAW_ENABLED
+    //overlay primitives ignore depth and are always visible
+    void line(const glm::vec3& from, const glm::vec3& to, uint32_t color, bool overlay = false);
+
+    void box(const AABB& bounds, uint32_t color, bool overlay = false);
+
+    //the volume a view-projection matrix built with glm::perspective sees
+    void frustum(const glm::mat4& viewproj, uint32_t color, bool overlay = false);
+
+    //lines of a cellSize grid on the y = height plane, covering cells around center
+    void grid(const glm::vec3& center, float cellSize, uint32_t cells, uint32_t color, bool overlay = false);
+
+    //copies the primitives into out, depth tested ones first, and clears them
+    DebugDrawCounts flush(DebugVertex* out, uint32_t capacity);
+
+    //vertices the last flushed frame dropped because MAX_VERTICES was reached
+    uint32_t dropped_vertices() const { return _lastDropped; }
+
+private:
+    std::vector<DebugVertex> _depthTested;
+    std::vector<DebugVertex> _overlay;
+    uint32_t _dropped{0};
+    uint32_t _lastDropped{0};
+#else
+    void line(const glm::vec3&, const glm::vec3&, uint32_t, bool = false) {}
+    void box(const AABB&, uint32_t, bool = false) {}
+    void frustum(const glm::mat4&, uint32_t, bool = false) {}
+    void grid(const glm::vec3&, float, uint32_t, uint32_t, bool = false) {}
+    DebugDrawCounts flush(DebugVertex*, uint32_t) { return DebugDrawCounts{0, 0}; }
+    uint32_t dropped_vertices() const { return 0; }
+#endif
+};
+
+}
@@ -0,0 +1,96 @@
+#include <vk_debugview.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+namespace vkutil {
+
+struct DebugViewInfo {
+    const char* name;
+    const char* argument;
+};
+
+static constexpr DebugViewInfo DEBUG_VIEWS[] = {
+    {"None", "none"},
+    {"Overdraw", "overdraw"},
+    {"Triangle density", "triangle-density"},
+    {"LOD level", "lod"},
+    {"Cull clusters", "cluster"},
+    {"Material cost", "material-cost"},
+};
+static_assert(std::size(DEBUG_VIEWS) == static_cast<size_t>(DebugView::Count), "a debug view is missing its names");
+
+const char* debug_view_name(DebugView view)
+{
+    if (view >= DebugView::Count) {
+        return "unknown";
+    }
+    return DEBUG_VIEWS[static_cast<size_t>(view)].name;
+}
+
+bool parse_debug_view(const char* name, DebugView& outView)
+{
+    for (size_t i = 0; i < std::size(DEBUG_VIEWS); i++) {
+        if (strcmp(name, DEBUG_VIEWS[i].argument) == 0) {
+            outView = static_cast<DebugView>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t lod_level(float distance, float drawDistance, uint32_t levels)
+{
+    if (levels == 0 || drawDistance <= 0.f) {
+        return 0;
+    }
+    const float band = std::max(0.f, distance / drawDistance) * levels;
+    return std::min(levels - 1, static_cast<uint32_t>(band));
+}
+
+void MaterialCostTracker::add_sample(const Material* material, float ms)
+{
+    _frameMs[material] += ms;
+}
+
+void MaterialCostTracker::end_frame()
+{
+    //heavy smoothing, the timestamps of a single frame jump around a lot at this granularity
+    constexpr float smoothing = 0.05f;
+
+    for (const auto& [material, ms] : _frameMs) {
+        auto it = _smoothedMs.find(material);
+        if (it == _smoothedMs.end()) {
+            _smoothedMs[material] = ms;
+        } else {
+            it->second += (ms - it->second) * smoothing;
+        }
+    }
+    _frameMs.clear();
+
+    _maxMs = 0.f;
+    for (const auto& [material, ms] : _smoothedMs) {
+        _maxMs = std::max(_maxMs, ms);
+    }
+}
+
+void MaterialCostTracker::clear()
+{
+    _frameMs.clear();
+    _smoothedMs.clear();
+    _maxMs = 0.f;
+}
+
+float MaterialCostTracker::cost_ms(const Material* material) const
+{
+    auto it = _smoothedMs.find(material);
+    return it != _smoothedMs.end() ? it->second : 0.f;
+}
+
+float MaterialCostTracker::relative_cost(const Material* material) const
+{
+    return _maxMs > 0.f ? cost_ms(material) / _maxMs : 0.f;
+}
+
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+
+#include <vk_scene.h>
+
+namespace vkutil {
+
+//what the scene pass shows instead of the shaded scene, values match DEBUG_VIEW_* in debug_view.frag
+enum class DebugView : uint32_t {
+    None = 0,
+    //every fragment adds to the pixel, depth test off, shown as a heat ramp by the upscale pass
+    Overdraw,
+    //screen area of each triangle, red for the smallest
+    TriangleDensity,
+    //band of the draw distance each object falls in, what a distance based LOD pick would use
+    LodLevel,
+    //one color per culled unit, so the chunks of split meshes show up separately
+    CullCluster,
+    //the shaded scene tinted green to red by the GPU time of each material
+    MaterialCost,
+    Count,
+};
+
+const char* debug_view_name(DebugView view);
+
+//takes the command line names: overdraw, triangle-density, lod, cluster, material-cost and none
+bool parse_debug_view(const char* name, DebugView& outView);
+
+//which of `levels` equal slices of drawDistance the distance is in, the last one for anything further
+uint32_t lod_level(float distance, float drawDistance, uint32_t levels);
+
+//GPU time of each material, fed from timestamps written around the draws of each material
+class MaterialCostTracker {
+public:
+    //materials drawn in several runs get the sum of their samples
+    void add_sample(const Material* material, float ms);
+
+    //folds the samples of the frame into the smoothed costs
+    void end_frame();
+
+    void clear();
+
+    float cost_ms(const Material* material) const;
+
+    //0 when free, 1 for the most expensive material
+    float relative_cost(const Material* material) const;
+
+private:
+    std::unordered_map<const Material*, float> _frameMs;
+    std::unordered_map<const Material*, float> _smoothedMs;
+    float _maxMs{0.f};
+};
+
+}
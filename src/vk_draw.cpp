@@ -0,0 +1,150 @@
+#include <vk_draw.h>
+
+#include <algorithm>
+
+namespace vkutil {
+
+static void bind_frame_sets(CommandBackend& commands, const FrameBindings& bindings, VkPipelineLayout layout)
+{
+    commands.bind_descriptor_sets(layout, 0, 1, &bindings.globalDescriptor, 1, &bindings.sceneDataOffset);
+    commands.bind_descriptor_sets(layout, 1, 1, &bindings.objectDescriptor, 0, nullptr);
+}
+
+void sort_for_drawing(std::vector<RenderObject>& objects)
+{
+    auto sortComparator = [](const RenderObject& l, const RenderObject& r){
+        if (l.material == r.material) {
+            return l.mesh < r.mesh;
+        }
+        return l.material < r.material;
+    };
+
+    std::sort(objects.begin(), objects.end(), sortComparator);
+}
+
+void write_object_data(const RenderObject* first, int count, GPUObjectData* out)
+{
+    for (int i = 0; i < count; i++)
+    {
+        const RenderObject& object = first[i];
+        out[i].modelMatrix = object.transformMatrix;
+        out[i].meshInfo = glm::uvec4(object.mesh->_arenaOffset, object.material->shadingModel, static_cast<uint32_t>(object.mesh->_vertexFormat), 0);
+    }
+}
+
+void record_forward_draws(CommandBackend& commands, const FrameBindings& bindings, const RenderObject* first, const std::vector<uint32_t>& visible)
+{
+    const Mesh* lastMesh = nullptr;
+    const Material* lastMaterial = nullptr;
+    for (uint32_t i : visible)
+    {
+        const RenderObject& object = first[i];
+
+        //only bind the pipeline if it doesn't match with the already bound one
+        if (object.material != lastMaterial) {
+            commands.bind_pipeline(object.material->pipeline);
+            lastMaterial = object.material;
+
+            //bind the descriptor sets when changing pipeline
+            bind_frame_sets(commands, bindings, object.material->pipelineLayout);
+
+            if (object.material->textureSet != VK_NULL_HANDLE) {
+                commands.bind_descriptor_sets(object.material->pipelineLayout, 2, 1, &object.material->textureSet, 0, nullptr);
+            }
+        }
+
+        MeshPushConstants constants;
+        constants.render_matrix = object.transformMatrix;
+        commands.push_constants(object.material->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(MeshPushConstants), &constants);
+
+        //only bind the mesh if it's a different one from last bind
+        if (object.mesh != lastMesh) {
+            commands.bind_vertex_buffer(object.mesh->_vertexBuffer._buffer, 0);
+            lastMesh = object.mesh;
+        }
+        //the instance index picks the object data
+        commands.draw(object.vertexCount, 1, object.firstVertex, i);
+    }
+}
+
+void record_pulled_draws(CommandBackend& commands, const FrameBindings& bindings, const RenderObject* first, const std::vector<uint32_t>& visible,
+    VkDrawIndirectCommand* drawCommands, VkBuffer indirectBuffer, bool multiDrawIndirect)
+{
+    const int count = static_cast<int>(visible.size());
+
+    //objects are sorted by material, every run of the same material becomes one batch
+    int batchStart = 0;
+    while (batchStart < count)
+    {
+        const Material* material = first[visible[batchStart]].material;
+
+        int batchEnd = batchStart;
+        while (batchEnd < count && first[visible[batchEnd]].material == material) {
+            //offsets and vertex format come from the object buffer through the instance index
+            const RenderObject& object = first[visible[batchEnd]];
+            VkDrawIndirectCommand& drawCommand = drawCommands[batchEnd];
+            drawCommand.vertexCount = object.vertexCount;
+            drawCommand.instanceCount = 1;
+            drawCommand.firstVertex = object.firstVertex;
+            drawCommand.firstInstance = visible[batchEnd];
+            ++batchEnd;
+        }
+
+        commands.bind_pipeline(material->pullingPipeline);
+        bind_frame_sets(commands, bindings, material->pipelineLayout);
+
+        if (material->textureSet != VK_NULL_HANDLE) {
+            commands.bind_descriptor_sets(material->pipelineLayout, 2, 1, &material->textureSet, 0, nullptr);
+        }
+
+        if (multiDrawIndirect) {
+            commands.draw_indirect(indirectBuffer, batchStart * sizeof(VkDrawIndirectCommand), batchEnd - batchStart, sizeof(VkDrawIndirectCommand));
+        } else {
+            for (int i = batchStart; i < batchEnd; i++) {
+                commands.draw(drawCommands[i].vertexCount, 1, drawCommands[i].firstVertex, drawCommands[i].firstInstance);
+            }
+        }
+
+        batchStart = batchEnd;
+    }
+}
+
+void record_debug_draws(CommandBackend& commands, const FrameBindings& bindings, VkPipeline pipeline, VkPipelineLayout layout,
+    const RenderObject* first, const std::vector<uint32_t>& visible, const std::vector<glm::vec4>& objectData)
+{
+    commands.bind_pipeline(pipeline);
+    bind_frame_sets(commands, bindings, layout);
+
+    for (size_t i = 0; i < visible.size(); i++)
+    {
+        const RenderObject& object = first[visible[i]];
+
+        MeshPushConstants constants;
+        constants.data = objectData[i];
+        constants.render_matrix = object.transformMatrix;
+        commands.push_constants(layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(MeshPushConstants), &constants);
+
+        commands.draw(object.vertexCount, 1, object.firstVertex, visible[i]);
+    }
+}
+
+void record_visibility_draws(CommandBackend& commands, const FrameBindings& bindings, VkPipeline pipeline, VkPipelineLayout layout,
+    const RenderObject* first, const std::vector<uint32_t>& visible)
+{
+    commands.bind_pipeline(pipeline);
+    bind_frame_sets(commands, bindings, layout);
+
+    const Mesh* lastMesh = nullptr;
+    for (uint32_t i : visible)
+    {
+        const RenderObject& object = first[i];
+
+        if (object.mesh != lastMesh) {
+            commands.bind_vertex_buffer(object.mesh->_vertexBuffer._buffer, 0);
+            lastMesh = object.mesh;
+        }
+        commands.draw(object.vertexCount, 1, object.firstVertex, i);
+    }
+}
+
+}
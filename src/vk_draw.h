@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+
+#include <vk_backend.h>
+#include <vk_scene.h>
+
+namespace vkutil {
+
+//descriptor sets every object draw of a frame uses
+struct FrameBindings {
+    VkDescriptorSet globalDescriptor;
+    VkDescriptorSet objectDescriptor;
+    //dynamic offset of this frame's scene data in the global set
+    uint32_t sceneDataOffset;
+};
+
+//orders objects by material, then mesh, so the draw loops rebind as little as possible
+void sort_for_drawing(std::vector<RenderObject>& objects);
+
+//fills the object buffer, one entry per object in order
+void write_object_data(const RenderObject* first, int count, GPUObjectData* out);
+
+//one draw per visible object, pipeline and vertex buffer are only rebound when they change
+void record_forward_draws(CommandBackend& commands, const FrameBindings& bindings, const RenderObject* first, const std::vector<uint32_t>& visible);
+
+//vertex pulling: objects sorted by material become one batch each. The draw commands are written to drawCommands,
+//the mapped contents of indirectBuffer, and issued as one multi draw per batch when multiDrawIndirect is available
+void record_pulled_draws(CommandBackend& commands, const FrameBindings& bindings, const RenderObject* first, const std::vector<uint32_t>& visible,
+    VkDrawIndirectCommand* drawCommands, VkBuffer indirectBuffer, bool multiDrawIndirect);
+
+//every object through one debug view pipeline, vertices pulled from the geometry arena.
+//objectData[i] is pushed as MeshPushConstants::data for visible[i]
+void record_debug_draws(CommandBackend& commands, const FrameBindings& bindings, VkPipeline pipeline, VkPipelineLayout layout,
+    const RenderObject* first, const std::vector<uint32_t>& visible, const std::vector<glm::vec4>& objectData);
+
+//every object through the single visibility pipeline, materials only matter when resolving
+void record_visibility_draws(CommandBackend& commands, const FrameBindings& bindings, VkPipeline pipeline, VkPipelineLayout layout,
+    const RenderObject* first, const std::vector<uint32_t>& visible);
+
+}
@@ -2,6 +2,9 @@
 
 #include <iostream>
 #include <fstream>
+#include <atomic>
+#include <numeric>
+#include <cstring>
 
 #include <SDL.h>
 #include <SDL_vulkan.h>
@@ -9,6 +12,8 @@
 #include <vk_types.h>
 #include <vk_initializers.h>
 #include <vk_textures.h>
+#include <vk_batching.h>
+#include <vk_culling.h>
 
 #include <imgui_impl_sdl.h>
 #include <imgui_impl_vulkan.h>
@@ -24,6 +29,10 @@
 #define VMA_IMPLEMENTATION
 #include <vk_mem_alloc.h>
 
+static uint64_t hash_draw_data(const ImDrawData* drawData);
+static bool is_input_event(const SDL_Event& event);
+static void print_timing_summary(const char* label, std::vector<float> samples);
+
 //we want to immediately abort when there is an error. In normal engines this would give an error message to the user, or perform a dump of state.
 using namespace std;
 #define VK_CHECK(x)                                                 \
@@ -39,19 +48,28 @@ using namespace std;
 
 void VulkanEngine::init()
 {
-    // We initialize SDL and create a window with it.
-    SDL_Init(SDL_INIT_VIDEO);
+    //replays only ever run headless
+    if (!_replayPath.empty()) {
+        _headless = true;
+    }
 
-    SDL_WindowFlags window_flags = (SDL_WindowFlags)(SDL_WINDOW_VULKAN);
+    _jobs.start();
 
-    _window = SDL_CreateWindow(
-        "Vulkan Engine",
-        SDL_WINDOWPOS_UNDEFINED,
-        SDL_WINDOWPOS_UNDEFINED,
-        _windowExtent.width,
-        _windowExtent.height,
-        window_flags
-    );
+    if (!_headless) {
+        // We initialize SDL and create a window with it.
+        SDL_Init(SDL_INIT_VIDEO);
+
+        SDL_WindowFlags window_flags = (SDL_WindowFlags)(SDL_WINDOW_VULKAN);
+
+        _window = SDL_CreateWindow(
+            "Vulkan Engine",
+            SDL_WINDOWPOS_UNDEFINED,
+            SDL_WINDOWPOS_UNDEFINED,
+            _windowExtent.width,
+            _windowExtent.height,
+            window_flags
+        );
+    }
 
     //load the core Vulkan structures
     init_vulkan();
@@ -67,10 +85,20 @@ void VulkanEngine::init()
 
     init_sync_structures();
 
+    init_gpu_timers();
+
     init_descriptors();
 
+    init_visibility_buffer();
+
+    init_scene_target();
+
+    init_ui_layer();
+
     init_pipelines();
 
+    init_particles();
+
     init_imgui();
 
     load_images();
@@ -79,39 +107,109 @@ void VulkanEngine::init()
 
     init_scene();
 
+    //a replay draws the captured objects only, nothing streams in
+    if (!_replayPath.empty()) {
+        _replaying = load_replay();
+        if (!_replaying) {
+            std::cout << "Replay of " << _replayPath << " failed" << std::endl;
+            _headlessFrames = 0;
+        }
+    } else {
+        init_streaming();
+    }
+
+    init_object_buffers();
+
+    init_geometry_arena();
+
+    _framePacer.set_target_rate(_frameRateLimit);
+
+    _latencyTracker.init(FRAME_OVERLAP);
+
+    _profiler.init(_hitchSettings);
+
+    _metrics.start(_metricsSettings);
+
     //everything went fine
     _isInitialized = true;
 }
 void VulkanEngine::cleanup()
 {	
     if (_isInitialized) {
+        _worldStreamer.stop();
+        _metrics.stop();
+        _jobs.stop();
+
         //make sure the GPU has stopped doing its things
         for (auto frameIdx = 0; frameIdx < FRAME_OVERLAP; ++frameIdx) {
             vkWaitForFences(_device, 1, &_frames[frameIdx].renderFence, true, 1000000000);
+            _frames[frameIdx].frameDeletionQueue.flush();
+        }
+
+        //cells still resident at exit
+        DeletionQueue streamedCellsDeletion;
+        while (!_streamedCells.empty()) {
+            unload_streamed_cell(_streamedCells.begin()->first, streamedCellsDeletion);
         }
+        streamedCellsDeletion.flush();
 
         _mainDeletionQueue.flush();
 
          vkDestroyDevice(_device, nullptr);
-         vkDestroySurfaceKHR(_instance, _surface, nullptr);
+         if (!_headless) {
+             vkDestroySurfaceKHR(_instance, _surface, nullptr);
+         }
          vkb::destroy_debug_utils_messenger(_instance, _debug_messenger);
          vkDestroyInstance(_instance, nullptr);
-         SDL_DestroyWindow(_window);
+         if (!_headless) {
+             SDL_DestroyWindow(_window);
+         }
 	}
 }
 
 void VulkanEngine::draw()
 {
-    ImGui::Render();
+    PROFILE_SCOPE(_profiler, "draw");
+
+    auto& currFrame = get_current_frame();
+    {
+        PROFILE_SCOPE(_profiler, "wait for GPU");
+        const auto waitStart = std::chrono::high_resolution_clock::now();
+        //wait until the GPU has finished rendering the last frame. Timeout of 1 second
+        VK_CHECK(vkWaitForFences(_device, 1, &currFrame.renderFence, true, 1000000000));
+        VK_CHECK(vkResetFences(_device, 1, &currFrame.renderFence));
+        record_queue_stall(waitStart);
+    }
+
+    const uint32_t frameSlot = _frameNumber % FRAME_OVERLAP;
+    _latencyTracker.gpu_complete(frameSlot);
+    _latencyTracker.begin_frame(frameSlot);
+
+    {
+        PROFILE_SCOPE(_profiler, "frame deletion queue");
+        currFrame.frameDeletionQueue.flush();
+    }
+
+    update_quality();
 
-    const auto& currFrame = get_current_frame();
-    //wait until the GPU has finished rendering the last frame. Timeout of 1 second
-    VK_CHECK(vkWaitForFences(_device, 1, &currFrame.renderFence, true, 1000000000));
-    VK_CHECK(vkResetFences(_device, 1, &currFrame.renderFence));
+    read_material_timings();
 
-    //request image from the swapchain, one second timeout
-    uint32_t swapchainImageIndex;
-    VK_CHECK(vkAcquireNextImageKHR(_device, _swapchain, 1000000000, currFrame.presentSemaphore, nullptr, &swapchainImageIndex));
+    read_compute_timings();
+
+    //request image from the swapchain, one second timeout. With late acquire this waits until the offscreen
+    //passes are recorded, under vsync the acquire can block and the CPU work gets done in the meantime
+    uint32_t swapchainImageIndex = 0;
+    auto acquireSwapchainImage = [&]() {
+        if (!_headless) {
+            PROFILE_SCOPE(_profiler, "acquire");
+            const auto acquireStart = std::chrono::high_resolution_clock::now();
+            VK_CHECK(vkAcquireNextImageKHR(_device, _swapchain, 1000000000, currFrame.presentSemaphore, nullptr, &swapchainImageIndex));
+            record_queue_stall(acquireStart);
+        }
+    };
+    if (!_lateAcquire) {
+        acquireSwapchainImage();
+    }
 
     //now that we are sure that the commands finished executing, we can safely reset the command buffer to begin recording again.
     VK_CHECK(vkResetCommandBuffer(currFrame.mainCommandBuffer, 0));
@@ -124,9 +222,72 @@ void VulkanEngine::draw()
 
     VK_CHECK(vkBeginCommandBuffer(cmd, &cmdBeginInfo));
 
+    //the scene draws are recorded through the backend interface
+    vkutil::VulkanCommandBackend commands{cmd};
+
+    const uint32_t firstTimestamp = (_frameNumber % FRAME_OVERLAP) * 2;
+    if (_supportsTimestamps) {
+        vkCmdResetQueryPool(cmd, _timestampQueryPool, firstTimestamp, 2);
+        vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, _timestampQueryPool, firstTimestamp);
+    }
+
+    //first, so on a compute queue it runs while the graphics work is recorded and executed
+    simulate_particles(cmd);
+
+    const bool debugView = _debugView != vkutil::DebugView::None;
+    if (_debugView == vkutil::DebugView::MaterialCost && _supportsTimestamps) {
+        vkCmdResetQueryPool(cmd, _materialTimestampPool, frameSlot * (MAX_TIMED_MATERIALS + 1), MAX_TIMED_MATERIALS + 1);
+    }
+
+    if (_rebuildUi) {
+        record_ui_layer(cmd);
+    }
+
+    update_camera();
+
+    update_streaming(cmd);
+
+    update_object_tree();
+    cull_renderables();
+
+    upload_frame_data(_renderables.data(), _renderables.size());
+
+    _latencyTracker.mark(frameSlot, vkutil::LatencyStage::Simulation);
+
+    if (_replaying && _frameNumber == 0 && _visibleObjects != _replayDrawList) {
+        std::cout << "Replay culled to " << _visibleObjects.size() << " objects, the captured frame drew " << _replayDrawList.size() << std::endl;
+    }
+
+    if (_captureRequested) {
+        capture_frame();
+        _captureRequested = false;
+    }
+
+    //debug views draw the objects themselves, the visibility buffer would go unused
+    if (_useVisibilityBuffer && !debugView) {
+        //object id 0 marks an empty texel
+        VkClearValue visibilityClear;
+        visibilityClear.color.uint32[0] = 0;
+        visibilityClear.color.uint32[1] = 0;
+        visibilityClear.color.uint32[2] = 0;
+        visibilityClear.color.uint32[3] = 0;
+
+        VkClearValue visibilityDepthClear;
+        visibilityDepthClear.depthStencil.depth = 1.f;
+
+        const std::vector<VkClearValue> visibilityClearValues{visibilityClear, visibilityDepthClear};
+        const VkRenderPassBeginInfo visibilityRpInfo = vkinit::renderpass_begin_info(_visibilityRenderPass, _renderExtent, _visibilityFramebuffer, visibilityClearValues);
+
+        vkCmdBeginRenderPass(cmd, &visibilityRpInfo, VK_SUBPASS_CONTENTS_INLINE);
+        set_viewport(cmd, _renderExtent);
+        draw_visibility(commands, _renderables.data(), _visibleObjects);
+        vkCmdEndRenderPass(cmd);
+    }
+
     //make a clear-color from frame number. This will flash with a 120*pi frame period.
     VkClearValue clearValue;
-    float flash = abs(sin(_frameNumber / 120.f));
+    //debug views start from black, the overdraw view counts on it
+    float flash = debugView ? 0.f : abs(sin(_animationFrame / 120.f));
     clearValue.color = { { 0.0f, 0.0f, flash, 1.0f } };
 
     //clear depth at 1
@@ -135,60 +296,217 @@ void VulkanEngine::draw()
 
     std::vector<VkClearValue> clearValues{clearValue, depthClear};
 
-    //start the main renderpass.
-    const VkRenderPassBeginInfo rpInfo = vkinit::renderpass_begin_info(_renderPass, _windowExtent, _framebuffers[swapchainImageIndex], clearValues);
+    //only the plain forward pass is cut into chunks, the other paths draw the scene in one go
+    const bool chunkable = !debugView && !_useVisibilityBuffer && !_useVertexPulling;
+    const uint32_t sceneChunks = _splitSubmission && chunkable ? std::clamp<uint32_t>(_sceneSubmits, 1, MAX_SCENE_SUBMITS) : 1;
+
+    //the scene goes into its own image, only the top left _renderExtent of it is used
+    const VkRenderPassBeginInfo sceneRpInfo = vkinit::renderpass_begin_info(_sceneRenderPass, _renderExtent, _sceneFramebuffer, clearValues);
 
-    vkCmdBeginRenderPass(cmd, &rpInfo, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBeginRenderPass(cmd, &sceneRpInfo, VK_SUBPASS_CONTENTS_INLINE);
+    set_viewport(cmd, _renderExtent);
 
     // vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, useColoredTrianglePipeline ? _coloredTrianglePipeline : _trianglePipeline);
     // vkCmdDraw(cmd, 3, 1, 0, 0);
 
-    draw_objects(cmd, _renderables.data(), _renderables.size());
+    if (_debugView == vkutil::DebugView::MaterialCost) {
+        draw_objects_timed(cmd, commands, _renderables.data(), _visibleObjects);
+        draw_debug_view(commands, _renderables.data(), _visibleObjects);
+    } else if (debugView) {
+        draw_debug_view(commands, _renderables.data(), _visibleObjects);
+    } else if (_useVisibilityBuffer) {
+        resolve_visibility(cmd);
+    } else if (_useVertexPulling) {
+        draw_objects_pulled(commands, _renderables.data(), _visibleObjects);
+    } else {
+        draw_objects(commands, _renderables.data(), sceneChunks > 1 ? scene_chunk(0, sceneChunks) : _visibleObjects);
+    }
+
+    if (sceneChunks == 1) {
+        draw_particles(cmd);
+    }
 
-    ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmd);
+#if DEBUG_DRAW_ENABLED
+    add_engine_debug_draws();
+    if (sceneChunks == 1) {
+        draw_debug_lines(cmd);
+    }
+#endif
 
-    //finalize the render pass
     vkCmdEndRenderPass(cmd);
+
+    //the GPU starts on the setup and first chunk while the rest of the frame is recorded. All parts go to the same
+    //queue, so submission order and the scene pass dependencies keep the chunks in order, the scene semaphore
+    //hands the finished scene over to the final part
+    const auto firstSubmitTime = std::chrono::high_resolution_clock::now();
+    if (_splitSubmission) {
+        submit_scene_part(cmd, sceneChunks == 1 ? currFrame.sceneSemaphore : VK_NULL_HANDLE, sceneChunks == 1);
+
+        for (uint32_t chunk = 1; chunk < sceneChunks; chunk++) {
+            PROFILE_SCOPE(_profiler, "scene chunk");
+
+            VkCommandBuffer chunkCmd = currFrame.splitCommandBuffers[chunk - 1];
+            VK_CHECK(vkResetCommandBuffer(chunkCmd, 0));
+            VK_CHECK(vkBeginCommandBuffer(chunkCmd, &cmdBeginInfo));
+
+            const VkRenderPassBeginInfo loadRpInfo = vkinit::renderpass_begin_info(_sceneLoadRenderPass, _renderExtent, _sceneFramebuffer, clearValues);
+            vkCmdBeginRenderPass(chunkCmd, &loadRpInfo, VK_SUBPASS_CONTENTS_INLINE);
+            set_viewport(chunkCmd, _renderExtent);
+
+            vkutil::VulkanCommandBackend chunkCommands{chunkCmd};
+            draw_objects(chunkCommands, _renderables.data(), scene_chunk(chunk, sceneChunks));
+
+            const bool lastChunk = chunk + 1 == sceneChunks;
+            if (lastChunk) {
+                draw_particles(chunkCmd);
+            }
+#if DEBUG_DRAW_ENABLED
+            if (lastChunk) {
+                draw_debug_lines(chunkCmd);
+            }
+#endif
+            vkCmdEndRenderPass(chunkCmd);
+
+            submit_scene_part(chunkCmd, lastChunk ? currFrame.sceneSemaphore : VK_NULL_HANDLE, lastChunk);
+        }
+
+        //the upscale and UI get a command buffer of their own
+        cmd = currFrame.splitCommandBuffers[sceneChunks - 1];
+        VK_CHECK(vkResetCommandBuffer(cmd, 0));
+        VK_CHECK(vkBeginCommandBuffer(cmd, &cmdBeginInfo));
+    }
+
+    if (_lateAcquire) {
+        acquireSwapchainImage();
+    }
+
+    //headless has nothing to present, the frame ends with the scene image
+    if (!_headless) {
+        //start the main renderpass, the UI is drawn over the upscaled scene at full resolution
+        const VkRenderPassBeginInfo rpInfo = vkinit::renderpass_begin_info(_renderPass, _windowExtent, _framebuffers[swapchainImageIndex], clearValues);
+
+        vkCmdBeginRenderPass(cmd, &rpInfo, VK_SUBPASS_CONTENTS_INLINE);
+        set_viewport(cmd, _windowExtent);
+
+        upscale_scene(cmd);
+
+        composite_ui_layer(cmd);
+
+        //finalize the render pass
+        vkCmdEndRenderPass(cmd);
+    }
+
+    if (_supportsTimestamps) {
+        vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, _timestampQueryPool, firstTimestamp + 1);
+    }
     //finalize the command buffer (we can no longer add commands, but it can now be executed)
     VK_CHECK(vkEndCommandBuffer(cmd));
 
+    _latencyTracker.mark(frameSlot, vkutil::LatencyStage::Record);
+
     //prepare the submission to the queue.
     //we want to wait on the currFrame., as that semaphore is signaled when the swapchain is ready
     //we will signal the _renderSemaphore, to signal that rendering has finished
 
-    const std::vector<VkCommandBuffer> cmdBuffers = {cmd};
-    const std::vector<VkSemaphore> presentationSemaphore = {currFrame.presentSemaphore};
-    const std::vector<VkSemaphore> renderSemaphore = {currFrame.renderSemaphore};
-    const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    const VkSubmitInfo submit = vkinit::submit_info(cmdBuffers, presentationSemaphore, renderSemaphore, &waitStage);
+    //with split submission the upscale also waits for the scene parts, the fence covers everything submitted before it
+    std::vector<VkSemaphore> waitSemaphores;
+    std::vector<VkPipelineStageFlags> waitStages;
+    if (!_headless) {
+        waitSemaphores.push_back(currFrame.presentSemaphore);
+        waitStages.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+    }
+    if (_splitSubmission) {
+        waitSemaphores.push_back(currFrame.sceneSemaphore);
+        waitStages.push_back(VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    }
+    const std::vector<VkSemaphore> renderSemaphore = _headless ? std::vector<VkSemaphore>{} : std::vector<VkSemaphore>{currFrame.renderSemaphore};
 
-    //submit command buffer to the queue and execute it.
-    // _renderFence will now block until the graphic commands finish execution
-    VK_CHECK(vkQueueSubmit(_graphicsQueue, 1, &submit, currFrame.renderFence));
+    {
+        PROFILE_SCOPE(_profiler, "submit");
+        //submit command buffer to the queue and execute it.
+        // _renderFence will now block until the graphic commands finish execution
+        submit_graphics(cmd, waitSemaphores, waitStages, renderSemaphore, !_splitSubmission, currFrame.renderFence);
+    }
+    _submitLeadMs = _splitSubmission ? std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - firstSubmitTime).count() : 0.f;
+
+    _latencyTracker.mark(frameSlot, vkutil::LatencyStage::Submit);
 
     // this will put the image we just rendered into the visible window.
     // we want to wait on the _renderSemaphore for that,
     // as it's necessary that drawing commands have finished before the image is displayed to the user
-    const VkPresentInfoKHR presentInfo = vkinit::present_info(_swapchain, currFrame.renderSemaphore, &swapchainImageIndex);
+    if (!_headless) {
+        PROFILE_SCOPE(_profiler, "present");
+        const VkPresentInfoKHR presentInfo = vkinit::present_info(_swapchain, currFrame.renderSemaphore, &swapchainImageIndex);
+
+        VK_CHECK(vkQueuePresentKHR(_graphicsQueue, &presentInfo));
+    }
 
-    VK_CHECK(vkQueuePresentKHR(_graphicsQueue, &presentInfo));
+    _latencyTracker.mark(frameSlot, vkutil::LatencyStage::Present);
+
+    //frame time is measured end to end, the first frame has nothing to measure from
+    const auto frameEndTime = std::chrono::high_resolution_clock::now();
+    if (_lastFrameEndTime != decltype(_lastFrameEndTime){}) {
+        //without timestamp queries _lastGpuFrameMs is the CPU fallback, which doesn't belong in the GPU histogram
+        const float gpuMs = _supportsTimestamps && _frameNumber >= FRAME_OVERLAP ? _lastGpuFrameMs : -1.f;
+        _metrics.record_frame(std::chrono::duration<float, std::milli>(frameEndTime - _lastFrameEndTime).count(), gpuMs);
+    }
+    _lastFrameEndTime = frameEndTime;
+
+    _framePacer.mark_frame();
 
     //increase the number of frames drawn
     ++_frameNumber;
+
+    //the animation only moves when it is on, so turning it off leaves nothing changing on its own
+    if (_animateScene) {
+        ++_animationFrame;
+    }
 }
 
 void VulkanEngine::run()
 {
+    if (_headless) {
+        run_headless();
+        return;
+    }
+
 	SDL_Event e;
 	bool bQuit = false;
 
 	//main loop
 	while (!bQuit)
 	{
+        //nothing changed since the last frame, so sleep until an event arrives instead of drawing the same image again.
+        //The event is left in the queue for the loop below
+        if (_enableIdleSkipping && _uiPendingRebuilds == 0 && !needs_redraw()) {
+            SDL_WaitEventTimeout(nullptr, idle_wait_ms());
+            _idledSinceLastFrame = true;
+        }
+
+        //wait out the rest of the frame before reading input, so what gets drawn is as fresh as it can be.
+        //Like idling, the wait says nothing about the GPU
+        if (_framePacer.wait_for_next_frame()) {
+            _idledSinceLastFrame = true;
+        }
+
+        poll_frame_latency();
+
+        _profiler.begin_frame(_frameNumber);
+
+        _profiler.begin_scope("input");
 		//Handle events on queue
 		while (SDL_PollEvent(&e) != 0)
 		{
             ImGui_ImplSDL2_ProcessEvent(&e);
+            _uiPendingRebuilds = UI_SETTLE_FRAMES;
+
+            if (is_input_event(e)) {
+                //SDL stamps the event when it is queued, which can be a good while before it is polled here
+                const uint32_t queuedMs = SDL_GetTicks() - e.common.timestamp;
+                _latencyTracker.add_input(vkutil::LatencyTracker::Clock::now() - std::chrono::milliseconds(queuedMs));
+            }
+            //any input can change what is on screen
+            _redrawRequested = true;
 
 			//close the window when user alt-f4s or clicks the X button			
             if (e.type == SDL_QUIT) {
@@ -205,6 +523,18 @@ void VulkanEngine::run()
                     case SDLK_SPACE:
                         useColoredTrianglePipeline = !useColoredTrianglePipeline;
                         break;
+                    case SDLK_v:
+                        _useVisibilityBuffer = !_useVisibilityBuffer;
+                        break;
+                    case SDLK_p:
+                        _useVertexPulling = !_useVertexPulling;
+                        break;
+                    case SDLK_F12:
+                        _captureRequested = true;
+                        break;
+                    case SDLK_F1:
+                        _debugView = static_cast<vkutil::DebugView>((static_cast<uint32_t>(_debugView) + 1) % static_cast<uint32_t>(vkutil::DebugView::Count));
+                        break;
                     case SDLK_w:
                         std::cout << "SDL_KEYDOWN w" << std::endl;
                         _camPos += glm::vec3{0.0f, 0.0f, 1.0f};
@@ -224,23 +554,48 @@ void VulkanEngine::run()
                     default:
                         break;
                 }
+            } else if (e.type == SDL_MOUSEBUTTONDOWN && e.button.button == SDL_BUTTON_LEFT && !ImGui::GetIO().WantCaptureMouse) {
+                pick_object(e.button.x, e.button.y);
             }
 		}
+        _profiler.end_scope();
 
-        //imgui new frame
-        ImGui_ImplVulkan_NewFrame();
-        ImGui_ImplSDL2_NewFrame(_window);
+        //the stats in the debug window change every frame, a capped rate keeps them readable and cheap
+        const auto uiTimeNow = std::chrono::high_resolution_clock::now();
+        const bool uiRefreshDue = _uiRefreshRate > 0.f && uiTimeNow - _lastUiRebuildTime >= std::chrono::duration<float>(1.f / _uiRefreshRate);
 
-        ImGui::NewFrame();
+        _rebuildUi = _uiPendingRebuilds > 0 || uiRefreshDue;
+        if (_rebuildUi) {
+            if (_uiPendingRebuilds > 0) {
+                --_uiPendingRebuilds;
+            }
+            _lastUiRebuildTime = uiTimeNow;
+
+            PROFILE_SCOPE(_profiler, "build UI");
+            build_ui();
+
+            //a rebuild that produced the same draw data doesn't have to be recorded or shown again
+            const uint64_t uiHash = hash_draw_data(ImGui::GetDrawData());
+            if (uiHash != _uiDrawDataHash) {
+                _uiDrawDataHash = uiHash;
+                _redrawRequested = true;
+            } else {
+                _rebuildUi = false;
+            }
+        }
 
-        //imgui commands
-        ImGui::ShowDemoWindow();
+        if (!_enableIdleSkipping || needs_redraw()) {
+            draw();
 
-        ImGui::Begin("Debug Window");
-        ImGui::Text((std::string("Frames per second: ") + std::to_string(_lastFps)).c_str());
-        ImGui::End();
+            _redrawRequested = false;
+            _lastDrawnCamPos = _camPos;
 
-		draw();
+            if (_profiler.end_frame()) {
+                _metrics.add_hitch();
+            }
+        } else {
+            _profiler.cancel_frame();
+        }
 
         // FPS reporter
         const auto timeNow = std::chrono::high_resolution_clock::now();
@@ -248,6 +603,9 @@ void VulkanEngine::run()
         if (timeDiff > std::chrono::seconds{1}) {
             _lastFps = _frameNumber - _lastFrameNumberReported;
             std::cout << "FPS: " << _lastFps << std::endl;
+            print_pacing_stats();
+            print_latency_stats();
+            update_metrics_gauges();
 
             _lastFrameNumberReported = _frameNumber;
             _lastFpsReportTime = timeNow;
@@ -255,6 +613,426 @@ void VulkanEngine::run()
     }
 }
 
+void VulkanEngine::run_headless()
+{
+    std::vector<float> cpuDrawMs;
+    std::vector<float> gpuFrameMs;
+    std::vector<float> computeMs;
+    std::vector<float> computeOverlapMs;
+
+    //no input, every frame gets drawn
+    for (uint32_t frame = 0; frame < _headlessFrames; frame++) {
+        if (_framePacer.wait_for_next_frame()) {
+            _idledSinceLastFrame = true;
+        }
+
+        poll_frame_latency();
+
+        _latencyTracker.add_input(vkutil::LatencyTracker::Clock::now());
+
+        _profiler.begin_frame(_frameNumber);
+        const auto drawStart = std::chrono::high_resolution_clock::now();
+        draw();
+        cpuDrawMs.push_back(std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - drawStart).count());
+        if (_profiler.end_frame()) {
+            _metrics.add_hitch();
+        }
+
+        //the GPU time read in this draw belongs to the frame that last used the slot, none before that
+        if (_supportsTimestamps && frame >= FRAME_OVERLAP) {
+            gpuFrameMs.push_back(_lastGpuFrameMs);
+            if (_enableParticles) {
+                computeMs.push_back(_lastComputeMs);
+                computeOverlapMs.push_back(_lastComputeOverlapMs);
+            }
+        }
+    }
+
+    //let the last frames finish before reporting
+    vkDeviceWaitIdle(_device);
+    poll_frame_latency();
+
+    std::cout << "Headless: drew " << _headlessFrames << " frames" << std::endl;
+    print_timing_summary("CPU draw", cpuDrawMs);
+    print_timing_summary("GPU frame", gpuFrameMs);
+    print_timing_summary(_useAsyncCompute && _hasComputeQueue ? "Async compute" : "Compute on graphics queue", computeMs);
+    print_timing_summary("Compute overlap", computeOverlapMs);
+    print_pacing_stats();
+    print_latency_stats();
+    update_metrics_gauges();
+}
+
+void VulkanEngine::print_pacing_stats() const
+{
+    const vkutil::FramePacingStats stats = _framePacer.stats();
+    if (stats.frames == 0) {
+        return;
+    }
+
+    std::cout << "Frame time over " << stats.frames << " frames: mean " << stats.meanMs << " ms, std dev " << stats.stdDevMs
+              << " ms, min " << stats.minMs << " ms, max " << stats.maxMs << " ms, p99 " << stats.p99Ms << " ms" << std::endl;
+}
+
+void VulkanEngine::print_latency_stats() const
+{
+    const vkutil::LatencyStats stats = _latencyTracker.stats();
+    if (stats.samples == 0) {
+        return;
+    }
+
+    std::cout << "Input latency over " << stats.samples << " frames (p50 / p95 / p99 / max ms):" << std::endl;
+    for (size_t stage = 0; stage < stats.stages.size(); stage++) {
+        const vkutil::LatencyPercentiles& percentiles = stats.stages[stage];
+        std::cout << "  " << vkutil::latency_stage_name(static_cast<vkutil::LatencyStage>(stage)) << ": " << percentiles.p50Ms << " / "
+                  << percentiles.p95Ms << " / " << percentiles.p99Ms << " / " << percentiles.maxMs << std::endl;
+    }
+}
+
+void VulkanEngine::record_queue_stall(std::chrono::time_point<std::chrono::high_resolution_clock> waitStart)
+{
+    //a wait that returns right away isn't a stall
+    const float waitMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - waitStart).count();
+    if (waitMs > 0.5f) {
+        _metrics.add_queue_stall(waitMs);
+    }
+}
+
+void VulkanEngine::update_metrics_gauges()
+{
+    if (!_metrics.is_running()) {
+        return;
+    }
+
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(_chosenGPU, &memoryProperties);
+    VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+    vmaGetBudget(_allocator, budgets);
+    for (uint32_t heap = 0; heap < memoryProperties.memoryHeapCount; heap++) {
+        const std::string labels = "heap=\"" + std::to_string(heap) + "\"";
+        _metrics.set_gauge("engine_gpu_memory_allocated_bytes", "Bytes allocated through VMA per memory heap.", labels, static_cast<double>(budgets[heap].allocationBytes));
+        _metrics.set_gauge("engine_gpu_memory_usage_bytes", "Estimated memory usage per heap.", labels, static_cast<double>(budgets[heap].usage));
+        _metrics.set_gauge("engine_gpu_memory_budget_bytes", "Estimated memory available per heap.", labels, static_cast<double>(budgets[heap].budget));
+    }
+
+    if (_worldStreamer.is_running()) {
+        const vkutil::StreamingStats streamingStats = _worldStreamer.stats();
+        _metrics.set_gauge("engine_streaming_resident_cells", "World cells resident.", "", streamingStats.residentCells);
+        _metrics.set_gauge("engine_streaming_pending_cells", "World cells queued or loading.", "", streamingStats.pendingCells);
+        _metrics.set_gauge("engine_streaming_memory_bytes", "Memory reserved by streamed cells.", "kind=\"cpu\"", static_cast<double>(streamingStats.cpuBytes));
+        _metrics.set_gauge("engine_streaming_memory_bytes", "Memory reserved by streamed cells.", "kind=\"gpu\"", static_cast<double>(streamingStats.gpuBytes));
+    }
+
+    _metrics.set_gauge("engine_fps", "Frames drawn in the last second.", "", static_cast<double>(_lastFps));
+    _metrics.set_gauge("engine_renderables", "Objects in the scene.", "", static_cast<double>(_renderables.size()));
+    _metrics.set_gauge("engine_visible_objects", "Objects left after culling in the last frame.", "", static_cast<double>(_visibleObjects.size()));
+    _metrics.set_gauge("engine_render_scale", "Render resolution scale picked by the quality governor.", "", _qualityGovernor.levels().renderScale);
+}
+
+void VulkanEngine::capture_frame()
+{
+    //render objects point at their mesh and material, the file refers to them by name
+    std::unordered_map<const Mesh*, std::string> meshNames;
+    for (const auto& [name, mesh] : _meshes) {
+        meshNames[&mesh] = name;
+    }
+    std::unordered_map<const Material*, std::string> materialNames;
+    for (const auto& [name, material] : _materials) {
+        materialNames[&material] = name;
+    }
+
+    vkutil::FrameCapture capture;
+    capture.frameNumber = _frameNumber;
+    capture.animationFrame = _animationFrame;
+    capture.camPos = _camPos;
+    capture.cameraFar = _cameraFar;
+    capture.renderScale = _qualityGovernor.levels().renderScale;
+    capture.drawDistanceScale = _qualityGovernor.levels().drawDistanceScale;
+    capture.flags = (_useVisibilityBuffer ? vkutil::CAPTURE_VISIBILITY_BUFFER : 0)
+        | (_useVertexPulling ? vkutil::CAPTURE_VERTEX_PULLING : 0)
+        | (_enableFrustumCulling ? vkutil::CAPTURE_FRUSTUM_CULLING : 0);
+
+    for (const RenderObject& object : _renderables) {
+        capture.objects.push_back(vkutil::CapturedObject{meshNames[object.mesh], materialNames[object.material], object.transformMatrix,
+            object.firstVertex, object.vertexCount, object.worldBounds, object.isStatic});
+    }
+    capture.drawList = _visibleObjects;
+
+    capture.cameraData.resize(sizeof(GPUCameraData));
+    memcpy(capture.cameraData.data(), &_cameraData, sizeof(GPUCameraData));
+    capture.sceneData.resize(sizeof(GPUSceneData));
+    memcpy(capture.sceneData.data(), &_sceneParameters, sizeof(GPUSceneData));
+
+    if (vkutil::save_capture(_capturePath, capture)) {
+        std::cout << "Captured frame " << _frameNumber << " (" << capture.objects.size() << " objects) to " << _capturePath << std::endl;
+    }
+}
+
+bool VulkanEngine::load_replay()
+{
+    vkutil::FrameCapture capture;
+    if (!vkutil::load_capture(_replayPath, capture)) {
+        return false;
+    }
+
+    if (capture.cameraData.size() != sizeof(GPUCameraData) || capture.sceneData.size() != sizeof(GPUSceneData)) {
+        std::cout << _replayPath << " was captured by a build with different uniform layouts" << std::endl;
+        return false;
+    }
+
+    //kept in the captured order, it was sorted already
+    std::vector<RenderObject> renderables;
+    for (const vkutil::CapturedObject& captured : capture.objects) {
+        RenderObject object;
+        object.mesh = get_mesh(captured.mesh);
+        object.material = get_material(captured.material);
+        if (object.mesh == nullptr || object.material == nullptr) {
+            //streamed cells aren't loaded during replays
+            std::cout << "Capture needs mesh " << captured.mesh << " with material " << captured.material << ", which isn't loaded" << std::endl;
+            return false;
+        }
+        object.transformMatrix = captured.transform;
+        object.firstVertex = captured.firstVertex;
+        object.vertexCount = captured.vertexCount;
+        object.worldBounds = captured.worldBounds;
+        object.isStatic = captured.isStatic;
+        renderables.push_back(object);
+    }
+    _renderables = std::move(renderables);
+    rebuild_object_tree();
+    _replayDrawList = capture.drawList;
+
+    _camPos = capture.camPos;
+    _cameraFar = capture.cameraFar;
+    _animationFrame = capture.animationFrame;
+    _animateScene = false;
+    _useVisibilityBuffer = capture.flags & vkutil::CAPTURE_VISIBILITY_BUFFER;
+    _useVertexPulling = capture.flags & vkutil::CAPTURE_VERTEX_PULLING;
+    _enableFrustumCulling = capture.flags & vkutil::CAPTURE_FRUSTUM_CULLING;
+
+    memcpy(&_cameraData, capture.cameraData.data(), sizeof(GPUCameraData));
+    memcpy(&_sceneParameters, capture.sceneData.data(), sizeof(GPUSceneData));
+
+    _qualityGovernor.set_levels(vkutil::QualityLevels{capture.renderScale, capture.drawDistanceScale});
+    apply_quality_levels();
+
+    std::cout << "Replaying frame " << capture.frameNumber << " of " << _replayPath << ", " << _renderables.size() << " objects" << std::endl;
+    return true;
+}
+
+void VulkanEngine::poll_frame_latency()
+{
+    for (uint32_t slot = 0; slot < FRAME_OVERLAP; slot++) {
+        if (_latencyTracker.is_pending(slot) && vkGetFenceStatus(_device, _frames[slot].renderFence) == VK_SUCCESS) {
+            _latencyTracker.gpu_complete(slot);
+        }
+    }
+}
+
+bool VulkanEngine::needs_redraw() const
+{
+    if (_redrawRequested || _animateScene || _camPos != _lastDrawnCamPos) {
+        return true;
+    }
+
+    //cells finished loading or have to be dropped
+    return _worldStreamer.is_running() && _worldStreamer.has_results();
+}
+
+uint32_t VulkanEngine::idle_wait_ms() const
+{
+    //wake up at least once a second, so the FPS reporter keeps going
+    float waitMs = 1000.f;
+
+    if (_uiRefreshRate > 0.f) {
+        const float sinceRebuildMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - _lastUiRebuildTime).count();
+        waitMs = std::min(waitMs, std::max(0.f, 1000.f / _uiRefreshRate - sinceRebuildMs));
+    }
+
+    //cells are being parsed in the background, check on them often enough to show them promptly
+    if (_worldStreamer.is_running() && _worldStreamer.stats().pendingCells > 0) {
+        waitMs = std::min(waitMs, 10.f);
+    }
+
+    return static_cast<uint32_t>(waitMs);
+}
+
+//order statistics are steadier than the mean when a few frames get disturbed by the OS
+static void print_timing_summary(const char* label, std::vector<float> samples)
+{
+    if (samples.empty()) {
+        return;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    auto percentile = [&](float fraction) {
+        return samples[std::min(samples.size() - 1, static_cast<size_t>(samples.size() * fraction))];
+    };
+    std::cout << label << " over " << samples.size() << " frames: median " << percentile(0.5f) << " ms, p5 " << percentile(0.05f)
+              << " ms, p95 " << percentile(0.95f) << " ms, min " << samples.front() << " ms, max " << samples.back() << " ms" << std::endl;
+}
+
+//events the user is waiting to see a reaction to, window and system events don't count
+static bool is_input_event(const SDL_Event& event)
+{
+    switch (event.type) {
+        case SDL_KEYDOWN:
+        case SDL_KEYUP:
+        case SDL_MOUSEMOTION:
+        case SDL_MOUSEBUTTONDOWN:
+        case SDL_MOUSEBUTTONUP:
+        case SDL_MOUSEWHEEL:
+            return true;
+        default:
+            return false;
+    }
+}
+
+//FNV-1a over everything ImGui would draw
+static uint64_t hash_draw_data(const ImDrawData* drawData)
+{
+    uint64_t hash = 14695981039346656037ull;
+    auto hashBytes = [&](const void* data, size_t size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+    };
+
+    if (drawData == nullptr) {
+        return hash;
+    }
+
+    for (int listIdx = 0; listIdx < drawData->CmdListsCount; listIdx++) {
+        const ImDrawList* cmdList = drawData->CmdLists[listIdx];
+        hashBytes(cmdList->VtxBuffer.Data, cmdList->VtxBuffer.Size * sizeof(ImDrawVert));
+        hashBytes(cmdList->IdxBuffer.Data, cmdList->IdxBuffer.Size * sizeof(ImDrawIdx));
+        //draw commands zero their padding, so hashing them whole is safe
+        hashBytes(cmdList->CmdBuffer.Data, cmdList->CmdBuffer.Size * sizeof(ImDrawCmd));
+    }
+    return hash;
+}
+
+void VulkanEngine::build_ui()
+{
+    //imgui new frame
+    ImGui_ImplVulkan_NewFrame();
+    ImGui_ImplSDL2_NewFrame(_window);
+
+    ImGui::NewFrame();
+
+    //imgui commands
+    ImGui::ShowDemoWindow();
+
+    ImGui::Begin("Debug Window");
+    ImGui::Text((std::string("Frames per second: ") + std::to_string(_lastFps)).c_str());
+    ImGui::Checkbox("Visibility buffer (V)", &_useVisibilityBuffer);
+    ImGui::Checkbox("Vertex pulling (P)", &_useVertexPulling);
+    if (ImGui::BeginCombo("Debug view (F1)", vkutil::debug_view_name(_debugView))) {
+        for (uint32_t view = 0; view < static_cast<uint32_t>(vkutil::DebugView::Count); view++) {
+            if (ImGui::Selectable(vkutil::debug_view_name(static_cast<vkutil::DebugView>(view)), view == static_cast<uint32_t>(_debugView))) {
+                _debugView = static_cast<vkutil::DebugView>(view);
+            }
+        }
+        ImGui::EndCombo();
+    }
+    if (_debugView == vkutil::DebugView::MaterialCost) {
+        for (const auto& [name, material] : _materials) {
+            ImGui::Text("  %s: %.3f ms", name.c_str(), _materialCosts.cost_ms(&material));
+        }
+    }
+#if DEBUG_DRAW_ENABLED
+    ImGui::Checkbox("Draw object bounds", &_debugDrawBounds);
+    ImGui::Checkbox("Draw streaming cells", &_debugDrawStreamingCells);
+    ImGui::Checkbox("Draw chunk grid", &_debugDrawChunkGrid);
+    if (ImGui::Checkbox("Freeze camera frustum", &_debugDrawFrozenFrustum)) {
+        _frozenViewproj = _cameraData.viewproj;
+    }
+    if (_debugDraw.dropped_vertices() > 0) {
+        ImGui::Text("Debug draw full, %u vertices dropped", _debugDraw.dropped_vertices());
+    }
+#endif
+    ImGui::Checkbox("Frustum culling", &_enableFrustumCulling);
+    ImGui::Checkbox("Occlusion culling", &_enableOcclusionCulling);
+    ImGui::Checkbox("Object tree", &_useObjectTree);
+    if (_useObjectTree) {
+        ImGui::Text("  %u objects, height %d", _objectTree.proxy_count(), _objectTree.height());
+    }
+    if (_pvsMesh) {
+        ImGui::Checkbox("Potentially visible set", &_enablePvs);
+        if (_pvsCell != vkutil::PotentiallyVisibleSet::INVALID_CELL) {
+            ImGui::Text("  cell %u, %u / %u chunks visible", _pvsCell, _pvs.visible_count(_pvsCell), _pvs.chunk_count());
+        }
+    }
+    if (_hasPick) {
+        ImGui::Text("Picked triangle %u at %.1f, %.1f, %.1f in %.1f us", _pickHit.triangle, _pickPosition.x, _pickPosition.y, _pickPosition.z, _pickMicroseconds);
+    } else {
+        ImGui::Text("Click the scene to pick a triangle");
+    }
+    if (_enableOcclusionCulling) {
+        const vkutil::OcclusionStats& occlusionStats = _occlusionRasterizer.stats();
+        ImGui::Text("  %u occluder triangles (%s), %u / %u objects occluded", occlusionStats.trianglesRasterized,
+            _occlusionRasterizer.uses_avx2() ? "AVX2" : "scalar", occlusionStats.objectsOccluded, occlusionStats.objectsTested);
+    }
+    ImGui::Checkbox("Quality governor", &_enableQualityGovernor);
+    ImGui::SliderFloat("Target frame time (ms)", &_qualityGovernor._settings.targetFrameMs, 4.f, 50.f);
+    ImGui::Text("GPU frame: %.2f ms, smoothed %.2f ms", _lastGpuFrameMs, _qualityGovernor.smoothed_frame_ms());
+    ImGui::Text("Render resolution: %ux%u, draw distance %.0f%%", _renderExtent.width, _renderExtent.height, _qualityGovernor.levels().drawDistanceScale * 100.f);
+    ImGui::Text("Visible objects: %zu / %zu", _visibleObjects.size(), _renderables.size());
+    if (_worldStreamer.is_running()) {
+        const vkutil::StreamingStats streamingStats = _worldStreamer.stats();
+        ImGui::Text("Streamed cells: %u resident, %u pending", streamingStats.residentCells, streamingStats.pendingCells);
+        ImGui::Text("Streaming CPU: %.1f / %.1f MB", streamingStats.cpuBytes / 1048576.0, _streamingSettings.cpuBudget / 1048576.0);
+        ImGui::Text("Streaming GPU: %.1f / %.1f MB", streamingStats.gpuBytes / 1048576.0, _streamingSettings.gpuBudget / 1048576.0);
+    }
+    ImGui::SliderFloat("UI refresh rate (Hz)", &_uiRefreshRate, 0.f, 60.f);
+    ImGui::Checkbox("Skip idle frames", &_enableIdleSkipping);
+    ImGui::Checkbox("Animate clear color and ambient", &_animateScene);
+    if (ImGui::SliderFloat("Frame rate limit (0 = off)", &_frameRateLimit, 0.f, 240.f)) {
+        _framePacer.set_target_rate(_frameRateLimit);
+    }
+    ImGui::Checkbox("Late swapchain acquire", &_lateAcquire);
+    ImGui::Checkbox("Split submission", &_splitSubmission);
+    if (_splitSubmission) {
+        int sceneSubmits = static_cast<int>(_sceneSubmits);
+        if (ImGui::SliderInt("Scene submissions", &sceneSubmits, 1, static_cast<int>(MAX_SCENE_SUBMITS))) {
+            _sceneSubmits = static_cast<uint32_t>(sceneSubmits);
+        }
+        ImGui::Text("First submission %.2f ms before the last", _submitLeadMs);
+    }
+    ImGui::Checkbox("Particles", &_enableParticles);
+    if (_enableParticles) {
+        int particleCount = static_cast<int>(_particleCount);
+        if (ImGui::SliderInt("Particle count", &particleCount, 1024, static_cast<int>(MAX_PARTICLES))) {
+            _particleCount = static_cast<uint32_t>(particleCount);
+        }
+        if (_hasComputeQueue) {
+            ImGui::Checkbox("Async compute", &_useAsyncCompute);
+        } else {
+            ImGui::Text("Async compute: no separate compute queue");
+        }
+        ImGui::Text("Particle simulation %.3f ms GPU, %.3f ms alongside graphics", _lastComputeMs, _lastComputeOverlapMs);
+    }
+    const vkutil::FramePacingStats pacingStats = _framePacer.stats();
+    ImGui::Text("Frame time: %.2f ms mean, %.2f ms std dev", pacingStats.meanMs, pacingStats.stdDevMs);
+    ImGui::Text("Frame time range: %.2f - %.2f ms, p99 %.2f ms", pacingStats.minMs, pacingStats.maxMs, pacingStats.p99Ms);
+    const vkutil::LatencyStats latencyStats = _latencyTracker.stats();
+    if (ImGui::Button("Capture frame (F12)")) {
+        _captureRequested = true;
+    }
+    ImGui::Checkbox("Hitch detector", &_profiler._settings.enabled);
+    ImGui::SliderFloat("Hitch threshold (ms)", &_profiler._settings.thresholdMs, 10.f, 200.f);
+    ImGui::Text("Hitches: %u, last %.1f ms, rolling p95 %.2f ms", _profiler.hitch_count(), _profiler.last_hitch_ms(), _profiler.rolling_p95_ms());
+    ImGui::Text("Input latency over %u frames (p50 / p95 / p99 / max ms):", latencyStats.samples);
+    for (size_t stage = 0; stage < latencyStats.stages.size(); stage++) {
+        const vkutil::LatencyPercentiles& percentiles = latencyStats.stages[stage];
+        ImGui::Text("  %s: %.2f / %.2f / %.2f / %.2f", vkutil::latency_stage_name(static_cast<vkutil::LatencyStage>(stage)),
+            percentiles.p50Ms, percentiles.p95Ms, percentiles.p99Ms, percentiles.maxMs);
+    }
+    ImGui::End();
+
+    ImGui::Render();
+}
+
 void VulkanEngine::immediate_submit(std::function<void (VkCommandBuffer)> &&function)
 {
     const VkCommandBuffer cmd = _uploadContext._commandBuffer;
@@ -292,6 +1070,8 @@ void VulkanEngine::init_vulkan()
         .request_validation_layers(true)
         .require_api_version(1, 1, 0)
         .use_default_debug_messenger()
+        //headless skips the surface extensions
+        .set_headless(_headless)
         .build();
 
     vkb::Instance vkb_inst = inst_ret.value();
@@ -301,18 +1081,30 @@ void VulkanEngine::init_vulkan()
     //store the debug messenger
     _debug_messenger = vkb_inst.debug_messenger;
 
-    // get the surface of the window we opened with SDL
-    SDL_Vulkan_CreateSurface(_window, _instance, &_surface);
-
     //use vkbootstrap to select a GPU.
     //We want a GPU that can write to the SDL surface and supports Vulkan 1.1
     vkb::PhysicalDeviceSelector selector{ vkb_inst };
+    selector.set_minimum_version(1, 1);
+    if (_headless) {
+        selector.require_present(false);
+    } else {
+        // get the surface of the window we opened with SDL
+        SDL_Vulkan_CreateSurface(_window, _instance, &_surface);
+        selector.set_surface(_surface);
+    }
+    //orders the async compute work, only enabled when the GPU has it
+    selector.add_desired_extension(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
     vkb::PhysicalDevice physicalDevice = selector
-        .set_minimum_version(1, 1)
-        .set_surface(_surface)
         .select()
         .value();
 
+    //optional features for the vertex pulling multi-draw, only turned on when the GPU has them
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(physicalDevice.physical_device, &supportedFeatures);
+    physicalDevice.features.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+    physicalDevice.features.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+    _supportsMultiDrawIndirect = supportedFeatures.multiDrawIndirect && supportedFeatures.drawIndirectFirstInstance;
+
     //create the final Vulkan device
     vkb::DeviceBuilder deviceBuilder{ physicalDevice };
     VkPhysicalDeviceShaderDrawParametersFeatures shader_draw_parameters_features = {};
@@ -320,6 +1112,29 @@ void VulkanEngine::init_vulkan()
     shader_draw_parameters_features.pNext = nullptr;
     shader_draw_parameters_features.shaderDrawParameters = VK_TRUE;
     deviceBuilder.add_pNext(&shader_draw_parameters_features);
+
+    //the feature struct may only be queried when the extension is there
+    uint32_t extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(physicalDevice.physical_device, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> extensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(physicalDevice.physical_device, nullptr, &extensionCount, extensions.data());
+
+    VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timeline_semaphore_features = {};
+    timeline_semaphore_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+    for (const VkExtensionProperties& extension : extensions) {
+        if (strcmp(extension.extensionName, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME) == 0) {
+            VkPhysicalDeviceFeatures2 features2 = {};
+            features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+            features2.pNext = &timeline_semaphore_features;
+            vkGetPhysicalDeviceFeatures2(physicalDevice.physical_device, &features2);
+        }
+    }
+    _supportsTimelineSemaphores = timeline_semaphore_features.timelineSemaphore;
+    if (_supportsTimelineSemaphores) {
+        timeline_semaphore_features.pNext = nullptr;
+        deviceBuilder.add_pNext(&timeline_semaphore_features);
+    }
+
     vkb::Device vkbDevice = deviceBuilder.build().value();
 
     // Get the VkDevice handle used in the rest of a Vulkan application
@@ -333,9 +1148,27 @@ void VulkanEngine::init_vulkan()
     _graphicsQueue = vkbDevice.get_queue(vkb::QueueType::graphics).value();
     _graphicsQueueFamily = vkbDevice.get_queue_index(vkb::QueueType::graphics).value();
 
-    VmaAllocatorCreateInfo allocatorInfo = {};
-    allocatorInfo.physicalDevice = _chosenGPU;
-    allocatorInfo.device = _device;
+    //a family with compute only runs alongside graphics best, any family with compute but no graphics still overlaps.
+    //vkbootstrap made one queue of every family
+    const auto dedicatedComputeFamily = vkbDevice.get_dedicated_queue_index(vkb::QueueType::compute);
+    const auto separateComputeFamily = vkbDevice.get_queue_index(vkb::QueueType::compute);
+    if (dedicatedComputeFamily.has_value()) {
+        _computeQueueFamily = dedicatedComputeFamily.value();
+        _hasComputeQueue = true;
+    } else if (separateComputeFamily.has_value()) {
+        _computeQueueFamily = separateComputeFamily.value();
+        _hasComputeQueue = true;
+    }
+    if (_hasComputeQueue) {
+        vkGetDeviceQueue(_device, _computeQueueFamily, 0, &_computeQueue);
+        std::cout << "Async compute on queue family " << _computeQueueFamily << (_supportsTimelineSemaphores ? ", timeline semaphores" : ", binary semaphores") << std::endl;
+    } else {
+        std::cout << "No separate compute queue family, compute passes run on the graphics queue" << std::endl;
+    }
+
+    VmaAllocatorCreateInfo allocatorInfo = {};
+    allocatorInfo.physicalDevice = _chosenGPU;
+    allocatorInfo.device = _device;
     allocatorInfo.instance = _instance;
     vmaCreateAllocator(&allocatorInfo, &_allocator);
 
@@ -346,24 +1179,27 @@ void VulkanEngine::init_vulkan()
 
 void VulkanEngine::init_swapchain()
 {
-    vkb::SwapchainBuilder swapchainBuilder{_chosenGPU,_device,_surface };
-
-    vkb::Swapchain vkbSwapchain = swapchainBuilder
-        .use_default_format_selection()
-        //use vsync present mode
-        // .set_desired_present_mode(VK_PRESENT_MODE_FIFO_KHR)
-        // render as fast as machine can
-        .set_desired_present_mode(VK_PRESENT_MODE_IMMEDIATE_KHR)
-        .set_desired_extent(_windowExtent.width, _windowExtent.height)
-        .build()
-        .value();
-
-    //store swapchain and its related images
-    _swapchain = vkbSwapchain.swapchain;
-    _swapchainImages = vkbSwapchain.get_images().value();
-    _swapchainImageViews = vkbSwapchain.get_image_views().value();
-
-    _swapchainImageFormat = vkbSwapchain.image_format;
+    if (_headless) {
+        //no swapchain, the main renderpass still gets created with this format so the pipelines built against it stay valid
+        _swapchainImageFormat = VK_FORMAT_B8G8R8A8_UNORM;
+    } else {
+        vkb::SwapchainBuilder swapchainBuilder{_chosenGPU,_device,_surface };
+
+        vkb::Swapchain vkbSwapchain = swapchainBuilder
+            .use_default_format_selection()
+            //vsync waits for the display, immediate renders as fast as machine can
+            .set_desired_present_mode(_vsync ? VK_PRESENT_MODE_FIFO_KHR : VK_PRESENT_MODE_IMMEDIATE_KHR)
+            .set_desired_extent(_windowExtent.width, _windowExtent.height)
+            .build()
+            .value();
+
+        //store swapchain and its related images
+        _swapchain = vkbSwapchain.swapchain;
+        _swapchainImages = vkbSwapchain.get_images().value();
+        _swapchainImageViews = vkbSwapchain.get_image_views().value();
+
+        _swapchainImageFormat = vkbSwapchain.image_format;
+    }
 
     //depth image size will match the window
 	VkExtent3D depthImageExtent = {
@@ -392,7 +1228,9 @@ void VulkanEngine::init_swapchain()
 	VK_CHECK(vkCreateImageView(_device, &dview_info, nullptr, &_depthImageView));
 
     _mainDeletionQueue.push_function([=]() {
-		vkDestroySwapchainKHR(_device, _swapchain, nullptr);
+        if (_swapchain != VK_NULL_HANDLE) {
+		    vkDestroySwapchainKHR(_device, _swapchain, nullptr);
+        }
         vkDestroyImageView(_device, _depthImageView, nullptr);
         vmaDestroyImage(_allocator, _depthImage._image, _depthImage._allocation);
 	});
@@ -412,10 +1250,25 @@ void VulkanEngine::init_commands()
         const VkCommandBufferAllocateInfo cmdAllocInfo = vkinit::command_buffer_allocate_info(_frames[frameIdx].commandPool);
 
         VK_CHECK(vkAllocateCommandBuffers(_device, &cmdAllocInfo, &_frames[frameIdx].mainCommandBuffer));
+
+        const VkCommandBufferAllocateInfo splitAllocInfo = vkinit::command_buffer_allocate_info(_frames[frameIdx].commandPool, MAX_SCENE_SUBMITS);
+        VK_CHECK(vkAllocateCommandBuffers(_device, &splitAllocInfo, _frames[frameIdx].splitCommandBuffers));
         
         _mainDeletionQueue.push_function([=]() {
             vkDestroyCommandPool(_device, _frames[frameIdx].commandPool, nullptr);
         });
+
+        if (_hasComputeQueue) {
+            const VkCommandPoolCreateInfo computePoolInfo = vkinit::command_pool_create_info(_computeQueueFamily, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+            VK_CHECK(vkCreateCommandPool(_device, &computePoolInfo, nullptr, &_frames[frameIdx].computeCommandPool));
+
+            const VkCommandBufferAllocateInfo computeAllocInfo = vkinit::command_buffer_allocate_info(_frames[frameIdx].computeCommandPool);
+            VK_CHECK(vkAllocateCommandBuffers(_device, &computeAllocInfo, &_frames[frameIdx].computeCommandBuffer));
+
+            _mainDeletionQueue.push_function([=]() {
+                vkDestroyCommandPool(_device, _frames[frameIdx].computeCommandPool, nullptr);
+            });
+        }
     }
 
     // For upload Context for immidiate submit commands
@@ -575,10 +1428,36 @@ void VulkanEngine::init_sync_structures()
 
         VK_CHECK(vkCreateSemaphore(_device, &semaphoreCreateInfo, nullptr, &_frames[frameIdx].presentSemaphore));
         VK_CHECK(vkCreateSemaphore(_device, &semaphoreCreateInfo, nullptr, &_frames[frameIdx].renderSemaphore));
+        VK_CHECK(vkCreateSemaphore(_device, &semaphoreCreateInfo, nullptr, &_frames[frameIdx].sceneSemaphore));
 
         _mainDeletionQueue.push_function([=]() {
             vkDestroySemaphore(_device, _frames[frameIdx].presentSemaphore, nullptr);
             vkDestroySemaphore(_device, _frames[frameIdx].renderSemaphore, nullptr);
+            vkDestroySemaphore(_device, _frames[frameIdx].sceneSemaphore, nullptr);
+        });
+
+        if (_hasComputeQueue && !_supportsTimelineSemaphores) {
+            VK_CHECK(vkCreateSemaphore(_device, &semaphoreCreateInfo, nullptr, &_frames[frameIdx].computeSemaphore));
+
+            _mainDeletionQueue.push_function([=]() {
+                vkDestroySemaphore(_device, _frames[frameIdx].computeSemaphore, nullptr);
+            });
+        }
+    }
+
+    //one timeline for all frames, the compute submission of every frame signals the next value
+    if (_hasComputeQueue && _supportsTimelineSemaphores) {
+        VkSemaphoreTypeCreateInfoKHR timelineTypeInfo = {};
+        timelineTypeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+        timelineTypeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+        timelineTypeInfo.initialValue = 0;
+
+        VkSemaphoreCreateInfo timelineCreateInfo = vkinit::semaphore_create_info();
+        timelineCreateInfo.pNext = &timelineTypeInfo;
+        VK_CHECK(vkCreateSemaphore(_device, &timelineCreateInfo, nullptr, &_computeTimeline));
+
+        _mainDeletionQueue.push_function([=]() {
+            vkDestroySemaphore(_device, _computeTimeline, nullptr);
         });
     }
 
@@ -685,6 +1564,9 @@ void VulkanEngine::init_pipelines()
     pipelineBuilder._scissor.offset = { 0, 0 };
     pipelineBuilder._scissor.extent = _windowExtent;
 
+    //the scene passes render at the governed resolution, which changes at runtime
+    pipelineBuilder._dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
     //configure the rasterizer to draw filled triangles
     pipelineBuilder._rasterizer = vkinit::rasterization_state_create_info(VK_POLYGON_MODE_FILL);
 
@@ -775,7 +1657,277 @@ void VulkanEngine::init_pipelines()
 
     pipelineBuilder._pipelineLayout = texturedPipeLayout;
     VkPipeline texPipeline = pipelineBuilder.build_pipeline(_device, _renderPass);
-    create_material(texPipeline, texturedPipeLayout, "texturedmesh");
+    Material* texturedMaterial = create_material(texPipeline, texturedPipeLayout, "texturedmesh");
+    texturedMaterial->shadingModel = 1;
+
+    // vertex pulling variants of the mesh pipelines, the vertex shader reads the geometry arena so there is no vertex input
+    const VkShaderModule vertexPullingShader = loadShader("vertex_pulling.vert.spv");
+    pipelineBuilder._vertexInputInfo = vkinit::vertex_input_state_create_info();
+
+    pipelineBuilder._shaderStages.clear();
+    pipelineBuilder._shaderStages.push_back(
+        vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, vertexPullingShader));
+    pipelineBuilder._shaderStages.push_back(
+        vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_FRAGMENT_BIT, defaultLitFragShader));
+
+    pipelineBuilder._pipelineLayout = _meshPipelineLayout;
+    const VkPipeline meshPullingPipeline = pipelineBuilder.build_pipeline(_device, _renderPass);
+    get_material("defaultmesh")->pullingPipeline = meshPullingPipeline;
+    get_material("defaultmesh_duplicate")->pullingPipeline = meshPullingPipeline;
+
+    pipelineBuilder._shaderStages.clear();
+    pipelineBuilder._shaderStages.push_back(
+        vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, vertexPullingShader));
+    pipelineBuilder._shaderStages.push_back(
+        vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_FRAGMENT_BIT, texturedLitFragShader));
+
+    pipelineBuilder._pipelineLayout = texturedPipeLayout;
+    texturedMaterial->pullingPipeline = pipelineBuilder.build_pipeline(_device, _renderPass);
+    const VkPipeline texPullingPipeline = texturedMaterial->pullingPipeline;
+
+    //textured with the baked light of the vertex colors, same layout and texture set as texturedmesh
+    const VkShaderModule texturedBakedFragShader = loadShader("textured_baked.frag.spv");
+    pipelineBuilder._shaderStages.clear();
+    pipelineBuilder._shaderStages.push_back(
+        vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, vertexPullingShader));
+    pipelineBuilder._shaderStages.push_back(
+        vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_FRAGMENT_BIT, texturedBakedFragShader));
+    const VkPipeline texBakedPullingPipeline = pipelineBuilder.build_pipeline(_device, _renderPass);
+
+    //its forward variant and the visibility pass still use the fixed-function vertex input
+    pipelineBuilder._vertexInputInfo.pVertexAttributeDescriptions = vertexDescription.attributes.data();
+    pipelineBuilder._vertexInputInfo.vertexAttributeDescriptionCount = vertexDescription.attributes.size();
+    pipelineBuilder._vertexInputInfo.pVertexBindingDescriptions = vertexDescription.bindings.data();
+    pipelineBuilder._vertexInputInfo.vertexBindingDescriptionCount = vertexDescription.bindings.size();
+
+    pipelineBuilder._shaderStages[0] = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, triangleMeshVertexShader);
+    const VkPipeline texBakedPipeline = pipelineBuilder.build_pipeline(_device, _renderPass);
+    Material* texturedBakedMaterial = create_material(texBakedPipeline, texturedPipeLayout, "texturedbaked");
+    texturedBakedMaterial->shadingModel = 2;
+    texturedBakedMaterial->pullingPipeline = texBakedPullingPipeline;
+
+    // visibility buffer pipeline, only writes ids so its cost doesn't depend on the material
+    pipelineBuilder._shaderStages.clear();
+    const VkShaderModule visibilityVertexShader = loadShader("visbuffer.vert.spv");
+    const VkShaderModule visibilityFragShader = loadShader("visbuffer.frag.spv");
+    pipelineBuilder._shaderStages.push_back(
+        vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, visibilityVertexShader));
+
+    pipelineBuilder._shaderStages.push_back(
+        vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_FRAGMENT_BIT, visibilityFragShader));
+
+    pipelineBuilder._pipelineLayout = _meshPipelineLayout;
+    _visibilityPipeline = pipelineBuilder.build_pipeline(_device, _visibilityRenderPass);
+
+    // debug view pipelines, one specialization of debug_view.frag per view. Vertices come from the geometry arena
+    const VkShaderModule debugViewVertexShader = loadShader("debug_view.vert.spv");
+    const VkShaderModule debugViewFragShader = loadShader("debug_view.frag.spv");
+    pipelineBuilder._vertexInputInfo = vkinit::vertex_input_state_create_info();
+
+    for (uint32_t view = 1; view < static_cast<uint32_t>(vkutil::DebugView::Count); view++) {
+        const VkSpecializationMapEntry viewEntry = {0, 0, sizeof(uint32_t)};
+
+        VkSpecializationInfo specialization = {};
+        specialization.mapEntryCount = 1;
+        specialization.pMapEntries = &viewEntry;
+        specialization.dataSize = sizeof(uint32_t);
+        specialization.pData = &view;
+
+        VkPipelineShaderStageCreateInfo debugViewFragStage = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_FRAGMENT_BIT, debugViewFragShader);
+        debugViewFragStage.pSpecializationInfo = &specialization;
+
+        pipelineBuilder._shaderStages.clear();
+        pipelineBuilder._shaderStages.push_back(
+            vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, debugViewVertexShader));
+        pipelineBuilder._shaderStages.push_back(debugViewFragStage);
+
+        pipelineBuilder._depthStencil = vkinit::depth_stencil_create_info(true, true, VK_COMPARE_OP_LESS_OR_EQUAL);
+        pipelineBuilder._colorBlendAttachment = vkinit::color_blend_attachment_state();
+
+        switch (static_cast<vkutil::DebugView>(view)) {
+            case vkutil::DebugView::Overdraw:
+                //hidden layers count too, every fragment adds to what is there
+                pipelineBuilder._depthStencil = vkinit::depth_stencil_create_info(false, false, VK_COMPARE_OP_ALWAYS);
+                pipelineBuilder._colorBlendAttachment.blendEnable = VK_TRUE;
+                pipelineBuilder._colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+                pipelineBuilder._colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+                pipelineBuilder._colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+                pipelineBuilder._colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+                pipelineBuilder._colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+                pipelineBuilder._colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+                break;
+            case vkutil::DebugView::MaterialCost:
+                //drawn after the shaded scene, multiplies the tint over the surfaces that are already in the depth buffer
+                pipelineBuilder._depthStencil = vkinit::depth_stencil_create_info(true, false, VK_COMPARE_OP_LESS_OR_EQUAL);
+                pipelineBuilder._colorBlendAttachment.blendEnable = VK_TRUE;
+                pipelineBuilder._colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_DST_COLOR;
+                pipelineBuilder._colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+                pipelineBuilder._colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+                pipelineBuilder._colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+                pipelineBuilder._colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+                pipelineBuilder._colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+                break;
+            default:
+                break;
+        }
+
+        _debugViewPipelines[view] = pipelineBuilder.build_pipeline(_device, _renderPass);
+    }
+
+    pipelineBuilder._colorBlendAttachment = vkinit::color_blend_attachment_state();
+
+#if DEBUG_DRAW_ENABLED
+    // debug draw pipelines, world space lines with a color each. Only the camera is read, from set 0
+    VkPipelineLayoutCreateInfo debug_draw_pipeline_layout_info = vkinit::pipeline_layout_create_info();
+    debug_draw_pipeline_layout_info.setLayoutCount = 1;
+    debug_draw_pipeline_layout_info.pSetLayouts = &_globalSetLayout;
+
+    VK_CHECK(vkCreatePipelineLayout(_device, &debug_draw_pipeline_layout_info, nullptr, &_debugDrawPipelineLayout));
+
+    VkVertexInputBindingDescription debugDrawBinding = {};
+    debugDrawBinding.binding = 0;
+    debugDrawBinding.stride = sizeof(vkutil::DebugVertex);
+    debugDrawBinding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    VkVertexInputAttributeDescription debugDrawAttributes[2] = {};
+    debugDrawAttributes[0].binding = 0;
+    debugDrawAttributes[0].location = 0;
+    debugDrawAttributes[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+    debugDrawAttributes[0].offset = offsetof(vkutil::DebugVertex, position);
+    debugDrawAttributes[1].binding = 0;
+    debugDrawAttributes[1].location = 1;
+    debugDrawAttributes[1].format = VK_FORMAT_R8G8B8A8_UNORM;
+    debugDrawAttributes[1].offset = offsetof(vkutil::DebugVertex, color);
+
+    pipelineBuilder._vertexInputInfo = vkinit::vertex_input_state_create_info();
+    pipelineBuilder._vertexInputInfo.vertexBindingDescriptionCount = 1;
+    pipelineBuilder._vertexInputInfo.pVertexBindingDescriptions = &debugDrawBinding;
+    pipelineBuilder._vertexInputInfo.vertexAttributeDescriptionCount = 2;
+    pipelineBuilder._vertexInputInfo.pVertexAttributeDescriptions = debugDrawAttributes;
+
+    const VkShaderModule debugDrawVertexShader = loadShader("debug_draw.vert.spv");
+    const VkShaderModule debugDrawFragShader = loadShader("debug_draw.frag.spv");
+    pipelineBuilder._shaderStages.clear();
+    pipelineBuilder._shaderStages.push_back(
+        vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, debugDrawVertexShader));
+    pipelineBuilder._shaderStages.push_back(
+        vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_FRAGMENT_BIT, debugDrawFragShader));
+
+    pipelineBuilder._inputAssembly = vkinit::input_assembly_create_info(VK_PRIMITIVE_TOPOLOGY_LINE_LIST);
+    pipelineBuilder._colorBlendAttachment.blendEnable = VK_TRUE;
+    pipelineBuilder._colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    pipelineBuilder._colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    pipelineBuilder._colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+    pipelineBuilder._colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    pipelineBuilder._colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    pipelineBuilder._colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+    pipelineBuilder._pipelineLayout = _debugDrawPipelineLayout;
+
+    //tested against the scene depth but never written, lines don't hide each other
+    pipelineBuilder._depthStencil = vkinit::depth_stencil_create_info(true, false, VK_COMPARE_OP_LESS_OR_EQUAL);
+    _debugDrawPipeline = pipelineBuilder.build_pipeline(_device, _renderPass);
+
+    pipelineBuilder._depthStencil = vkinit::depth_stencil_create_info(false, false, VK_COMPARE_OP_ALWAYS);
+    _debugDrawOverlayPipeline = pipelineBuilder.build_pipeline(_device, _renderPass);
+
+    vkDestroyShaderModule(_device, debugDrawVertexShader, nullptr);
+    vkDestroyShaderModule(_device, debugDrawFragShader, nullptr);
+
+    _mainDeletionQueue.push_function([=]() {
+        vkDestroyPipeline(_device, _debugDrawPipeline, nullptr);
+        vkDestroyPipeline(_device, _debugDrawOverlayPipeline, nullptr);
+        vkDestroyPipelineLayout(_device, _debugDrawPipelineLayout, nullptr);
+    });
+
+    pipelineBuilder._inputAssembly = vkinit::input_assembly_create_info(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+    pipelineBuilder._colorBlendAttachment = vkinit::color_blend_attachment_state();
+#endif
+
+    // visibility resolve pipeline, a full-screen triangle that fetches the vertices from the geometry arena
+    VkPipelineLayoutCreateInfo resolve_pipeline_layout_info = vkinit::pipeline_layout_create_info();
+    const std::vector<VkDescriptorSetLayout> resolveSetLayouts = { _globalSetLayout, _objectSetLayout, _visibilityResolveSetLayout, _singleTextureSetLayout };
+    resolve_pipeline_layout_info.setLayoutCount = static_cast<uint32_t>(resolveSetLayouts.size());
+    resolve_pipeline_layout_info.pSetLayouts = resolveSetLayouts.data();
+
+    //the render extent, to rebuild the NDC of a pixel when the render scale is below 1
+    VkPushConstantRange resolve_push_constant;
+    resolve_push_constant.offset = 0;
+    resolve_push_constant.size = sizeof(glm::vec4);
+    resolve_push_constant.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    resolve_pipeline_layout_info.pPushConstantRanges = &resolve_push_constant;
+    resolve_pipeline_layout_info.pushConstantRangeCount = 1;
+
+    VK_CHECK(vkCreatePipelineLayout(_device, &resolve_pipeline_layout_info, nullptr, &_visibilityResolvePipelineLayout));
+
+    pipelineBuilder._shaderStages.clear();
+    const VkShaderModule resolveVertexShader = loadShader("visbuffer_resolve.vert.spv");
+    const VkShaderModule resolveFragShader = loadShader("visbuffer_resolve.frag.spv");
+    pipelineBuilder._shaderStages.push_back(
+        vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, resolveVertexShader));
+
+    pipelineBuilder._shaderStages.push_back(
+        vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_FRAGMENT_BIT, resolveFragShader));
+
+    pipelineBuilder._vertexInputInfo = vkinit::vertex_input_state_create_info();
+    pipelineBuilder._depthStencil = vkinit::depth_stencil_create_info(false, false, VK_COMPARE_OP_ALWAYS);
+    pipelineBuilder._pipelineLayout = _visibilityResolvePipelineLayout;
+    _visibilityResolvePipeline = pipelineBuilder.build_pipeline(_device, _renderPass);
+
+    // upscale pipeline, stretches the scene image over the swapchain with the same full-screen triangle
+    VkPipelineLayoutCreateInfo upscale_pipeline_layout_info = vkinit::pipeline_layout_create_info();
+
+    VkPushConstantRange upscale_push_constant;
+    upscale_push_constant.offset = 0;
+    upscale_push_constant.size = sizeof(glm::vec4) * 2;
+    upscale_push_constant.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    upscale_pipeline_layout_info.pPushConstantRanges = &upscale_push_constant;
+    upscale_pipeline_layout_info.pushConstantRangeCount = 1;
+    upscale_pipeline_layout_info.setLayoutCount = 1;
+    upscale_pipeline_layout_info.pSetLayouts = &_singleTextureSetLayout;
+
+    VK_CHECK(vkCreatePipelineLayout(_device, &upscale_pipeline_layout_info, nullptr, &_upscalePipelineLayout));
+
+    pipelineBuilder._shaderStages.clear();
+    const VkShaderModule upscaleFragShader = loadShader("upscale.frag.spv");
+    pipelineBuilder._shaderStages.push_back(
+        vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, resolveVertexShader));
+
+    pipelineBuilder._shaderStages.push_back(
+        vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_FRAGMENT_BIT, upscaleFragShader));
+
+    pipelineBuilder._pipelineLayout = _upscalePipelineLayout;
+    _upscalePipeline = pipelineBuilder.build_pipeline(_device, _renderPass);
+
+    // UI composite pipeline, blends the cached UI layer over the upscaled scene
+    VkPipelineLayoutCreateInfo ui_pipeline_layout_info = vkinit::pipeline_layout_create_info();
+    ui_pipeline_layout_info.setLayoutCount = 1;
+    ui_pipeline_layout_info.pSetLayouts = &_singleTextureSetLayout;
+
+    VK_CHECK(vkCreatePipelineLayout(_device, &ui_pipeline_layout_info, nullptr, &_uiCompositePipelineLayout));
+
+    pipelineBuilder._shaderStages.clear();
+    const VkShaderModule uiCompositeFragShader = loadShader("ui_composite.frag.spv");
+    pipelineBuilder._shaderStages.push_back(
+        vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, resolveVertexShader));
+
+    pipelineBuilder._shaderStages.push_back(
+        vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_FRAGMENT_BIT, uiCompositeFragShader));
+
+    //the layer is premultiplied
+    pipelineBuilder._colorBlendAttachment.blendEnable = VK_TRUE;
+    pipelineBuilder._colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    pipelineBuilder._colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    pipelineBuilder._colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+    pipelineBuilder._colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    pipelineBuilder._colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    pipelineBuilder._colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+    pipelineBuilder._pipelineLayout = _uiCompositePipelineLayout;
+    _uiCompositePipeline = pipelineBuilder.build_pipeline(_device, _renderPass);
+
+    pipelineBuilder._colorBlendAttachment = vkinit::color_blend_attachment_state();
 
     // delete vulkan shaders
     vkDestroyShaderModule(_device, triangleFragShader, nullptr);
@@ -785,6 +1937,16 @@ void VulkanEngine::init_pipelines()
     vkDestroyShaderModule(_device, triangleMeshVertexShader, nullptr);
     vkDestroyShaderModule(_device, defaultLitFragShader, nullptr);
     vkDestroyShaderModule(_device, texturedLitFragShader, nullptr);
+    vkDestroyShaderModule(_device, texturedBakedFragShader, nullptr);
+    vkDestroyShaderModule(_device, vertexPullingShader, nullptr);
+    vkDestroyShaderModule(_device, visibilityVertexShader, nullptr);
+    vkDestroyShaderModule(_device, visibilityFragShader, nullptr);
+    vkDestroyShaderModule(_device, debugViewVertexShader, nullptr);
+    vkDestroyShaderModule(_device, debugViewFragShader, nullptr);
+    vkDestroyShaderModule(_device, resolveVertexShader, nullptr);
+    vkDestroyShaderModule(_device, resolveFragShader, nullptr);
+    vkDestroyShaderModule(_device, upscaleFragShader, nullptr);
+    vkDestroyShaderModule(_device, uiCompositeFragShader, nullptr);
 
     _mainDeletionQueue.push_function([=]() {
 		//destroy the 2 pipelines we have created
@@ -792,17 +1954,36 @@ void VulkanEngine::init_pipelines()
         vkDestroyPipeline(_device, _trianglePipeline, nullptr);
         vkDestroyPipeline(_device, _meshPipeline, nullptr);
         vkDestroyPipeline(_device, texPipeline, nullptr);
+        vkDestroyPipeline(_device, meshPullingPipeline, nullptr);
+        vkDestroyPipeline(_device, texPullingPipeline, nullptr);
+        vkDestroyPipeline(_device, texBakedPipeline, nullptr);
+        vkDestroyPipeline(_device, texBakedPullingPipeline, nullptr);
+        vkDestroyPipeline(_device, _visibilityPipeline, nullptr);
+        vkDestroyPipeline(_device, _visibilityResolvePipeline, nullptr);
+        vkDestroyPipeline(_device, _upscalePipeline, nullptr);
+        vkDestroyPipeline(_device, _uiCompositePipeline, nullptr);
+        for (VkPipeline debugViewPipeline : _debugViewPipelines) {
+            vkDestroyPipeline(_device, debugViewPipeline, nullptr);
+        }
 
 		//destroy the pipeline layout that they use
 		vkDestroyPipelineLayout(_device, _trianglePipelineLayout, nullptr);
         vkDestroyPipelineLayout(_device, _meshPipelineLayout, nullptr);
         vkDestroyPipelineLayout(_device, texturedPipeLayout, nullptr);
+        vkDestroyPipelineLayout(_device, _visibilityResolvePipelineLayout, nullptr);
+        vkDestroyPipelineLayout(_device, _upscalePipelineLayout, nullptr);
+        vkDestroyPipelineLayout(_device, _uiCompositePipelineLayout, nullptr);
     });
 }
 
 // Based from - https://github.com/ocornut/imgui/blob/master/examples/example_sdl_vulkan/main.cpp
 void VulkanEngine::init_imgui()
 {
+    //ImGui needs the SDL window
+    if (_headless) {
+        return;
+    }
+
     //1: create descriptor pool for IMGUI
     // the size of the pool is very oversize, but it's copied from imgui demo itself.
     VkDescriptorPoolSize pool_sizes[] =
@@ -850,7 +2031,8 @@ void VulkanEngine::init_imgui()
     init_info.ImageCount = 3;
     init_info.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
 
-    ImGui_ImplVulkan_Init(&init_info, _renderPass);
+    //imgui only ever draws into the cached UI layer
+    ImGui_ImplVulkan_Init(&init_info, _uiRenderPass);
 
     //execute a gpu command to upload imgui font textures
     immediate_submit([&](VkCommandBuffer cmd) {
@@ -869,134 +2051,716 @@ void VulkanEngine::init_imgui()
         });
 }
 
-VkPipeline PipelineBuilder::build_pipeline(VkDevice device, VkRenderPass pass)
+void VulkanEngine::init_visibility_buffer()
 {
-    //make viewport state from our stored viewport and scissor.
-    //at the moment we won't support multiple viewports or scissors
-    VkPipelineViewportStateCreateInfo viewportState = {};
-    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-    viewportState.pNext = nullptr;
+    /*** Visibility image - object id and triangle id per pixel ***/
+    const VkExtent3D visibilityExtent = {
+        _windowExtent.width,
+        _windowExtent.height,
+        1
+    };
 
-    viewportState.viewportCount = 1;
-    viewportState.pViewports = &_viewport;
-    viewportState.scissorCount = 1;
-    viewportState.pScissors = &_scissor;
+    const VkImageCreateInfo vimg_info = vkinit::image_create_info(_visibilityFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, visibilityExtent);
 
-    //setup dummy color blending. We aren't using transparent objects yet
-    //the blending is just "no blend", but we do write to the color attachment
-    VkPipelineColorBlendStateCreateInfo colorBlending = {};
-    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-    colorBlending.pNext = nullptr;
+    VmaAllocationCreateInfo vimg_allocinfo = {};
+    vimg_allocinfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    vimg_allocinfo.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-    colorBlending.logicOpEnable = VK_FALSE;
-    colorBlending.logicOp = VK_LOGIC_OP_COPY;
-    colorBlending.attachmentCount = 1;
-    colorBlending.pAttachments = &_colorBlendAttachment;
+    vmaCreateImage(_allocator, &vimg_info, &vimg_allocinfo, &_visibilityImage._image, &_visibilityImage._allocation, nullptr);
 
-    //build the actual pipeline
-    //we now use all of the info structs we have been writing into into this one to create the pipeline
-    VkGraphicsPipelineCreateInfo pipelineInfo = {};
-    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineInfo.pNext = nullptr;
+    const VkImageViewCreateInfo vview_info = vkinit::imageview_create_info(_visibilityFormat, _visibilityImage._image, VK_IMAGE_ASPECT_COLOR_BIT);
+    VK_CHECK(vkCreateImageView(_device, &vview_info, nullptr, &_visibilityImageView));
 
-    pipelineInfo.stageCount = _shaderStages.size();
-    pipelineInfo.pStages = _shaderStages.data();
-    pipelineInfo.pVertexInputState = &_vertexInputInfo;
-    pipelineInfo.pInputAssemblyState = &_inputAssembly;
-    pipelineInfo.pViewportState = &viewportState;
-    pipelineInfo.pRasterizationState = &_rasterizer;
-    pipelineInfo.pMultisampleState = &_multisampling;
-    pipelineInfo.pDepthStencilState = &_depthStencil;
-    pipelineInfo.pColorBlendState = &colorBlending;
-    pipelineInfo.layout = _pipelineLayout;
-    pipelineInfo.renderPass = pass;
-    pipelineInfo.subpass = 0;
-    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+    /*** Render pass - ids + depth, ids are left ready to be sampled by the resolve ***/
+    VkAttachmentDescription visibility_attachment = {};
+    visibility_attachment.format = _visibilityFormat;
+    visibility_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    visibility_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    visibility_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    visibility_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    visibility_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    visibility_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    visibility_attachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-    //it's easy to error out on create graphics pipeline, so we handle it a bit better than the common VK_CHECK case
-    VkPipeline newPipeline;
-    if (vkCreateGraphicsPipelines(
-        device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &newPipeline) != VK_SUCCESS) {
-        std::cout << "failed to create pipeline\n";
-        return VK_NULL_HANDLE; // failed to create graphics pipeline
-    }
-    else
-    {
-        return newPipeline;
-    }
-}
+    VkAttachmentReference visibility_attachment_ref = {};
+    visibility_attachment_ref.attachment = 0;
+    visibility_attachment_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
-void VulkanEngine::load_meshes() {
-	//make the array 3 vertices long
-	_triangleMesh._vertices.resize(3);
+    //depth is only needed to keep the nearest triangle, nothing reads it afterwards
+    VkAttachmentDescription depth_attachment = {};
+    depth_attachment.format = _depthFormat;
+    depth_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depth_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depth_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depth_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    depth_attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
-	//vertex positions
-	_triangleMesh._vertices[0].position = { 1.f, 1.f, 0.0f };
-	_triangleMesh._vertices[1].position = {-1.f, 1.f, 0.0f };
-	_triangleMesh._vertices[2].position = { 0.f,-1.f, 0.0f };
+    VkAttachmentReference depth_attachment_ref = {};
+    depth_attachment_ref.attachment = 1;
+    depth_attachment_ref.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
-	//vertex colors, all green
-	_triangleMesh._vertices[0].color = { 0.f, 1.f, 0.0f }; //pure green
-	_triangleMesh._vertices[1].color = { 0.f, 1.f, 0.0f }; //pure green
-	_triangleMesh._vertices[2].color = { 0.f, 1.f, 0.0f }; //pure green
+    VkSubpassDescription subpass = {};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &visibility_attachment_ref;
+    subpass.pDepthStencilAttachment = &depth_attachment_ref;
+
+    //wait for the previous frame's resolve to stop reading before writing new ids
+    VkSubpassDependency dependency_in = {};
+    dependency_in.srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependency_in.dstSubpass = 0;
+    dependency_in.srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependency_in.srcAccessMask = 0;
+    dependency_in.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    dependency_in.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+    //make the ids visible to the resolve pass
+    VkSubpassDependency dependency_out = {};
+    dependency_out.srcSubpass = 0;
+    dependency_out.dstSubpass = VK_SUBPASS_EXTERNAL;
+    dependency_out.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependency_out.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependency_out.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependency_out.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    VkAttachmentDescription attachments[2] = { visibility_attachment, depth_attachment };
+    VkSubpassDependency dependencies[2] = { dependency_in, dependency_out };
 
-	//we don't care about the vertex normals
-	upload_mesh(_triangleMesh);
+    VkRenderPassCreateInfo render_pass_info = {};
+    render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    render_pass_info.attachmentCount = 2;
+    render_pass_info.pAttachments = attachments;
+    render_pass_info.subpassCount = 1;
+    render_pass_info.pSubpasses = &subpass;
+    render_pass_info.dependencyCount = 2;
+    render_pass_info.pDependencies = dependencies;
 
-    //load the monkey
-	_monkeyMesh.load_from_obj("../assets/monkey_smooth.obj");
-    upload_mesh(_monkeyMesh);
+    VK_CHECK(vkCreateRenderPass(_device, &render_pass_info, nullptr, &_visibilityRenderPass));
 
-    _wolfMesh.load_from_obj("../assets/wolf/Wolf_One_obj.obj");
-    upload_mesh(_wolfMesh);
+    /*** Framebuffer - shares the depth image with the main pass ***/
+    VkImageView fbAttachments[2] = { _visibilityImageView, _depthImageView };
 
-    _maleHumanMesh.load_from_obj("../assets/FinalBaseMesh.obj");
-    upload_mesh(_maleHumanMesh);
+    VkFramebufferCreateInfo fb_info = {};
+    fb_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    fb_info.pNext = nullptr;
+    fb_info.renderPass = _visibilityRenderPass;
+    fb_info.attachmentCount = 2;
+    fb_info.pAttachments = fbAttachments;
+    fb_info.width = _windowExtent.width;
+    fb_info.height = _windowExtent.height;
+    fb_info.layers = 1;
 
-    //note that we are copying them. Eventually we will delete the hardcoded _monkey and _triangle meshes, so it's no problem now.
-	_meshes["monkey"] = _monkeyMesh;
-    _meshes["wolf"] = _wolfMesh;
-    _meshes["maleHuman"] = _maleHumanMesh;
-	_meshes["triangle"] = _triangleMesh;
+    VK_CHECK(vkCreateFramebuffer(_device, &fb_info, nullptr, &_visibilityFramebuffer));
 
-    // Lost empire
-    Mesh lostEmpire{};
-    lostEmpire.load_from_obj("../assets/lost_empire.obj");
-    upload_mesh(lostEmpire);
-    _meshes["empire"] = lostEmpire;
-}
+    /*** Resolve descriptor set - ids are read with texelFetch, so the sampler never filters ***/
+    const VkSamplerCreateInfo samplerInfo = vkinit::sampler_create_info(VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
 
-void VulkanEngine::upload_mesh(Mesh& mesh) {
-    const size_t bufferSize = mesh._vertices.size() * sizeof(Vertex);
+    VkSampler visibilitySampler;
+    VK_CHECK(vkCreateSampler(_device, &samplerInfo, nullptr, &visibilitySampler));
 
-    if (use_gpu_only_memory_for_mesh_buffers) {
-        //allocate staging buffer
-        VkBufferCreateInfo stagingBufferInfo = {};
-        stagingBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        stagingBufferInfo.pNext = nullptr;
+    const std::vector<VkDescriptorSetLayout> resolveLayouts = {_visibilityResolveSetLayout};
+    const VkDescriptorSetAllocateInfo allocInfo = vkinit::descriptorset_allocate_info(_descriptorPool, resolveLayouts);
+    VK_CHECK(vkAllocateDescriptorSets(_device, &allocInfo, &_visibilityResolveDescriptor));
 
-        stagingBufferInfo.size = bufferSize;
-        stagingBufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    VkDescriptorImageInfo visibilityImageInfo;
+    visibilityImageInfo.sampler = visibilitySampler;
+    visibilityImageInfo.imageView = _visibilityImageView;
+    visibilityImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-        //let the VMA library know that this data should be on CPU RAM
-        VmaAllocationCreateInfo vmaallocInfo = {};
-        vmaallocInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+    const VkWriteDescriptorSet visibilityWrite = vkinit::write_descriptor_image(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, _visibilityResolveDescriptor, &visibilityImageInfo, 0);
+    vkUpdateDescriptorSets(_device, 1, &visibilityWrite, 0, nullptr);
 
-        AllocatedBuffer stagingBuffer;
+    _mainDeletionQueue.push_function([=]() {
+        vkDestroySampler(_device, visibilitySampler, nullptr);
+        vkDestroyFramebuffer(_device, _visibilityFramebuffer, nullptr);
+        vkDestroyRenderPass(_device, _visibilityRenderPass, nullptr);
+        vkDestroyImageView(_device, _visibilityImageView, nullptr);
+        vmaDestroyImage(_allocator, _visibilityImage._image, _visibilityImage._allocation);
+    });
+}
 
-        //allocate the buffer
-        VK_CHECK(vmaCreateBuffer(_allocator, &stagingBufferInfo, &vmaallocInfo,
-            &stagingBuffer._buffer,
-            &stagingBuffer._allocation,
-            nullptr));
+void VulkanEngine::init_scene_target()
+{
+    /*** Scene image - same format as the swapchain so every scene pipeline stays compatible with the main pass ***/
+    const VkExtent3D sceneExtent = {
+        _windowExtent.width,
+        _windowExtent.height,
+        1
+    };
 
-        //copy vertex data
-        void* data;
-        vmaMapMemory(_allocator, stagingBuffer._allocation, &data);
+    const VkImageCreateInfo simg_info = vkinit::image_create_info(_swapchainImageFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, sceneExtent);
 
-        memcpy(data, mesh._vertices.data(), bufferSize);
+    VmaAllocationCreateInfo simg_allocinfo = {};
+    simg_allocinfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    simg_allocinfo.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-        vmaUnmapMemory(_allocator, stagingBuffer._allocation);
+    vmaCreateImage(_allocator, &simg_info, &simg_allocinfo, &_sceneImage._image, &_sceneImage._allocation, nullptr);
+
+    const VkImageViewCreateInfo sview_info = vkinit::imageview_create_info(_swapchainImageFormat, _sceneImage._image, VK_IMAGE_ASPECT_COLOR_BIT);
+    VK_CHECK(vkCreateImageView(_device, &sview_info, nullptr, &_sceneImageView));
+
+    /*** Render pass - color + depth, color is left ready to be sampled by the upscale ***/
+    VkAttachmentDescription color_attachment = {};
+    color_attachment.format = _swapchainImageFormat;
+    color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    color_attachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VkAttachmentReference color_attachment_ref = {};
+    color_attachment_ref.attachment = 0;
+    color_attachment_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentDescription depth_attachment = {};
+    depth_attachment.format = _depthFormat;
+    depth_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    //kept for the scene chunks of split submission, they test against the depth of the earlier chunks
+    depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    depth_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depth_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depth_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    depth_attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference depth_attachment_ref = {};
+    depth_attachment_ref.attachment = 1;
+    depth_attachment_ref.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass = {};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &color_attachment_ref;
+    subpass.pDepthStencilAttachment = &depth_attachment_ref;
+
+    //wait for the previous frame's upscale to stop reading, and for the visibility pass to release the depth image
+    VkSubpassDependency dependency_in = {};
+    dependency_in.srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependency_in.dstSubpass = 0;
+    dependency_in.srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependency_in.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependency_in.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    dependency_in.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+    //make the scene visible to the upscale
+    VkSubpassDependency dependency_out = {};
+    dependency_out.srcSubpass = 0;
+    dependency_out.dstSubpass = VK_SUBPASS_EXTERNAL;
+    dependency_out.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependency_out.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependency_out.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependency_out.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    VkAttachmentDescription attachments[2] = { color_attachment, depth_attachment };
+    VkSubpassDependency dependencies[2] = { dependency_in, dependency_out };
+
+    VkRenderPassCreateInfo render_pass_info = {};
+    render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    render_pass_info.attachmentCount = 2;
+    render_pass_info.pAttachments = attachments;
+    render_pass_info.subpassCount = 1;
+    render_pass_info.pSubpasses = &subpass;
+    render_pass_info.dependencyCount = 2;
+    render_pass_info.pDependencies = dependencies;
+
+    VK_CHECK(vkCreateRenderPass(_device, &render_pass_info, nullptr, &_sceneRenderPass));
+
+    /*** Load render pass - the later scene chunks continue on what the earlier chunks left ***/
+    VkAttachmentDescription load_color_attachment = color_attachment;
+    load_color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    load_color_attachment.initialLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VkAttachmentDescription load_depth_attachment = depth_attachment;
+    load_depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    load_depth_attachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    //wait for the previous chunk's color and depth writes
+    VkSubpassDependency load_dependency_in = {};
+    load_dependency_in.srcSubpass = VK_SUBPASS_EXTERNAL;
+    load_dependency_in.dstSubpass = 0;
+    load_dependency_in.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    load_dependency_in.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    load_dependency_in.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    load_dependency_in.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+        | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+    VkAttachmentDescription load_attachments[2] = { load_color_attachment, load_depth_attachment };
+    VkSubpassDependency load_dependencies[2] = { load_dependency_in, dependency_out };
+
+    render_pass_info.pAttachments = load_attachments;
+    render_pass_info.pDependencies = load_dependencies;
+
+    VK_CHECK(vkCreateRenderPass(_device, &render_pass_info, nullptr, &_sceneLoadRenderPass));
+
+    /*** Framebuffer - allocated at window size, lower resolutions only use part of it ***/
+    VkImageView fbAttachments[2] = { _sceneImageView, _depthImageView };
+
+    VkFramebufferCreateInfo fb_info = {};
+    fb_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    fb_info.pNext = nullptr;
+    fb_info.renderPass = _sceneRenderPass;
+    fb_info.attachmentCount = 2;
+    fb_info.pAttachments = fbAttachments;
+    fb_info.width = _windowExtent.width;
+    fb_info.height = _windowExtent.height;
+    fb_info.layers = 1;
+
+    VK_CHECK(vkCreateFramebuffer(_device, &fb_info, nullptr, &_sceneFramebuffer));
+
+    /*** Upscale descriptor set - bilinear filtering does the upscale ***/
+    const VkSamplerCreateInfo samplerInfo = vkinit::sampler_create_info(VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
+
+    VkSampler sceneSampler;
+    VK_CHECK(vkCreateSampler(_device, &samplerInfo, nullptr, &sceneSampler));
+
+    const std::vector<VkDescriptorSetLayout> sceneLayouts = {_singleTextureSetLayout};
+    const VkDescriptorSetAllocateInfo allocInfo = vkinit::descriptorset_allocate_info(_descriptorPool, sceneLayouts);
+    VK_CHECK(vkAllocateDescriptorSets(_device, &allocInfo, &_sceneTextureDescriptor));
+
+    VkDescriptorImageInfo sceneImageInfo;
+    sceneImageInfo.sampler = sceneSampler;
+    sceneImageInfo.imageView = _sceneImageView;
+    sceneImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    const VkWriteDescriptorSet sceneWrite = vkinit::write_descriptor_image(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, _sceneTextureDescriptor, &sceneImageInfo, 0);
+    vkUpdateDescriptorSets(_device, 1, &sceneWrite, 0, nullptr);
+
+    _qualityGovernor.init(_governorSettings);
+    apply_quality_levels();
+
+    _mainDeletionQueue.push_function([=]() {
+        vkDestroySampler(_device, sceneSampler, nullptr);
+        vkDestroyFramebuffer(_device, _sceneFramebuffer, nullptr);
+        vkDestroyRenderPass(_device, _sceneRenderPass, nullptr);
+        vkDestroyRenderPass(_device, _sceneLoadRenderPass, nullptr);
+        vkDestroyImageView(_device, _sceneImageView, nullptr);
+        vmaDestroyImage(_allocator, _sceneImage._image, _sceneImage._allocation);
+    });
+}
+
+void VulkanEngine::init_ui_layer()
+{
+    /*** UI image - swapchain format, so ImGui blends exactly like it did straight into the swapchain ***/
+    const VkExtent3D uiExtent = {
+        _windowExtent.width,
+        _windowExtent.height,
+        1
+    };
+
+    const VkImageCreateInfo uimg_info = vkinit::image_create_info(_swapchainImageFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, uiExtent);
+
+    VmaAllocationCreateInfo uimg_allocinfo = {};
+    uimg_allocinfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    uimg_allocinfo.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    vmaCreateImage(_allocator, &uimg_info, &uimg_allocinfo, &_uiImage._image, &_uiImage._allocation, nullptr);
+
+    const VkImageViewCreateInfo uview_info = vkinit::imageview_create_info(_swapchainImageFormat, _uiImage._image, VK_IMAGE_ASPECT_COLOR_BIT);
+    VK_CHECK(vkCreateImageView(_device, &uview_info, nullptr, &_uiImageView));
+
+    /*** Render pass - a single color attachment left ready to be sampled by the composite ***/
+    VkAttachmentDescription color_attachment = {};
+    color_attachment.format = _swapchainImageFormat;
+    color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    color_attachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VkAttachmentReference color_attachment_ref = {};
+    color_attachment_ref.attachment = 0;
+    color_attachment_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass = {};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &color_attachment_ref;
+
+    //the previous frame may still be compositing the old layer
+    VkSubpassDependency dependency_in = {};
+    dependency_in.srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependency_in.dstSubpass = 0;
+    dependency_in.srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependency_in.srcAccessMask = 0;
+    dependency_in.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependency_in.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+    VkSubpassDependency dependency_out = {};
+    dependency_out.srcSubpass = 0;
+    dependency_out.dstSubpass = VK_SUBPASS_EXTERNAL;
+    dependency_out.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependency_out.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependency_out.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependency_out.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    VkSubpassDependency dependencies[2] = { dependency_in, dependency_out };
+
+    VkRenderPassCreateInfo render_pass_info = {};
+    render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    render_pass_info.attachmentCount = 1;
+    render_pass_info.pAttachments = &color_attachment;
+    render_pass_info.subpassCount = 1;
+    render_pass_info.pSubpasses = &subpass;
+    render_pass_info.dependencyCount = 2;
+    render_pass_info.pDependencies = dependencies;
+
+    VK_CHECK(vkCreateRenderPass(_device, &render_pass_info, nullptr, &_uiRenderPass));
+
+    VkFramebufferCreateInfo fb_info = {};
+    fb_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    fb_info.pNext = nullptr;
+    fb_info.renderPass = _uiRenderPass;
+    fb_info.attachmentCount = 1;
+    fb_info.pAttachments = &_uiImageView;
+    fb_info.width = _windowExtent.width;
+    fb_info.height = _windowExtent.height;
+    fb_info.layers = 1;
+
+    VK_CHECK(vkCreateFramebuffer(_device, &fb_info, nullptr, &_uiFramebuffer));
+
+    /*** Composite descriptor set - read with texelFetch, the layer matches the window pixel for pixel ***/
+    const VkSamplerCreateInfo samplerInfo = vkinit::sampler_create_info(VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
+
+    VkSampler uiSampler;
+    VK_CHECK(vkCreateSampler(_device, &samplerInfo, nullptr, &uiSampler));
+
+    const std::vector<VkDescriptorSetLayout> uiLayouts = {_singleTextureSetLayout};
+    const VkDescriptorSetAllocateInfo allocInfo = vkinit::descriptorset_allocate_info(_descriptorPool, uiLayouts);
+    VK_CHECK(vkAllocateDescriptorSets(_device, &allocInfo, &_uiTextureDescriptor));
+
+    VkDescriptorImageInfo uiImageInfo;
+    uiImageInfo.sampler = uiSampler;
+    uiImageInfo.imageView = _uiImageView;
+    uiImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    const VkWriteDescriptorSet uiWrite = vkinit::write_descriptor_image(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, _uiTextureDescriptor, &uiImageInfo, 0);
+    vkUpdateDescriptorSets(_device, 1, &uiWrite, 0, nullptr);
+
+    _mainDeletionQueue.push_function([=]() {
+        vkDestroySampler(_device, uiSampler, nullptr);
+        vkDestroyFramebuffer(_device, _uiFramebuffer, nullptr);
+        vkDestroyRenderPass(_device, _uiRenderPass, nullptr);
+        vkDestroyImageView(_device, _uiImageView, nullptr);
+        vmaDestroyImage(_allocator, _uiImage._image, _uiImage._allocation);
+    });
+}
+
+void VulkanEngine::init_gpu_timers()
+{
+    _supportsTimestamps = _gpuProperties.limits.timestampComputeAndGraphics;
+    if (!_supportsTimestamps) {
+        std::cout << "GPU timestamps not supported, the quality governor will use CPU frame times" << std::endl;
+        return;
+    }
+
+    VkQueryPoolCreateInfo queryPoolInfo = {};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.pNext = nullptr;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolInfo.queryCount = FRAME_OVERLAP * 2;
+
+    VK_CHECK(vkCreateQueryPool(_device, &queryPoolInfo, nullptr, &_timestampQueryPool));
+
+    queryPoolInfo.queryCount = FRAME_OVERLAP * (MAX_TIMED_MATERIALS + 1);
+
+    VK_CHECK(vkCreateQueryPool(_device, &queryPoolInfo, nullptr, &_materialTimestampPool));
+
+    //timestampComputeAndGraphics covers the compute queues too
+    queryPoolInfo.queryCount = FRAME_OVERLAP * 2;
+
+    VK_CHECK(vkCreateQueryPool(_device, &queryPoolInfo, nullptr, &_computeTimestampPool));
+
+    _mainDeletionQueue.push_function([=]() {
+        vkDestroyQueryPool(_device, _timestampQueryPool, nullptr);
+        vkDestroyQueryPool(_device, _materialTimestampPool, nullptr);
+        vkDestroyQueryPool(_device, _computeTimestampPool, nullptr);
+    });
+}
+
+void VulkanEngine::init_particles()
+{
+    /*** DescriptorSetLayout - Particle Buffer, written by the simulation and read by the point draw ***/
+    const VkDescriptorSetLayoutBinding particleBind = vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT, 0);
+
+    const std::vector<VkDescriptorSetLayoutBinding> particleBindings = {particleBind};
+    const VkDescriptorSetLayoutCreateInfo particleSetInfo = vkinit::descriptorset_layout_create_info(particleBindings);
+
+    VK_CHECK(vkCreateDescriptorSetLayout(_device, &particleSetInfo, nullptr, &_particleSetLayout));
+
+    //shared by both queue families when the simulation runs on the compute queue, so no ownership transfers are needed
+    const uint32_t queueFamilies[2] = {_graphicsQueueFamily, _computeQueueFamily};
+    const bool concurrent = _hasComputeQueue && _computeQueueFamily != _graphicsQueueFamily;
+
+    for (size_t frameIdx = 0; frameIdx < FRAME_OVERLAP; frameIdx++) {
+        VkBufferCreateInfo bufferInfo = {};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = sizeof(GPUParticle) * MAX_PARTICLES;
+        bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+        bufferInfo.sharingMode = concurrent ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+        bufferInfo.queueFamilyIndexCount = concurrent ? 2 : 0;
+        bufferInfo.pQueueFamilyIndices = concurrent ? queueFamilies : nullptr;
+
+        VmaAllocationCreateInfo vmaallocInfo = {};
+        vmaallocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+        AllocatedBuffer& particleBuffer = _frames[frameIdx].particleBuffer;
+        VK_CHECK(vmaCreateBuffer(_allocator, &bufferInfo, &vmaallocInfo, &particleBuffer._buffer, &particleBuffer._allocation, nullptr));
+
+        const std::vector<VkDescriptorSetLayout> particleLayouts = {_particleSetLayout};
+        const VkDescriptorSetAllocateInfo allocInfo = vkinit::descriptorset_allocate_info(_descriptorPool, particleLayouts);
+        VK_CHECK(vkAllocateDescriptorSets(_device, &allocInfo, &_frames[frameIdx].particleDescriptor));
+
+        VkDescriptorBufferInfo particleBufferInfo;
+        particleBufferInfo.buffer = particleBuffer._buffer;
+        particleBufferInfo.offset = 0;
+        particleBufferInfo.range = sizeof(GPUParticle) * MAX_PARTICLES;
+
+        const VkWriteDescriptorSet particleWrite = vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _frames[frameIdx].particleDescriptor, &particleBufferInfo, 0);
+        vkUpdateDescriptorSets(_device, 1, &particleWrite, 0, nullptr);
+
+        _mainDeletionQueue.push_function([=]() {
+            vmaDestroyBuffer(_allocator, _frames[frameIdx].particleBuffer._buffer, _frames[frameIdx].particleBuffer._allocation);
+        });
+    }
+
+    /*** Simulation - particles.comp, the particle set and the emitter as push constants ***/
+    VkPushConstantRange computePushConstant;
+    computePushConstant.offset = 0;
+    computePushConstant.size = sizeof(ParticlePushConstants);
+    computePushConstant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkPipelineLayoutCreateInfo compute_pipeline_layout_info = vkinit::pipeline_layout_create_info();
+    compute_pipeline_layout_info.setLayoutCount = 1;
+    compute_pipeline_layout_info.pSetLayouts = &_particleSetLayout;
+    compute_pipeline_layout_info.pushConstantRangeCount = 1;
+    compute_pipeline_layout_info.pPushConstantRanges = &computePushConstant;
+
+    VK_CHECK(vkCreatePipelineLayout(_device, &compute_pipeline_layout_info, nullptr, &_particleComputeLayout));
+
+    VkShaderModule particleComputeShader;
+    if (!load_shader_module("../shaders/particles.comp.spv", &particleComputeShader)) {
+        std::cout << "Error loading particles.comp.spv shader module" << std::endl;
+    }
+
+    VkComputePipelineCreateInfo computePipelineInfo = {};
+    computePipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    computePipelineInfo.stage = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, particleComputeShader);
+    computePipelineInfo.layout = _particleComputeLayout;
+
+    VK_CHECK(vkCreateComputePipelines(_device, VK_NULL_HANDLE, 1, &computePipelineInfo, nullptr, &_particleComputePipeline));
+
+    /*** Draw - one point per particle, pulled from the particle set in the vertex shader ***/
+    const VkDescriptorSetLayout drawSetLayouts[2] = {_globalSetLayout, _particleSetLayout};
+    VkPipelineLayoutCreateInfo draw_pipeline_layout_info = vkinit::pipeline_layout_create_info();
+    draw_pipeline_layout_info.setLayoutCount = 2;
+    draw_pipeline_layout_info.pSetLayouts = drawSetLayouts;
+
+    VK_CHECK(vkCreatePipelineLayout(_device, &draw_pipeline_layout_info, nullptr, &_particleDrawLayout));
+
+    VkShaderModule particleVertexShader;
+    if (!load_shader_module("../shaders/particles.vert.spv", &particleVertexShader)) {
+        std::cout << "Error loading particles.vert.spv shader module" << std::endl;
+    }
+    //the debug lines' fragment shader just passes the color on
+    VkShaderModule particleFragShader;
+    if (!load_shader_module("../shaders/debug_draw.frag.spv", &particleFragShader)) {
+        std::cout << "Error loading debug_draw.frag.spv shader module" << std::endl;
+    }
+
+    PipelineBuilder pipelineBuilder;
+    pipelineBuilder._shaderStages.push_back(
+        vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, particleVertexShader));
+    pipelineBuilder._shaderStages.push_back(
+        vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_FRAGMENT_BIT, particleFragShader));
+    pipelineBuilder._vertexInputInfo = vkinit::vertex_input_state_create_info();
+    pipelineBuilder._inputAssembly = vkinit::input_assembly_create_info(VK_PRIMITIVE_TOPOLOGY_POINT_LIST);
+    pipelineBuilder._viewport = {0.f, 0.f, (float)_windowExtent.width, (float)_windowExtent.height, 0.f, 1.f};
+    pipelineBuilder._scissor = {{0, 0}, _windowExtent};
+    pipelineBuilder._dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    pipelineBuilder._rasterizer = vkinit::rasterization_state_create_info(VK_POLYGON_MODE_FILL);
+    pipelineBuilder._multisampling = vkinit::multisampling_state_create_info();
+
+    //additive, tested against the scene depth but never written
+    pipelineBuilder._colorBlendAttachment = vkinit::color_blend_attachment_state();
+    pipelineBuilder._colorBlendAttachment.blendEnable = VK_TRUE;
+    pipelineBuilder._colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    pipelineBuilder._colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    pipelineBuilder._colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+    pipelineBuilder._colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    pipelineBuilder._colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    pipelineBuilder._colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+    pipelineBuilder._depthStencil = vkinit::depth_stencil_create_info(true, false, VK_COMPARE_OP_LESS_OR_EQUAL);
+    pipelineBuilder._pipelineLayout = _particleDrawLayout;
+
+    _particleDrawPipeline = pipelineBuilder.build_pipeline(_device, _renderPass);
+
+    vkDestroyShaderModule(_device, particleComputeShader, nullptr);
+    vkDestroyShaderModule(_device, particleVertexShader, nullptr);
+    vkDestroyShaderModule(_device, particleFragShader, nullptr);
+
+    _mainDeletionQueue.push_function([=]() {
+        vkDestroyPipeline(_device, _particleDrawPipeline, nullptr);
+        vkDestroyPipelineLayout(_device, _particleDrawLayout, nullptr);
+        vkDestroyPipeline(_device, _particleComputePipeline, nullptr);
+        vkDestroyPipelineLayout(_device, _particleComputeLayout, nullptr);
+        vkDestroyDescriptorSetLayout(_device, _particleSetLayout, nullptr);
+    });
+}
+
+VkPipeline PipelineBuilder::build_pipeline(VkDevice device, VkRenderPass pass)
+{
+    //make viewport state from our stored viewport and scissor.
+    //at the moment we won't support multiple viewports or scissors
+    VkPipelineViewportStateCreateInfo viewportState = {};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.pNext = nullptr;
+
+    viewportState.viewportCount = 1;
+    viewportState.pViewports = &_viewport;
+    viewportState.scissorCount = 1;
+    viewportState.pScissors = &_scissor;
+
+    VkPipelineDynamicStateCreateInfo dynamicState = {};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.pNext = nullptr;
+    dynamicState.dynamicStateCount = static_cast<uint32_t>(_dynamicStates.size());
+    dynamicState.pDynamicStates = _dynamicStates.data();
+
+    //setup dummy color blending. We aren't using transparent objects yet
+    //the blending is just "no blend", but we do write to the color attachment
+    VkPipelineColorBlendStateCreateInfo colorBlending = {};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.pNext = nullptr;
+
+    colorBlending.logicOpEnable = VK_FALSE;
+    colorBlending.logicOp = VK_LOGIC_OP_COPY;
+    colorBlending.attachmentCount = 1;
+    colorBlending.pAttachments = &_colorBlendAttachment;
+
+    //build the actual pipeline
+    //we now use all of the info structs we have been writing into into this one to create the pipeline
+    VkGraphicsPipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.pNext = nullptr;
+
+    pipelineInfo.stageCount = _shaderStages.size();
+    pipelineInfo.pStages = _shaderStages.data();
+    pipelineInfo.pVertexInputState = &_vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &_inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &_rasterizer;
+    pipelineInfo.pMultisampleState = &_multisampling;
+    pipelineInfo.pDepthStencilState = &_depthStencil;
+    pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.pDynamicState = _dynamicStates.empty() ? nullptr : &dynamicState;
+    pipelineInfo.layout = _pipelineLayout;
+    pipelineInfo.renderPass = pass;
+    pipelineInfo.subpass = 0;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+    //it's easy to error out on create graphics pipeline, so we handle it a bit better than the common VK_CHECK case
+    VkPipeline newPipeline;
+    if (vkCreateGraphicsPipelines(
+        device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &newPipeline) != VK_SUCCESS) {
+        std::cout << "failed to create pipeline\n";
+        return VK_NULL_HANDLE; // failed to create graphics pipeline
+    }
+    else
+    {
+        return newPipeline;
+    }
+}
+
+void VulkanEngine::load_meshes() {
+	//make the array 3 vertices long
+	_triangleMesh._vertices.resize(3);
+
+	//vertex positions
+	_triangleMesh._vertices[0].position = { 1.f, 1.f, 0.0f };
+	_triangleMesh._vertices[1].position = {-1.f, 1.f, 0.0f };
+	_triangleMesh._vertices[2].position = { 0.f,-1.f, 0.0f };
+
+	//vertex colors, all green
+	_triangleMesh._vertices[0].color = { 0.f, 1.f, 0.0f }; //pure green
+	_triangleMesh._vertices[1].color = { 0.f, 1.f, 0.0f }; //pure green
+	_triangleMesh._vertices[2].color = { 0.f, 1.f, 0.0f }; //pure green
+
+	//we don't care about the vertex normals
+	_triangleMesh.compute_bounds();
+	upload_mesh(_triangleMesh);
+
+    //load the monkey
+	_monkeyMesh.load_from_obj("../assets/monkey_smooth.obj");
+    upload_mesh(_monkeyMesh);
+
+    _wolfMesh.load_from_obj("../assets/wolf/Wolf_One_obj.obj");
+    upload_mesh(_wolfMesh);
+
+    _maleHumanMesh.load_from_obj("../assets/FinalBaseMesh.obj");
+    upload_mesh(_maleHumanMesh);
+
+    //note that we are copying them. Eventually we will delete the hardcoded _monkey and _triangle meshes, so it's no problem now.
+	_meshes["monkey"] = _monkeyMesh;
+    _meshes["wolf"] = _wolfMesh;
+    _meshes["maleHuman"] = _maleHumanMesh;
+	_meshes["triangle"] = _triangleMesh;
+
+    // Lost empire
+    Mesh lostEmpire{};
+    lostEmpire.load_from_obj("../assets/lost_empire.obj");
+    //the textured shading never reads the vertex color, so the arena can keep it packed
+    lostEmpire._vertexFormat = VertexFormat::Packed;
+    //drawn in one piece, the whole map goes through the vertex shader from anywhere, so split it into cullable chunks
+    if (lostEmpire._vertices.size() > MESH_CHUNK_VERTEX_THRESHOLD) {
+        lostEmpire.build_chunks(_meshChunkSize);
+    }
+    //baked per vertex, after chunking like the baker does. The packed format would drop the colors holding it
+    if (!_bakedLightingPath.empty() && vkutil::load_baked_lighting(_bakedLightingPath, lostEmpire)) {
+        lostEmpire._vertexFormat = VertexFormat::Full;
+        _empireLightingBaked = true;
+    }
+    upload_mesh(lostEmpire);
+    _meshes["empire"] = lostEmpire;
+}
+
+void VulkanEngine::upload_mesh(Mesh& mesh) {
+    const size_t bufferSize = mesh._vertices.size() * sizeof(Vertex);
+    _metrics.add_upload_bytes(bufferSize);
+
+    if (use_gpu_only_memory_for_mesh_buffers) {
+        //allocate staging buffer
+        VkBufferCreateInfo stagingBufferInfo = {};
+        stagingBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        stagingBufferInfo.pNext = nullptr;
+
+        stagingBufferInfo.size = bufferSize;
+        stagingBufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+        //let the VMA library know that this data should be on CPU RAM
+        VmaAllocationCreateInfo vmaallocInfo = {};
+        vmaallocInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+
+        AllocatedBuffer stagingBuffer;
+
+        //allocate the buffer
+        VK_CHECK(vmaCreateBuffer(_allocator, &stagingBufferInfo, &vmaallocInfo,
+            &stagingBuffer._buffer,
+            &stagingBuffer._allocation,
+            nullptr));
+
+        //copy vertex data
+        void* data;
+        vmaMapMemory(_allocator, stagingBuffer._allocation, &data);
+
+        memcpy(data, mesh._vertices.data(), bufferSize);
+
+        vmaUnmapMemory(_allocator, stagingBuffer._allocation);
 
         //allocate vertex buffer
         VkBufferCreateInfo vertexBufferInfo = {};
@@ -1005,282 +2769,1280 @@ void VulkanEngine::upload_mesh(Mesh& mesh) {
         //this buffer is going to be used as a Vertex Buffer
         vertexBufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
 
-        // reuse the vmaAllocInfo but with different type
-        vmaallocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+        // reuse the vmaAllocInfo but with different type
+        vmaallocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+        //allocate the buffer
+        VK_CHECK(vmaCreateBuffer(_allocator, &vertexBufferInfo, &vmaallocInfo,
+            &mesh._vertexBuffer._buffer,
+            &mesh._vertexBuffer._allocation,
+            nullptr));
+
+        immediate_submit([=](VkCommandBuffer cmd){
+            VkBufferCopy copy;
+            copy.dstOffset = 0;
+            copy.srcOffset = 0;
+            copy.size = bufferSize;
+            vkCmdCopyBuffer(cmd, stagingBuffer._buffer, mesh._vertexBuffer._buffer, 1, &copy);
+        });
+
+        // add the destruction of triangle mesh buffer to the deletion queue
+        _mainDeletionQueue.push_function([=]() {
+            vmaDestroyBuffer(_allocator, mesh._vertexBuffer._buffer, mesh._vertexBuffer._allocation);
+        });
+
+        // immdiately delete staging buffer
+        vmaDestroyBuffer(_allocator, stagingBuffer._buffer, stagingBuffer._allocation);
+    } else {
+        VkBufferCreateInfo vertexBufferInfo = {};
+        vertexBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        vertexBufferInfo.size = bufferSize;
+        vertexBufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+
+        VmaAllocationCreateInfo vmaallocInfo = {};
+        vmaallocInfo.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+
+        //allocate the buffer
+        VK_CHECK(vmaCreateBuffer(_allocator, &vertexBufferInfo, &vmaallocInfo,
+            &mesh._vertexBuffer._buffer,
+            &mesh._vertexBuffer._allocation,
+            nullptr));
+
+        //copy vertex data
+        void* data;
+        vmaMapMemory(_allocator, mesh._vertexBuffer._allocation, &data);
+
+        memcpy(data, mesh._vertices.data(), bufferSize);
+
+        vmaUnmapMemory(_allocator, mesh._vertexBuffer._allocation);
+
+        // add the destruction of triangle mesh buffer to the deletion queue
+        _mainDeletionQueue.push_function([=]() {
+            vmaDestroyBuffer(_allocator, mesh._vertexBuffer._buffer, mesh._vertexBuffer._allocation);
+        });
+    }
+}
+
+void VulkanEngine::init_geometry_arena()
+{
+    //pack every mesh back to back in its own vertex format, shaders find a vertex from the mesh's offset and format
+    std::vector<uint32_t> arenaWords;
+    for (auto& [name, mesh] : _meshes) {
+        mesh._arenaOffset = static_cast<uint32_t>(arenaWords.size());
+        mesh.pack_vertices(arenaWords);
+    }
+
+    const size_t staticSize = arenaWords.size() * sizeof(uint32_t);
+
+    //streamed meshes keep about half of their GPU budget in the arena, the rest in their vertex buffers
+    size_t arenaSize = staticSize;
+    if (_worldStreamer.is_running()) {
+        arenaSize += _streamingSettings.gpuBudget / 2;
+    }
+
+    _arenaAllocator.init(static_cast<uint32_t>(arenaSize / sizeof(uint32_t)));
+    uint32_t staticOffset;
+    _arenaAllocator.allocate(static_cast<uint32_t>(arenaWords.size()), staticOffset);
+
+    AllocatedBuffer stagingBuffer = create_buffer(staticSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+    _metrics.add_upload_bytes(staticSize);
+
+    void* data;
+    vmaMapMemory(_allocator, stagingBuffer._allocation, &data);
+    memcpy(data, arenaWords.data(), staticSize);
+    vmaUnmapMemory(_allocator, stagingBuffer._allocation);
+
+    _geometryArena = create_buffer(arenaSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+
+    immediate_submit([=](VkCommandBuffer cmd) {
+        VkBufferCopy copy;
+        copy.dstOffset = 0;
+        copy.srcOffset = 0;
+        copy.size = staticSize;
+        vkCmdCopyBuffer(cmd, stagingBuffer._buffer, _geometryArena._buffer, 1, &copy);
+    });
+
+    vmaDestroyBuffer(_allocator, stagingBuffer._buffer, stagingBuffer._allocation);
+
+    _mainDeletionQueue.push_function([=]() {
+        vmaDestroyBuffer(_allocator, _geometryArena._buffer, _geometryArena._allocation);
+    });
+
+    //point binding 1 of every frame's object set at the arena
+    for (size_t frameIdx = 0; frameIdx < FRAME_OVERLAP; frameIdx++) {
+        VkDescriptorBufferInfo arenaBufferInfo;
+        arenaBufferInfo.buffer = _geometryArena._buffer;
+        arenaBufferInfo.offset = 0;
+        arenaBufferInfo.range = arenaSize;
+
+        const VkWriteDescriptorSet arenaWrite = vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _frames[frameIdx].objectDescriptor, &arenaBufferInfo, 1);
+        vkUpdateDescriptorSets(_device, 1, &arenaWrite, 0, nullptr);
+    }
+}
+
+Material* VulkanEngine::create_material(VkPipeline pipeline, VkPipelineLayout layout, const std::string& name)
+{
+	Material mat;
+	mat.pipeline = pipeline;
+	mat.pipelineLayout = layout;
+	_materials[name] = mat;
+	return &_materials[name];
+}
+
+Material* VulkanEngine::get_material(const std::string& name)
+{
+	//search for the object, and return nullptr if not found
+	auto it = _materials.find(name);
+	if (it == _materials.end()) {
+		return nullptr;
+	}
+	else {
+		return &(*it).second;
+	}
+}
+
+
+Mesh* VulkanEngine::get_mesh(const std::string& name)
+{
+	auto it = _meshes.find(name);
+	if (it == _meshes.end()) {
+		return nullptr;
+	}
+	else {
+		return &(*it).second;
+	}
+}
+
+
+void VulkanEngine::update_camera()
+{
+    PROFILE_SCOPE(_profiler, "camera");
+
+    //replays keep the captured camera
+    if (_replaying) {
+        return;
+    }
+
+	//camera view
+	glm::mat4 view = glm::translate(glm::mat4(1.f), _camPos);
+
+	//camera projection
+	glm::mat4 projection = glm::perspective(glm::radians(70.f), 1700.f / 900.f, 0.1f, _cameraFar);
+	projection[1][1] *= -1;
+
+    //fill a GPU camera data struct
+	_cameraData.proj = projection;
+	_cameraData.view = view;
+	_cameraData.viewproj = projection * view;
+}
+
+void VulkanEngine::cull_renderables()
+{
+    PROFILE_SCOPE(_profiler, "culling");
+
+    if (!_enableFrustumCulling) {
+        _visibleObjects.resize(_renderables.size());
+        for (size_t i = 0; i < _renderables.size(); i++) {
+            _visibleObjects[i] = static_cast<uint32_t>(i);
+        }
+        return;
+    }
+
+    vkutil::Frustum frustum = vkutil::extract_frustum(_cameraData.viewproj);
+
+    //the governor can pull the far plane in, the view matrix moves the world by _camPos so the camera sits at -_camPos
+    const float drawDistanceScale = _qualityGovernor.levels().drawDistanceScale;
+    if (drawDistanceScale < 1.f) {
+        vkutil::set_far_distance(frustum, -_camPos, _cameraFar * drawDistanceScale);
+    }
+
+    _pvsCell = vkutil::PotentiallyVisibleSet::INVALID_CELL;
+    if (_enablePvs && _pvsMesh) {
+        _pvsCell = _pvs.cell_at(glm::vec3(_pvsWorldToMesh * glm::vec4(-_camPos, 1.f)));
+    }
+
+    //outside the baked grid everything goes through frustum culling
+    if (_pvsCell != vkutil::PotentiallyVisibleSet::INVALID_CELL) {
+        _pvs.filter_objects(_pvsCell, _pvsMesh, _renderables.data(), _renderables.size(), _pvsCandidates);
+        vkutil::cull_objects(frustum, _renderables.data(), _pvsCandidates, _visibleObjects);
+    } else if (_useObjectTree) {
+        //the tree answers with fattened boxes, the exact bounds decide. Sorted to keep the draw order
+        _objectTree.query_frustum(frustum, _treeCandidates);
+        std::sort(_treeCandidates.begin(), _treeCandidates.end());
+        vkutil::cull_objects(frustum, _renderables.data(), _treeCandidates, _visibleObjects);
+    } else {
+        vkutil::cull_objects(frustum, _renderables.data(), _renderables.size(), _visibleObjects);
+    }
+
+    if (_enableOcclusionCulling && !_occluders.empty()) {
+        PROFILE_SCOPE(_profiler, "occlusion culling");
+        _occlusionRasterizer.clear();
+        _occlusionRasterizer.rasterize(_cameraData.viewproj, _occluders.data(), _occluders.size(), &_jobs);
+        _occlusionRasterizer.cull_objects(_renderables.data(), _visibleObjects);
+    }
+}
+
+void VulkanEngine::upload_frame_data(RenderObject* first, int count)
+{
+    PROFILE_SCOPE(_profiler, "upload frame data");
+
+    //copy the camera to the buffer
+	void* data;
+	vmaMapMemory(_allocator, get_current_frame().cameraBuffer._allocation, &data);
+	memcpy(data, &_cameraData, sizeof(GPUCameraData));
+	vmaUnmapMemory(_allocator, get_current_frame().cameraBuffer._allocation);
+
+    void* objectData;
+    vmaMapMemory(_allocator, get_current_frame().objectBuffer._allocation, &objectData);
+
+    //the buffer holds _objectCapacity, init_object_buffers and streaming keep _renderables within that
+    vkutil::write_object_data(first, std::min(count, static_cast<int>(_objectCapacity)), (GPUObjectData*)objectData);
+
+    vmaUnmapMemory(_allocator, get_current_frame().objectBuffer._allocation);
+
+    
+    /*** Scene Data -- start ***/
+    float framed = (_animationFrame / 120.f);
+
+    //replays keep the captured scene data
+    if (!_replaying) {
+	    _sceneParameters.ambientColor = { sin(framed),0,cos(framed),1 };
+    }
+
+	char* sceneData;
+
+	vmaMapMemory(_allocator, _sceneParameterBuffer._allocation , (void**)&sceneData);
+
+	const int frameIndex = _frameNumber % FRAME_OVERLAP;
+
+	sceneData += pad_uniform_buffer_size(sizeof(GPUSceneData)) * frameIndex;
+
+	memcpy(sceneData, &_sceneParameters, sizeof(GPUSceneData));
+
+	vmaUnmapMemory(_allocator, _sceneParameterBuffer._allocation);
+    /*** Scene Data -- end ***/
+}
+
+void VulkanEngine::draw_objects(vkutil::CommandBackend& commands, RenderObject* first, const std::vector<uint32_t>& visible)
+{
+    PROFILE_SCOPE(_profiler, "draw objects");
+
+    vkutil::record_forward_draws(commands, get_frame_bindings(), first, visible);
+}
+
+const std::vector<uint32_t>& VulkanEngine::scene_chunk(uint32_t chunk, uint32_t chunkCount)
+{
+    //an even split by object count, _visibleObjects is in draw order so every chunk keeps its pipeline runs
+    const size_t begin = _visibleObjects.size() * chunk / chunkCount;
+    const size_t end = _visibleObjects.size() * (chunk + 1) / chunkCount;
+    _chunkDrawList.assign(_visibleObjects.begin() + begin, _visibleObjects.begin() + end);
+    return _chunkDrawList;
+}
+
+void VulkanEngine::submit_scene_part(VkCommandBuffer cmd, VkSemaphore signalSemaphore, bool lastPart)
+{
+    PROFILE_SCOPE(_profiler, "submit scene part");
+
+    VK_CHECK(vkEndCommandBuffer(cmd));
+
+    const std::vector<VkSemaphore> signalSemaphores = signalSemaphore == VK_NULL_HANDLE ? std::vector<VkSemaphore>{} : std::vector<VkSemaphore>{signalSemaphore};
+    submit_graphics(cmd, {}, {}, signalSemaphores, lastPart, VK_NULL_HANDLE);
+}
+
+void VulkanEngine::draw_objects_pulled(vkutil::CommandBackend& commands, RenderObject* first, const std::vector<uint32_t>& visible)
+{
+    PROFILE_SCOPE(_profiler, "draw objects pulled");
+
+    const AllocatedBuffer& indirectBuffer = get_current_frame().indirectBuffer;
+
+    VkDrawIndirectCommand* drawCommands;
+    vmaMapMemory(_allocator, indirectBuffer._allocation, (void**)&drawCommands);
+
+    vkutil::record_pulled_draws(commands, get_frame_bindings(), first, visible, drawCommands, indirectBuffer._buffer, _supportsMultiDrawIndirect);
+
+    vmaUnmapMemory(_allocator, indirectBuffer._allocation);
+}
+
+void VulkanEngine::draw_objects_timed(VkCommandBuffer cmd, vkutil::CommandBackend& commands, RenderObject* first, const std::vector<uint32_t>& visible)
+{
+    PROFILE_SCOPE(_profiler, "draw objects timed");
+
+    if (!_supportsTimestamps) {
+        vkutil::record_forward_draws(commands, get_frame_bindings(), first, visible);
+        return;
+    }
+
+    std::vector<const Material*>& timedMaterials = _timedMaterials[_frameNumber % FRAME_OVERLAP];
+    const uint32_t firstQuery = (_frameNumber % FRAME_OVERLAP) * (MAX_TIMED_MATERIALS + 1);
+
+    //all timestamps are at the bottom of the pipe, each material gets the time from the previous one finishing to it finishing
+    vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, _materialTimestampPool, firstQuery);
+
+    //visible is in material order, so every material is a single run
+    std::vector<uint32_t> run;
+    size_t runStart = 0;
+    while (runStart < visible.size()) {
+        const Material* material = first[visible[runStart]].material;
+
+        size_t runEnd = runStart;
+        while (runEnd < visible.size() && first[visible[runEnd]].material == material) {
+            ++runEnd;
+        }
+        //out of queries, whatever is left is drawn untimed
+        if (timedMaterials.size() == MAX_TIMED_MATERIALS) {
+            runEnd = visible.size();
+        }
+
+        run.assign(visible.begin() + runStart, visible.begin() + runEnd);
+        vkutil::record_forward_draws(commands, get_frame_bindings(), first, run);
+
+        if (timedMaterials.size() < MAX_TIMED_MATERIALS) {
+            timedMaterials.push_back(material);
+            vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, _materialTimestampPool, firstQuery + static_cast<uint32_t>(timedMaterials.size()));
+        }
+        runStart = runEnd;
+    }
+}
+
+void VulkanEngine::draw_debug_view(vkutil::CommandBackend& commands, RenderObject* first, const std::vector<uint32_t>& visible)
+{
+    PROFILE_SCOPE(_profiler, "draw debug view");
+
+    //taken from the view matrix rather than _camPos, so replays get the captured camera
+    const glm::vec3 cameraPosition = glm::vec3(glm::inverse(_cameraData.view)[3]);
+    const float drawDistance = _cameraFar * _qualityGovernor.levels().drawDistanceScale;
+
+    _debugViewData.resize(visible.size());
+    for (size_t i = 0; i < visible.size(); i++) {
+        const RenderObject& object = first[visible[i]];
+        const float distance = glm::distance(cameraPosition, object.worldBounds.center());
+
+        //4 levels, as many as debug_view.frag has colors for
+        _debugViewData[i] = glm::vec4(
+            static_cast<float>(vkutil::lod_level(distance, drawDistance, 4)),
+            _materialCosts.relative_cost(object.material),
+            static_cast<float>(_renderExtent.width),
+            static_cast<float>(_renderExtent.height));
+    }
+
+    const VkPipeline pipeline = _debugViewPipelines[static_cast<size_t>(_debugView)];
+    vkutil::record_debug_draws(commands, get_frame_bindings(), pipeline, _meshPipelineLayout, first, visible, _debugViewData);
+}
+
+void VulkanEngine::read_material_timings()
+{
+    std::vector<const Material*>& timedMaterials = _timedMaterials[_frameNumber % FRAME_OVERLAP];
+    if (timedMaterials.empty()) {
+        return;
+    }
+
+    //this frame's fence was just waited on, so the timestamps it wrote are ready
+    std::array<uint64_t, MAX_TIMED_MATERIALS + 1> timestamps;
+    const uint32_t firstQuery = (_frameNumber % FRAME_OVERLAP) * (MAX_TIMED_MATERIALS + 1);
+    const uint32_t queryCount = static_cast<uint32_t>(timedMaterials.size()) + 1;
+    if (vkGetQueryPoolResults(_device, _materialTimestampPool, firstQuery, queryCount, queryCount * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+        for (size_t i = 0; i < timedMaterials.size(); i++) {
+            _materialCosts.add_sample(timedMaterials[i], (timestamps[i + 1] - timestamps[i]) * _gpuProperties.limits.timestampPeriod / 1000000.f);
+        }
+        _materialCosts.end_frame();
+    }
+
+    timedMaterials.clear();
+}
+
+void VulkanEngine::read_compute_timings()
+{
+    const uint32_t frameSlot = _frameNumber % FRAME_OVERLAP;
+    if (!_computeTimed[frameSlot]) {
+        return;
+    }
+    _computeTimed[frameSlot] = false;
+
+    //this frame's fence was just waited on, and the graphics work waited on the compute work
+    uint64_t compute[2];
+    uint64_t graphics[2];
+    if (vkGetQueryPoolResults(_device, _computeTimestampPool, frameSlot * 2, 2, sizeof(compute), compute, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS
+        || vkGetQueryPoolResults(_device, _timestampQueryPool, frameSlot * 2, 2, sizeof(graphics), graphics, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+        return;
+    }
+
+    const float toMs = _gpuProperties.limits.timestampPeriod / 1000000.f;
+    _lastComputeMs = (compute[1] - compute[0]) * toMs;
+
+    //the part of the simulation that ran between the start and end of the graphics frame
+    const uint64_t overlapStart = std::max(compute[0], graphics[0]);
+    const uint64_t overlapEnd = std::min(compute[1], graphics[1]);
+    _lastComputeOverlapMs = overlapEnd > overlapStart ? (overlapEnd - overlapStart) * toMs : 0.f;
+}
+
+#if DEBUG_DRAW_ENABLED
+void VulkanEngine::add_engine_debug_draws()
+{
+    if (_debugDrawBounds) {
+        //_visibleObjects is in ascending order, walk it alongside the renderables
+        size_t nextVisible = 0;
+        for (size_t i = 0; i < _renderables.size(); i++) {
+            const bool visible = nextVisible < _visibleObjects.size() && _visibleObjects[nextVisible] == i;
+            if (visible) {
+                ++nextVisible;
+            }
+            _debugDraw.box(_renderables[i].worldBounds, visible ? vkutil::debug_color(0.2f, 1.f, 0.2f) : vkutil::debug_color(1.f, 0.2f, 0.2f, 0.6f));
+        }
+    }
+
+    if (_debugDrawStreamingCells && _worldStreamer.is_running()) {
+        for (uint32_t cellIndex = 0; cellIndex < _worldStreamer.cell_count(); cellIndex++) {
+            const bool resident = _streamedCells.count(cellIndex) > 0;
+            _debugDraw.box(_worldStreamer.cell(cellIndex).bounds, resident ? vkutil::debug_color(0.2f, 0.8f, 1.f) : vkutil::debug_color(0.5f, 0.5f, 0.5f, 0.5f), true);
+        }
+    }
+
+    if (_debugDrawChunkGrid) {
+        //the camera sits at -_camPos, the grid lies on the ground plane under it
+        const glm::vec3 cameraPosition = glm::vec3(glm::inverse(_cameraData.view)[3]);
+        _debugDraw.grid(glm::vec3(cameraPosition.x, 0.f, cameraPosition.z), _meshChunkSize, 16, vkutil::debug_color(1.f, 1.f, 0.3f, 0.5f));
+    }
+
+    if (_debugDrawFrozenFrustum) {
+        _debugDraw.frustum(_frozenViewproj, vkutil::debug_color(1.f, 0.8f, 0.f), true);
+    }
+
+    if (_hasPick) {
+        _debugDraw.box(_pickBounds, vkutil::debug_color(1.f, 0.4f, 1.f), true);
+        const float crossSize = 0.25f;
+        for (int axis = 0; axis < 3; axis++) {
+            glm::vec3 offset{0.f};
+            offset[axis] = crossSize;
+            _debugDraw.line(_pickPosition - offset, _pickPosition + offset, vkutil::debug_color(1.f, 1.f, 1.f), true);
+        }
+    }
+}
+
+void VulkanEngine::draw_debug_lines(VkCommandBuffer cmd)
+{
+    PROFILE_SCOPE(_profiler, "draw debug lines");
+
+    FrameData& frame = get_current_frame();
+    const vkutil::DebugDrawCounts counts = _debugDraw.flush(frame.debugDrawVertices, vkutil::DebugDraw::MAX_VERTICES);
+    if (counts.depthTested + counts.overlay == 0) {
+        return;
+    }
+
+    const vkutil::FrameBindings bindings = get_frame_bindings();
+    const VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(cmd, 0, 1, &frame.debugDrawBuffer._buffer, &offset);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _debugDrawPipelineLayout, 0, 1, &bindings.globalDescriptor, 1, &bindings.sceneDataOffset);
+
+    //the overlay lines follow the depth tested ones in the buffer
+    if (counts.depthTested > 0) {
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _debugDrawPipeline);
+        vkCmdDraw(cmd, counts.depthTested, 1, 0, 0);
+    }
+    if (counts.overlay > 0) {
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _debugDrawOverlayPipeline);
+        vkCmdDraw(cmd, counts.overlay, 1, counts.depthTested, 0);
+    }
+}
+#endif
+
+void VulkanEngine::simulate_particles(VkCommandBuffer cmd)
+{
+    const uint32_t frameSlot = _frameNumber % FRAME_OVERLAP;
+    _computeTimed[frameSlot] = false;
+    if (!_enableParticles) {
+        return;
+    }
+
+    PROFILE_SCOPE(_profiler, "simulate particles");
+
+    FrameData& frame = get_current_frame();
+    const bool async = _useAsyncCompute && _hasComputeQueue;
+
+    VkCommandBuffer computeCmd = cmd;
+    if (async) {
+        //the graphics frame that last used this slot waited on its compute work, and its fence was just waited on
+        computeCmd = frame.computeCommandBuffer;
+        VK_CHECK(vkResetCommandBuffer(computeCmd, 0));
+
+        const VkCommandBufferBeginInfo beginInfo = vkinit::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+        VK_CHECK(vkBeginCommandBuffer(computeCmd, &beginInfo));
+    }
+
+    if (_supportsTimestamps) {
+        vkCmdResetQueryPool(computeCmd, _computeTimestampPool, frameSlot * 2, 2);
+        vkCmdWriteTimestamp(computeCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, _computeTimestampPool, frameSlot * 2);
+    }
+
+    const uint32_t particleCount = std::min(_particleCount, MAX_PARTICLES);
+
+    ParticlePushConstants constants;
+    constants.emitter = glm::vec4{_particleEmitter, _animationFrame / 60.f};
+    constants.params = glm::uvec4{particleCount, 0, 0, 0};
+
+    vkCmdBindPipeline(computeCmd, VK_PIPELINE_BIND_POINT_COMPUTE, _particleComputePipeline);
+    vkCmdBindDescriptorSets(computeCmd, VK_PIPELINE_BIND_POINT_COMPUTE, _particleComputeLayout, 0, 1, &frame.particleDescriptor, 0, nullptr);
+    vkCmdPushConstants(computeCmd, _particleComputeLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ParticlePushConstants), &constants);
+    vkCmdDispatch(computeCmd, (particleCount + 255) / 256, 1, 1);
+
+    if (_supportsTimestamps) {
+        vkCmdWriteTimestamp(computeCmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, _computeTimestampPool, frameSlot * 2 + 1);
+        _computeTimed[frameSlot] = true;
+    }
+
+    if (!async) {
+        //same command buffer as the draw, a barrier is enough
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        return;
+    }
+
+    VK_CHECK(vkEndCommandBuffer(computeCmd));
+
+    const std::vector<VkCommandBuffer> cmdBuffers = {computeCmd};
+    const std::vector<VkSemaphore> signalSemaphores = {_supportsTimelineSemaphores ? _computeTimeline : frame.computeSemaphore};
+    VkSubmitInfo submit = vkinit::submit_info(cmdBuffers, {}, signalSemaphores, nullptr);
+
+    ++_computeTimelineValue;
+    VkTimelineSemaphoreSubmitInfoKHR timelineInfo = {};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+    timelineInfo.signalSemaphoreValueCount = 1;
+    timelineInfo.pSignalSemaphoreValues = &_computeTimelineValue;
+    if (_supportsTimelineSemaphores) {
+        submit.pNext = &timelineInfo;
+    }
+
+    {
+        PROFILE_SCOPE(_profiler, "submit compute");
+        VK_CHECK(vkQueueSubmit(_computeQueue, 1, &submit, VK_NULL_HANDLE));
+    }
+    _computeWaitPending = true;
+}
+
+void VulkanEngine::draw_particles(VkCommandBuffer cmd)
+{
+    if (!_enableParticles) {
+        return;
+    }
+
+    const vkutil::FrameBindings bindings = get_frame_bindings();
+    const VkDescriptorSet sets[2] = {bindings.globalDescriptor, get_current_frame().particleDescriptor};
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _particleDrawPipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _particleDrawLayout, 0, 2, sets, 1, &bindings.sceneDataOffset);
+    vkCmdDraw(cmd, std::min(_particleCount, MAX_PARTICLES), 1, 0, 0);
+}
+
+void VulkanEngine::submit_graphics(VkCommandBuffer cmd, std::vector<VkSemaphore> waitSemaphores, std::vector<VkPipelineStageFlags> waitStages,
+    const std::vector<VkSemaphore>& signalSemaphores, bool waitForCompute, VkFence fence)
+{
+    //binary semaphores ignore their wait value, the timeline submit info needs one for every wait all the same
+    std::vector<uint64_t> waitValues(waitSemaphores.size(), 0);
+    bool waitsOnTimeline = false;
+    if (waitForCompute && _computeWaitPending) {
+        waitSemaphores.push_back(_supportsTimelineSemaphores ? _computeTimeline : get_current_frame().computeSemaphore);
+        waitStages.push_back(VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
+        waitValues.push_back(_computeTimelineValue);
+        waitsOnTimeline = _supportsTimelineSemaphores;
+        _computeWaitPending = false;
+    }
+
+    const std::vector<VkCommandBuffer> cmdBuffers = {cmd};
+    VkSubmitInfo submit = vkinit::submit_info(cmdBuffers, waitSemaphores, signalSemaphores, waitStages.data());
+
+    VkTimelineSemaphoreSubmitInfoKHR timelineInfo = {};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+    timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+    timelineInfo.pWaitSemaphoreValues = waitValues.data();
+    if (waitsOnTimeline) {
+        submit.pNext = &timelineInfo;
+    }
+
+    VK_CHECK(vkQueueSubmit(_graphicsQueue, 1, &submit, fence));
+}
+
+void VulkanEngine::draw_visibility(vkutil::CommandBackend& commands, RenderObject* first, const std::vector<uint32_t>& visible)
+{
+    PROFILE_SCOPE(_profiler, "draw visibility");
+
+    vkutil::record_visibility_draws(commands, get_frame_bindings(), _visibilityPipeline, _meshPipelineLayout, first, visible);
+}
+
+void VulkanEngine::upscale_scene(VkCommandBuffer cmd)
+{
+    //the overdraw view leaves layer counts in the scene image, 32 per unit like OVERDRAW_STEP in debug_view.frag
+    const float overdrawLayers = _debugView == vkutil::DebugView::Overdraw ? 32.f : 0.f;
+
+    const glm::vec4 upscaleData[2] = {
+        {
+            static_cast<float>(_renderExtent.width) / _windowExtent.width,
+            static_cast<float>(_renderExtent.height) / _windowExtent.height,
+            static_cast<float>(_windowExtent.width),
+            static_cast<float>(_windowExtent.height)
+        },
+        {overdrawLayers, 0.f, 0.f, 0.f}
+    };
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _upscalePipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _upscalePipelineLayout, 0, 1, &_sceneTextureDescriptor, 0, nullptr);
+    vkCmdPushConstants(cmd, _upscalePipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(upscaleData), upscaleData);
+
+    //one triangle covering the whole screen
+    vkCmdDraw(cmd, 3, 1, 0, 0);
+}
+
+void VulkanEngine::record_ui_layer(VkCommandBuffer cmd)
+{
+    PROFILE_SCOPE(_profiler, "record UI");
+
+    //fully transparent, so the composite leaves the scene untouched where there is no UI
+    VkClearValue uiClear;
+    uiClear.color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+
+    const std::vector<VkClearValue> uiClearValues{uiClear};
+    const VkRenderPassBeginInfo uiRpInfo = vkinit::renderpass_begin_info(_uiRenderPass, _windowExtent, _uiFramebuffer, uiClearValues);
+
+    vkCmdBeginRenderPass(cmd, &uiRpInfo, VK_SUBPASS_CONTENTS_INLINE);
+    ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmd);
+    vkCmdEndRenderPass(cmd);
+}
+
+void VulkanEngine::composite_ui_layer(VkCommandBuffer cmd)
+{
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _uiCompositePipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _uiCompositePipelineLayout, 0, 1, &_uiTextureDescriptor, 0, nullptr);
+
+    //one triangle covering the whole screen
+    vkCmdDraw(cmd, 3, 1, 0, 0);
+}
+
+void VulkanEngine::set_viewport(VkCommandBuffer cmd, VkExtent2D extent)
+{
+    VkViewport viewport;
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = static_cast<float>(extent.width);
+    viewport.height = static_cast<float>(extent.height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+
+    VkRect2D scissor;
+    scissor.offset = { 0, 0 };
+    scissor.extent = extent;
+
+    vkCmdSetViewport(cmd, 0, 1, &viewport);
+    vkCmdSetScissor(cmd, 0, 1, &scissor);
+}
+
+void VulkanEngine::update_quality()
+{
+    const auto timeNow = std::chrono::high_resolution_clock::now();
+    const float cpuFrameMs = std::chrono::duration<float, std::milli>(timeNow - _lastDrawTime).count();
+    _lastDrawTime = timeNow;
+
+    const bool idledSinceLastFrame = _idledSinceLastFrame;
+    _idledSinceLastFrame = false;
+
+    //nothing was measured yet in this frame's slot
+    if (_frameNumber < FRAME_OVERLAP) {
+        return;
+    }
+
+    if (_supportsTimestamps) {
+        //this frame's fence was just waited on, so the timestamps it wrote are ready
+        uint64_t timestamps[2];
+        const uint32_t firstTimestamp = (_frameNumber % FRAME_OVERLAP) * 2;
+        if (vkGetQueryPoolResults(_device, _timestampQueryPool, firstTimestamp, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+            return;
+        }
+        _lastGpuFrameMs = (timestamps[1] - timestamps[0]) * _gpuProperties.limits.timestampPeriod / 1000000.f;
+    } else {
+        //without GPU timers the CPU frame time is the closest thing, it is GPU bound whenever the fence wait blocks.
+        //Time spent sleeping while idle says nothing about the GPU though
+        if (idledSinceLastFrame) {
+            return;
+        }
+        _lastGpuFrameMs = cpuFrameMs;
+    }
+
+    //replays keep the captured quality levels
+    if (_replaying) {
+        return;
+    }
+
+    if (!_enableQualityGovernor) {
+        const vkutil::QualityLevels& levels = _qualityGovernor.levels();
+        if (levels.renderScale < 1.f || levels.drawDistanceScale < 1.f) {
+            _qualityGovernor.reset();
+            apply_quality_levels();
+        }
+        return;
+    }
+
+    if (_qualityGovernor.update(_lastGpuFrameMs)) {
+        apply_quality_levels();
+    }
+}
+
+void VulkanEngine::apply_quality_levels()
+{
+    const float renderScale = _qualityGovernor.levels().renderScale;
+    _renderExtent.width = std::max(1u, static_cast<uint32_t>(_windowExtent.width * renderScale));
+    _renderExtent.height = std::max(1u, static_cast<uint32_t>(_windowExtent.height * renderScale));
+}
+
+void VulkanEngine::resolve_visibility(VkCommandBuffer cmd)
+{
+    PROFILE_SCOPE(_profiler, "resolve visibility");
+
+    const int frameIndex = _frameNumber % FRAME_OVERLAP;
+    const uint32_t uniform_offset = pad_uniform_buffer_size(sizeof(GPUSceneData)) * frameIndex;
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _visibilityResolvePipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _visibilityResolvePipelineLayout, 0, 1, &get_current_frame().globalDescriptor, 1, &uniform_offset);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _visibilityResolvePipelineLayout, 1, 1, &get_current_frame().objectDescriptor, 0, nullptr);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _visibilityResolvePipelineLayout, 2, 1, &_visibilityResolveDescriptor, 0, nullptr);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _visibilityResolvePipelineLayout, 3, 1, &get_material("texturedmesh")->textureSet, 0, nullptr);
+
+    const glm::vec4 renderExtent{ static_cast<float>(_renderExtent.width), static_cast<float>(_renderExtent.height), 0.f, 0.f };
+    vkCmdPushConstants(cmd, _visibilityResolvePipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(glm::vec4), &renderExtent);
+
+    //one triangle covering the whole screen
+    vkCmdDraw(cmd, 3, 1, 0, 0);
+}
+
+void VulkanEngine::init_scene() {
+    VkSamplerCreateInfo samplerInfo = vkinit::sampler_create_info(VK_FILTER_NEAREST);
+
+    VkSampler blockySampler;
+    vkCreateSampler(_device, &samplerInfo, nullptr, &blockySampler);
+    _mainDeletionQueue.push_function([=]{
+        vkDestroySampler(_device, blockySampler, nullptr);
+    });
+
+    Material* texturedMat =	get_material("texturedmesh");
+
+    //allocate the descriptor set for single-texture to use on the material
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.pNext = nullptr;
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = _descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &_singleTextureSetLayout;
+
+    VK_CHECK(vkAllocateDescriptorSets(_device, &allocInfo, &texturedMat->textureSet));
 
-        //allocate the buffer
-        VK_CHECK(vmaCreateBuffer(_allocator, &vertexBufferInfo, &vmaallocInfo,
-            &mesh._vertexBuffer._buffer,
-            &mesh._vertexBuffer._allocation,
-            nullptr));
+    //write to the descriptor set so that it points to our empire_diffuse texture
+    VkDescriptorImageInfo imageBufferInfo;
+    imageBufferInfo.sampler = blockySampler;
+    imageBufferInfo.imageView = _loadedTextures["empire_diffuse"].imageView;
+    imageBufferInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-        immediate_submit([=](VkCommandBuffer cmd){
-            VkBufferCopy copy;
-            copy.dstOffset = 0;
-            copy.srcOffset = 0;
-            copy.size = bufferSize;
-            vkCmdCopyBuffer(cmd, stagingBuffer._buffer, mesh._vertexBuffer._buffer, 1, &copy);
-        });
+    VkWriteDescriptorSet texture1 = vkinit::write_descriptor_image(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, texturedMat->textureSet, &imageBufferInfo, 0);
 
-        // add the destruction of triangle mesh buffer to the deletion queue
-        _mainDeletionQueue.push_function([=]() {
-            vmaDestroyBuffer(_allocator, mesh._vertexBuffer._buffer, mesh._vertexBuffer._allocation);
-        });
+    vkUpdateDescriptorSets(_device, 1, &texture1, 0, nullptr);
 
-        // immdiately delete staging buffer
-        vmaDestroyBuffer(_allocator, stagingBuffer._buffer, stagingBuffer._allocation);
-    } else {
-        VkBufferCreateInfo vertexBufferInfo = {};
-        vertexBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        vertexBufferInfo.size = bufferSize;
-        vertexBufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+    //same texture, the baked light comes from the vertices
+    get_material("texturedbaked")->textureSet = texturedMat->textureSet;
 
-        VmaAllocationCreateInfo vmaallocInfo = {};
-        vmaallocInfo.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+    if (!load_scene(_scenePath)) {
+        std::cout << "Failed to load scene " << _scenePath << ", starting with an empty scene" << std::endl;
+    }
+    instantiate_scene();
+
+    const Mesh* empire = get_mesh("empire");
+    const RenderObject* map = nullptr;
+    for (RenderObject& object : _renderables) {
+        if (object.mesh == empire) {
+            //the baked light is in the vertex colors, whichever textured material the scene gave the map
+            if (_empireLightingBaked && object.material == texturedMat) {
+                object.material = get_material("texturedbaked");
+            }
+            map = &object;
+        }
+    }
 
-        //allocate the buffer
-        VK_CHECK(vmaCreateBuffer(_allocator, &vertexBufferInfo, &vmaallocInfo,
-            &mesh._vertexBuffer._buffer,
-            &mesh._vertexBuffer._allocation,
-            nullptr));
+    //baked in the mesh's object space, and only valid for the chunks it was baked with
+    if (map && _enablePvs && _pvs.load(_pvsPath)) {
+        if (_pvs.matches(*map->mesh)) {
+            _pvsMesh = map->mesh;
+            _pvsWorldToMesh = glm::inverse(map->transformMatrix);
+        } else {
+            std::cout << _pvsPath << " was baked from different chunks, rebake it with bake_pvs" << std::endl;
+        }
+    }
 
-        //copy vertex data
-        void* data;
-        vmaMapMemory(_allocator, mesh._vertexBuffer._allocation, &data);
+    build_occluders();
 
-        memcpy(data, mesh._vertices.data(), bufferSize);
+    if (_enableStaticBatching) {
+        build_static_batches();
+    }
 
-        vmaUnmapMemory(_allocator, mesh._vertexBuffer._allocation);
+    sort_renderables();
+    build_mesh_bvhs();
+}
 
-        // add the destruction of triangle mesh buffer to the deletion queue
-        _mainDeletionQueue.push_function([=]() {
-            vmaDestroyBuffer(_allocator, mesh._vertexBuffer._buffer, mesh._vertexBuffer._allocation);
-        });
+bool VulkanEngine::load_scene(const std::string& path)
+{
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    if (!_sceneFile.open(path)) {
+        return false;
+    }
+
+    //names are looked up once, the entities only index them
+    _sceneMeshes.resize(_sceneFile.mesh_count());
+    for (uint32_t i = 0; i < _sceneFile.mesh_count(); i++) {
+        _sceneMeshes[i] = get_mesh(std::string(_sceneFile.mesh_name(i)));
+        if (_sceneMeshes[i] == nullptr) {
+            std::cout << path << " uses mesh " << _sceneFile.mesh_name(i) << ", which isn't loaded" << std::endl;
+            _sceneFile.close();
+            return false;
+        }
+    }
+    _sceneMaterials.resize(_sceneFile.material_count());
+    for (uint32_t i = 0; i < _sceneFile.material_count(); i++) {
+        _sceneMaterials[i] = get_material(std::string(_sceneFile.material_name(i)));
+        if (_sceneMaterials[i] == nullptr) {
+            std::cout << path << " uses material " << _sceneFile.material_name(i) << ", which doesn't exist" << std::endl;
+            _sceneFile.close();
+            return false;
+        }
     }
+
+    const float loadMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    std::cout << "Scene: mapped " << _sceneFile.entity_count() << " entities from " << path << " in " << loadMs << " ms" << std::endl;
+    return true;
 }
 
-Material* VulkanEngine::create_material(VkPipeline pipeline, VkPipelineLayout layout, const std::string& name)
+void VulkanEngine::instantiate_scene()
 {
-	Material mat;
-	mat.pipeline = pipeline;
-	mat.pipelineLayout = layout;
-	_materials[name] = mat;
-	return &_materials[name];
+    if (!_sceneFile.is_open()) {
+        return;
+    }
+
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    //blocks of entities are counted, then written from their offset, both in parallel
+    constexpr uint32_t ENTITIES_PER_BLOCK = 4096;
+    const vkutil::SceneEntity* entities = _sceneFile.entities();
+    const uint32_t entityCount = _sceneFile.entity_count();
+    const uint32_t blockCount = (entityCount + ENTITIES_PER_BLOCK - 1) / ENTITIES_PER_BLOCK;
+    auto blockEntities = [&](uint32_t block) {
+        return std::min(ENTITIES_PER_BLOCK, entityCount - block * ENTITIES_PER_BLOCK);
+    };
+
+    std::vector<size_t> blockOffsets(blockCount + 1, 0);
+    _jobs.parallel_for(blockCount, 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t block = begin; block < end; block++) {
+            blockOffsets[block + 1] = vkutil::count_entity_objects(entities + block * ENTITIES_PER_BLOCK, blockEntities(block), _sceneMeshes, _sceneMaterials);
+        }
+    });
+    for (uint32_t block = 0; block < blockCount; block++) {
+        blockOffsets[block + 1] += blockOffsets[block];
+    }
+
+    const size_t first = _renderables.size();
+    _renderables.resize(first + blockOffsets.back());
+
+    std::atomic<uint32_t> invalid{0};
+    _jobs.parallel_for(blockCount, 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t block = begin; block < end; block++) {
+            invalid += vkutil::instantiate_entities(entities + block * ENTITIES_PER_BLOCK, blockEntities(block), _sceneMeshes, _sceneMaterials,
+                &_renderables[first + blockOffsets[block]]);
+        }
+    });
+    if (invalid > 0) {
+        std::cout << "Scene: skipped " << invalid << " entities with out of range mesh or material" << std::endl;
+    }
+
+    _sceneFile.close();
+
+    const float instantiateMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    std::cout << "Scene: " << _renderables.size() - first << " objects from " << entityCount << " entities in " << instantiateMs << " ms" << std::endl;
 }
 
-Material* VulkanEngine::get_material(const std::string& name)
+void VulkanEngine::sort_renderables()
 {
-	//search for the object, and return nullptr if not found
-	auto it = _materials.find(name);
-	if (it == _materials.end()) {
-		return nullptr;
-	}
-	else {
-		return &(*it).second;
-	}
+    vkutil::sort_for_drawing(_renderables);
+
+    //the tree knows the objects by index
+    rebuild_object_tree();
 }
 
+void VulkanEngine::rebuild_object_tree()
+{
+    std::vector<AABB> bounds(_renderables.size());
+    for (size_t i = 0; i < _renderables.size(); i++) {
+        bounds[i] = _renderables[i].worldBounds;
+    }
+    //the new tree starts from the current bounds, and the marks held indices from before the reorder
+    _movedObjects.clear();
+    _objectTree.build(bounds, _objectProxies);
+}
 
-Mesh* VulkanEngine::get_mesh(const std::string& name)
+void VulkanEngine::update_object_tree()
 {
-	auto it = _meshes.find(name);
-	if (it == _meshes.end()) {
-		return nullptr;
-	}
-	else {
-		return &(*it).second;
-	}
+    PROFILE_SCOPE(_profiler, "update object tree");
+
+    _movedObjects.update(_objectTree, _objectProxies, _renderables.data());
 }
 
+void VulkanEngine::set_object_transform(uint32_t index, const glm::mat4& transform)
+{
+    RenderObject& object = _renderables[index];
+    object.transformMatrix = transform;
+    const AABB& localBounds = object.chunkIndex != UINT32_MAX ? object.mesh->_chunks[object.chunkIndex].bounds : object.mesh->_bounds;
+    object.worldBounds = localBounds.transformed(transform);
+    _movedObjects.mark(index);
+}
 
-void VulkanEngine::draw_objects(VkCommandBuffer cmd,RenderObject* first, int count)
+void VulkanEngine::init_streaming()
 {
-	//camera view
-	glm::mat4 view = glm::translate(glm::mat4(1.f), _camPos);
+    if (_worldManifestPath.empty()) {
+        return;
+    }
 
-	//camera projection
-	glm::mat4 projection = glm::perspective(glm::radians(70.f), 1700.f / 900.f, 0.1f, 200.0f);
-	projection[1][1] *= -1;
+    if (!_worldStreamer.load_manifest(_worldManifestPath)) {
+        std::cout << "World streaming disabled" << std::endl;
+        return;
+    }
 
-    //fill a GPU camera data struct
-	GPUCameraData camData;
-	camData.proj = projection;
-	camData.view = view;
-	camData.viewproj = projection * view;
+    _worldStreamer.start(_streamingSettings);
+}
 
-    //and copy it to the buffer
-	void* data;
-	vmaMapMemory(_allocator, get_current_frame().cameraBuffer._allocation, &data);
-	memcpy(data, &camData, sizeof(GPUCameraData));
-	vmaUnmapMemory(_allocator, get_current_frame().cameraBuffer._allocation);
+void VulkanEngine::update_streaming(VkCommandBuffer cmd)
+{
+    PROFILE_SCOPE(_profiler, "streaming");
 
-    void* objectData;
-    vmaMapMemory(_allocator, get_current_frame().objectBuffer._allocation, &objectData);
+    if (!_worldStreamer.is_running()) {
+        return;
+    }
 
-    GPUObjectData* objectSSBO = (GPUObjectData*)objectData;
+    //the view matrix moves the world by _camPos, so the camera sits at -_camPos
+    _worldStreamer.update(-_camPos);
 
-    for (int i = 0; i < count; i++)
-    {
-        RenderObject& object = first[i];
-        objectSSBO[i].modelMatrix = object.transformMatrix;
+    bool renderablesChanged = false;
+
+    //the last frames may still draw these cells, so their buffers go through this frame's deletion queue
+    for (uint32_t cellIndex : _worldStreamer.take_unloads()) {
+        unload_streamed_cell(cellIndex, get_current_frame().frameDeletionQueue);
+        renderablesChanged = true;
     }
 
-    vmaUnmapMemory(_allocator, get_current_frame().objectBuffer._allocation);
+    bool uploaded = false;
+    for (vkutil::LoadedCell& cell : _worldStreamer.take_loaded(_streamingUploadBytesPerFrame)) {
+        if (upload_streamed_cell(cmd, cell)) {
+            uploaded = true;
+        } else {
+            _worldStreamer.reject_cell(cell.cellIndex);
+        }
+    }
 
-    
-    /*** Scene Data -- start ***/
-    float framed = (_frameNumber / 120.f);
+    if (uploaded) {
+        //make the copies visible to the draws of this frame
+        VkMemoryBarrier uploadBarrier = {};
+        uploadBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        uploadBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        uploadBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
 
-	_sceneParameters.ambientColor = { sin(framed),0,cos(framed),1 };
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            0, 1, &uploadBarrier, 0, nullptr, 0, nullptr);
 
-	char* sceneData;
+        renderablesChanged = true;
+    }
 
-	vmaMapMemory(_allocator, _sceneParameterBuffer._allocation , (void**)&sceneData);
+    if (renderablesChanged) {
+        sort_renderables();
+    }
+}
 
-	const int frameIndex = _frameNumber % FRAME_OVERLAP;
+bool VulkanEngine::upload_streamed_cell(VkCommandBuffer cmd, vkutil::LoadedCell& cell)
+{
+    if (_renderables.size() + cell.meshes.size() > _objectCapacity) {
+        std::cout << "Object buffer full, skipping cell " << _worldStreamer.cell(cell.cellIndex).name << std::endl;
+        return false;
+    }
 
-	sceneData += pad_uniform_buffer_size(sizeof(GPUSceneData)) * frameIndex;
+    //place every mesh in the arena first, so a cell is either fully resident or not at all
+    std::vector<uint32_t> arenaOffsets;
+    for (vkutil::StreamedMesh& streamed : cell.meshes) {
+        const uint32_t words = streamed.mesh._vertices.size() * vertex_format_stride(streamed.mesh._vertexFormat);
+        uint32_t offset;
+        if (!_arenaAllocator.allocate(words, offset)) {
+            for (size_t i = 0; i < arenaOffsets.size(); i++) {
+                const Mesh& mesh = cell.meshes[i].mesh;
+                _arenaAllocator.free(arenaOffsets[i], mesh._vertices.size() * vertex_format_stride(mesh._vertexFormat));
+            }
+            std::cout << "Geometry arena full, skipping cell " << _worldStreamer.cell(cell.cellIndex).name << std::endl;
+            return false;
+        }
+        arenaOffsets.push_back(offset);
+    }
 
-	memcpy(sceneData, &_sceneParameters, sizeof(GPUSceneData));
+    //one staging buffer holds the vertex buffer contents and the arena words of every mesh
+    std::vector<uint32_t> stagingWords;
+    std::vector<size_t> vertexOffsets;
+    for (vkutil::StreamedMesh& streamed : cell.meshes) {
+        vertexOffsets.push_back(stagingWords.size());
+        const size_t vertexWords = streamed.mesh._vertices.size() * sizeof(Vertex) / sizeof(uint32_t);
+        stagingWords.resize(stagingWords.size() + vertexWords);
+        memcpy(stagingWords.data() + vertexOffsets.back(), streamed.mesh._vertices.data(), vertexWords * sizeof(uint32_t));
 
-	vmaUnmapMemory(_allocator, _sceneParameterBuffer._allocation);
-    /*** Scene Data -- end ***/
+        streamed.mesh.pack_vertices(stagingWords);
+    }
 
-	Mesh* lastMesh = nullptr;
-	Material* lastMaterial = nullptr;
-    size_t pipelineBindCount = 0;
-    size_t vertexBuffersBindCount = 0;
-	for (int i = 0; i < count; i++)
-	{
-		RenderObject& object = first[i];
+    const size_t stagingSize = stagingWords.size() * sizeof(uint32_t);
+    AllocatedBuffer stagingBuffer = create_buffer(stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+    _metrics.add_upload_bytes(stagingSize);
 
-		//only bind the pipeline if it doesn't match with the already bound one
-		if (object.material != lastMaterial) {
-            ++pipelineBindCount;
-			vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, object.material->pipeline);
-			lastMaterial = object.material;
+    void* data;
+    vmaMapMemory(_allocator, stagingBuffer._allocation, &data);
+    memcpy(data, stagingWords.data(), stagingSize);
+    vmaUnmapMemory(_allocator, stagingBuffer._allocation);
 
-            // offset scene buffer
-            const uint32_t uniform_offset = pad_uniform_buffer_size(sizeof(GPUSceneData)) * frameIndex;
+    get_current_frame().frameDeletionQueue.push_function([=]() {
+        vmaDestroyBuffer(_allocator, stagingBuffer._buffer, stagingBuffer._allocation);
+    });
 
-            //bind the descriptor set when changing pipeline
-        	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, object.material->pipelineLayout, 0, 1, &get_current_frame().globalDescriptor, 1, &uniform_offset);
+    const std::string& cellName = _worldStreamer.cell(cell.cellIndex).name;
+    std::vector<std::string>& meshNames = _streamedCells[cell.cellIndex];
 
-            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, object.material->pipelineLayout, 1, 1, &get_current_frame().objectDescriptor, 0, nullptr);
+    for (size_t i = 0; i < cell.meshes.size(); i++) {
+        vkutil::StreamedMesh& streamed = cell.meshes[i];
+        Mesh& mesh = streamed.mesh;
 
-            if (object.material->textureSet != VK_NULL_HANDLE) {
-                vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, object.material->pipelineLayout, 2, 1, &object.material->textureSet, 0, nullptr);
-            }
-		}
+        const size_t vertexBytes = mesh._vertices.size() * sizeof(Vertex);
+        mesh._vertexBuffer = create_buffer(vertexBytes, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+        mesh._arenaOffset = arenaOffsets[i];
 
-		MeshPushConstants constants;
-		constants.render_matrix = object.transformMatrix;
+        VkBufferCopy copies[2];
+        copies[0].srcOffset = vertexOffsets[i] * sizeof(uint32_t);
+        copies[0].dstOffset = 0;
+        copies[0].size = vertexBytes;
+        vkCmdCopyBuffer(cmd, stagingBuffer._buffer, mesh._vertexBuffer._buffer, 1, &copies[0]);
 
-		//upload the mesh to the GPU via push constants
-		vkCmdPushConstants(cmd, object.material->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(MeshPushConstants), &constants);
+        copies[1].srcOffset = copies[0].srcOffset + vertexBytes;
+        copies[1].dstOffset = arenaOffsets[i] * sizeof(uint32_t);
+        copies[1].size = mesh._vertices.size() * vertex_format_stride(mesh._vertexFormat) * sizeof(uint32_t);
+        vkCmdCopyBuffer(cmd, stagingBuffer._buffer, _geometryArena._buffer, 1, &copies[1]);
 
-		//only bind the mesh if it's a different one from last bind
-		if (object.mesh != lastMesh) {
-            ++vertexBuffersBindCount;
-			//bind the mesh vertex buffer with offset 0
-			VkDeviceSize offset = 0;
-			vkCmdBindVertexBuffers(cmd, 0, 1, &object.mesh->_vertexBuffer._buffer, &offset);
-			lastMesh = object.mesh;
-		}
-		//we can now draw
-		vkCmdDraw(cmd, object.mesh->_vertices.size(), 1, 0, i);
-	}
+        const std::string meshName = "cell_" + cellName + "_" + std::to_string(i);
+        _meshes[meshName] = std::move(mesh);
+        meshNames.push_back(meshName);
 
-    // std::cout << "Total Bind Count Pipeline: " << pipelineBindCount << " , Vertex Buffers:" << vertexBuffersBindCount << std::endl;
-}
+        Material* material = get_material(streamed.material);
+        if (material == nullptr) {
+            std::cout << "Unknown material " << streamed.material << " in cell " << cellName << std::endl;
+            material = get_material("defaultmesh");
+        }
 
-void VulkanEngine::init_scene() {
-	RenderObject monkey;
-	monkey.mesh = get_mesh("monkey");
-	monkey.material = get_material("defaultmesh");
-	monkey.transformMatrix = glm::mat4{ 1.0f };
+        RenderObject object;
+        object.mesh = &_meshes[meshName];
+        object.material = material;
+        object.transformMatrix = streamed.transform;
+        object.isStatic = true;
+        object.firstVertex = 0;
+        object.vertexCount = static_cast<uint32_t>(object.mesh->_vertices.size());
+        object.worldBounds = object.mesh->_bounds.transformed(object.transformMatrix);
+        _renderables.push_back(object);
+    }
 
-    _renderables.push_back(monkey);
+    return true;
+}
 
-    RenderObject wolf;
-	wolf.mesh = get_mesh("wolf");
-	wolf.material = get_material("defaultmesh");
-	wolf.transformMatrix = glm::translate(glm::scale(glm::mat4{ 1.0f }, glm::vec3{3.0f, 3.0f, 3.0f}), glm::vec3{-1.f, 3.0f, 0.0f});
+void VulkanEngine::unload_streamed_cell(uint32_t cellIndex, DeletionQueue& deletionQueue)
+{
+    auto cellIt = _streamedCells.find(cellIndex);
+    if (cellIt == _streamedCells.end()) {
+        return;
+    }
 
-    _renderables.push_back(wolf);
+    for (const std::string& meshName : cellIt->second) {
+        Mesh* mesh = get_mesh(meshName);
 
-    RenderObject maleHuman;
-	maleHuman.mesh = get_mesh("maleHuman");
-	maleHuman.material = get_material("defaultmesh");
-	maleHuman.transformMatrix = glm::translate(glm::scale(glm::mat4{ 1.0f }, glm::vec3{0.3f, 0.3f, 0.3f}), glm::vec3{10.f, 3.0f, 0.0f});
+        _renderables.erase(std::remove_if(_renderables.begin(), _renderables.end(), [=](const RenderObject& object) {
+            return object.mesh == mesh;
+        }), _renderables.end());
 
-    _renderables.push_back(maleHuman);
+        const AllocatedBuffer vertexBuffer = mesh->_vertexBuffer;
+        const uint32_t arenaOffset = mesh->_arenaOffset;
+        const uint32_t arenaWords = mesh->_vertices.size() * vertex_format_stride(mesh->_vertexFormat);
+        deletionQueue.push_function([=]() {
+            vmaDestroyBuffer(_allocator, vertexBuffer._buffer, vertexBuffer._allocation);
+            _arenaAllocator.free(arenaOffset, arenaWords);
+        });
 
-	for (int x = -20; x <= 20; x++) {
-		for (int y = -20; y <= 20; y++) {
+        _meshBvhs.erase(mesh);
+        _meshes.erase(meshName);
+    }
 
-			RenderObject tri;
-			tri.mesh = get_mesh("triangle");
-			tri.material = get_material(y%2 == 0 ? "defaultmesh_duplicate" : "defaultmesh");
-            glm::mat4 translation = glm::translate(glm::mat4{ 1.0 }, glm::vec3(x, 0, y));
-			glm::mat4 scale = glm::scale(glm::mat4{ 1.0 }, glm::vec3(0.2, 0.2, 0.2));
-			tri.transformMatrix = translation * scale;
+    _streamedCells.erase(cellIt);
+}
 
-            _renderables.push_back(tri);
-		}
-	}
+void VulkanEngine::build_occluders()
+{
+    _occluders.clear();
+    for (const RenderObject& object : _renderables) {
+        if (!object.mesh->_chunks.empty()) {
+            _occluders.push_back(vkutil::build_occluder(*object.mesh, object.firstVertex, object.vertexCount, object.transformMatrix, OCCLUDER_TRIANGLES_PER_CHUNK));
+        }
+    }
 
-    VkSamplerCreateInfo samplerInfo = vkinit::sampler_create_info(VK_FILTER_NEAREST);
+    //low resolution is the point, a box needs to be hidden in a few hundred pixels and not in millions
+    _occlusionRasterizer.resize(256, 128);
+}
 
-    VkSampler blockySampler;
-    vkCreateSampler(_device, &samplerInfo, nullptr, &blockySampler);
-    _mainDeletionQueue.push_function([=]{
-        vkDestroySampler(_device, blockySampler, nullptr);
-    });
+void VulkanEngine::build_mesh_bvhs()
+{
+    const auto start = std::chrono::high_resolution_clock::now();
 
-    Material* texturedMat =	get_material("texturedmesh");
+    size_t triangleCount = 0;
+    for (const RenderObject& object : _renderables) {
+        if (_meshBvhs.count(object.mesh) > 0) {
+            continue;
+        }
 
-    //allocate the descriptor set for single-texture to use on the material
-    VkDescriptorSetAllocateInfo allocInfo = {};
-    allocInfo.pNext = nullptr;
-    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocInfo.descriptorPool = _descriptorPool;
-    allocInfo.descriptorSetCount = 1;
-    allocInfo.pSetLayouts = &_singleTextureSetLayout;
+        std::vector<glm::vec3> positions(object.mesh->_vertices.size());
+        for (size_t i = 0; i < positions.size(); i++) {
+            positions[i] = object.mesh->_vertices[i].position;
+        }
+        _meshBvhs[object.mesh].build(positions, &_jobs);
+        triangleCount += positions.size() / 3;
+    }
 
-    vkAllocateDescriptorSets(_device, &allocInfo, &texturedMat->textureSet);
+    const float buildMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    std::cout << "Mesh BVHs: " << _meshBvhs.size() << " meshes, " << triangleCount << " triangles in " << buildMs << " ms" << std::endl;
+}
 
-    //write to the descriptor set so that it points to our empire_diffuse texture
-    VkDescriptorImageInfo imageBufferInfo;
-    imageBufferInfo.sampler = blockySampler;
-    imageBufferInfo.imageView = _loadedTextures["empire_diffuse"].imageView;
-    imageBufferInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+void VulkanEngine::pick_object(int32_t x, int32_t y)
+{
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    //the projection flips y already, so window pixels map straight onto NDC. The far plane is at z = 1 whatever the
+    //depth range, and the ray leaves from the camera
+    const glm::vec2 ndc{2.f * (x + 0.5f) / _windowExtent.width - 1.f, 2.f * (y + 0.5f) / _windowExtent.height - 1.f};
+    const glm::vec4 farPoint = glm::inverse(_cameraData.viewproj) * glm::vec4(ndc, 1.f, 1.f);
+    const glm::vec3 origin = glm::vec3(glm::inverse(_cameraData.view)[3]);
+    const glm::vec3 direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - origin);
+    const glm::vec3 inverseDirection = 1.f / direction;
+
+    float closest = std::numeric_limits<float>::max();
+    const RenderObject* hitObject = nullptr;
+    vkutil::RayHit hit{};
+
+    if (_useObjectTree) {
+        _objectTree.query_ray(origin, direction, std::numeric_limits<float>::max(), _treeCandidates);
+    } else {
+        _treeCandidates.resize(_renderables.size());
+        std::iota(_treeCandidates.begin(), _treeCandidates.end(), 0);
+    }
 
-    VkWriteDescriptorSet texture1 = vkinit::write_descriptor_image(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, texturedMat->textureSet, &imageBufferInfo, 0);
+    //the chunks of a mesh share its BVH, it is only traced once per mesh and transform
+    std::vector<std::pair<const Mesh*, glm::mat4>> traced;
+    for (uint32_t index : _treeCandidates) {
+        const RenderObject& object = _renderables[index];
+        const glm::vec3 t0 = (object.worldBounds.min - origin) * inverseDirection;
+        const glm::vec3 t1 = (object.worldBounds.max - origin) * inverseDirection;
+        const glm::vec3 tNear = glm::min(t0, t1);
+        const glm::vec3 tFar = glm::max(t0, t1);
+        const float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.f));
+        const float exit = std::min(std::min(tFar.x, tFar.y), tFar.z);
+        if (enter > exit || enter >= closest) {
+            continue;
+        }
 
-    vkUpdateDescriptorSets(_device, 1, &texture1, 0, nullptr);
+        const auto tracedIt = std::find_if(traced.begin(), traced.end(), [&](const std::pair<const Mesh*, glm::mat4>& entry) {
+            return entry.first == object.mesh && entry.second == object.transformMatrix;
+        });
+        if (tracedIt != traced.end()) {
+            continue;
+        }
+        traced.push_back({object.mesh, object.transformMatrix});
 
-    RenderObject map;
-    map.mesh = get_mesh("empire");
-    map.material = get_material("texturedmesh");
-    map.transformMatrix = glm::translate(glm::vec3{ 5,-10,0 });
+        auto bvhIt = _meshBvhs.find(object.mesh);
+        if (bvhIt == _meshBvhs.end()) {
+            std::vector<glm::vec3> positions(object.mesh->_vertices.size());
+            for (size_t i = 0; i < positions.size(); i++) {
+                positions[i] = object.mesh->_vertices[i].position;
+            }
+            bvhIt = _meshBvhs.emplace(object.mesh, vkutil::TriangleBvh{}).first;
+            bvhIt->second.build(positions, &_jobs);
+        }
 
-    _renderables.push_back(map);
+        //traced in object space, the direction keeps the transform's scale so distances stay in world units
+        const glm::mat4 worldToObject = glm::inverse(object.transformMatrix);
+        const glm::vec3 objectOrigin = glm::vec3(worldToObject * glm::vec4(origin, 1.f));
+        const glm::vec3 objectDirection = glm::vec3(worldToObject * glm::vec4(direction, 0.f));
+        vkutil::RayHit objectHit;
+        if (bvhIt->second.raycast(objectOrigin, objectDirection, closest, objectHit)) {
+            closest = objectHit.distance;
+            hit = objectHit;
+            hitObject = &object;
+        }
+    }
 
-    auto sortComparator = [](const RenderObject& l, const RenderObject& r){
-        if (l.material == r.material) {
-            return l.mesh < r.mesh;
+    _hasPick = hitObject != nullptr;
+    if (_hasPick) {
+        //the object drawing the hit triangle, one of the chunks when the mesh was split
+        const uint32_t hitVertex = hit.triangle * 3;
+        for (const RenderObject& object : _renderables) {
+            if (object.mesh == hitObject->mesh && object.transformMatrix == hitObject->transformMatrix
+                && hitVertex >= object.firstVertex && hitVertex < object.firstVertex + object.vertexCount) {
+                hitObject = &object;
+                break;
+            }
         }
-        return l.material < r.material;
-    };
+        _pickHit = hit;
+        _pickPosition = origin + direction * hit.distance;
+        _pickBounds = hitObject->worldBounds;
+    }
+    _pickMicroseconds = std::chrono::duration<float, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+}
 
-    std::sort(_renderables.begin(), _renderables.end(), sortComparator);
+void VulkanEngine::build_static_batches()
+{
+    const size_t objectCount = _renderables.size();
+    std::vector<vkutil::StaticBatch> batches = vkutil::build_static_batches(_renderables, _staticBatchChunkSize);
+
+    for (size_t i = 0; i < batches.size(); i++) {
+        //batched meshes live with the others so their pointers stay valid and they end up in the geometry arena
+        Mesh& batchMesh = _meshes["static_batch_" + std::to_string(i)];
+        batchMesh = std::move(batches[i].mesh);
+        upload_mesh(batchMesh);
+
+        RenderObject batchObject;
+        batchObject.mesh = &batchMesh;
+        batchObject.material = batches[i].material;
+        batchObject.transformMatrix = glm::mat4{ 1.0f };
+        batchObject.firstVertex = 0;
+        batchObject.vertexCount = static_cast<uint32_t>(batchMesh._vertices.size());
+        batchObject.worldBounds = batchMesh._bounds;
+        batchObject.isStatic = true;
+
+        _renderables.push_back(batchObject);
+    }
+
+    std::cout << "Static batching: " << objectCount << " objects -> " << _renderables.size() << " draws in " << batches.size() << " batches" << std::endl;
 }
 
 FrameData& VulkanEngine::get_current_frame() {
     return _frames[_frameNumber % FRAME_OVERLAP];
 }
 
+vkutil::FrameBindings VulkanEngine::get_frame_bindings()
+{
+    const int frameIndex = _frameNumber % FRAME_OVERLAP;
+
+    vkutil::FrameBindings bindings;
+    bindings.globalDescriptor = get_current_frame().globalDescriptor;
+    bindings.objectDescriptor = get_current_frame().objectDescriptor;
+    bindings.sceneDataOffset = pad_uniform_buffer_size(sizeof(GPUSceneData)) * frameIndex;
+    return bindings;
+}
+
 AllocatedBuffer VulkanEngine::create_buffer(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage)
 {
 	//allocate vertex buffer
@@ -1325,26 +4087,27 @@ void VulkanEngine::load_images()
 void VulkanEngine::init_descriptors()
 {
     /*** Descriptor Pool ***/
+    //every engine set comes from this pool (ten today), keep headroom when adding more
 	std::vector<VkDescriptorPoolSize> sizes =
 	{
-		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 10 },
-        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 10 },
-        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 10 },
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 32 },
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 32 },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 32 },
         //add combined-image-sampler descriptor types to the pool
-        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 10 }
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 32 }
 	};
 
     VkDescriptorPoolCreateInfo pool_info = {};
 	pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
 	pool_info.flags = 0;
-	pool_info.maxSets = 10;
+	pool_info.maxSets = 32;
 	pool_info.poolSizeCount = static_cast<uint32_t>(sizes.size());
 	pool_info.pPoolSizes = sizes.data();
 
 	vkCreateDescriptorPool(_device, &pool_info, nullptr, &_descriptorPool);
 
     /*** DescriptorSetLayout 0 - Camera, Scene Buffer ***/
-	const VkDescriptorSetLayoutBinding camBufferBinding = vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0);
+	const VkDescriptorSetLayoutBinding camBufferBinding = vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0);
     const VkDescriptorSetLayoutBinding sceneBufferBinding = vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 1);
 
     const std::vector<VkDescriptorSetLayoutBinding> descriptor0Bindings = { camBufferBinding, sceneBufferBinding };
@@ -1353,10 +4116,11 @@ void VulkanEngine::init_descriptors()
 
 	vkCreateDescriptorSetLayout(_device, &set1info, nullptr, &_globalSetLayout);
 
-    /*** DescriptorSetLayout 1 - Storage Buffer ***/
-    const VkDescriptorSetLayoutBinding objectBind = vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0);
+    /*** DescriptorSetLayout 1 - Storage Buffer, Geometry Arena ***/
+    const VkDescriptorSetLayoutBinding objectBind = vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0);
+    const VkDescriptorSetLayoutBinding arenaBind = vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 1);
 
-    const std::vector<VkDescriptorSetLayoutBinding> descriptor1Bindings = {objectBind};
+    const std::vector<VkDescriptorSetLayoutBinding> descriptor1Bindings = {objectBind, arenaBind};
 
     const VkDescriptorSetLayoutCreateInfo set2info = vkinit::descriptorset_layout_create_info(descriptor1Bindings);
 
@@ -1370,11 +4134,20 @@ void VulkanEngine::init_descriptors()
 
     vkCreateDescriptorSetLayout(_device, &set3info, nullptr, &_singleTextureSetLayout);
 
+    /*** DescriptorSetLayout - Visibility Buffer Resolve ***/
+    const VkDescriptorSetLayoutBinding visibilityBind = vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0);
+
+    const std::vector<VkDescriptorSetLayoutBinding> visibilityBindings = {visibilityBind};
+    const VkDescriptorSetLayoutCreateInfo visibilityInfo = vkinit::descriptorset_layout_create_info(visibilityBindings);
+
+    vkCreateDescriptorSetLayout(_device, &visibilityInfo, nullptr, &_visibilityResolveSetLayout);
+
 	// add descriptor set layout to deletion queues
 	_mainDeletionQueue.push_function([&]() {
 		vkDestroyDescriptorSetLayout(_device, _globalSetLayout, nullptr);
         vkDestroyDescriptorSetLayout(_device, _objectSetLayout, nullptr);
         vkDestroyDescriptorSetLayout(_device, _singleTextureSetLayout, nullptr);
+        vkDestroyDescriptorSetLayout(_device, _visibilityResolveSetLayout, nullptr);
         vkDestroyDescriptorPool(_device, _descriptorPool, nullptr);
 	});
 
@@ -1387,18 +4160,26 @@ void VulkanEngine::init_descriptors()
 
     for (size_t frameIdx = 0; frameIdx < FRAME_OVERLAP; frameIdx++)
 	{
-        constexpr int MAX_OBJECTS = 10000;
-        _frames[frameIdx].objectBuffer = create_buffer(sizeof(GPUObjectData) * MAX_OBJECTS, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
         _frames[frameIdx].cameraBuffer = create_buffer(sizeof(GPUCameraData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
 
+#if DEBUG_DRAW_ENABLED
+        _frames[frameIdx].debugDrawBuffer = create_buffer(sizeof(vkutil::DebugVertex) * vkutil::DebugDraw::MAX_VERTICES, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+        vmaMapMemory(_allocator, _frames[frameIdx].debugDrawBuffer._allocation, (void**)&_frames[frameIdx].debugDrawVertices);
+
+        _mainDeletionQueue.push_function([=]() {
+            vmaUnmapMemory(_allocator, _frames[frameIdx].debugDrawBuffer._allocation);
+            vmaDestroyBuffer(_allocator, _frames[frameIdx].debugDrawBuffer._buffer, _frames[frameIdx].debugDrawBuffer._allocation);
+        });
+#endif
+
         /*** Create DescriptorSet using DescriptorSetLayout ***/
         const std::vector<VkDescriptorSetLayout> globalDescriptorLayouts = {_globalSetLayout};
         const VkDescriptorSetAllocateInfo allocInfo = vkinit::descriptorset_allocate_info(_descriptorPool, globalDescriptorLayouts);
-        vkAllocateDescriptorSets(_device, &allocInfo, &_frames[frameIdx].globalDescriptor);
+        VK_CHECK(vkAllocateDescriptorSets(_device, &allocInfo, &_frames[frameIdx].globalDescriptor));
 
         const std::vector<VkDescriptorSetLayout> objectDescriptorLayouts = {_objectSetLayout};
         const VkDescriptorSetAllocateInfo objectBufferAlloc =vkinit::descriptorset_allocate_info(_descriptorPool, objectDescriptorLayouts);
-        vkAllocateDescriptorSets(_device, &objectBufferAlloc, &_frames[frameIdx].objectDescriptor);
+        VK_CHECK(vkAllocateDescriptorSets(_device, &objectBufferAlloc, &_frames[frameIdx].objectDescriptor));
 
         /*** DescriptorBufferInfo - information the descriptor will point to ***/
 		VkDescriptorBufferInfo cameraBufferInfo;
@@ -1411,29 +4192,58 @@ void VulkanEngine::init_descriptors()
 		sceneBufferInfo.offset = 0; // we'll do the offset when binding the descriptor set
 		sceneBufferInfo.range = sizeof(GPUSceneData);
 
-        VkDescriptorBufferInfo objectBufferInfo;
-        objectBufferInfo.buffer = _frames[frameIdx].objectBuffer._buffer;
-		objectBufferInfo.offset = 0;
-		objectBufferInfo.range = sizeof(GPUObjectData) * MAX_OBJECTS;
-
         VkWriteDescriptorSet cameraWrite = vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, _frames[frameIdx].globalDescriptor, &cameraBufferInfo, 0);
 
         VkWriteDescriptorSet sceneWrite = vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, _frames[frameIdx].globalDescriptor, &sceneBufferInfo, 1);
 
-        VkWriteDescriptorSet objectWrite = vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _frames[frameIdx].objectDescriptor, &objectBufferInfo, 0);
-
-        VkWriteDescriptorSet setWrites[] = { cameraWrite, sceneWrite, objectWrite };
+        VkWriteDescriptorSet setWrites[] = { cameraWrite, sceneWrite };
 
         // write/save it to device that this descriptors will be pointing to those buffers
-		vkUpdateDescriptorSets(_device, 3, setWrites, 0, nullptr);
+		vkUpdateDescriptorSets(_device, 2, setWrites, 0, nullptr);
 
         _mainDeletionQueue.push_function([=]() {
             vmaDestroyBuffer(_allocator, _frames[frameIdx].cameraBuffer._buffer, _frames[frameIdx].cameraBuffer._allocation);
-            vmaDestroyBuffer(_allocator, _frames[frameIdx].objectBuffer._buffer, _frames[frameIdx].objectBuffer._allocation);
 		});
 	}
 }
 
+void VulkanEngine::init_object_buffers()
+{
+    //a descriptor sees at most maxStorageBufferRange bytes of the object buffer
+    const uint32_t deviceCapacity = _gpuProperties.limits.maxStorageBufferRange / sizeof(GPUObjectData);
+    _objectCapacity = static_cast<uint32_t>(std::min<size_t>(_renderables.size() + OBJECT_HEADROOM, deviceCapacity));
+
+    if (_renderables.size() > _objectCapacity) {
+        std::cout << "The scene has " << _renderables.size() << " objects, but the object buffer holds at most " << _objectCapacity
+            << " on this device (maxStorageBufferRange " << _gpuProperties.limits.maxStorageBufferRange << " bytes). Dropping the rest" << std::endl;
+        _renderables.resize(_objectCapacity);
+        rebuild_object_tree();
+        _replayDrawList.erase(std::remove_if(_replayDrawList.begin(), _replayDrawList.end(), [&](uint32_t index) {
+            return index >= _objectCapacity;
+        }), _replayDrawList.end());
+    }
+
+    for (size_t frameIdx = 0; frameIdx < FRAME_OVERLAP; frameIdx++) {
+        _frames[frameIdx].objectBuffer = create_buffer(sizeof(GPUObjectData) * _objectCapacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+        _frames[frameIdx].indirectBuffer = create_buffer(sizeof(VkDrawIndirectCommand) * _objectCapacity, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+
+        VkDescriptorBufferInfo objectBufferInfo;
+        objectBufferInfo.buffer = _frames[frameIdx].objectBuffer._buffer;
+        objectBufferInfo.offset = 0;
+        objectBufferInfo.range = sizeof(GPUObjectData) * _objectCapacity;
+
+        VkWriteDescriptorSet objectWrite = vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _frames[frameIdx].objectDescriptor, &objectBufferInfo, 0);
+        vkUpdateDescriptorSets(_device, 1, &objectWrite, 0, nullptr);
+
+        _mainDeletionQueue.push_function([=]() {
+            vmaDestroyBuffer(_allocator, _frames[frameIdx].objectBuffer._buffer, _frames[frameIdx].objectBuffer._allocation);
+            vmaDestroyBuffer(_allocator, _frames[frameIdx].indirectBuffer._buffer, _frames[frameIdx].indirectBuffer._allocation);
+        });
+    }
+
+    std::cout << "Object buffers: " << _objectCapacity << " objects, " << _renderables.size() << " in the scene" << std::endl;
+}
+
 // For buffer alignment based from GPU properties
 // https://github.com/SaschaWillems/Vulkan/tree/master/examples/dynamicuniformbuffer
 size_t VulkanEngine::pad_uniform_buffer_size(size_t originalSize)
@@ -13,6 +13,23 @@
 
 #include <vk_mem_alloc.h>
 #include <vk_mesh.h>
+#include <vk_scene.h>
+#include <vk_streaming.h>
+#include <vk_governor.h>
+#include <vk_pacing.h>
+#include <vk_latency.h>
+#include <vk_profiler.h>
+#include <vk_metrics.h>
+#include <vk_capture.h>
+#include <vk_draw.h>
+#include <vk_debugview.h>
+#include <vk_debugdraw.h>
+#include <vk_jobs.h>
+#include <vk_occlusion.h>
+#include <vk_pvs.h>
+#include <vk_bvh.h>
+#include <vk_spatial.h>
+#include <vk_scenefile.h>
 #include <glm/glm.hpp>
 
 struct Texture {
@@ -34,8 +51,15 @@ struct GPUCameraData {
 	glm::mat4 viewproj;
 };
 
-struct GPUObjectData{
-	glm::mat4 modelMatrix;
+//one particle of the compute simulation, written by particles.comp and read by particles.vert
+struct GPUParticle {
+	glm::vec4 position;
+	glm::vec4 color;
+};
+
+struct ParticlePushConstants {
+	glm::vec4 emitter; //xyz position, w simulation time in seconds
+	glm::uvec4 params; //x particle count, yzw unused
 };
 
 struct UploadContext {
@@ -44,42 +68,10 @@ struct UploadContext {
     VkCommandBuffer _commandBuffer;
 };
 
-// Per frame context
-struct FrameData {
-	VkCommandPool commandPool;
-    VkCommandBuffer mainCommandBuffer;
-
-	VkFence renderFence;
-	VkSemaphore presentSemaphore;
-	VkSemaphore renderSemaphore;
-
-	//buffer that holds a single GPUCameraData to use when rendering
-	AllocatedBuffer cameraBuffer;
-	AllocatedBuffer objectBuffer;
-
-	VkDescriptorSet globalDescriptor;
-	VkDescriptorSet objectDescriptor;
-};
-
-struct Material {
-    VkDescriptorSet textureSet{VK_NULL_HANDLE}; //texture defaulted to null
-	VkPipeline pipeline;
-	VkPipelineLayout pipelineLayout;
-};
-
-struct RenderObject {
-	Mesh* mesh;
-
-	Material* material;
-
-	glm::mat4 transformMatrix;
-};
-
-struct MeshPushConstants {
-	glm::vec4 data;
-	glm::mat4 render_matrix;
-};
+//most submissions the scene pass of a frame is split into, see VulkanEngine::_splitSubmission
+constexpr uint32_t MAX_SCENE_SUBMITS = 8;
 
+// Per frame context
 struct DeletionQueue
 {
 	std::deque<std::function<void()>> deletors;
@@ -98,6 +90,49 @@ struct DeletionQueue
 	}
 };
 
+struct FrameData {
+	VkCommandPool commandPool;
+    VkCommandBuffer mainCommandBuffer;
+    //with split submission mainCommandBuffer only holds the setup and the first scene chunk,
+    //these hold the remaining chunks and the final upscale and UI pass
+    VkCommandBuffer splitCommandBuffers[MAX_SCENE_SUBMITS];
+
+	VkFence renderFence;
+	VkSemaphore presentSemaphore;
+	VkSemaphore renderSemaphore;
+	//signaled by the last scene submission, the final submission waits on it before the upscale reads the scene
+	VkSemaphore sceneSemaphore;
+
+	//async compute, recorded from a pool of the compute queue family
+	VkCommandPool computeCommandPool;
+	VkCommandBuffer computeCommandBuffer;
+	//signaled by the compute submission when timeline semaphores are not available
+	VkSemaphore computeSemaphore;
+
+	//written by the particle simulation, drawn by the scene pass of the same frame
+	AllocatedBuffer particleBuffer;
+	VkDescriptorSet particleDescriptor;
+
+	//buffer that holds a single GPUCameraData to use when rendering
+	AllocatedBuffer cameraBuffer;
+	AllocatedBuffer objectBuffer;
+
+	//draw commands for the vertex pulling path
+	AllocatedBuffer indirectBuffer;
+
+#if DEBUG_DRAW_ENABLED
+	//debug lines of the frame, mapped for as long as the buffer lives
+	AllocatedBuffer debugDrawBuffer;
+	vkutil::DebugVertex* debugDrawVertices;
+#endif
+
+	VkDescriptorSet globalDescriptor;
+	VkDescriptorSet objectDescriptor;
+
+	//resources that were in use by the previous frames, freed once this frame's fence is signaled again
+	DeletionQueue frameDeletionQueue;
+};
+
 class PipelineBuilder {
 public:
 
@@ -111,6 +146,8 @@ public:
     VkPipelineMultisampleStateCreateInfo _multisampling;
 	VkPipelineDepthStencilStateCreateInfo _depthStencil;
     VkPipelineLayout _pipelineLayout;
+    //when set, _viewport and _scissor are ignored and have to be set while recording
+    std::vector<VkDynamicState> _dynamicStates;
 
     VkPipeline build_pipeline(VkDevice device, VkRenderPass pass);
 };
@@ -146,7 +183,7 @@ public:
 	VkDevice _device; // Vulkan device for commands
 	VkSurfaceKHR _surface; // Vulkan window surface
 
-    VkSwapchainKHR _swapchain; // from other articles
+    VkSwapchainKHR _swapchain{VK_NULL_HANDLE}; // from other articles
 
     // image format expected by the windowing system
     VkFormat _swapchainImageFormat;
@@ -160,6 +197,20 @@ public:
     VkQueue _graphicsQueue; //queue we will submit to
     uint32_t _graphicsQueueFamily; //family of that queue
 
+    // Async compute: compute passes go to a queue family without graphics when the GPU has one, preferably a dedicated
+    // one, and the graphics submission that uses their results waits on a timeline semaphore (one binary semaphore per
+    // frame without VK_KHR_timeline_semaphore). Without such a family they are recorded into the graphics frame
+    bool _useAsyncCompute{true};
+    bool _hasComputeQueue{false};
+    VkQueue _computeQueue{VK_NULL_HANDLE};
+    uint32_t _computeQueueFamily{0};
+    bool _supportsTimelineSemaphores{false};
+    VkSemaphore _computeTimeline{VK_NULL_HANDLE};
+    //value the compute submission of the current frame signals
+    uint64_t _computeTimelineValue{0};
+    //set when this frame's compute work went to the compute queue, cleared by the graphics submission that waits on it
+    bool _computeWaitPending{false};
+
     VkCommandPool _commandPool; //the command pool for our commands
     VkCommandBuffer _mainCommandBuffer; //the buffer we will record into
 
@@ -199,12 +250,92 @@ public:
 	std::unordered_map<std::string,Material> _materials;
 	std::unordered_map<std::string,Mesh> _meshes;
 
+	//binary scene instantiated by init_scene, converted from its text form with convert_scene
+	std::string _scenePath{"../assets/default.bscene"};
+	//mapped by load_scene and read in place by instantiate_scene, which closes it. The tables resolve the file's names
+	vkutil::SceneFile _sceneFile;
+	std::vector<Mesh*> _sceneMeshes;
+	std::vector<Material*> _sceneMaterials;
+
 	glm::vec3 _camPos{0.0f, -6.f, -10.0f};
 
+	//meshes bigger than this are split into spatial chunks that are culled separately
+	static constexpr size_t MESH_CHUNK_VERTEX_THRESHOLD = 65536;
+	float _meshChunkSize{32.f};
+
+	bool _enableFrustumCulling{true};
+
+	//same frame CPU occlusion culling of the frustum culling survivors, against simplified chunks of the chunked meshes
+	bool _enableOcclusionCulling{false};
+	static constexpr uint32_t OCCLUDER_TRIANGLES_PER_CHUNK = 512;
+	std::vector<vkutil::Occluder> _occluders;
+	vkutil::OcclusionRasterizer _occlusionRasterizer;
+
+	//precomputed visibility between cells of the map and chunks of lost_empire, baked offline with bake_pvs.
+	//Chunks hidden from the camera's cell are dropped before frustum culling
+	std::string _pvsPath{"../assets/lost_empire.pvs"};
+	bool _enablePvs{true};
+	vkutil::PotentiallyVisibleSet _pvs;
+	const Mesh* _pvsMesh{nullptr};
+	glm::mat4 _pvsWorldToMesh{1.f};
+
+	//bounding volume tree over the renderables' world bounds, queried by culling and picking instead of scanning every
+	//object. Rebuilt when _renderables is reordered, the objects moved with set_object_transform are refit each frame
+	bool _useObjectTree{true};
+	vkutil::ObjectTree _objectTree;
+	//tree proxy of each renderable, by index, and the renderables moved since the last refit
+	std::vector<uint32_t> _objectProxies;
+	vkutil::MovedObjects _movedObjects;
+	std::vector<uint32_t> _treeCandidates;
+
+	//triangle BVHs of the scene's meshes for mouse picking, built at load. Streamed meshes get theirs on the first
+	//pick that reaches them
+	std::unordered_map<const Mesh*, vkutil::TriangleBvh> _meshBvhs;
+	bool _hasPick{false};
+	vkutil::RayHit _pickHit{};
+	glm::vec3 _pickPosition{0.f};
+	AABB _pickBounds;
+	float _pickMicroseconds{0.f};
+	uint32_t _pvsCell{vkutil::PotentiallyVisibleSet::INVALID_CELL};
+	std::vector<uint32_t> _pvsCandidates;
+
+	//ambient occlusion of lost_empire baked offline with bake_lighting, stored in its vertex colors and shaded by
+	//the texturedbaked material. Set with --baked-lighting, empty keeps the unlit textured material
+	std::string _bakedLightingPath;
+	bool _empireLightingBaked{false};
+
+	//worker threads for CPU work split over every core
+	vkutil::JobSystem _jobs;
+
+	//indices into _renderables that survived culling this frame, in draw order
+	std::vector<uint32_t> _visibleObjects;
+
+	GPUCameraData _cameraData;
+
+	//world streaming, enabled by setting a cell manifest before init
+	std::string _worldManifestPath;
+	vkutil::StreamingSettings _streamingSettings;
+	vkutil::WorldStreamer _worldStreamer;
+
+	//vertex data uploaded per frame at most, the other parsed cells wait for the next frames
+	size_t _streamingUploadBytesPerFrame{8 * 1024 * 1024};
+
+	//mesh names of every resident cell
+	std::unordered_map<uint32_t, std::vector<std::string>> _streamedCells;
+
+	//merge static objects into pre-transformed chunk meshes at scene build time
+	bool _enableStaticBatching{false};
+	float _staticBatchChunkSize{16.f};
+
 	// Double buffering
 	static constexpr size_t FRAME_OVERLAP = 2;
 	std::array<FrameData, FRAME_OVERLAP> _frames;
 
+	//the object and indirect buffers hold the scene and this many more objects, room for streamed cells
+	static constexpr uint32_t OBJECT_HEADROOM = 10000;
+	//objects the per-frame object and indirect buffers hold, sized by init_object_buffers once the scene is built
+	uint32_t _objectCapacity{0};
+
 	VkDescriptorSetLayout _globalSetLayout;
 	VkDescriptorSetLayout _objectSetLayout;
     VkDescriptorSetLayout _singleTextureSetLayout;
@@ -225,6 +356,179 @@ public:
 
     void load_images();
 
+    // Visibility buffer path: a cheap pass writes object/triangle ids, then one full-screen pass shades each pixel once
+    bool _useVisibilityBuffer{false};
+
+    //all mesh vertices packed back to back, fetched by the resolve and vertex pulling shaders
+    AllocatedBuffer _geometryArena;
+
+    //ranges of the arena in use, in words. Streamed meshes are placed in what the static meshes left free
+    vkutil::RangeAllocator _arenaAllocator;
+
+    // Vertex pulling path: no vertex buffers bound, each material is drawn with one multi-draw
+    bool _useVertexPulling{false};
+    bool _supportsMultiDrawIndirect{false};
+
+    VkFormat _visibilityFormat{VK_FORMAT_R32G32_UINT};
+    AllocatedImage _visibilityImage;
+    VkImageView _visibilityImageView;
+    VkRenderPass _visibilityRenderPass;
+    VkFramebuffer _visibilityFramebuffer;
+
+    VkPipeline _visibilityPipeline;
+    VkPipeline _visibilityResolvePipeline;
+    VkPipelineLayout _visibilityResolvePipelineLayout;
+
+    VkDescriptorSetLayout _visibilityResolveSetLayout;
+    VkDescriptorSet _visibilityResolveDescriptor;
+
+    // Dynamic resolution: the scene is rendered offscreen at _renderExtent, then upscaled to the swapchain
+    VkExtent2D _renderExtent;
+    AllocatedImage _sceneImage;
+    VkImageView _sceneImageView;
+    VkRenderPass _sceneRenderPass;
+    //compatible with _sceneRenderPass, loads color and depth so a later scene chunk draws on top of the earlier ones
+    VkRenderPass _sceneLoadRenderPass;
+    VkFramebuffer _sceneFramebuffer;
+    VkDescriptorSet _sceneTextureDescriptor;
+
+    VkPipeline _upscalePipeline;
+    VkPipelineLayout _upscalePipelineLayout;
+
+    //GPU time of every frame, two timestamps per frame in flight
+    VkQueryPool _timestampQueryPool{VK_NULL_HANDLE};
+    bool _supportsTimestamps{false};
+    float _lastGpuFrameMs{0.f};
+    std::chrono::time_point<std::chrono::high_resolution_clock> _lastDrawTime{std::chrono::high_resolution_clock::now()};
+
+    bool _enableQualityGovernor{true};
+    vkutil::GovernorSettings _governorSettings;
+    vkutil::QualityGovernor _qualityGovernor;
+
+    float _cameraFar{200.f};
+
+    // Cached UI: ImGui is only rebuilt and re-recorded into _uiImage on input or every 1/_uiRefreshRate seconds,
+    // every other frame just composites the cached image over the scene
+    AllocatedImage _uiImage;
+    VkImageView _uiImageView;
+    VkRenderPass _uiRenderPass;
+    VkFramebuffer _uiFramebuffer;
+    VkDescriptorSet _uiTextureDescriptor;
+
+    VkPipeline _uiCompositePipeline;
+    VkPipelineLayout _uiCompositePipelineLayout;
+
+    float _uiRefreshRate{10.f};
+    //frames to keep rebuilding after an input event, ImGui reacts to some inputs one frame late (hover, focus)
+    static constexpr uint32_t UI_SETTLE_FRAMES = 3;
+    uint32_t _uiPendingRebuilds{UI_SETTLE_FRAMES};
+    //set by run() when the UI was rebuilt this frame and has to be recorded again
+    bool _rebuildUi{false};
+    std::chrono::time_point<std::chrono::high_resolution_clock> _lastUiRebuildTime;
+    uint64_t _uiDrawDataHash{0};
+
+    // Idle frame skipping: run() only draws when the camera, scene, UI or animation changed since the last frame
+    bool _enableIdleSkipping{true};
+    //the flashing clear color and ambient light, the only things that change on their own
+    bool _animateScene{true};
+    size_t _animationFrame{0};
+    bool _redrawRequested{true};
+    glm::vec3 _lastDrawnCamPos{0.f};
+    bool _idledSinceLastFrame{false};
+
+    // Frame pacing: run() waits for the pacer before polling input, so input is read as late as possible,
+    // and with late acquire the swapchain image is only requested once the offscreen passes are recorded
+    vkutil::FramePacer _framePacer;
+    //0 is uncapped
+    float _frameRateLimit{0.f};
+    bool _lateAcquire{true};
+
+    // Split submission: the frame goes to the GPU in parts, each submitted as soon as it is recorded. The setup and
+    // first scene chunk go first, the forward pass is cut into _sceneSubmits chunks, the upscale and UI come last
+    bool _splitSubmission{true};
+    uint32_t _sceneSubmits{4};
+    //how long before the final submit the GPU had the first part of the frame, last frame
+    float _submitLeadMs{0.f};
+    std::vector<uint32_t> _chunkDrawList;
+    //FIFO present mode when set, immediate otherwise
+    bool _vsync{false};
+
+    // Headless: no window, surface or swapchain. The scene is still rendered into its offscreen target,
+    // run() draws _headlessFrames frames and prints the frame time stats
+    bool _headless{false};
+    uint32_t _headlessFrames{600};
+
+    //input to display latency, headless frames count as having input at the start of every frame
+    vkutil::LatencyTracker _latencyTracker;
+
+    //CPU scope timings of the last few seconds, dumped to a trace file when a frame hitches
+    vkutil::HitchSettings _hitchSettings;
+    vkutil::Profiler _profiler;
+
+    //Prometheus metrics, written to _metricsSettings.path when one is set
+    vkutil::MetricsSettings _metricsSettings;
+    vkutil::MetricsExporter _metrics;
+    //end of the previous drawn frame, unset until the first one so init() never counts as frame time
+    std::chrono::time_point<std::chrono::high_resolution_clock> _lastFrameEndTime{};
+
+    // Frame capture: F12 writes the next drawn frame to _capturePath. --replay loads such a file instead of the
+    // scene and redraws that one frame headless, so optimizations can be timed on identical work
+    std::string _capturePath{"frame.capture"};
+    bool _captureRequested{false};
+    std::string _replayPath;
+    bool _replaying{false};
+    std::vector<uint32_t> _replayDrawList;
+
+    // Debug views: the scene pass draws _debugView instead of the shaded scene, each view is a specialization of
+    // debug_view.frag. The material cost view shades as usual and multiplies a tint over the result
+    vkutil::DebugView _debugView{vkutil::DebugView::None};
+    std::array<VkPipeline, static_cast<size_t>(vkutil::DebugView::Count)> _debugViewPipelines{};
+    //push constant data of every visible object, refilled each frame a debug view is on
+    std::vector<glm::vec4> _debugViewData;
+
+    //one timestamp before the scene draws and one after each material, written while the material cost view is on
+    static constexpr uint32_t MAX_TIMED_MATERIALS = 32;
+    VkQueryPool _materialTimestampPool{VK_NULL_HANDLE};
+    std::array<std::vector<const Material*>, FRAME_OVERLAP> _timedMaterials;
+    vkutil::MaterialCostTracker _materialCosts;
+
+    // Particles: a fountain simulated by particles.comp on the async compute queue and drawn as points at the end of
+    // the scene pass. The simulation only depends on time, so it never waits for graphics work
+    static constexpr uint32_t MAX_PARTICLES = 131072;
+    bool _enableParticles{true};
+    uint32_t _particleCount{65536};
+    glm::vec3 _particleEmitter{0.f, 0.f, 0.f};
+    VkDescriptorSetLayout _particleSetLayout{VK_NULL_HANDLE};
+    VkPipeline _particleComputePipeline{VK_NULL_HANDLE};
+    VkPipelineLayout _particleComputeLayout{VK_NULL_HANDLE};
+    VkPipeline _particleDrawPipeline{VK_NULL_HANDLE};
+    VkPipelineLayout _particleDrawLayout{VK_NULL_HANDLE};
+    //start and end of the simulation per frame in flight, written on the queue it ran on
+    VkQueryPool _computeTimestampPool{VK_NULL_HANDLE};
+    //the particles were simulated in this slot's last frame, so its timestamps can be read
+    std::array<bool, FRAME_OVERLAP> _computeTimed{};
+    float _lastComputeMs{0.f};
+    //GPU time the simulation ran alongside the graphics work of its frame. Vulkan only promises timestamps compare on
+    //the same queue, desktop GPUs share one clock between their queues so this is an estimate elsewhere
+    float _lastComputeOverlapMs{0.f};
+
+#if DEBUG_DRAW_ENABLED
+    //debug draw: lines added to _debugDraw during the frame are drawn at the end of the scene pass,
+    //depth tested in one draw and overlaid in another
+    vkutil::DebugDraw _debugDraw;
+    VkPipeline _debugDrawPipeline{VK_NULL_HANDLE};
+    VkPipeline _debugDrawOverlayPipeline{VK_NULL_HANDLE};
+    VkPipelineLayout _debugDrawPipelineLayout{VK_NULL_HANDLE};
+
+    //what the engine draws through it: object bounds (visible green, culled red), streaming cells, the mesh chunk grid,
+    //and the frustum the camera had when it was frozen
+    bool _debugDrawBounds{false};
+    bool _debugDrawStreamingCells{false};
+    bool _debugDrawChunkGrid{false};
+    bool _debugDrawFrozenFrustum{false};
+    glm::mat4 _frozenViewproj{1.f};
+#endif
+
 private:
 	void init_vulkan();
 
@@ -244,6 +548,47 @@ private:
 
     void init_imgui();
 
+    void init_visibility_buffer();
+
+    void init_scene_target();
+
+    void init_gpu_timers();
+
+    //compute pipeline, per frame buffers and the point pipeline that draws them
+    void init_particles();
+
+    void init_ui_layer();
+
+    //builds the ImGui frame, only called when the cached layer is out of date
+    void build_ui();
+
+    bool needs_redraw() const;
+
+    void run_headless();
+
+    void print_pacing_stats() const;
+
+    void print_latency_stats() const;
+
+    void capture_frame();
+
+    //swaps the scene for the capture at _replayPath
+    bool load_replay();
+
+    //checks the fences of the frames carrying input without waiting on them
+    void poll_frame_latency();
+
+    //memory, streaming and scene gauges, too slow to gather every frame
+    void update_metrics_gauges();
+
+    //adds the time since waitStart to the stall metrics when it is long enough to count
+    void record_queue_stall(std::chrono::time_point<std::chrono::high_resolution_clock> waitStart);
+
+    //how long run() can sleep when idle before something is due
+    uint32_t idle_wait_ms() const;
+
+    void init_geometry_arena();
+
 	void load_meshes();
 
 	void upload_mesh(Mesh& mesh);
@@ -257,15 +602,130 @@ private:
 	//returns nullptr if it can't be found
 	Mesh* get_mesh(const std::string& name);
 
+	//writes camera, object and scene data for the current frame
+	void upload_frame_data(RenderObject* first, int count);
+
 	//our draw function
-	void draw_objects(VkCommandBuffer cmd,RenderObject* first, int count);
+	void draw_objects(vkutil::CommandBackend& commands, RenderObject* first, const std::vector<uint32_t>& visible);
+
+    //the part of _visibleObjects the given scene chunk draws, kept in _chunkDrawList
+    const std::vector<uint32_t>& scene_chunk(uint32_t chunk, uint32_t chunkCount);
+    //ends cmd and submits it without a fence, signalSemaphore may be VK_NULL_HANDLE. lastPart is the submission
+    //that ends the scene pass, the one that draws the particles
+    void submit_scene_part(VkCommandBuffer cmd, VkSemaphore signalSemaphore, bool lastPart);
+
+	//same as draw_objects, but vertices are pulled from the geometry arena and each material is a single multi-draw
+	void draw_objects_pulled(vkutil::CommandBackend& commands, RenderObject* first, const std::vector<uint32_t>& visible);
+
+	//same as draw_objects, with timestamps around the draws of each material
+	void draw_objects_timed(VkCommandBuffer cmd, vkutil::CommandBackend& commands, RenderObject* first, const std::vector<uint32_t>& visible);
+
+	//draws the visible objects with the pipeline of _debugView
+	void draw_debug_view(vkutil::CommandBackend& commands, RenderObject* first, const std::vector<uint32_t>& visible);
+
+	//feeds the material timestamps of the last frame that used this frame's slot to _materialCosts
+	void read_material_timings();
+
+#if DEBUG_DRAW_ENABLED
+	//adds the engine's own debug primitives, selected in the debug window
+	void add_engine_debug_draws();
+
+	//copies the frame's debug lines into its vertex buffer and draws them
+	void draw_debug_lines(VkCommandBuffer cmd);
+#endif
+
+	//runs the particle simulation of this frame, submitted on its own to the compute queue when there is one.
+	//Otherwise it is recorded into cmd, the graphics command buffer, followed by a barrier for the vertex shader
+	void simulate_particles(VkCommandBuffer cmd);
+
+	void draw_particles(VkCommandBuffer cmd);
+
+	//the compute and graphics timestamps of the last frame that used this frame's slot, and how much they overlapped
+	void read_compute_timings();
+
+	//submits cmd to the graphics queue. The first submission of the frame to pass waitForCompute also waits for the
+	//frame's async compute work before its vertex shaders
+	void submit_graphics(VkCommandBuffer cmd, std::vector<VkSemaphore> waitSemaphores, std::vector<VkPipelineStageFlags> waitStages,
+		const std::vector<VkSemaphore>& signalSemaphores, bool waitForCompute, VkFence fence);
+
+	//writes object and triangle ids of every object into the visibility buffer
+	void draw_visibility(vkutil::CommandBackend& commands, RenderObject* first, const std::vector<uint32_t>& visible);
+
+	//shades the visibility buffer with a single full-screen triangle
+	void resolve_visibility(VkCommandBuffer cmd);
+
+	//draws the scene image over the whole swapchain image
+	void upscale_scene(VkCommandBuffer cmd);
+
+	//records the ImGui draw data into the cached UI layer
+	void record_ui_layer(VkCommandBuffer cmd);
+
+	void composite_ui_layer(VkCommandBuffer cmd);
+
+	void set_viewport(VkCommandBuffer cmd, VkExtent2D extent);
+
+	//reads the GPU time of the last frame that used this frame's slot and lets the governor react to it
+	void update_quality();
+
+	void apply_quality_levels();
 
 	void init_scene();
 
+	//maps a binary scene file and resolves its names, false when the file or what it references is missing.
+	//Nothing is read per entity until instantiate_scene
+	bool load_scene(const std::string& path);
+
+	//appends the objects of the loaded scene to _renderables, one per chunk of a chunked mesh, and closes the file
+	void instantiate_scene();
+
+	//one occluder per chunk of a chunked mesh, see OCCLUDER_TRIANGLES_PER_CHUNK
+	void build_occluders();
+
+	//one BVH per mesh used by a renderable, see _meshBvhs
+	void build_mesh_bvhs();
+
+	//closest triangle under the window pixel x, y
+	void pick_object(int32_t x, int32_t y);
+
+	void sort_renderables();
+
+	//inserts every renderable into _objectTree
+	void rebuild_object_tree();
+
+	//moves the tree proxies of the dynamic objects to their current world bounds
+	void update_object_tree();
+
+	//moves a renderable that isn't static and marks it for the next refit of the object tree
+	void set_object_transform(uint32_t index, const glm::mat4& transform);
+
+	void init_streaming();
+
+	//frees cells that went out of range and uploads the ones that finished loading
+	void update_streaming(VkCommandBuffer cmd);
+
+	//records the copies into cmd, returns false when the cell does not fit in the geometry arena
+	bool upload_streamed_cell(VkCommandBuffer cmd, vkutil::LoadedCell& cell);
+
+	void unload_streamed_cell(uint32_t cellIndex, DeletionQueue& deletionQueue);
+
+	void build_static_batches();
+
+	//view and projection for this frame
+	void update_camera();
+
+	//fills _visibleObjects
+	void cull_renderables();
+
 	FrameData& get_current_frame();
 
+	//descriptor sets and scene data offset of the current frame, for the vkutil::record_* draw functions
+	vkutil::FrameBindings get_frame_bindings();
+
 	void init_descriptors();
 
+	//per-frame object and indirect buffers sized to _renderables, written to the object descriptor sets
+	void init_object_buffers();
+
 	size_t pad_uniform_buffer_size(size_t originalSize);
 
     bool use_gpu_only_memory_for_mesh_buffers = true;
@@ -0,0 +1,77 @@
+#include <vk_governor.h>
+
+#include <algorithm>
+
+namespace vkutil {
+
+void QualityGovernor::init(const GovernorSettings& settings)
+{
+    _settings = settings;
+    reset();
+}
+
+void QualityGovernor::reset()
+{
+    _levels = QualityLevels{};
+    _smoothedMs = 0.f;
+    _overBudgetFrames = 0;
+    _underBudgetFrames = 0;
+}
+
+bool QualityGovernor::update(float gpuFrameMs)
+{
+    _smoothedMs = _smoothedMs == 0.f ? gpuFrameMs : _smoothedMs + (gpuFrameMs - _smoothedMs) * _settings.smoothing;
+
+    if (_smoothedMs > _settings.targetFrameMs * (1.f + _settings.overBudgetMargin)) {
+        ++_overBudgetFrames;
+        _underBudgetFrames = 0;
+    } else if (_smoothedMs < _settings.targetFrameMs * (1.f - _settings.underBudgetMargin)) {
+        ++_underBudgetFrames;
+        _overBudgetFrames = 0;
+    } else {
+        _overBudgetFrames = 0;
+        _underBudgetFrames = 0;
+    }
+
+    bool changed = false;
+    if (_overBudgetFrames >= _settings.framesBeforeLowering) {
+        changed = lower_quality();
+    } else if (_underBudgetFrames >= _settings.framesBeforeRaising) {
+        changed = raise_quality();
+    }
+
+    if (changed) {
+        //the frames in flight were rendered at the old levels, start counting again from here
+        _overBudgetFrames = 0;
+        _underBudgetFrames = 0;
+    }
+    return changed;
+}
+
+bool QualityGovernor::lower_quality()
+{
+    if (_levels.renderScale > _settings.minRenderScale) {
+        _levels.renderScale = std::max(_settings.minRenderScale, _levels.renderScale - _settings.renderScaleStep);
+        return true;
+    }
+    if (_levels.drawDistanceScale > _settings.minDrawDistanceScale) {
+        _levels.drawDistanceScale = std::max(_settings.minDrawDistanceScale, _levels.drawDistanceScale - _settings.drawDistanceStep);
+        return true;
+    }
+    return false;
+}
+
+bool QualityGovernor::raise_quality()
+{
+    if (_levels.drawDistanceScale < 1.f) {
+        _levels.drawDistanceScale = std::min(1.f, _levels.drawDistanceScale + _settings.drawDistanceStep);
+        return true;
+    }
+    if (_levels.renderScale < 1.f) {
+        _levels.renderScale = std::min(1.f, _levels.renderScale + _settings.renderScaleStep);
+        return true;
+    }
+    return false;
+}
+
+}
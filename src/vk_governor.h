@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+
+namespace vkutil {
+
+//the knobs the governor turns, 1 is full quality
+struct QualityLevels {
+    //fraction of the window resolution the scene is rendered at before being upscaled
+    float renderScale{1.f};
+    //fraction of the camera far plane objects are still drawn at
+    float drawDistanceScale{1.f};
+};
+
+struct GovernorSettings {
+    float targetFrameMs{1000.f / 60.f};
+
+    //quality drops once the smoothed frame time goes over target * (1 + overBudgetMargin) and only comes back
+    //once it is under target * (1 - underBudgetMargin), the gap between the two keeps it from oscillating
+    float overBudgetMargin{0.05f};
+    float underBudgetMargin{0.2f};
+
+    //frames the condition has to hold before acting. Raising waits longer, a spike costs less than a stutter back and forth
+    uint32_t framesBeforeLowering{10};
+    uint32_t framesBeforeRaising{90};
+
+    float minRenderScale{0.5f};
+    float renderScaleStep{0.1f};
+
+    float minDrawDistanceScale{0.4f};
+    float drawDistanceStep{0.15f};
+
+    //weight of the newest frame in the moving average
+    float smoothing{0.1f};
+};
+
+//watches GPU frame times and trades quality for time when over budget. Resolution goes first since it scales
+//almost linearly with pixel cost, draw distance only once resolution is at its minimum. Raising goes in reverse.
+class QualityGovernor {
+public:
+    void init(const GovernorSettings& settings);
+
+    //feed the GPU time of a finished frame, returns true when the quality levels changed
+    bool update(float gpuFrameMs);
+
+    //back to full quality, e.g. when the governor gets turned off
+    void reset();
+
+    //replays restore the levels a frame was captured with
+    void set_levels(const QualityLevels& levels) { _levels = levels; }
+
+    const QualityLevels& levels() const { return _levels; }
+    float smoothed_frame_ms() const { return _smoothedMs; }
+
+    GovernorSettings _settings;
+
+private:
+    bool lower_quality();
+    bool raise_quality();
+
+    QualityLevels _levels;
+    float _smoothedMs{0.f};
+    uint32_t _overBudgetFrames{0};
+    uint32_t _underBudgetFrames{0};
+};
+
+}
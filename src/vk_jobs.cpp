@@ -0,0 +1,110 @@
+#include <vk_jobs.h>
+
+#include <algorithm>
+
+namespace vkutil {
+
+JobSystem::~JobSystem()
+{
+    stop();
+}
+
+void JobSystem::start(uint32_t workerCount)
+{
+    if (!_workers.empty()) {
+        return;
+    }
+
+    if (workerCount == 0) {
+        const uint32_t hardwareThreads = std::thread::hardware_concurrency();
+        workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+    }
+
+    _stopping = false;
+    for (uint32_t i = 0; i < workerCount; i++) {
+        _workers.emplace_back(&JobSystem::worker_loop, this);
+    }
+}
+
+void JobSystem::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _wakeWorkers.notify_all();
+
+    for (std::thread& worker : _workers) {
+        worker.join();
+    }
+    _workers.clear();
+}
+
+void JobSystem::parallel_for(uint32_t count, uint32_t grainSize, const RangeFunction& body)
+{
+    grainSize = std::max(grainSize, 1u);
+    if (count == 0) {
+        return;
+    }
+    if (_workers.empty() || count <= grainSize) {
+        body(0, count);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _body = &body;
+        _count = count;
+        _grainSize = grainSize;
+        _nextIndex = 0;
+        _activeWorkers = static_cast<uint32_t>(_workers.size());
+        ++_loopId;
+    }
+    _wakeWorkers.notify_all();
+
+    run_ranges();
+
+    //body lives on the caller's stack, wait until no worker can still be using it
+    std::unique_lock<std::mutex> lock(_mutex);
+    _loopDone.wait(lock, [&] { return _activeWorkers == 0; });
+    _body = nullptr;
+}
+
+void JobSystem::run_ranges()
+{
+    while (true) {
+        const uint32_t begin = _nextIndex.fetch_add(_grainSize);
+        if (begin >= _count) {
+            return;
+        }
+        (*_body)(begin, std::min(begin + _grainSize, _count));
+    }
+}
+
+void JobSystem::worker_loop()
+{
+    uint64_t lastLoop = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _wakeWorkers.wait(lock, [&] { return _stopping || _loopId != lastLoop; });
+            if (_stopping) {
+                return;
+            }
+            lastLoop = _loopId;
+        }
+
+        run_ranges();
+
+        bool last;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            last = --_activeWorkers == 0;
+        }
+        if (last) {
+            _loopDone.notify_one();
+        }
+    }
+}
+
+}
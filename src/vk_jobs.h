@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vkutil {
+
+//a fixed pool of worker threads running parallel loops. The calling thread works on the loop too and returns once
+//every index has been processed, so loops are always run to completion before the caller moves on
+class JobSystem {
+public:
+    //body(begin, end) processes the indices begin..end-1
+    using RangeFunction = std::function<void(uint32_t begin, uint32_t end)>;
+
+    ~JobSystem();
+
+    //0 uses one worker per hardware thread besides the caller
+    void start(uint32_t workerCount = 0);
+    void stop();
+
+    //splits 0..count-1 into ranges of at most grainSize indices and hands them out to the workers and the caller.
+    //Runs inline without workers or for a single range. Not reentrant: body must not call parallel_for
+    void parallel_for(uint32_t count, uint32_t grainSize, const RangeFunction& body);
+
+    //threads a parallel_for runs on, the caller included
+    uint32_t thread_count() const { return static_cast<uint32_t>(_workers.size()) + 1; }
+
+private:
+    void worker_loop();
+
+    //takes ranges of the current loop until none are left
+    void run_ranges();
+
+    std::vector<std::thread> _workers;
+
+    std::mutex _mutex;
+    std::condition_variable _wakeWorkers;
+    std::condition_variable _loopDone;
+    bool _stopping{false};
+
+    //the loop being run, bumped each time so sleeping workers see a new one
+    uint64_t _loopId{0};
+    const RangeFunction* _body{nullptr};
+    uint32_t _count{0};
+    uint32_t _grainSize{1};
+    std::atomic<uint32_t> _nextIndex{0};
+    //workers still inside the current loop
+    uint32_t _activeWorkers{0};
+};
+
+}
@@ -0,0 +1,105 @@
+#include <vk_latency.h>
+
+#include <algorithm>
+
+namespace vkutil {
+
+const char* latency_stage_name(LatencyStage stage)
+{
+    switch (stage) {
+        case LatencyStage::Simulation:
+            return "simulation";
+        case LatencyStage::Record:
+            return "record";
+        case LatencyStage::Submit:
+            return "submit";
+        case LatencyStage::Present:
+            return "present";
+        case LatencyStage::GpuComplete:
+            return "GPU complete";
+        default:
+            return "unknown";
+    }
+}
+
+void LatencyTracker::init(uint32_t frameSlots)
+{
+    _frames.assign(frameSlots, FrameRecord{});
+    _hasPendingInput = false;
+    _sampleCount = 0;
+    _nextSample = 0;
+}
+
+void LatencyTracker::add_input(Clock::time_point time)
+{
+    if (!_hasPendingInput || time < _pendingInput) {
+        _pendingInput = time;
+        _hasPendingInput = true;
+    }
+}
+
+void LatencyTracker::begin_frame(uint32_t slot)
+{
+    FrameRecord& frame = _frames[slot];
+    frame.active = _hasPendingInput;
+    if (!frame.active) {
+        return;
+    }
+
+    frame.input = _pendingInput;
+    //stages that never get marked read as the input time, i.e. 0
+    frame.stages.fill(_pendingInput);
+    _hasPendingInput = false;
+}
+
+void LatencyTracker::mark(uint32_t slot, LatencyStage stage)
+{
+    FrameRecord& frame = _frames[slot];
+    if (frame.active) {
+        frame.stages[static_cast<size_t>(stage)] = Clock::now();
+    }
+}
+
+void LatencyTracker::gpu_complete(uint32_t slot)
+{
+    FrameRecord& frame = _frames[slot];
+    if (!frame.active) {
+        return;
+    }
+
+    frame.stages[static_cast<size_t>(LatencyStage::GpuComplete)] = Clock::now();
+    frame.active = false;
+
+    for (size_t stage = 0; stage < frame.stages.size(); stage++) {
+        _samples[stage][_nextSample] = std::chrono::duration<float, std::milli>(frame.stages[stage] - frame.input).count();
+    }
+    _nextSample = (_nextSample + 1) % HISTORY;
+    _sampleCount = std::min(_sampleCount + 1, HISTORY);
+}
+
+LatencyStats LatencyTracker::stats() const
+{
+    LatencyStats stats{};
+    stats.samples = static_cast<uint32_t>(_sampleCount);
+    if (_sampleCount == 0) {
+        return stats;
+    }
+
+    auto percentile = [&](const std::array<float, HISTORY>& sorted, float fraction) {
+        return sorted[std::min(_sampleCount - 1, static_cast<size_t>(_sampleCount * fraction))];
+    };
+
+    for (size_t stage = 0; stage < stats.stages.size(); stage++) {
+        std::array<float, HISTORY> sorted;
+        std::copy(_samples[stage].begin(), _samples[stage].begin() + _sampleCount, sorted.begin());
+        std::sort(sorted.begin(), sorted.begin() + _sampleCount);
+
+        stats.stages[stage].p50Ms = percentile(sorted, 0.5f);
+        stats.stages[stage].p95Ms = percentile(sorted, 0.95f);
+        stats.stages[stage].p99Ms = percentile(sorted, 0.99f);
+        stats.stages[stage].maxMs = sorted[_sampleCount - 1];
+    }
+    return stats;
+}
+
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace vkutil {
+
+//points of the frame pipeline an input is followed through, each one measured from the input
+enum class LatencyStage : uint32_t {
+    Simulation,     //camera, streaming, culling and frame data done
+    Record,         //command buffer ended
+    Submit,         //queue submit returned
+    Present,        //present returned
+    GpuComplete,    //the frame's fence was seen signaled
+    Count
+};
+
+const char* latency_stage_name(LatencyStage stage);
+
+struct LatencyPercentiles {
+    float p50Ms;
+    float p95Ms;
+    float p99Ms;
+    float maxMs;
+};
+
+struct LatencyStats {
+    uint32_t samples;
+    std::array<LatencyPercentiles, static_cast<size_t>(LatencyStage::Count)> stages;
+};
+
+//follows input events through the frames that show them. Only frames with input since the previous frame are
+//measured, from the oldest such event, since that is the one the user waited on the longest
+class LatencyTracker {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr size_t HISTORY = 256;
+
+    //one slot per frame in flight
+    void init(uint32_t frameSlots);
+
+    void add_input(Clock::time_point time);
+
+    //a frame starts in the slot, it carries the pending input if there is any
+    void begin_frame(uint32_t slot);
+
+    void mark(uint32_t slot, LatencyStage stage);
+
+    //the slot's fence has signaled. The fence is only polled, so this is an upper bound on when the GPU finished
+    void gpu_complete(uint32_t slot);
+
+    //the frame in the slot carries input and still waits for the GPU
+    bool is_pending(uint32_t slot) const { return _frames[slot].active; }
+
+    LatencyStats stats() const;
+
+private:
+    struct FrameRecord {
+        bool active{false};
+        Clock::time_point input;
+        std::array<Clock::time_point, static_cast<size_t>(LatencyStage::Count)> stages;
+    };
+
+    std::vector<FrameRecord> _frames;
+
+    Clock::time_point _pendingInput;
+    bool _hasPendingInput{false};
+
+    //input to stage time of the last HISTORY measured frames
+    std::array<std::array<float, HISTORY>, static_cast<size_t>(LatencyStage::Count)> _samples;
+    size_t _sampleCount{0};
+    size_t _nextSample{0};
+};
+
+}
@@ -0,0 +1,194 @@
+#include <vk_lightbake.h>
+#include <vk_binary.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <unordered_map>
+
+namespace vkutil {
+
+//"VLIT" and the layout version
+static constexpr uint32_t LIGHT_MAGIC = 0x54494C56;
+static constexpr uint32_t LIGHT_VERSION = 1;
+
+//rays start this far above the surface so they don't hit the triangle they leave from
+static constexpr float RAY_OFFSET = 1e-3f;
+
+void AoBaker::init(const Mesh& mesh, const AoBakeSettings& settings)
+{
+    _settings = settings;
+    _passes = 0;
+    _points.clear();
+
+    std::vector<glm::vec3> positions(mesh._vertices.size());
+    for (size_t i = 0; i < positions.size(); i++) {
+        positions[i] = mesh._vertices[i].position;
+    }
+    _bvh.build(positions);
+
+    //the obj normals can be smoothed, the face normal keeps the rays out of the surface
+    struct PointKey {
+        glm::ivec3 position;
+        glm::ivec3 normal;
+        bool operator==(const PointKey& other) const { return position == other.position && normal == other.normal; }
+    };
+    struct PointKeyHash {
+        size_t operator()(const PointKey& key) const
+        {
+            size_t hash = 0;
+            for (int axis = 0; axis < 3; axis++) {
+                hash = hash * 1000003u ^ static_cast<size_t>(key.position[axis]);
+                hash = hash * 1000003u ^ static_cast<size_t>(key.normal[axis]);
+            }
+            return hash;
+        }
+    };
+    std::unordered_map<PointKey, uint32_t, PointKeyHash> pointIndices;
+
+    _vertexPoints.resize(positions.size());
+    for (size_t triangle = 0; triangle < positions.size() / 3; triangle++) {
+        const glm::vec3* corners = &positions[triangle * 3];
+        const glm::vec3 cross = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+        const float length = glm::length(cross);
+        const glm::vec3 normal = length > 0.f ? cross / length : glm::vec3{0.f, 1.f, 0.f};
+
+        for (uint32_t corner = 0; corner < 3; corner++) {
+            const PointKey key{glm::ivec3(glm::round(corners[corner] * 1024.f)), glm::ivec3(glm::round(normal * 64.f))};
+            auto [it, inserted] = pointIndices.try_emplace(key, static_cast<uint32_t>(_points.size()));
+            if (inserted) {
+                _points.push_back(SamplePoint{corners[corner] + normal * RAY_OFFSET, normal, 0});
+            }
+            _vertexPoints[triangle * 3 + corner] = it->second;
+        }
+    }
+}
+
+float AoBaker::point_ao(const SamplePoint& point) const
+{
+    return _passes == 0 ? 1.f : static_cast<float>(point.unoccludedRays) / rays_per_point();
+}
+
+float AoBaker::refine(JobSystem* jobs)
+{
+    const uint32_t pass = _passes;
+    const uint32_t raysPerPass = _settings.raysPerPass;
+    const uint32_t pointCount = static_cast<uint32_t>(_points.size());
+
+    std::vector<float> previousAo(pointCount);
+    for (uint32_t pointIndex = 0; pointIndex < pointCount; pointIndex++) {
+        previousAo[pointIndex] = point_ao(_points[pointIndex]);
+    }
+
+    auto tracePoints = [&](uint32_t begin, uint32_t end) {
+        for (uint32_t pointIndex = begin; pointIndex < end; pointIndex++) {
+            SamplePoint& point = _points[pointIndex];
+            //seeded per point and pass, the bake doesn't depend on how the points were spread over the threads
+            std::mt19937 random{pointIndex * 7919u + pass};
+            std::uniform_real_distribution<float> unit{0.f, 1.f};
+
+            //orthonormal basis around the normal (Duff et al. 2017)
+            const glm::vec3& n = point.normal;
+            const float sign = std::copysign(1.f, n.z);
+            const float a = -1.f / (sign + n.z);
+            const float b = n.x * n.y * a;
+            const glm::vec3 tangent{1.f + sign * n.x * n.x * a, sign * b, -sign * n.x};
+            const glm::vec3 bitangent{b, sign + n.y * n.y * a, -n.y};
+
+            for (uint32_t ray = 0; ray < raysPerPass; ray++) {
+                //cosine weighted, so the fraction of unoccluded rays is the irradiance of a uniform sky
+                const float radius = std::sqrt(unit(random));
+                const float angle = 2.f * 3.14159265f * unit(random);
+                const float x = radius * std::cos(angle);
+                const float y = radius * std::sin(angle);
+                const glm::vec3 direction = tangent * x + bitangent * y + n * std::sqrt(std::max(0.f, 1.f - x * x - y * y));
+
+                if (!_bvh.ray_blocked(point.position, direction, 0.f, _settings.radius)) {
+                    point.unoccludedRays++;
+                }
+            }
+        }
+    };
+
+    if (jobs) {
+        jobs->parallel_for(pointCount, 256, tracePoints);
+    } else {
+        tracePoints(0, pointCount);
+    }
+    _passes++;
+
+    float largestChange = 0.f;
+    for (uint32_t pointIndex = 0; pointIndex < pointCount; pointIndex++) {
+        largestChange = std::max(largestChange, std::abs(point_ao(_points[pointIndex]) - previousAo[pointIndex]));
+    }
+    return largestChange;
+}
+
+std::vector<uint8_t> AoBaker::vertex_light() const
+{
+    std::vector<uint8_t> light(_vertexPoints.size());
+    for (size_t vertex = 0; vertex < light.size(); vertex++) {
+        light[vertex] = static_cast<uint8_t>(std::lround(point_ao(_points[_vertexPoints[vertex]]) * 255.f));
+    }
+    return light;
+}
+
+bool save_baked_lighting(const std::string& path, const Mesh& mesh, const std::vector<uint8_t>& light)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        std::cout << "Failed to write baked lighting " << path << std::endl;
+        return false;
+    }
+
+    BinaryWriter writer(file);
+    writer.value(LIGHT_MAGIC);
+    writer.value(LIGHT_VERSION);
+    writer.value(static_cast<uint32_t>(mesh._vertices.size()));
+    writer.value(static_cast<uint32_t>(mesh._chunks.size()));
+    writer.array(light);
+
+    return file.good();
+}
+
+bool load_baked_lighting(const std::string& path, Mesh& mesh)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cout << "Failed to open baked lighting " << path << std::endl;
+        return false;
+    }
+
+    BinaryReader reader(file);
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    uint32_t vertexCount = 0;
+    uint32_t chunkCount = 0;
+    std::vector<uint8_t> light;
+    reader.value(magic);
+    reader.value(version);
+    if (magic != LIGHT_MAGIC || version != LIGHT_VERSION) {
+        std::cout << path << " is not version " << LIGHT_VERSION << " baked lighting" << std::endl;
+        return false;
+    }
+
+    reader.value(vertexCount);
+    reader.value(chunkCount);
+    reader.array(light);
+    if (!reader.ok()) {
+        std::cout << "Failed to read baked lighting " << path << std::endl;
+        return false;
+    }
+    if (vertexCount != mesh._vertices.size() || chunkCount != mesh._chunks.size() || light.size() != vertexCount) {
+        std::cout << path << " was baked from different vertices, rebake it with bake_lighting" << std::endl;
+        return false;
+    }
+
+    for (size_t vertex = 0; vertex < light.size(); vertex++) {
+        mesh._vertices[vertex].color = glm::vec3(light[vertex] / 255.f);
+    }
+    return true;
+}
+
+}
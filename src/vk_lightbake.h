@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <vk_bvh.h>
+#include <vk_jobs.h>
+#include <vk_mesh.h>
+#include <glm/glm.hpp>
+
+namespace vkutil {
+
+struct AoBakeSettings {
+    //occluders farther than this from a vertex don't darken it
+    float radius{6.f};
+    //rays every sample point gets per refine pass
+    uint32_t raysPerPass{16};
+};
+
+//ambient occlusion of every vertex of a mesh, path traced against the mesh itself. Rays are added a pass at a time so
+//a bake can be stopped once it stops changing. Corners shared by triangles facing the same way are traced once
+class AoBaker {
+public:
+    void init(const Mesh& mesh, const AoBakeSettings& settings);
+
+    //traces raysPerPass more cosine weighted rays from every sample point, on all threads of jobs.
+    //Returns the largest change of a point's AO caused by the pass
+    float refine(JobSystem* jobs);
+
+    size_t point_count() const { return _points.size(); }
+    uint32_t rays_per_point() const { return _passes * _settings.raysPerPass; }
+
+    //0 fully occluded to 255 open, per vertex of the mesh
+    std::vector<uint8_t> vertex_light() const;
+
+private:
+    struct SamplePoint {
+        glm::vec3 position;
+        glm::vec3 normal;
+        uint32_t unoccludedRays;
+    };
+
+    float point_ao(const SamplePoint& point) const;
+
+    AoBakeSettings _settings;
+    TriangleBvh _bvh;
+    std::vector<SamplePoint> _points;
+    //sample point of each vertex
+    std::vector<uint32_t> _vertexPoints;
+    uint32_t _passes{0};
+};
+
+//baked light is stored per vertex in the mesh's final vertex order, after build_chunks
+bool save_baked_lighting(const std::string& path, const Mesh& mesh, const std::vector<uint8_t>& light);
+
+//puts the baked light in the vertex colors of mesh. Fails when the file was baked from other vertices
+bool load_baked_lighting(const std::string& path, Mesh& mesh);
+
+}
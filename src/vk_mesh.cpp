@@ -2,6 +2,14 @@
 
 #include <tiny_obj_loader.h>
 #include <iostream>
+#include <map>
+#include <tuple>
+#include <cstring>
+#include <cmath>
+
+#include <glm/packing.hpp>
+#include <glm/geometric.hpp>
+#include <glm/common.hpp>
 
 VertexInputDescription Vertex::get_vertex_description() {
     VertexInputDescription description;
@@ -125,5 +133,123 @@ bool Mesh::load_from_obj(const char* filename) {
 		}
 	}
 
+    compute_bounds();
+
     return true;
 }
+
+void Mesh::compute_bounds() {
+    _bounds = AABB{};
+    for (const Vertex& vertex : _vertices) {
+        _bounds.expand(vertex.position);
+    }
+}
+
+void Mesh::build_chunks(float chunkSize) {
+    //bucket triangles by the cell their centroid falls in, std::map keeps the chunk order deterministic
+    using CellKey = std::tuple<int, int, int>;
+    std::map<CellKey, std::vector<uint32_t>> cells;
+
+    const uint32_t triangleCount = static_cast<uint32_t>(_vertices.size() / 3);
+    for (uint32_t triangle = 0; triangle < triangleCount; triangle++) {
+        const glm::vec3 centroid = (_vertices[triangle * 3].position + _vertices[triangle * 3 + 1].position + _vertices[triangle * 3 + 2].position) / 3.f;
+        const glm::ivec3 cell = glm::ivec3(glm::floor(centroid / chunkSize));
+        cells[CellKey{cell.x, cell.y, cell.z}].push_back(triangle);
+    }
+
+    std::vector<Vertex> reordered;
+    reordered.reserve(_vertices.size());
+    _chunks.clear();
+
+    for (const auto& [cell, triangles] : cells) {
+        MeshChunk chunk;
+        chunk.firstVertex = static_cast<uint32_t>(reordered.size());
+
+        for (uint32_t triangle : triangles) {
+            for (uint32_t corner = 0; corner < 3; corner++) {
+                const Vertex& vertex = _vertices[triangle * 3 + corner];
+                chunk.bounds.expand(vertex.position);
+                reordered.push_back(vertex);
+            }
+        }
+
+        chunk.vertexCount = static_cast<uint32_t>(reordered.size()) - chunk.firstVertex;
+        _chunks.push_back(chunk);
+    }
+
+    _vertices = std::move(reordered);
+}
+
+void AABB::expand(const glm::vec3& point) {
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+}
+
+void AABB::expand(const AABB& other) {
+    min = glm::min(min, other.min);
+    max = glm::max(max, other.max);
+}
+
+AABB AABB::transformed(const glm::mat4& transform) const {
+    if (empty()) {
+        return *this;
+    }
+
+    //transform the center and project the extents onto the new axes (Arvo's method)
+    const glm::vec3 newCenter = glm::vec3(transform * glm::vec4(center(), 1.f));
+    const glm::vec3 halfExtents = extents();
+    glm::vec3 newExtents{0.f};
+    for (int axis = 0; axis < 3; axis++) {
+        newExtents += glm::abs(glm::vec3(transform[axis])) * halfExtents[axis];
+    }
+
+    AABB result;
+    result.min = newCenter - newExtents;
+    result.max = newCenter + newExtents;
+    return result;
+}
+
+uint32_t vertex_format_stride(VertexFormat format) {
+    switch (format) {
+        case VertexFormat::Packed:
+            return 5;
+        case VertexFormat::Full:
+        default:
+            return sizeof(Vertex) / sizeof(uint32_t);
+    }
+}
+
+//octahedral encoding, maps a unit vector onto a square in [-1, 1]
+static glm::vec2 oct_encode(glm::vec3 n) {
+    const float sum = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    if (sum == 0.f) {
+        return glm::vec2{0.f};
+    }
+    n /= sum;
+
+    glm::vec2 encoded{n.x, n.y};
+    if (n.z < 0.f) {
+        encoded.x = (1.f - std::abs(n.y)) * (n.x >= 0.f ? 1.f : -1.f);
+        encoded.y = (1.f - std::abs(n.x)) * (n.y >= 0.f ? 1.f : -1.f);
+    }
+    return encoded;
+}
+
+void Mesh::pack_vertices(std::vector<uint32_t>& out) const {
+    const uint32_t stride = vertex_format_stride(_vertexFormat);
+    const size_t base = out.size();
+    out.resize(base + _vertices.size() * stride);
+
+    if (_vertexFormat == VertexFormat::Full) {
+        memcpy(out.data() + base, _vertices.data(), _vertices.size() * sizeof(Vertex));
+        return;
+    }
+
+    uint32_t* dst = out.data() + base;
+    for (const Vertex& vertex : _vertices) {
+        memcpy(dst, &vertex.position, sizeof(glm::vec3));
+        dst[3] = glm::packSnorm2x16(oct_encode(vertex.normal));
+        dst[4] = glm::packHalf2x16(vertex.uv);
+        dst += stride;
+    }
+}
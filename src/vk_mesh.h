@@ -2,8 +2,26 @@
 
 #include <vk_types.h>
 #include <vector>
+#include <limits>
 #include <glm/vec3.hpp>
 #include <glm/vec2.hpp>
+#include <glm/mat4x4.hpp>
+
+//axis aligned bounding box, starts out empty
+struct AABB {
+    glm::vec3 min{std::numeric_limits<float>::max()};
+    glm::vec3 max{std::numeric_limits<float>::lowest()};
+
+    void expand(const glm::vec3& point);
+    void expand(const AABB& other);
+
+    bool empty() const { return min.x > max.x; }
+    glm::vec3 center() const { return (min + max) * 0.5f; }
+    glm::vec3 extents() const { return (max - min) * 0.5f; }
+
+    //box enclosing this one after transforming it
+    AABB transformed(const glm::mat4& transform) const;
+};
 
 struct VertexInputDescription {
 
@@ -13,6 +31,15 @@ struct VertexInputDescription {
 	VkPipelineVertexInputStateCreateFlags flags = 0;
 };
 
+//how a mesh's vertices are stored in the geometry arena, decoded by the shaders in vertex_fetch.glsl
+enum class VertexFormat : uint32_t {
+    Full = 0,   //the Vertex struct as is, 11 floats
+    Packed = 1, //position, octahedral normal as 2x snorm16, uv as 2x half. Color is rebuilt from the normal
+};
+
+//size of one vertex of the given format, in 32 bit words
+uint32_t vertex_format_stride(VertexFormat format);
+
 struct Vertex {
 
     glm::vec3 position;
@@ -23,10 +50,36 @@ struct Vertex {
     static VertexInputDescription get_vertex_description();
 };
 
+//a contiguous run of triangles inside a mesh with its own bounds, see Mesh::build_chunks
+struct MeshChunk {
+    uint32_t firstVertex;
+    uint32_t vertexCount;
+    AABB bounds;
+};
+
 struct Mesh {
 	std::vector<Vertex> _vertices;
 
 	AllocatedBuffer _vertexBuffer;
 
+	//object space bounds of all vertices
+	AABB _bounds;
+
+	//spatial chunks, empty unless build_chunks was called
+	std::vector<MeshChunk> _chunks;
+
+	//format and offset (in 32 bit words) of this mesh inside the engine's geometry arena
+	VertexFormat _vertexFormat{VertexFormat::Full};
+	uint32_t _arenaOffset{0};
+
     bool load_from_obj(const char* filename);
+
+    void compute_bounds();
+
+    //reorders the triangles so each cell of a chunkSize grid is contiguous, and records one chunk per non empty cell.
+    //Must run before the mesh is uploaded
+    void build_chunks(float chunkSize);
+
+    //appends the vertices to out, encoded with _vertexFormat
+    void pack_vertices(std::vector<uint32_t>& out) const;
 };
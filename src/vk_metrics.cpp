@@ -0,0 +1,180 @@
+#include <vk_metrics.h>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace vkutil {
+
+void MsHistogram::add(float ms)
+{
+    size_t bucket = 0;
+    while (bucket < BOUNDS.size() && ms > BOUNDS[bucket]) {
+        ++bucket;
+    }
+    ++buckets[bucket];
+    sumMs += ms;
+    ++count;
+}
+
+MetricsExporter::~MetricsExporter()
+{
+    stop();
+}
+
+void MetricsExporter::start(const MetricsSettings& settings)
+{
+    stop();
+
+    _settings = settings;
+    if (_settings.path.empty()) {
+        return;
+    }
+    _stopping = false;
+    _worker = std::thread(&MetricsExporter::worker_loop, this);
+}
+
+void MetricsExporter::stop()
+{
+    if (!_worker.joinable()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _wakeWorker.notify_one();
+    _worker.join();
+}
+
+void MetricsExporter::record_frame(float frameMs, float gpuMs)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _frameTimes.add(frameMs);
+    if (gpuMs >= 0.f) {
+        _gpuFrameTimes.add(gpuMs);
+    }
+}
+
+void MetricsExporter::add_upload_bytes(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _uploadBytes += bytes;
+}
+
+void MetricsExporter::add_queue_stall(float ms)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    ++_queueStalls;
+    _queueStallMs += ms;
+}
+
+void MetricsExporter::add_hitch()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    ++_hitches;
+}
+
+void MetricsExporter::set_gauge(const std::string& name, const std::string& help, const std::string& labels, double value)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    GaugeFamily& family = _gauges[name];
+    family.help = help;
+    family.values[labels] = value;
+}
+
+static void format_histogram(std::ostringstream& out, const char* name, const char* help, const MsHistogram& histogram)
+{
+    out << "# HELP " << name << " " << help << "\n";
+    out << "# TYPE " << name << " histogram\n";
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < MsHistogram::BOUNDS.size(); i++) {
+        cumulative += histogram.buckets[i];
+        out << name << "_bucket{le=\"" << MsHistogram::BOUNDS[i] << "\"} " << cumulative << "\n";
+    }
+    cumulative += histogram.buckets.back();
+    out << name << "_bucket{le=\"+Inf\"} " << cumulative << "\n";
+    out << name << "_sum " << histogram.sumMs << "\n";
+    out << name << "_count " << histogram.count << "\n";
+}
+
+static void format_counter(std::ostringstream& out, const char* name, const char* help, double value)
+{
+    out << "# HELP " << name << " " << help << "\n";
+    out << "# TYPE " << name << " counter\n";
+    out << name << " " << value << "\n";
+}
+
+std::string MetricsExporter::format() const
+{
+    std::ostringstream out;
+    out.precision(10);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    format_histogram(out, "engine_frame_time_ms", "Time between drawn frames in milliseconds.", _frameTimes);
+    //no series at all rather than an empty one when the GPU time is never measured
+    if (_gpuFrameTimes.count > 0) {
+        format_histogram(out, "engine_gpu_frame_time_ms", "GPU time per frame in milliseconds.", _gpuFrameTimes);
+    }
+    format_counter(out, "engine_frames_total", "Frames drawn.", static_cast<double>(_frameTimes.count));
+    format_counter(out, "engine_upload_bytes_total", "Bytes copied to the GPU through staging buffers.", static_cast<double>(_uploadBytes));
+    format_counter(out, "engine_queue_stalls_total", "Times the render thread blocked on a fence or the swapchain.", static_cast<double>(_queueStalls));
+    format_counter(out, "engine_queue_stall_ms_total", "Milliseconds the render thread spent blocked on a fence or the swapchain.", _queueStallMs);
+    format_counter(out, "engine_hitches_total", "Frames flagged by the hitch detector.", static_cast<double>(_hitches));
+
+    for (const auto& [name, family] : _gauges) {
+        out << "# HELP " << name << " " << family.help << "\n";
+        out << "# TYPE " << name << " gauge\n";
+        for (const auto& [labels, value] : family.values) {
+            out << name;
+            if (!labels.empty()) {
+                out << "{" << labels << "}";
+            }
+            out << " " << value << "\n";
+        }
+    }
+    return out.str();
+}
+
+void MetricsExporter::write_file(const std::string& text) const
+{
+    //write next to the target and rename over it, so a scraper never reads a half written file
+    const std::string tempPath = _settings.path + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::trunc);
+        if (!file.is_open()) {
+            std::cout << "Failed to write metrics to " << tempPath << std::endl;
+            return;
+        }
+        file << text;
+    }
+    if (std::rename(tempPath.c_str(), _settings.path.c_str()) != 0) {
+        //Windows won't rename over an existing file
+        std::remove(_settings.path.c_str());
+        std::rename(tempPath.c_str(), _settings.path.c_str());
+    }
+}
+
+void MetricsExporter::worker_loop()
+{
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _wakeWorker.wait_for(lock, std::chrono::duration<float>(_settings.intervalSeconds), [&] { return _stopping; });
+            if (_stopping) {
+                break;
+            }
+        }
+
+        //formatting takes the lock only while reading the values, writing the file happens without it
+        write_file(format());
+    }
+
+    //one last time, so the file has the final values
+    write_file(format());
+}
+
+}
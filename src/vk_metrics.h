@@ -0,0 +1,79 @@
+#pragma once
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace vkutil {
+
+struct MetricsSettings {
+    //file the metrics get written to, in the Prometheus text format. Empty turns the exporter off.
+    //Meant for the node exporter textfile collector, or anything else that can scrape a file
+    std::string path;
+    float intervalSeconds{5.f};
+};
+
+//cumulative histogram in milliseconds, the way Prometheus expects it
+struct MsHistogram {
+    //upper bounds of the buckets, the last bucket is +Inf
+    static constexpr std::array<double, 10> BOUNDS = {2.0, 4.0, 8.0, 12.0, 16.7, 25.0, 33.3, 50.0, 100.0, 250.0};
+
+    std::array<uint64_t, BOUNDS.size() + 1> buckets{};
+    double sumMs{0.0};
+    uint64_t count{0};
+
+    void add(float ms);
+};
+
+//collects engine metrics on the render thread and writes them out from a background thread, so the render thread
+//only ever pays for a short lock and a few additions
+class MetricsExporter {
+public:
+    ~MetricsExporter();
+
+    void start(const MetricsSettings& settings);
+    void stop();
+
+    bool is_running() const { return _worker.joinable(); }
+
+    //gpuMs is negative when the frame's GPU time wasn't measured, e.g. without timestamp queries, and is left out
+    void record_frame(float frameMs, float gpuMs);
+    void add_upload_bytes(size_t bytes);
+    //time the render thread spent blocked on the GPU or the swapchain
+    void add_queue_stall(float ms);
+    void add_hitch();
+
+    //gauges are set from time to time by the engine, labels in Prometheus syntax e.g. heap="0" or empty
+    void set_gauge(const std::string& name, const std::string& help, const std::string& labels, double value);
+
+private:
+    struct GaugeFamily {
+        std::string help;
+        std::map<std::string, double> values;
+    };
+
+    void worker_loop();
+    std::string format() const;
+    void write_file(const std::string& text) const;
+
+    MetricsSettings _settings;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _wakeWorker;
+    std::thread _worker;
+    bool _stopping{false};
+
+    MsHistogram _frameTimes;
+    MsHistogram _gpuFrameTimes;
+    uint64_t _uploadBytes{0};
+    uint64_t _queueStalls{0};
+    double _queueStallMs{0.0};
+    uint64_t _hitches{0};
+    std::map<std::string, GaugeFamily> _gauges;
+};
+
+}
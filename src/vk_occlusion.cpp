@@ -0,0 +1,428 @@
+#include <vk_occlusion.h>
+#include <vk_culling.h>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define OCCLUSION_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+//MSVC compiles AVX2 intrinsics without any flag
+#define OCCLUSION_AVX2_TARGET
+#else
+#define OCCLUSION_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#else
+#define OCCLUSION_X86 0
+#endif
+
+namespace vkutil {
+
+//the engine is built for any x86-64 CPU, so the AVX2 path is picked at runtime
+static bool cpu_has_avx2()
+{
+#if OCCLUSION_X86 && defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    const bool osSavesAvx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+    __cpuidex(info, 7, 0);
+    return osSavesAvx && (info[1] & (1 << 5));
+#elif OCCLUSION_X86
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+static const bool hasAvx2 = cpu_has_avx2();
+
+Occluder build_occluder(const Mesh& mesh, uint32_t firstVertex, uint32_t vertexCount, const glm::mat4& transform, uint32_t maxTriangles)
+{
+    const uint32_t triangleCount = vertexCount / 3;
+
+    std::vector<glm::vec3> positions(triangleCount * 3);
+    std::vector<float> areas(triangleCount);
+    for (uint32_t triangle = 0; triangle < triangleCount; triangle++) {
+        for (uint32_t corner = 0; corner < 3; corner++) {
+            const glm::vec3& position = mesh._vertices[firstVertex + triangle * 3 + corner].position;
+            positions[triangle * 3 + corner] = glm::vec3(transform * glm::vec4(position, 1.f));
+        }
+        const glm::vec3* p = &positions[triangle * 3];
+        areas[triangle] = glm::length(glm::cross(p[1] - p[0], p[2] - p[0]));
+    }
+
+    std::vector<uint32_t> order(triangleCount);
+    std::iota(order.begin(), order.end(), 0);
+    if (triangleCount > maxTriangles) {
+        std::nth_element(order.begin(), order.begin() + maxTriangles, order.end(),
+            [&](uint32_t a, uint32_t b) { return areas[a] > areas[b]; });
+        order.resize(maxTriangles);
+    }
+
+    Occluder occluder;
+    occluder.positions.reserve(order.size() * 3);
+    for (uint32_t triangle : order) {
+        for (uint32_t corner = 0; corner < 3; corner++) {
+            occluder.positions.push_back(positions[triangle * 3 + corner]);
+            occluder.bounds.expand(positions[triangle * 3 + corner]);
+        }
+    }
+    return occluder;
+}
+
+void OcclusionRasterizer::resize(uint32_t width, uint32_t height)
+{
+    _tilesX = (width + TILE_WIDTH - 1) / TILE_WIDTH;
+    _tilesY = (height + TILE_HEIGHT - 1) / TILE_HEIGHT;
+    _tiles.resize(_tilesX * _tilesY);
+    clear();
+}
+
+void OcclusionRasterizer::clear()
+{
+    for (Tile& tile : _tiles) {
+        tile = Tile{};
+    }
+    _triangles.clear();
+    _stats = OcclusionStats{};
+}
+
+bool OcclusionRasterizer::uses_avx2() const
+{
+    return hasAvx2 && !_forceScalar;
+}
+
+void OcclusionRasterizer::rasterize(const glm::mat4& viewproj, const Occluder* occluders, size_t count, JobSystem* jobs)
+{
+    _viewproj = viewproj;
+
+    const Frustum frustum = extract_frustum(viewproj);
+    std::vector<uint32_t> firstTriangle(count + 1, 0);
+    for (size_t i = 0; i < count; i++) {
+        const bool visible = is_visible(frustum, occluders[i].bounds);
+        firstTriangle[i + 1] = firstTriangle[i] + (visible ? static_cast<uint32_t>(occluders[i].positions.size() / 3) : 0);
+    }
+
+    _triangles.resize(firstTriangle[count]);
+
+    const float width = static_cast<float>(this->width());
+    const float height = static_cast<float>(this->height());
+
+    auto setup = [&](uint32_t begin, uint32_t end) {
+        for (uint32_t occluderIndex = begin; occluderIndex < end; occluderIndex++) {
+            const Occluder& occluder = occluders[occluderIndex];
+            const uint32_t triangleCount = firstTriangle[occluderIndex + 1] - firstTriangle[occluderIndex];
+
+            for (uint32_t triangle = 0; triangle < triangleCount; triangle++) {
+                ScreenTriangle& tri = _triangles[firstTriangle[occluderIndex] + triangle];
+                //rejected triangles keep an empty rectangle
+                tri.minX = 1;
+                tri.maxX = 0;
+
+                glm::vec2 screen[3];
+                float depth = std::numeric_limits<float>::max();
+                bool crossesNear = false;
+                for (uint32_t corner = 0; corner < 3; corner++) {
+                    const glm::vec4 clip = viewproj * glm::vec4(occluder.positions[triangle * 3 + corner], 1.f);
+                    //glm::perspective maps the near plane to z = -w
+                    if (clip.w <= 0.f || clip.z < -clip.w) {
+                        crossesNear = true;
+                        break;
+                    }
+                    const float invW = 1.f / clip.w;
+                    screen[corner] = glm::vec2((clip.x * invW * 0.5f + 0.5f) * width, (clip.y * invW * 0.5f + 0.5f) * height);
+                    depth = std::min(depth, invW);
+                }
+                if (crossesNear) {
+                    continue;
+                }
+
+                const float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) - (screen[1].y - screen[0].y) * (screen[2].x - screen[0].x);
+                if (area == 0.f) {
+                    continue;
+                }
+
+                //occluders are rasterized with both windings, the inside is where all three edges are positive
+                const float sign = area > 0.f ? 1.f : -1.f;
+                for (uint32_t edge = 0; edge < 3; edge++) {
+                    const glm::vec2& from = screen[edge];
+                    const glm::vec2& to = screen[(edge + 1) % 3];
+                    tri.edgeA[edge] = (from.y - to.y) * sign;
+                    tri.edgeB[edge] = (to.x - from.x) * sign;
+                    tri.edgeC[edge] = -(tri.edgeA[edge] * from.x + tri.edgeB[edge] * from.y);
+                }
+                tri.depth = depth;
+
+                const glm::vec2 minCorner = glm::min(glm::min(screen[0], screen[1]), screen[2]);
+                const glm::vec2 maxCorner = glm::max(glm::max(screen[0], screen[1]), screen[2]);
+                //clamped before converting, far off screen corners don't fit an int
+                tri.minX = static_cast<int32_t>(std::clamp(std::floor(minCorner.x), 0.f, width));
+                tri.minY = static_cast<int32_t>(std::clamp(std::floor(minCorner.y), 0.f, height));
+                tri.maxX = static_cast<int32_t>(std::clamp(std::ceil(maxCorner.x), -1.f, width - 1.f));
+                tri.maxY = static_cast<int32_t>(std::clamp(std::ceil(maxCorner.y), -1.f, height - 1.f));
+            }
+        }
+    };
+
+    auto rasterizeBand = [&](uint32_t begin, uint32_t end) { rasterize_band(begin, end); };
+
+    if (jobs) {
+        jobs->parallel_for(static_cast<uint32_t>(count), 16, setup);
+        jobs->parallel_for(_tilesY, 1, rasterizeBand);
+    } else {
+        setup(0, static_cast<uint32_t>(count));
+        rasterizeBand(0, _tilesY);
+    }
+
+    for (const ScreenTriangle& tri : _triangles) {
+        if (tri.minX <= tri.maxX && tri.minY <= tri.maxY) {
+            _stats.trianglesRasterized++;
+        }
+    }
+}
+
+void OcclusionRasterizer::rasterize_band(uint32_t firstTileRow, uint32_t endTileRow)
+{
+    const bool avx2 = uses_avx2();
+    const int32_t bandMinY = static_cast<int32_t>(firstTileRow * TILE_HEIGHT);
+    const int32_t bandMaxY = static_cast<int32_t>(endTileRow * TILE_HEIGHT) - 1;
+
+    uint32_t mask[TILE_HEIGHT];
+    for (const ScreenTriangle& tri : _triangles) {
+        if (tri.minX > tri.maxX || tri.maxY < bandMinY || tri.minY > bandMaxY) {
+            continue;
+        }
+
+        const uint32_t firstRow = static_cast<uint32_t>(std::max(tri.minY, bandMinY)) / TILE_HEIGHT;
+        const uint32_t lastRow = static_cast<uint32_t>(std::min(tri.maxY, bandMaxY)) / TILE_HEIGHT;
+        const uint32_t firstColumn = static_cast<uint32_t>(tri.minX) / TILE_WIDTH;
+        const uint32_t lastColumn = static_cast<uint32_t>(tri.maxX) / TILE_WIDTH;
+
+        for (uint32_t row = firstRow; row <= lastRow; row++) {
+            for (uint32_t column = firstColumn; column <= lastColumn; column++) {
+                Tile& tile = _tiles[row * _tilesX + column];
+                //already covered by something nearer than the whole triangle
+                if (tri.depth <= tile.zReference) {
+                    continue;
+                }
+
+                const int32_t tileX = static_cast<int32_t>(column * TILE_WIDTH);
+                const int32_t tileY = static_cast<int32_t>(row * TILE_HEIGHT);
+                if (avx2) {
+                    tile_coverage_avx2(tri, tileX, tileY, mask);
+                } else {
+                    tile_coverage_scalar(tri, tileX, tileY, mask);
+                }
+                update_tile(tile, mask, tri.depth);
+            }
+        }
+    }
+}
+
+void OcclusionRasterizer::tile_coverage_scalar(const ScreenTriangle& tri, int32_t tileX, int32_t tileY, uint32_t outMask[TILE_HEIGHT])
+{
+    for (uint32_t row = 0; row < TILE_HEIGHT; row++) {
+        const float y = static_cast<float>(tileY + static_cast<int32_t>(row)) + 0.5f;
+
+        //pixels lo..hi-1 of the row are inside every edge
+        float lo = 0.f;
+        float hi = static_cast<float>(TILE_WIDTH);
+        for (uint32_t edge = 0; edge < 3; edge++) {
+            const float a = tri.edgeA[edge];
+            const float rowValue = tri.edgeB[edge] * y + tri.edgeC[edge];
+            if (a == 0.f) {
+                if (rowValue < 0.f) {
+                    hi = 0.f;
+                }
+                continue;
+            }
+
+            //the edge crosses the row at pixel center x = crossing, relative to the tile
+            const float crossing = -rowValue / a - static_cast<float>(tileX) - 0.5f;
+            if (a > 0.f) {
+                lo = std::max(lo, std::ceil(crossing));
+            } else {
+                hi = std::min(hi, std::floor(crossing) + 1.f);
+            }
+        }
+
+        const uint32_t first = static_cast<uint32_t>(std::clamp(lo, 0.f, 32.f));
+        const uint32_t end = static_cast<uint32_t>(std::clamp(hi, 0.f, 32.f));
+        if (first >= end) {
+            outMask[row] = 0;
+            continue;
+        }
+        const uint32_t endMask = end == 32 ? ~0u : (1u << end) - 1;
+        outMask[row] = endMask & (~0u << first);
+    }
+}
+
+#if OCCLUSION_X86
+//the same as tile_coverage_scalar with the eight rows of the tile in the eight lanes
+OCCLUSION_AVX2_TARGET void OcclusionRasterizer::tile_coverage_avx2(const ScreenTriangle& tri, int32_t tileX, int32_t tileY, uint32_t outMask[TILE_HEIGHT])
+{
+    const __m256 y = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(tileY) + 0.5f), _mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f));
+    const __m256 pixelOffset = _mm256_set1_ps(static_cast<float>(tileX) + 0.5f);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 tileWidth = _mm256_set1_ps(static_cast<float>(TILE_WIDTH));
+
+    __m256 lo = zero;
+    __m256 hi = tileWidth;
+    for (uint32_t edge = 0; edge < 3; edge++) {
+        const float a = tri.edgeA[edge];
+        const __m256 rowValue = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(tri.edgeB[edge]), y), _mm256_set1_ps(tri.edgeC[edge]));
+        if (a == 0.f) {
+            const __m256 outside = _mm256_cmp_ps(rowValue, zero, _CMP_LT_OQ);
+            hi = _mm256_blendv_ps(hi, zero, outside);
+            continue;
+        }
+
+        const __m256 crossing = _mm256_sub_ps(_mm256_div_ps(rowValue, _mm256_set1_ps(-a)), pixelOffset);
+        if (a > 0.f) {
+            lo = _mm256_max_ps(lo, _mm256_ceil_ps(crossing));
+        } else {
+            hi = _mm256_min_ps(hi, _mm256_add_ps(_mm256_floor_ps(crossing), _mm256_set1_ps(1.f)));
+        }
+    }
+
+    //shifts by 32 or more give 0, which is what the end of a full row needs
+    const __m256i first = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(lo, zero), tileWidth));
+    const __m256i end = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(hi, zero), tileWidth));
+    const __m256i ones = _mm256_set1_epi32(-1);
+    const __m256i mask = _mm256_andnot_si256(_mm256_sllv_epi32(ones, end), _mm256_sllv_epi32(ones, first));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(outMask), mask);
+}
+#else
+void OcclusionRasterizer::tile_coverage_avx2(const ScreenTriangle& tri, int32_t tileX, int32_t tileY, uint32_t outMask[TILE_HEIGHT])
+{
+    tile_coverage_scalar(tri, tileX, tileY, outMask);
+}
+#endif
+
+void OcclusionRasterizer::update_tile(Tile& tile, const uint32_t mask[TILE_HEIGHT], float depth)
+{
+    uint32_t covered = 0;
+    bool workingEmpty = true;
+    for (uint32_t row = 0; row < TILE_HEIGHT; row++) {
+        covered |= mask[row];
+        workingEmpty &= tile.mask[row] == 0;
+    }
+    if (covered == 0) {
+        return;
+    }
+
+    if (workingEmpty) {
+        tile.zWorking = depth;
+    } else if (depth < tile.zWorking && tile.zWorking - depth > tile.zWorking - tile.zReference) {
+        //the paper's heuristic: a triangle further behind the working layer than the reference layer is starts
+        //the working layer over, instead of pulling it back and making it worthless
+        for (uint32_t& row : tile.mask) {
+            row = 0;
+        }
+        tile.zWorking = depth;
+    } else {
+        tile.zWorking = std::min(tile.zWorking, depth);
+    }
+
+    bool full = true;
+    for (uint32_t row = 0; row < TILE_HEIGHT; row++) {
+        tile.mask[row] |= mask[row];
+        full &= tile.mask[row] == ~0u;
+    }
+
+    //the whole tile is covered at zWorking or nearer, it becomes the reference
+    if (full) {
+        tile.zReference = std::max(tile.zReference, tile.zWorking);
+        tile.zWorking = 0.f;
+        for (uint32_t& row : tile.mask) {
+            row = 0;
+        }
+    }
+}
+
+bool OcclusionRasterizer::is_occluded(const AABB& bounds) const
+{
+    if (_tiles.empty() || bounds.empty()) {
+        return false;
+    }
+
+    const float width = static_cast<float>(this->width());
+    const float height = static_cast<float>(this->height());
+
+    glm::vec2 minCorner{std::numeric_limits<float>::max()};
+    glm::vec2 maxCorner{std::numeric_limits<float>::lowest()};
+    float nearestDepth = 0.f;
+    for (uint32_t corner = 0; corner < 8; corner++) {
+        const glm::vec3 position{
+            corner & 1 ? bounds.max.x : bounds.min.x,
+            corner & 2 ? bounds.max.y : bounds.min.y,
+            corner & 4 ? bounds.max.z : bounds.min.z};
+        const glm::vec4 clip = _viewproj * glm::vec4(position, 1.f);
+        if (clip.w <= 0.f || clip.z < -clip.w) {
+            return false;
+        }
+
+        const float invW = 1.f / clip.w;
+        const glm::vec2 screen{(clip.x * invW * 0.5f + 0.5f) * width, (clip.y * invW * 0.5f + 0.5f) * height};
+        minCorner = glm::min(minCorner, screen);
+        maxCorner = glm::max(maxCorner, screen);
+        nearestDepth = std::max(nearestDepth, invW);
+    }
+
+    if (maxCorner.x <= 0.f || maxCorner.y <= 0.f || minCorner.x >= width || minCorner.y >= height) {
+        return false;
+    }
+
+    //every pixel the box touches, not only those whose center it covers
+    const uint32_t minX = static_cast<uint32_t>(std::max(std::floor(minCorner.x), 0.f));
+    const uint32_t minY = static_cast<uint32_t>(std::max(std::floor(minCorner.y), 0.f));
+    const uint32_t maxX = static_cast<uint32_t>(std::min(std::ceil(maxCorner.x), width) - 1.f);
+    const uint32_t maxY = static_cast<uint32_t>(std::min(std::ceil(maxCorner.y), height) - 1.f);
+
+    for (uint32_t row = minY / TILE_HEIGHT; row <= maxY / TILE_HEIGHT; row++) {
+        for (uint32_t column = minX / TILE_WIDTH; column <= maxX / TILE_WIDTH; column++) {
+            const Tile& tile = _tiles[row * _tilesX + column];
+            if (nearestDepth < tile.zReference) {
+                continue;
+            }
+            if (nearestDepth >= tile.zWorking) {
+                return false;
+            }
+
+            //only hidden by the working layer, which must then cover the part of the rectangle inside this tile
+            const uint32_t tileX = column * TILE_WIDTH;
+            const uint32_t tileY = row * TILE_HEIGHT;
+            const uint32_t first = std::max(minX, tileX) - tileX;
+            const uint32_t last = std::min(maxX, tileX + TILE_WIDTH - 1) - tileX;
+            const uint32_t rowMask = (last == 31 ? ~0u : (1u << (last + 1)) - 1) & (~0u << first);
+            for (uint32_t y = std::max(minY, tileY); y <= std::min(maxY, tileY + TILE_HEIGHT - 1); y++) {
+                if ((tile.mask[y - tileY] & rowMask) != rowMask) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+void OcclusionRasterizer::cull_objects(const RenderObject* objects, std::vector<uint32_t>& visible)
+{
+    _stats.objectsTested += static_cast<uint32_t>(visible.size());
+
+    const auto firstOccluded = std::remove_if(visible.begin(), visible.end(),
+        [&](uint32_t index) { return is_occluded(objects[index].worldBounds); });
+    _stats.objectsOccluded += static_cast<uint32_t>(visible.end() - firstOccluded);
+    visible.erase(firstOccluded, visible.end());
+}
+
+float OcclusionRasterizer::pixel_depth(uint32_t x, uint32_t y) const
+{
+    const Tile& tile = _tiles[(y / TILE_HEIGHT) * _tilesX + x / TILE_WIDTH];
+    const bool inWorkingLayer = tile.mask[y % TILE_HEIGHT] & (1u << (x % TILE_WIDTH));
+    return inWorkingLayer ? std::max(tile.zReference, tile.zWorking) : tile.zReference;
+}
+
+}
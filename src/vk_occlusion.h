@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <vk_jobs.h>
+#include <vk_scene.h>
+#include <glm/glm.hpp>
+
+namespace vkutil {
+
+//world space triangles of an occluder, three positions per triangle. Must lie inside the geometry it stands for,
+//anything it hides is skipped by the renderer
+struct Occluder {
+    std::vector<glm::vec3> positions;
+    AABB bounds;
+};
+
+//a cheaper occluder for a run of a mesh's triangles: the largest maxTriangles of them, transformed to world space.
+//A subset of the real triangles can only occlude less than the mesh does, so culling with it stays correct
+Occluder build_occluder(const Mesh& mesh, uint32_t firstVertex, uint32_t vertexCount, const glm::mat4& transform, uint32_t maxTriangles);
+
+struct OcclusionStats {
+    uint32_t trianglesRasterized;
+    uint32_t objectsTested;
+    uint32_t objectsOccluded;
+};
+
+//masked software occlusion culling (Hasselgren et al. 2016): occluders are rasterized into a low resolution buffer of
+//32x8 pixel tiles, each holding a coverage bit per pixel and two depths instead of a depth per pixel. Depth is 1/w,
+//larger is nearer. Rasterization runs one band of tile rows per job, with AVX2 when the CPU has it
+class OcclusionRasterizer {
+public:
+    static constexpr uint32_t TILE_WIDTH = 32;
+    static constexpr uint32_t TILE_HEIGHT = 8;
+
+    //width is rounded up to a multiple of TILE_WIDTH and height to a multiple of TILE_HEIGHT
+    void resize(uint32_t width, uint32_t height);
+
+    //forgets every occluder, e.g. at the start of a frame
+    void clear();
+
+    //rasterizes the occluders seen through viewproj (built like the engine's camera, glm::perspective with y flipped).
+    //Triangles crossing the near plane are skipped
+    void rasterize(const glm::mat4& viewproj, const Occluder* occluders, size_t count, JobSystem* jobs);
+
+    //true when every pixel the box covers is behind the occluders. Boxes crossing the near plane or outside the
+    //screen are never occluded, frustum culling handles the latter
+    bool is_occluded(const AABB& bounds) const;
+
+    //removes the occluded indices from visible, keeping the order
+    void cull_objects(const RenderObject* objects, std::vector<uint32_t>& visible);
+
+    //disables the AVX2 path, to compare it against the scalar one
+    void set_force_scalar(bool forceScalar) { _forceScalar = forceScalar; }
+    bool uses_avx2() const;
+
+    uint32_t width() const { return _tilesX * TILE_WIDTH; }
+    uint32_t height() const { return _tilesY * TILE_HEIGHT; }
+
+    //depth of the pixel as the occlusion test sees it, 0 when nothing covers it. Used by engine_checks
+    float pixel_depth(uint32_t x, uint32_t y) const;
+
+    const OcclusionStats& stats() const { return _stats; }
+
+private:
+    struct Tile {
+        //every pixel of the tile is covered by an occluder at least this near
+        float zReference;
+        //pixels in mask are covered by an occluder at least this near
+        float zWorking;
+        //one 32 bit row mask per pixel row of the tile, bit i is pixel i from the left
+        uint32_t mask[TILE_HEIGHT];
+    };
+
+    //a triangle after setup: edge functions a*x + b*y + c >= 0 inside, evaluated at pixel centers
+    struct ScreenTriangle {
+        float edgeA[3];
+        float edgeB[3];
+        float edgeC[3];
+        //farthest depth of the three vertices, what the triangle is conservatively assumed to be at
+        float depth;
+        int32_t minX, maxX, minY, maxY;
+    };
+
+    //coverage of tri in the tile whose top left pixel is (tileX, tileY)
+    static void tile_coverage_scalar(const ScreenTriangle& tri, int32_t tileX, int32_t tileY, uint32_t outMask[TILE_HEIGHT]);
+    static void tile_coverage_avx2(const ScreenTriangle& tri, int32_t tileX, int32_t tileY, uint32_t outMask[TILE_HEIGHT]);
+
+    static void update_tile(Tile& tile, const uint32_t mask[TILE_HEIGHT], float depth);
+
+    void rasterize_band(uint32_t firstTileRow, uint32_t endTileRow);
+
+    uint32_t _tilesX{0};
+    uint32_t _tilesY{0};
+    std::vector<Tile> _tiles;
+
+    glm::mat4 _viewproj{1.f};
+    std::vector<ScreenTriangle> _triangles;
+
+    bool _forceScalar{false};
+    OcclusionStats _stats{};
+};
+
+}
@@ -0,0 +1,93 @@
+#include <vk_pacing.h>
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace vkutil {
+
+void FramePacer::set_target_rate(float framesPerSecond)
+{
+    _targetRate = std::max(0.f, framesPerSecond);
+    _period = _targetRate > 0.f
+        ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / _targetRate))
+        : Clock::duration{0};
+    _paced = false;
+}
+
+bool FramePacer::wait_for_next_frame()
+{
+    if (_period == Clock::duration{0}) {
+        return false;
+    }
+
+    const Clock::time_point now = Clock::now();
+    bool waited = false;
+    if (!_paced || now > _nextDeadline + _period) {
+        _nextDeadline = now;
+        _paced = true;
+    } else if (now < _nextDeadline) {
+        waited = true;
+        const std::chrono::duration<double> remaining = _nextDeadline - now;
+        if (remaining > _spinMargin) {
+            const std::chrono::duration<double> sleepTime = remaining - _spinMargin;
+            std::this_thread::sleep_for(sleepTime);
+
+            //keep the margin a bit above the worst recent overshoot, and let it shrink slowly when sleeps get precise
+            const std::chrono::duration<double> overshoot = (Clock::now() - now) - sleepTime;
+            _spinMargin = std::clamp(std::max(overshoot * 1.5, _spinMargin * 0.99),
+                std::chrono::duration<double>(0.0002), std::chrono::duration<double>(0.004));
+        }
+
+        while (Clock::now() < _nextDeadline) {
+            std::this_thread::yield();
+        }
+    }
+
+    _nextDeadline += _period;
+    return waited;
+}
+
+void FramePacer::mark_frame()
+{
+    const Clock::time_point now = Clock::now();
+    if (_hasLastFrame) {
+        _frameTimes[_nextFrameTime] = std::chrono::duration<float, std::milli>(now - _lastFrame).count();
+        _nextFrameTime = (_nextFrameTime + 1) % HISTORY;
+        _frameTimeCount = std::min(_frameTimeCount + 1, HISTORY);
+    }
+    _lastFrame = now;
+    _hasLastFrame = true;
+}
+
+FramePacingStats FramePacer::stats() const
+{
+    FramePacingStats stats{};
+    stats.frames = static_cast<uint32_t>(_frameTimeCount);
+    if (_frameTimeCount == 0) {
+        return stats;
+    }
+
+    std::array<float, HISTORY> sorted;
+    std::copy(_frameTimes.begin(), _frameTimes.begin() + _frameTimeCount, sorted.begin());
+    std::sort(sorted.begin(), sorted.begin() + _frameTimeCount);
+
+    double sum = 0.0;
+    for (size_t i = 0; i < _frameTimeCount; i++) {
+        sum += sorted[i];
+    }
+    stats.meanMs = static_cast<float>(sum / _frameTimeCount);
+
+    double variance = 0.0;
+    for (size_t i = 0; i < _frameTimeCount; i++) {
+        variance += (sorted[i] - stats.meanMs) * (sorted[i] - stats.meanMs);
+    }
+    stats.stdDevMs = static_cast<float>(std::sqrt(variance / _frameTimeCount));
+
+    stats.minMs = sorted[0];
+    stats.maxMs = sorted[_frameTimeCount - 1];
+    stats.p99Ms = sorted[std::min(_frameTimeCount - 1, static_cast<size_t>(_frameTimeCount * 0.99))];
+    return stats;
+}
+
+}
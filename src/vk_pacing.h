@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+namespace vkutil {
+
+//frame to frame times over the last FramePacer::HISTORY frames
+struct FramePacingStats {
+    uint32_t frames;
+    float meanMs;
+    float stdDevMs;
+    float minMs;
+    float maxMs;
+    float p99Ms;
+};
+
+//caps the frame rate and measures how even the frames are
+class FramePacer {
+public:
+    static constexpr size_t HISTORY = 240;
+
+    //0 means uncapped, frames are then only measured
+    void set_target_rate(float framesPerSecond);
+    float target_rate() const { return _targetRate; }
+
+    //blocks until the next frame is due. OS sleeps overshoot by up to a scheduler tick, so the thread sleeps for most
+    //of the wait and spins the rest. A frame that is late by more than a period resyncs instead of rushing to catch up.
+    //Returns true when it had to wait
+    bool wait_for_next_frame();
+
+    //call once per frame at the same point, e.g. right after present
+    void mark_frame();
+
+    FramePacingStats stats() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    float _targetRate{0.f};
+    Clock::duration _period{0};
+
+    Clock::time_point _nextDeadline;
+    bool _paced{false};
+
+    //how early to wake up from the sleep, grows with the overshoot seen so far
+    std::chrono::duration<double> _spinMargin{0.002};
+
+    std::array<float, HISTORY> _frameTimes;
+    size_t _frameTimeCount{0};
+    size_t _nextFrameTime{0};
+    Clock::time_point _lastFrame;
+    bool _hasLastFrame{false};
+};
+
+}
@@ -0,0 +1,233 @@
+#include <vk_profiler.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+
+namespace vkutil {
+
+void Profiler::init(const HitchSettings& settings)
+{
+    _settings = settings;
+    _epoch = Clock::now();
+
+    _events.assign(MAX_SCOPE_EVENTS, ScopeEvent{});
+    _nextEvent = 0;
+    _eventCount = 0;
+
+    _frames.assign(MAX_FRAMES, FrameSample{});
+    _nextFrame = 0;
+    _frameCount = 0;
+
+    _openScopes.clear();
+    _hitchCount = 0;
+}
+
+int64_t Profiler::now_us() const
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - _epoch).count();
+}
+
+void Profiler::begin_frame(uint64_t frame)
+{
+    _currentFrame = frame;
+    _frameStartUs = now_us();
+    _inFrame = true;
+
+    _frameFirstEvent = _nextEvent;
+    _eventCountAtFrameStart = _eventCount;
+    _frameEvents = 0;
+}
+
+void Profiler::cancel_frame()
+{
+    if (!_inFrame) {
+        return;
+    }
+    _inFrame = false;
+
+    _nextEvent = _frameFirstEvent;
+    //the frame's events overwrote the oldest ones once the ring was full
+    _eventCount = std::min(_eventCountAtFrameStart, MAX_SCOPE_EVENTS - std::min(_frameEvents, MAX_SCOPE_EVENTS));
+}
+
+bool Profiler::end_frame()
+{
+    if (!_inFrame) {
+        return false;
+    }
+    _inFrame = false;
+
+    FrameSample& sample = _frames[_nextFrame];
+    sample.frame = _currentFrame;
+    sample.startUs = _frameStartUs;
+    sample.durationUs = now_us() - _frameStartUs;
+    _nextFrame = (_nextFrame + 1) % MAX_FRAMES;
+    _frameCount = std::min(_frameCount + 1, MAX_FRAMES);
+
+    const float frameMs = sample.durationUs / 1000.f;
+
+    //the frame is compared against the percentile from before it, so one hitch can't raise its own bar
+    const bool warmedUp = _frameCount > _settings.warmupFrames;
+    const bool overThreshold = frameMs > _settings.thresholdMs;
+    const bool overPercentile = _rollingP95Ms > 0.f && frameMs > _rollingP95Ms * _settings.percentileFactor;
+
+    if (++_framesSincePercentile >= 30) {
+        update_rolling_percentile();
+    }
+
+    if (!_settings.enabled || !warmedUp || !(overThreshold || overPercentile)) {
+        return false;
+    }
+
+    const float sinceDumpSeconds = (sample.startUs - _lastDumpUs) / 1000000.f;
+    if (_hasDumped && sinceDumpSeconds < _settings.cooldownSeconds) {
+        return false;
+    }
+
+    ++_hitchCount;
+    _lastHitchMs = frameMs;
+    _lastDumpUs = sample.startUs;
+    _hasDumped = true;
+
+    dump_hitch(sample);
+    return true;
+}
+
+void Profiler::begin_scope(const char* name)
+{
+    _openScopes.push_back(OpenScope{name, now_us()});
+}
+
+void Profiler::end_scope()
+{
+    const OpenScope scope = _openScopes.back();
+    _openScopes.pop_back();
+
+    ScopeEvent& event = _events[_nextEvent];
+    event.name = scope.name;
+    event.frame = _currentFrame;
+    event.startUs = scope.startUs;
+    event.durationUs = now_us() - scope.startUs;
+    event.depth = static_cast<uint32_t>(_openScopes.size());
+    _nextEvent = (_nextEvent + 1) % MAX_SCOPE_EVENTS;
+    _eventCount = std::min(_eventCount + 1, MAX_SCOPE_EVENTS);
+    ++_frameEvents;
+}
+
+void Profiler::update_rolling_percentile()
+{
+    _framesSincePercentile = 0;
+
+    //the last ~5 seconds at 60 fps
+    const size_t count = std::min<size_t>(_frameCount, 300);
+    if (count == 0) {
+        return;
+    }
+
+    std::vector<float> frameMs(count);
+    for (size_t i = 0; i < count; i++) {
+        frameMs[i] = _frames[(_nextFrame + MAX_FRAMES - 1 - i) % MAX_FRAMES].durationUs / 1000.f;
+    }
+    const size_t p95 = std::min(count - 1, static_cast<size_t>(count * 0.95f));
+    std::nth_element(frameMs.begin(), frameMs.begin() + p95, frameMs.end());
+    _rollingP95Ms = frameMs[p95];
+}
+
+void Profiler::dump_hitch(const FrameSample& hitch)
+{
+    const int64_t windowStartUs = hitch.startUs - static_cast<int64_t>(_settings.windowSeconds * 1000000.f);
+
+    //oldest first
+    std::vector<FrameSample> frames;
+    for (size_t i = 0; i < _frameCount; i++) {
+        const FrameSample& frame = _frames[(_nextFrame + MAX_FRAMES - _frameCount + i) % MAX_FRAMES];
+        if (frame.startUs >= windowStartUs) {
+            frames.push_back(frame);
+        }
+    }
+
+    std::vector<ScopeEvent> events;
+    for (size_t i = 0; i < _eventCount; i++) {
+        const ScopeEvent& event = _events[(_nextEvent + MAX_SCOPE_EVENTS - _eventCount + i) % MAX_SCOPE_EVENTS];
+        if (event.startUs >= windowStartUs) {
+            events.push_back(event);
+        }
+    }
+
+    //time per scope name in the hitch frame against the median over the other frames of the window,
+    //the scopes that grew the most are the likely cause
+    std::map<std::string, float> hitchTotals;
+    std::map<std::string, std::map<uint64_t, float>> otherTotals;
+    for (const ScopeEvent& event : events) {
+        const float ms = event.durationUs / 1000.f;
+        if (event.frame == hitch.frame) {
+            hitchTotals[event.name] += ms;
+        } else {
+            otherTotals[event.name][event.frame] += ms;
+        }
+    }
+
+    const size_t otherFrames = frames.empty() ? 0 : frames.size() - 1;
+    struct ScopeGrowth {
+        std::string name;
+        float hitchMs;
+        float medianMs;
+    };
+    std::vector<ScopeGrowth> growth;
+    for (const auto& [name, hitchMs] : hitchTotals) {
+        //frames where the scope didn't run count as 0
+        std::vector<float> perFrame(otherFrames, 0.f);
+        size_t i = 0;
+        for (const auto& [frame, ms] : otherTotals[name]) {
+            if (i < perFrame.size()) {
+                perFrame[i++] = ms;
+            }
+        }
+        float medianMs = 0.f;
+        if (!perFrame.empty()) {
+            std::nth_element(perFrame.begin(), perFrame.begin() + perFrame.size() / 2, perFrame.end());
+            medianMs = perFrame[perFrame.size() / 2];
+        }
+        growth.push_back(ScopeGrowth{name, hitchMs, medianMs});
+    }
+    std::sort(growth.begin(), growth.end(), [](const ScopeGrowth& l, const ScopeGrowth& r) {
+        return l.hitchMs - l.medianMs > r.hitchMs - r.medianMs;
+    });
+    growth.resize(std::min<size_t>(growth.size(), 5));
+
+    const std::string path = _settings.outputDirectory + "/hitch_frame" + std::to_string(hitch.frame) + ".json";
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        std::cout << "Failed to write hitch trace " << path << std::endl;
+        return;
+    }
+
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    for (const FrameSample& frame : frames) {
+        file << (first ? "" : ",\n") << "{\"name\":\"frame " << frame.frame << "\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":"
+             << frame.startUs << ",\"dur\":" << frame.durationUs << "}";
+        first = false;
+    }
+    for (const ScopeEvent& event : events) {
+        file << (first ? "" : ",\n") << "{\"name\":\"" << event.name << "\",\"cat\":\"scope\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":"
+             << event.startUs << ",\"dur\":" << event.durationUs << "}";
+        first = false;
+    }
+    file << "\n],\"otherData\":{\"hitchFrame\":" << hitch.frame << ",\"hitchMs\":" << hitch.durationUs / 1000.f
+         << ",\"rollingP95Ms\":" << _rollingP95Ms << ",\"scopes\":\"";
+    for (const ScopeGrowth& scope : growth) {
+        file << scope.name << " " << scope.hitchMs << "ms (median " << scope.medianMs << "ms); ";
+    }
+    file << "\"}}\n";
+
+    std::cout << "Hitch: frame " << hitch.frame << " took " << hitch.durationUs / 1000.f << " ms (p95 " << _rollingP95Ms
+              << " ms), trace written to " << path << std::endl;
+    for (const ScopeGrowth& scope : growth) {
+        std::cout << "  " << scope.name << ": " << scope.hitchMs << " ms, median " << scope.medianMs << " ms" << std::endl;
+    }
+}
+
+}
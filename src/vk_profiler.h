@@ -0,0 +1,129 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace vkutil {
+
+struct HitchSettings {
+    bool enabled{true};
+
+    //a frame is a hitch when it takes longer than thresholdMs, or percentileFactor times the rolling p95
+    float thresholdMs{50.f};
+    float percentileFactor{2.5f};
+
+    //how much history goes into a dump
+    float windowSeconds{3.f};
+    //no dumps this soon after the previous one, a stutter tends to come in bursts
+    float cooldownSeconds{5.f};
+    //the first frames compile pipelines and fill caches, they are slow without being hitches
+    uint32_t warmupFrames{60};
+
+    std::string outputDirectory{"."};
+};
+
+//a profiled scope that has ended
+struct ScopeEvent {
+    //scope names are string literals, only the pointer is kept
+    const char* name;
+    uint64_t frame;
+    int64_t startUs;
+    int64_t durationUs;
+    uint32_t depth;
+};
+
+struct FrameSample {
+    uint64_t frame;
+    int64_t startUs;
+    int64_t durationUs;
+};
+
+//keeps the last few seconds of scope timings in ring buffers, and writes them out as a Chrome trace
+//(chrome://tracing, Perfetto) when a frame hitches. Only meant for the render thread
+class Profiler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr size_t MAX_SCOPE_EVENTS = 1 << 16;
+    static constexpr size_t MAX_FRAMES = 4096;
+
+    void init(const HitchSettings& settings);
+
+    void begin_frame(uint64_t frame);
+    //returns true when the frame was a hitch and a trace got written. The trace is written after the frame's duration
+    //is taken and before the next begin_frame, so no frame sample includes it
+    bool end_frame();
+    //the frame was not drawn after all. It doesn't count as a frame and the scopes it recorded are dropped, so they
+    //don't get merged into the next frame under the same frame number
+    void cancel_frame();
+
+    void begin_scope(const char* name);
+    void end_scope();
+
+    uint32_t hitch_count() const { return _hitchCount; }
+    float last_hitch_ms() const { return _lastHitchMs; }
+    float rolling_p95_ms() const { return _rollingP95Ms; }
+
+    HitchSettings _settings;
+
+private:
+    struct OpenScope {
+        const char* name;
+        int64_t startUs;
+    };
+
+    int64_t now_us() const;
+
+    void update_rolling_percentile();
+
+    void dump_hitch(const FrameSample& hitch);
+
+    Clock::time_point _epoch;
+
+    std::vector<ScopeEvent> _events;
+    size_t _nextEvent{0};
+    size_t _eventCount{0};
+
+    std::vector<FrameSample> _frames;
+    size_t _nextFrame{0};
+    size_t _frameCount{0};
+
+    std::vector<OpenScope> _openScopes;
+
+    uint64_t _currentFrame{0};
+    int64_t _frameStartUs{0};
+    //where the event ring stood at begin_frame, what cancel_frame rolls back to
+    size_t _frameFirstEvent{0};
+    size_t _eventCountAtFrameStart{0};
+    size_t _frameEvents{0};
+    bool _inFrame{false};
+
+    float _rollingP95Ms{0.f};
+    uint32_t _framesSincePercentile{0};
+    int64_t _lastDumpUs{0};
+    bool _hasDumped{false};
+
+    uint32_t _hitchCount{0};
+    float _lastHitchMs{0.f};
+};
+
+//times the enclosing block
+class ProfileScope {
+public:
+    ProfileScope(Profiler& profiler, const char* name) : _profiler(profiler) { _profiler.begin_scope(name); }
+    ~ProfileScope() { _profiler.end_scope(); }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    Profiler& _profiler;
+};
+
+}
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(profiler, name) vkutil::ProfileScope PROFILE_CONCAT(profileScope, __LINE__){profiler, name}
@@ -0,0 +1,181 @@
+#include <vk_pvs.h>
+#include <vk_binary.h>
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+
+namespace vkutil {
+
+//"VPVS" and the layout version
+static constexpr uint32_t PVS_MAGIC = 0x53565056;
+static constexpr uint32_t PVS_VERSION = 1;
+
+static uint32_t popcount(uint64_t bits)
+{
+    uint32_t count = 0;
+    for (; bits != 0; bits &= bits - 1) {
+        count++;
+    }
+    return count;
+}
+
+void PotentiallyVisibleSet::bake(const Mesh& mesh, const PvsSettings& settings, JobSystem* jobs)
+{
+    _cellSize = settings.cellSize;
+    _origin = mesh._bounds.min;
+    _cells = glm::max(glm::uvec3(glm::ceil((mesh._bounds.max - mesh._bounds.min) / _cellSize)), glm::uvec3(1));
+    _vertexCount = static_cast<uint32_t>(mesh._vertices.size());
+    _chunkCount = static_cast<uint32_t>(mesh._chunks.size());
+    _wordsPerCell = (_chunkCount + 63) / 64;
+    _bits.assign(static_cast<size_t>(cell_count()) * _wordsPerCell, 0);
+
+    std::vector<glm::vec3> positions(mesh._vertices.size());
+    for (size_t i = 0; i < positions.size(); i++) {
+        positions[i] = mesh._vertices[i].position;
+    }
+    TriangleBvh bvh;
+    bvh.build(positions, jobs);
+
+    auto bakeCells = [&](uint32_t begin, uint32_t end) {
+        for (uint32_t cell = begin; cell < end; cell++) {
+            //seeded per cell, the result doesn't depend on how the cells were spread over the threads
+            std::mt19937 random{cell};
+            std::uniform_real_distribution<float> unit{0.f, 1.f};
+
+            const glm::uvec3 coordinates{cell % _cells.x, (cell / _cells.x) % _cells.y, cell / (_cells.x * _cells.y)};
+            AABB cellBounds;
+            cellBounds.min = _origin + glm::vec3(coordinates) * _cellSize;
+            cellBounds.max = cellBounds.min + glm::vec3(_cellSize);
+
+            uint64_t* cellBits = &_bits[static_cast<size_t>(cell) * _wordsPerCell];
+            for (uint32_t chunkIndex = 0; chunkIndex < _chunkCount; chunkIndex++) {
+                const MeshChunk& chunk = mesh._chunks[chunkIndex];
+
+                //a chunk touching the cell can be seen from inside it no matter what
+                bool visible = glm::all(glm::lessThanEqual(chunk.bounds.min, cellBounds.max)) && glm::all(glm::lessThanEqual(cellBounds.min, chunk.bounds.max));
+
+                const uint32_t chunkTriangles = chunk.vertexCount / 3;
+                for (uint32_t sample = 0; sample < settings.samplesPerChunk && !visible && chunkTriangles > 0; sample++) {
+                    const glm::vec3 from = cellBounds.min + glm::vec3(unit(random), unit(random), unit(random)) * _cellSize;
+
+                    //a point on one of the chunk's triangles, uniform over the triangle
+                    const uint32_t triangle = chunk.firstVertex / 3 + std::min(static_cast<uint32_t>(unit(random) * chunkTriangles), chunkTriangles - 1);
+                    float u = unit(random);
+                    float v = unit(random);
+                    if (u + v > 1.f) {
+                        u = 1.f - u;
+                        v = 1.f - v;
+                    }
+                    const glm::vec3& p0 = positions[triangle * 3];
+                    const glm::vec3 to = p0 + (positions[triangle * 3 + 1] - p0) * u + (positions[triangle * 3 + 2] - p0) * v;
+
+                    visible = !bvh.segment_blocked(from, to);
+                }
+
+                if (visible) {
+                    cellBits[chunkIndex / 64] |= uint64_t{1} << (chunkIndex % 64);
+                }
+            }
+        }
+    };
+
+    if (jobs) {
+        jobs->parallel_for(cell_count(), 1, bakeCells);
+    } else {
+        bakeCells(0, cell_count());
+    }
+}
+
+bool PotentiallyVisibleSet::save(const std::string& path) const
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        std::cout << "Failed to write PVS " << path << std::endl;
+        return false;
+    }
+
+    BinaryWriter writer(file);
+    writer.value(PVS_MAGIC);
+    writer.value(PVS_VERSION);
+    writer.value(_origin);
+    writer.value(_cellSize);
+    writer.value(_cells);
+    writer.value(_vertexCount);
+    writer.value(_chunkCount);
+    writer.array(_bits);
+
+    return file.good();
+}
+
+bool PotentiallyVisibleSet::load(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cout << "Failed to open PVS " << path << std::endl;
+        return false;
+    }
+
+    BinaryReader reader(file);
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    reader.value(magic);
+    reader.value(version);
+    if (magic != PVS_MAGIC || version != PVS_VERSION) {
+        std::cout << path << " is not a version " << PVS_VERSION << " PVS" << std::endl;
+        return false;
+    }
+
+    reader.value(_origin);
+    reader.value(_cellSize);
+    reader.value(_cells);
+    reader.value(_vertexCount);
+    reader.value(_chunkCount);
+    reader.array(_bits);
+
+    _wordsPerCell = (_chunkCount + 63) / 64;
+    if (!reader.ok() || _bits.size() != static_cast<size_t>(cell_count()) * _wordsPerCell) {
+        std::cout << "Failed to read PVS " << path << std::endl;
+        _bits.clear();
+        return false;
+    }
+    return true;
+}
+
+bool PotentiallyVisibleSet::matches(const Mesh& mesh) const
+{
+    return !empty() && _vertexCount == mesh._vertices.size() && _chunkCount == mesh._chunks.size();
+}
+
+uint32_t PotentiallyVisibleSet::cell_at(const glm::vec3& position) const
+{
+    const glm::vec3 local = (position - _origin) / _cellSize;
+    if (empty() || glm::any(glm::lessThan(local, glm::vec3(0.f))) || glm::any(glm::greaterThanEqual(local, glm::vec3(_cells)))) {
+        return INVALID_CELL;
+    }
+
+    const glm::uvec3 coordinates{local};
+    return coordinates.x + coordinates.y * _cells.x + coordinates.z * _cells.x * _cells.y;
+}
+
+void PotentiallyVisibleSet::filter_objects(uint32_t cell, const Mesh* mesh, const RenderObject* objects, size_t count, std::vector<uint32_t>& outCandidates) const
+{
+    outCandidates.clear();
+    for (size_t i = 0; i < count; i++) {
+        const RenderObject& object = objects[i];
+        if (object.mesh != mesh || object.chunkIndex >= _chunkCount || is_visible(cell, object.chunkIndex)) {
+            outCandidates.push_back(static_cast<uint32_t>(i));
+        }
+    }
+}
+
+uint32_t PotentiallyVisibleSet::visible_count(uint32_t cell) const
+{
+    uint32_t count = 0;
+    for (uint32_t word = 0; word < _wordsPerCell; word++) {
+        count += popcount(_bits[static_cast<size_t>(cell) * _wordsPerCell + word]);
+    }
+    return count;
+}
+
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <vk_bvh.h>
+#include <vk_jobs.h>
+#include <vk_scene.h>
+#include <glm/glm.hpp>
+
+namespace vkutil {
+
+struct PvsSettings {
+    //edge of the cubic view cells the mesh bounds are divided into
+    float cellSize{16.f};
+    //point pairs tried per cell and chunk before the chunk is considered hidden from the cell
+    uint32_t samplesPerChunk{64};
+};
+
+//which chunks of a static chunked mesh (Mesh::build_chunks) can be seen from each cell of a grid over it, in the
+//mesh's object space. Baked offline by casting rays between the cells and the chunks' triangles, one bit per chunk.
+//Sampling can miss a narrow gap, so it is a close estimate and not a conservative one
+class PotentiallyVisibleSet {
+public:
+    static constexpr uint32_t INVALID_CELL = UINT32_MAX;
+
+    //mesh must already be split into chunks
+    void bake(const Mesh& mesh, const PvsSettings& settings, JobSystem* jobs);
+
+    bool save(const std::string& path) const;
+    bool load(const std::string& path);
+
+    //true when the set was baked from this mesh, with the same vertices and chunks
+    bool matches(const Mesh& mesh) const;
+
+    //the cell holding an object space position, INVALID_CELL outside the grid
+    uint32_t cell_at(const glm::vec3& position) const;
+
+    bool is_visible(uint32_t cell, uint32_t chunk) const
+    {
+        return (_bits[cell * _wordsPerCell + chunk / 64] >> (chunk % 64)) & 1;
+    }
+
+    //fills outCandidates with the objects not hidden from cell: every object of another mesh or without a chunk,
+    //and the chunks of mesh visible from the cell
+    void filter_objects(uint32_t cell, const Mesh* mesh, const RenderObject* objects, size_t count, std::vector<uint32_t>& outCandidates) const;
+
+    bool empty() const { return _bits.empty(); }
+    uint32_t cell_count() const { return _cells.x * _cells.y * _cells.z; }
+    uint32_t chunk_count() const { return _chunkCount; }
+    //chunks visible from the cell
+    uint32_t visible_count(uint32_t cell) const;
+
+private:
+    glm::vec3 _origin{0.f};
+    float _cellSize{1.f};
+    glm::uvec3 _cells{0};
+
+    //what the set was baked from, to catch a stale file
+    uint32_t _vertexCount{0};
+    uint32_t _chunkCount{0};
+
+    uint32_t _wordsPerCell{0};
+    std::vector<uint64_t> _bits;
+};
+
+}
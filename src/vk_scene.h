@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vk_types.h>
+#include <vk_mesh.h>
+#include <glm/glm.hpp>
+
+struct Material {
+    VkDescriptorSet textureSet{VK_NULL_HANDLE}; //texture defaulted to null
+	VkPipeline pipeline;
+	VkPipelineLayout pipelineLayout;
+	uint32_t shadingModel{0}; //which shading the visibility-buffer resolve applies, 1 is textured
+	VkPipeline pullingPipeline{VK_NULL_HANDLE}; //same shading, vertices fetched from the geometry arena
+};
+
+struct MeshPushConstants {
+	glm::vec4 data;
+	glm::mat4 render_matrix;
+};
+
+struct GPUObjectData{
+	glm::mat4 modelMatrix;
+	glm::uvec4 meshInfo; //x: arena offset in words, y: shading model, z: vertex format, w unused.
+};
+
+struct RenderObject {
+	Mesh* mesh;
+
+	Material* material;
+
+	glm::mat4 transformMatrix;
+
+	//range of the mesh this object draws, a single chunk for objects split by Mesh::build_chunks
+	uint32_t firstVertex{0};
+	uint32_t vertexCount{0};
+
+	//index into mesh->_chunks of that chunk, UINT32_MAX for objects drawing a whole mesh
+	uint32_t chunkIndex{UINT32_MAX};
+
+	//world space bounds, kept for culling
+	AABB worldBounds;
+
+	//static objects never move, so they can be merged at scene build time
+	bool isStatic{false};
+};
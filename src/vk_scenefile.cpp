@@ -0,0 +1,328 @@
+#include <vk_scenefile.h>
+#include <vk_binary.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <glm/gtx/transform.hpp>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace vkutil {
+
+//"VSCN" and the layout version
+static constexpr uint32_t SCENE_MAGIC = 0x4E435356;
+static constexpr uint32_t SCENE_VERSION = 1;
+
+//the file starts with the header, then a name table of offset and length pairs into the string bytes that follow it,
+//meshes first. The entities start at entityOffset, aligned to 16 bytes
+struct SceneFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t meshCount;
+    uint32_t materialCount;
+    uint32_t entityCount;
+    uint32_t stringBytes;
+    uint32_t entityOffset;
+    uint32_t reserved;
+};
+
+struct SceneName {
+    uint32_t offset;
+    uint32_t length;
+};
+
+static uint32_t entity_offset(uint32_t nameCount, uint32_t stringBytes)
+{
+    const uint32_t end = sizeof(SceneFileHeader) + nameCount * sizeof(SceneName) + stringBytes;
+    return (end + 15) & ~15u;
+}
+
+uint32_t SceneDescription::name_index(std::vector<std::string>& names, const std::string& name)
+{
+    for (size_t i = 0; i < names.size(); i++) {
+        if (names[i] == name) {
+            return static_cast<uint32_t>(i);
+        }
+    }
+    names.push_back(name);
+    return static_cast<uint32_t>(names.size() - 1);
+}
+
+bool parse_scene_text(const std::string& path, SceneDescription& outScene)
+{
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cout << "Failed to open scene " << path << std::endl;
+        return false;
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        ++lineNumber;
+
+        std::istringstream tokens(line);
+        std::string keyword;
+        if (!(tokens >> keyword) || keyword[0] == '#') {
+            continue;
+        }
+
+        if (keyword == "entity") {
+            std::string mesh;
+            std::string material;
+            std::string mobility;
+            glm::vec3 translation;
+            float scale;
+            if (!(tokens >> mesh >> material >> mobility >> translation.x >> translation.y >> translation.z >> scale)
+                || (mobility != "static" && mobility != "dynamic")) {
+                std::cout << path << ":" << lineNumber << ": malformed entity" << std::endl;
+                return false;
+            }
+
+            SceneEntity entity{};
+            entity.transform = glm::translate(translation) * glm::scale(glm::vec3{scale});
+            entity.mesh = SceneDescription::name_index(outScene.meshes, mesh);
+            entity.material = SceneDescription::name_index(outScene.materials, material);
+            entity.flags = mobility == "static" ? SCENE_ENTITY_STATIC : 0;
+            outScene.entities.push_back(entity);
+        } else {
+            std::cout << path << ":" << lineNumber << ": unknown entry " << keyword << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool save_scene(const std::string& path, const SceneDescription& scene)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        std::cout << "Failed to write " << path << std::endl;
+        return false;
+    }
+
+    std::vector<SceneName> names;
+    std::string strings;
+    for (const std::vector<std::string>* list : {&scene.meshes, &scene.materials}) {
+        for (const std::string& name : *list) {
+            names.push_back(SceneName{static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(name.size())});
+            strings += name;
+        }
+    }
+
+    SceneFileHeader header{};
+    header.magic = SCENE_MAGIC;
+    header.version = SCENE_VERSION;
+    header.meshCount = static_cast<uint32_t>(scene.meshes.size());
+    header.materialCount = static_cast<uint32_t>(scene.materials.size());
+    header.entityCount = static_cast<uint32_t>(scene.entities.size());
+    header.stringBytes = static_cast<uint32_t>(strings.size());
+    header.entityOffset = entity_offset(static_cast<uint32_t>(names.size()), header.stringBytes);
+
+    BinaryWriter writer{file};
+    writer.value(header);
+    for (const SceneName& name : names) {
+        writer.value(name);
+    }
+    file.write(strings.data(), strings.size());
+
+    const uint32_t written = sizeof(SceneFileHeader) + static_cast<uint32_t>(names.size() * sizeof(SceneName) + strings.size());
+    const char zeros[16] = {};
+    file.write(zeros, header.entityOffset - written);
+    file.write(reinterpret_cast<const char*>(scene.entities.data()), scene.entities.size() * sizeof(SceneEntity));
+    return file.good();
+}
+
+size_t count_entity_objects(const SceneEntity* entities, uint32_t count, const std::vector<Mesh*>& meshes, const std::vector<Material*>& materials)
+{
+    size_t objects = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        const SceneEntity& entity = entities[i];
+        if (entity.mesh < meshes.size() && entity.material < materials.size()) {
+            objects += std::max<size_t>(meshes[entity.mesh]->_chunks.size(), 1);
+        }
+    }
+    return objects;
+}
+
+uint32_t instantiate_entities(const SceneEntity* entities, uint32_t count, const std::vector<Mesh*>& meshes, const std::vector<Material*>& materials, RenderObject* objects)
+{
+    uint32_t invalid = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        const SceneEntity& entity = entities[i];
+        if (entity.mesh >= meshes.size() || entity.material >= materials.size()) {
+            invalid++;
+            continue;
+        }
+
+        const Mesh* mesh = meshes[entity.mesh];
+        if (mesh->_chunks.empty()) {
+            RenderObject& object = *objects++;
+            object.mesh = meshes[entity.mesh];
+            object.material = materials[entity.material];
+            object.transformMatrix = entity.transform;
+            object.firstVertex = 0;
+            object.vertexCount = static_cast<uint32_t>(mesh->_vertices.size());
+            object.chunkIndex = UINT32_MAX;
+            object.worldBounds = mesh->_bounds.transformed(entity.transform);
+            object.isStatic = (entity.flags & SCENE_ENTITY_STATIC) != 0;
+            continue;
+        }
+
+        for (uint32_t chunkIndex = 0; chunkIndex < mesh->_chunks.size(); chunkIndex++) {
+            const MeshChunk& chunk = mesh->_chunks[chunkIndex];
+            RenderObject& object = *objects++;
+            object.mesh = meshes[entity.mesh];
+            object.material = materials[entity.material];
+            object.transformMatrix = entity.transform;
+            object.firstVertex = chunk.firstVertex;
+            object.vertexCount = chunk.vertexCount;
+            object.chunkIndex = chunkIndex;
+            object.worldBounds = chunk.bounds.transformed(entity.transform);
+            object.isStatic = (entity.flags & SCENE_ENTITY_STATIC) != 0;
+        }
+    }
+    return invalid;
+}
+
+bool SceneFile::open(const std::string& path)
+{
+    close();
+
+#ifdef _WIN32
+    _file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (_file == INVALID_HANDLE_VALUE) {
+        _file = nullptr;
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(_file, &fileSize);
+    _size = static_cast<size_t>(fileSize.QuadPart);
+    _mapping = _size > 0 ? CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    _data = _mapping ? static_cast<const uint8_t*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+#else
+    const int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        return false;
+    }
+    struct stat status;
+    if (fstat(file, &status) == 0 && status.st_size > 0) {
+        _size = static_cast<size_t>(status.st_size);
+        //every entity is read right away, faulting the pages in up front is cheaper than one by one
+#ifdef MAP_POPULATE
+        const int flags = MAP_PRIVATE | MAP_POPULATE;
+#else
+        const int flags = MAP_PRIVATE;
+#endif
+        void* data = mmap(nullptr, _size, PROT_READ, flags, file, 0);
+        _data = data == MAP_FAILED ? nullptr : static_cast<const uint8_t*>(data);
+    }
+    //the mapping keeps the file alive
+    ::close(file);
+#endif
+
+    if (_data == nullptr || _size < sizeof(SceneFileHeader)) {
+        std::cout << "Failed to map scene " << path << std::endl;
+        close();
+        return false;
+    }
+
+    SceneFileHeader header;
+    memcpy(&header, _data, sizeof(header));
+    const uint64_t nameCount = static_cast<uint64_t>(header.meshCount) + header.materialCount;
+    if (header.magic != SCENE_MAGIC || header.version != SCENE_VERSION
+        || header.entityOffset < sizeof(SceneFileHeader) + nameCount * sizeof(SceneName) + header.stringBytes
+        || header.entityOffset % 16 != 0
+        || header.entityOffset + static_cast<uint64_t>(header.entityCount) * sizeof(SceneEntity) > _size) {
+        std::cout << path << " is not a scene file this build can read, convert it again with convert_scene" << std::endl;
+        close();
+        return false;
+    }
+
+    //names pointing past the string bytes would be read out of bounds later
+    const SceneName* names = reinterpret_cast<const SceneName*>(_data + sizeof(SceneFileHeader));
+    for (uint64_t i = 0; i < nameCount; i++) {
+        if (static_cast<uint64_t>(names[i].offset) + names[i].length > header.stringBytes) {
+            std::cout << path << " has a corrupt name table" << std::endl;
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+void SceneFile::close()
+{
+#ifdef _WIN32
+    if (_data) {
+        UnmapViewOfFile(_data);
+    }
+    if (_mapping) {
+        CloseHandle(_mapping);
+    }
+    if (_file) {
+        CloseHandle(_file);
+    }
+    _mapping = nullptr;
+    _file = nullptr;
+#else
+    if (_data) {
+        munmap(const_cast<uint8_t*>(_data), _size);
+    }
+#endif
+    _data = nullptr;
+    _size = 0;
+}
+
+uint32_t SceneFile::mesh_count() const
+{
+    return _data ? reinterpret_cast<const SceneFileHeader*>(_data)->meshCount : 0;
+}
+
+uint32_t SceneFile::material_count() const
+{
+    return _data ? reinterpret_cast<const SceneFileHeader*>(_data)->materialCount : 0;
+}
+
+uint32_t SceneFile::entity_count() const
+{
+    return _data ? reinterpret_cast<const SceneFileHeader*>(_data)->entityCount : 0;
+}
+
+std::string_view SceneFile::mesh_name(uint32_t mesh) const
+{
+    return name(mesh);
+}
+
+std::string_view SceneFile::material_name(uint32_t material) const
+{
+    return name(mesh_count() + material);
+}
+
+const SceneEntity* SceneFile::entities() const
+{
+    return _data ? reinterpret_cast<const SceneEntity*>(_data + reinterpret_cast<const SceneFileHeader*>(_data)->entityOffset) : nullptr;
+}
+
+std::string_view SceneFile::name(uint32_t index) const
+{
+    const SceneFileHeader* header = reinterpret_cast<const SceneFileHeader*>(_data);
+    const SceneName* names = reinterpret_cast<const SceneName*>(_data + sizeof(SceneFileHeader));
+    const char* strings = reinterpret_cast<const char*>(names + header->meshCount + header->materialCount);
+    return std::string_view(strings + names[index].offset, names[index].length);
+}
+
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <vk_scene.h>
+#include <glm/glm.hpp>
+
+namespace vkutil {
+
+//SceneEntity::flags
+static constexpr uint32_t SCENE_ENTITY_STATIC = 1;
+
+//one object of a scene, laid out as it is stored in scene files
+struct SceneEntity {
+    glm::mat4 transform;
+    //indices into the scene's mesh and material names
+    uint32_t mesh;
+    uint32_t material;
+    uint32_t flags;
+    uint32_t padding;
+};
+
+//a scene as parsed from text and written to a scene file
+struct SceneDescription {
+    std::vector<std::string> meshes;
+    std::vector<std::string> materials;
+    std::vector<SceneEntity> entities;
+
+    //index of name in names, added when missing
+    static uint32_t name_index(std::vector<std::string>& names, const std::string& name);
+};
+
+//text scenes, one entry per line, # starts a comment:
+//  entity <mesh> <material> <static|dynamic> <x> <y> <z> <scale>
+//the transform is the translation times the uniform scale, like the world manifest's mesh entries
+bool parse_scene_text(const std::string& path, SceneDescription& outScene);
+
+bool save_scene(const std::string& path, const SceneDescription& scene);
+
+//objects instantiate_entities makes for the entities: one per chunk of a chunked mesh, one for any other mesh and none
+//for entities with a mesh or material index out of range
+size_t count_entity_objects(const SceneEntity* entities, uint32_t count, const std::vector<Mesh*>& meshes, const std::vector<Material*>& materials);
+
+//writes the objects of the entities to objects, as many as count_entity_objects returns. Chunked meshes get one object
+//per chunk so each chunk is culled on its own. meshes and materials are the file's name tables resolved by the caller.
+//Returns how many entities were skipped for an index out of range
+uint32_t instantiate_entities(const SceneEntity* entities, uint32_t count, const std::vector<Mesh*>& meshes, const std::vector<Material*>& materials, RenderObject* objects);
+
+//a binary scene written by save_scene, mapped into memory. The entities are read in place, nothing is parsed or copied
+//until the caller instantiates them
+class SceneFile {
+public:
+    SceneFile() = default;
+    SceneFile(const SceneFile&) = delete;
+    SceneFile& operator=(const SceneFile&) = delete;
+    ~SceneFile() { close(); }
+
+    //false for missing, truncated or mismatched files, which are left closed
+    bool open(const std::string& path);
+    void close();
+    bool is_open() const { return _data != nullptr; }
+
+    uint32_t mesh_count() const;
+    uint32_t material_count() const;
+    uint32_t entity_count() const;
+
+    std::string_view mesh_name(uint32_t mesh) const;
+    std::string_view material_name(uint32_t material) const;
+    //valid until the file is closed
+    const SceneEntity* entities() const;
+
+private:
+    std::string_view name(uint32_t index) const;
+
+    const uint8_t* _data{nullptr};
+    size_t _size{0};
+#ifdef _WIN32
+    void* _file{nullptr};
+    void* _mapping{nullptr};
+#endif
+};
+
+}
@@ -0,0 +1,449 @@
+#include <vk_spatial.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace vkutil {
+
+namespace {
+
+AABB merged(const AABB& a, const AABB& b)
+{
+    AABB box = a;
+    box.expand(b);
+    return box;
+}
+
+float surface_area(const AABB& box)
+{
+    const glm::vec3 size = box.max - box.min;
+    return 2.f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+bool contains(const AABB& outer, const AABB& inner)
+{
+    return glm::all(glm::lessThanEqual(outer.min, inner.min)) && glm::all(glm::lessThanEqual(inner.max, outer.max));
+}
+
+enum class FrustumTest {
+    Outside,
+    Intersecting,
+    Inside,
+};
+
+FrustumTest classify(const Frustum& frustum, const AABB& bounds)
+{
+    const glm::vec3 center = bounds.center();
+    const glm::vec3 extents = bounds.extents();
+
+    FrustumTest result = FrustumTest::Inside;
+    for (const glm::vec4& plane : frustum.planes) {
+        //same test as is_visible, plus whether the nearest corner is inside too
+        const float radius = glm::dot(extents, glm::abs(glm::vec3(plane)));
+        const float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+        if (distance + radius < 0.f) {
+            return FrustumTest::Outside;
+        }
+        if (distance - radius < 0.f) {
+            result = FrustumTest::Intersecting;
+        }
+    }
+    return result;
+}
+
+}
+
+uint32_t ObjectTree::allocate_node()
+{
+    if (_freeList == NULL_NODE) {
+        _nodes.emplace_back();
+        _nodes.back().height = 0;
+        return static_cast<uint32_t>(_nodes.size() - 1);
+    }
+
+    const uint32_t node = _freeList;
+    _freeList = _nodes[node].parent;
+    _nodes[node] = Node{};
+    _nodes[node].height = 0;
+    return node;
+}
+
+void ObjectTree::free_node(uint32_t node)
+{
+    _nodes[node] = Node{};
+    _nodes[node].parent = _freeList;
+    _freeList = node;
+}
+
+uint32_t ObjectTree::insert(const AABB& bounds, uint32_t object)
+{
+    const uint32_t proxy = allocate_node();
+    _nodes[proxy].bounds.min = bounds.min - glm::vec3(_margin);
+    _nodes[proxy].bounds.max = bounds.max + glm::vec3(_margin);
+    _nodes[proxy].object = object;
+
+    insert_leaf(proxy);
+    _proxyCount++;
+    return proxy;
+}
+
+void ObjectTree::remove(uint32_t proxy)
+{
+    remove_leaf(proxy);
+    free_node(proxy);
+    _proxyCount--;
+}
+
+bool ObjectTree::move(uint32_t proxy, const AABB& bounds)
+{
+    if (contains(_nodes[proxy].bounds, bounds)) {
+        return false;
+    }
+
+    remove_leaf(proxy);
+    _nodes[proxy].bounds.min = bounds.min - glm::vec3(_margin);
+    _nodes[proxy].bounds.max = bounds.max + glm::vec3(_margin);
+    insert_leaf(proxy);
+    return true;
+}
+
+void ObjectTree::clear()
+{
+    _nodes.clear();
+    _root = NULL_NODE;
+    _freeList = NULL_NODE;
+    _proxyCount = 0;
+}
+
+void ObjectTree::build(const std::vector<AABB>& bounds, std::vector<uint32_t>& outProxies)
+{
+    clear();
+    outProxies.resize(bounds.size());
+    if (bounds.empty()) {
+        return;
+    }
+
+    std::vector<uint32_t> objects(bounds.size());
+    std::vector<glm::vec3> centers(bounds.size());
+    for (uint32_t i = 0; i < bounds.size(); i++) {
+        objects[i] = i;
+        centers[i] = bounds[i].center();
+    }
+    _nodes.reserve(bounds.size() * 2 - 1);
+
+    //median splits along the widest axis of the centers. Nodes are created as they are popped, depth first, with the
+    //first child right after its parent
+    struct Range {
+        uint32_t first;
+        uint32_t count;
+        uint32_t parent;
+    };
+    std::vector<Range> pending{{0, static_cast<uint32_t>(bounds.size()), NULL_NODE}};
+    while (!pending.empty()) {
+        const Range range = pending.back();
+        pending.pop_back();
+
+        const uint32_t node = allocate_node();
+        _nodes[node].parent = range.parent;
+        if (range.parent == NULL_NODE) {
+            _root = node;
+        } else if (_nodes[range.parent].child1 == NULL_NODE) {
+            _nodes[range.parent].child1 = node;
+        } else {
+            _nodes[range.parent].child2 = node;
+        }
+
+        if (range.count == 1) {
+            const uint32_t object = objects[range.first];
+            _nodes[node].bounds.min = bounds[object].min - glm::vec3(_margin);
+            _nodes[node].bounds.max = bounds[object].max + glm::vec3(_margin);
+            _nodes[node].object = object;
+            outProxies[object] = node;
+            continue;
+        }
+
+        AABB centerBounds;
+        for (uint32_t i = range.first; i < range.first + range.count; i++) {
+            centerBounds.expand(centers[objects[i]]);
+        }
+        const glm::vec3 size = centerBounds.max - centerBounds.min;
+        const int axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+        const uint32_t half = range.count / 2;
+        std::nth_element(objects.begin() + range.first, objects.begin() + range.first + half, objects.begin() + range.first + range.count,
+            [&](uint32_t a, uint32_t b) { return centers[a][axis] < centers[b][axis]; });
+
+        //pushed second so it is popped, and created, first
+        pending.push_back(Range{range.first + half, range.count - half, node});
+        pending.push_back(Range{range.first, half, node});
+    }
+
+    //children always come after their parent, so walking backwards refits bottom up
+    for (size_t i = _nodes.size(); i-- > 0;) {
+        Node& node = _nodes[i];
+        if (!node.is_leaf()) {
+            node.bounds = merged(_nodes[node.child1].bounds, _nodes[node.child2].bounds);
+            node.height = 1 + std::max(_nodes[node.child1].height, _nodes[node.child2].height);
+        }
+    }
+    _proxyCount = static_cast<uint32_t>(bounds.size());
+}
+
+void ObjectTree::insert_leaf(uint32_t leaf)
+{
+    if (_root == NULL_NODE) {
+        _root = leaf;
+        _nodes[leaf].parent = NULL_NODE;
+        return;
+    }
+
+    //walk down to the sibling whose box grows the least, by the surface area heuristic
+    const AABB leafBounds = _nodes[leaf].bounds;
+    uint32_t index = _root;
+    while (!_nodes[index].is_leaf()) {
+        const Node& node = _nodes[index];
+        const float area = surface_area(node.bounds);
+        const float combinedArea = surface_area(merged(node.bounds, leafBounds));
+
+        //a new parent for this node and the leaf, or pushing the leaf further down, which grows this node anyway
+        const float cost = 2.f * combinedArea;
+        const float inheritanceCost = 2.f * (combinedArea - area);
+
+        auto descendCost = [&](uint32_t child) {
+            const float childArea = surface_area(merged(leafBounds, _nodes[child].bounds));
+            return (_nodes[child].is_leaf() ? childArea : childArea - surface_area(_nodes[child].bounds)) + inheritanceCost;
+        };
+        const float cost1 = descendCost(node.child1);
+        const float cost2 = descendCost(node.child2);
+
+        if (cost < cost1 && cost < cost2) {
+            break;
+        }
+        index = cost1 < cost2 ? node.child1 : node.child2;
+    }
+
+    const uint32_t sibling = index;
+    const uint32_t oldParent = _nodes[sibling].parent;
+    const uint32_t newParent = allocate_node();
+    _nodes[newParent].parent = oldParent;
+    _nodes[newParent].bounds = merged(leafBounds, _nodes[sibling].bounds);
+    _nodes[newParent].height = _nodes[sibling].height + 1;
+    _nodes[newParent].child1 = sibling;
+    _nodes[newParent].child2 = leaf;
+    _nodes[sibling].parent = newParent;
+    _nodes[leaf].parent = newParent;
+
+    if (oldParent == NULL_NODE) {
+        _root = newParent;
+    } else if (_nodes[oldParent].child1 == sibling) {
+        _nodes[oldParent].child1 = newParent;
+    } else {
+        _nodes[oldParent].child2 = newParent;
+    }
+
+    refit_ancestors(_nodes[leaf].parent);
+}
+
+void ObjectTree::remove_leaf(uint32_t leaf)
+{
+    if (leaf == _root) {
+        _root = NULL_NODE;
+        return;
+    }
+
+    const uint32_t parent = _nodes[leaf].parent;
+    const uint32_t grandParent = _nodes[parent].parent;
+    const uint32_t sibling = _nodes[parent].child1 == leaf ? _nodes[parent].child2 : _nodes[parent].child1;
+
+    //the sibling takes the parent's place
+    _nodes[sibling].parent = grandParent;
+    free_node(parent);
+    if (grandParent == NULL_NODE) {
+        _root = sibling;
+        return;
+    }
+
+    if (_nodes[grandParent].child1 == parent) {
+        _nodes[grandParent].child1 = sibling;
+    } else {
+        _nodes[grandParent].child2 = sibling;
+    }
+    refit_ancestors(grandParent);
+}
+
+void ObjectTree::refit_ancestors(uint32_t node)
+{
+    while (node != NULL_NODE) {
+        node = balance(node);
+
+        Node& current = _nodes[node];
+        current.height = 1 + std::max(_nodes[current.child1].height, _nodes[current.child2].height);
+        current.bounds = merged(_nodes[current.child1].bounds, _nodes[current.child2].bounds);
+        node = current.parent;
+    }
+}
+
+uint32_t ObjectTree::balance(uint32_t a)
+{
+    if (_nodes[a].is_leaf() || _nodes[a].height < 2) {
+        return a;
+    }
+
+    const uint32_t b = _nodes[a].child1;
+    const uint32_t c = _nodes[a].child2;
+    const int32_t difference = _nodes[c].height - _nodes[b].height;
+    if (difference >= -1 && difference <= 1) {
+        return a;
+    }
+
+    //the taller child goes up into a's place, a keeps the shorter child and the shorter grandchild, the taller child
+    //keeps a and its taller grandchild
+    const uint32_t up = difference > 1 ? c : b;
+    const uint32_t kept = difference > 1 ? b : c;
+    const uint32_t first = _nodes[up].child1;
+    const uint32_t second = _nodes[up].child2;
+    const bool firstTaller = _nodes[first].height > _nodes[second].height;
+    const uint32_t tallGrandchild = firstTaller ? first : second;
+    const uint32_t shortGrandchild = firstTaller ? second : first;
+
+    _nodes[up].parent = _nodes[a].parent;
+    _nodes[a].parent = up;
+    if (_nodes[up].parent == NULL_NODE) {
+        _root = up;
+    } else if (_nodes[_nodes[up].parent].child1 == a) {
+        _nodes[_nodes[up].parent].child1 = up;
+    } else {
+        _nodes[_nodes[up].parent].child2 = up;
+    }
+
+    _nodes[up].child1 = a;
+    _nodes[up].child2 = tallGrandchild;
+    _nodes[a].child1 = kept;
+    _nodes[a].child2 = shortGrandchild;
+    _nodes[shortGrandchild].parent = a;
+
+    _nodes[a].bounds = merged(_nodes[kept].bounds, _nodes[shortGrandchild].bounds);
+    _nodes[a].height = 1 + std::max(_nodes[kept].height, _nodes[shortGrandchild].height);
+    _nodes[up].bounds = merged(_nodes[a].bounds, _nodes[tallGrandchild].bounds);
+    _nodes[up].height = 1 + std::max(_nodes[a].height, _nodes[tallGrandchild].height);
+    return up;
+}
+
+void ObjectTree::collect_leaves(uint32_t node, std::vector<uint32_t>& outObjects, std::vector<uint32_t>& stack) const
+{
+    const size_t base = stack.size();
+    stack.push_back(node);
+    while (stack.size() > base) {
+        const Node& current = _nodes[stack.back()];
+        stack.pop_back();
+        if (current.is_leaf()) {
+            outObjects.push_back(current.object);
+        } else {
+            stack.push_back(current.child1);
+            stack.push_back(current.child2);
+        }
+    }
+}
+
+void ObjectTree::query_frustum(const Frustum& frustum, std::vector<uint32_t>& outObjects) const
+{
+    outObjects.clear();
+    if (_root == NULL_NODE) {
+        return;
+    }
+
+    std::vector<uint32_t> stack{_root};
+    while (!stack.empty()) {
+        const uint32_t index = stack.back();
+        stack.pop_back();
+
+        const Node& node = _nodes[index];
+        const FrustumTest test = classify(frustum, node.bounds);
+        if (test == FrustumTest::Outside) {
+            continue;
+        }
+        if (test == FrustumTest::Inside || node.is_leaf()) {
+            collect_leaves(index, outObjects, stack);
+            continue;
+        }
+        stack.push_back(node.child1);
+        stack.push_back(node.child2);
+    }
+}
+
+void ObjectTree::query_sphere(const glm::vec3& center, float radius, std::vector<uint32_t>& outObjects) const
+{
+    outObjects.clear();
+    if (_root == NULL_NODE) {
+        return;
+    }
+
+    std::vector<uint32_t> stack{_root};
+    while (!stack.empty()) {
+        const Node& node = _nodes[stack.back()];
+        stack.pop_back();
+
+        //distance from the center to the nearest point of the box
+        const glm::vec3 nearest = glm::clamp(center, node.bounds.min, node.bounds.max);
+        const glm::vec3 offset = nearest - center;
+        if (glm::dot(offset, offset) > radius * radius) {
+            continue;
+        }
+
+        if (node.is_leaf()) {
+            outObjects.push_back(node.object);
+        } else {
+            stack.push_back(node.child1);
+            stack.push_back(node.child2);
+        }
+    }
+}
+
+void ObjectTree::query_ray(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, std::vector<uint32_t>& outObjects) const
+{
+    outObjects.clear();
+    if (_root == NULL_NODE) {
+        return;
+    }
+
+    //axis parallel rays would divide by zero, a tiny component keeps the slabs finite
+    glm::vec3 inverseDirection;
+    for (int axis = 0; axis < 3; axis++) {
+        inverseDirection[axis] = 1.f / (std::abs(direction[axis]) < 1e-20f ? 1e-20f : direction[axis]);
+    }
+
+    std::vector<uint32_t> stack{_root};
+    while (!stack.empty()) {
+        const Node& node = _nodes[stack.back()];
+        stack.pop_back();
+
+        const glm::vec3 t0 = (node.bounds.min - origin) * inverseDirection;
+        const glm::vec3 t1 = (node.bounds.max - origin) * inverseDirection;
+        const glm::vec3 tNear = glm::min(t0, t1);
+        const glm::vec3 tFar = glm::max(t0, t1);
+        const float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.f));
+        const float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+        if (enter > exit) {
+            continue;
+        }
+
+        if (node.is_leaf()) {
+            outObjects.push_back(node.object);
+        } else {
+            stack.push_back(node.child1);
+            stack.push_back(node.child2);
+        }
+    }
+}
+
+uint32_t MovedObjects::update(ObjectTree& tree, const std::vector<uint32_t>& proxies, const RenderObject* objects)
+{
+    //an object marked twice is refit once, the second move finds its box fits
+    uint32_t changed = 0;
+    for (uint32_t object : _objects) {
+        changed += tree.move(proxies[object], objects[object].worldBounds);
+    }
+    _objects.clear();
+    return changed;
+}
+
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <vk_culling.h>
+#include <vk_mesh.h>
+#include <glm/glm.hpp>
+
+namespace vkutil {
+
+//dynamic bounding volume tree over the world bounds of scene objects, in the style of Box2D's b2DynamicTree.
+//Leaves hold fattened boxes so objects moving a little don't touch the tree, and inserts and removes rebalance with
+//rotations, so updating the tree costs O(log n) per object that moved. Queries return the objects whose fattened
+//boxes pass, callers test the exact bounds
+class ObjectTree {
+public:
+    static constexpr uint32_t NULL_NODE = UINT32_MAX;
+
+    //margin added to every side of the bounds given to insert and move, in world units
+    explicit ObjectTree(float margin = 0.5f) : _margin(margin) {}
+
+    //returns the proxy the object is known by until it is removed
+    uint32_t insert(const AABB& bounds, uint32_t object);
+    void remove(uint32_t proxy);
+    //refits the proxy to bounds when they left its fattened box, returns true when the tree changed
+    bool move(uint32_t proxy, const AABB& bounds);
+    void clear();
+
+    //replaces the tree with one built top down over bounds, object i is bounds[i]. Faster than inserting one by one and
+    //lays the nodes out depth first, later inserts, removes and moves work as usual. Fills outProxies by object
+    void build(const std::vector<AABB>& bounds, std::vector<uint32_t>& outProxies);
+
+    //objects crossing the frustum. Subtrees fully inside it are taken without testing their leaves
+    void query_frustum(const Frustum& frustum, std::vector<uint32_t>& outObjects) const;
+    void query_sphere(const glm::vec3& center, float radius, std::vector<uint32_t>& outObjects) const;
+    //objects whose box the ray enters within maxDistance, in multiples of direction's length
+    void query_ray(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, std::vector<uint32_t>& outObjects) const;
+
+    uint32_t object(uint32_t proxy) const { return _nodes[proxy].object; }
+    const AABB& fat_bounds(uint32_t proxy) const { return _nodes[proxy].bounds; }
+    uint32_t proxy_count() const { return _proxyCount; }
+    //0 for an empty tree or a single object
+    int32_t height() const { return _root == NULL_NODE ? 0 : _nodes[_root].height; }
+
+private:
+    struct Node {
+        AABB bounds;
+        //the parent, or the next free node while the node is on the free list
+        uint32_t parent{NULL_NODE};
+        uint32_t child1{NULL_NODE};
+        uint32_t child2{NULL_NODE};
+        uint32_t object{0};
+        //0 for leaves, -1 for free nodes
+        int32_t height{-1};
+
+        bool is_leaf() const { return child1 == NULL_NODE; }
+    };
+
+    uint32_t allocate_node();
+    void free_node(uint32_t node);
+
+    void insert_leaf(uint32_t leaf);
+    void remove_leaf(uint32_t leaf);
+    //refits and rebalances every node from node up to the root
+    void refit_ancestors(uint32_t node);
+    //rotates the taller grandchild up when node's children differ in height by more than one, returns the node now
+    //in node's place
+    uint32_t balance(uint32_t node);
+
+    //appends every object under node
+    void collect_leaves(uint32_t node, std::vector<uint32_t>& outObjects, std::vector<uint32_t>& stack) const;
+
+    float _margin;
+    std::vector<Node> _nodes;
+    uint32_t _root{NULL_NODE};
+    uint32_t _freeList{NULL_NODE};
+    uint32_t _proxyCount{0};
+};
+
+//objects whose world bounds changed since the tree was last updated. Whatever changes an object's transform marks it
+//and update refits only those, so a frame where nothing moved leaves the tree untouched
+class MovedObjects {
+public:
+    void mark(uint32_t object) { _objects.push_back(object); }
+    //forgets the marks, e.g. when the objects were reordered and the tree rebuilt
+    void clear() { _objects.clear(); }
+    size_t size() const { return _objects.size(); }
+
+    //moves the proxy of every marked object to its world bounds and clears the marks. proxies is by object index.
+    //Returns how many proxies left their fattened box
+    uint32_t update(ObjectTree& tree, const std::vector<uint32_t>& proxies, const RenderObject* objects);
+
+private:
+    std::vector<uint32_t> _objects;
+};
+
+}
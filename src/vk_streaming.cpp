@@ -0,0 +1,399 @@
+#include <vk_streaming.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <glm/gtx/transform.hpp>
+
+namespace vkutil {
+
+void RangeAllocator::init(uint32_t capacity)
+{
+    _freeRanges.clear();
+    if (capacity > 0) {
+        _freeRanges[0] = capacity;
+    }
+    _freeSpace = capacity;
+}
+
+bool RangeAllocator::allocate(uint32_t size, uint32_t& outOffset)
+{
+    for (auto it = _freeRanges.begin(); it != _freeRanges.end(); ++it) {
+        if (it->second < size) {
+            continue;
+        }
+
+        outOffset = it->first;
+        const uint32_t remaining = it->second - size;
+        _freeRanges.erase(it);
+        if (remaining > 0) {
+            _freeRanges[outOffset + size] = remaining;
+        }
+        _freeSpace -= size;
+        return true;
+    }
+    return false;
+}
+
+void RangeAllocator::free(uint32_t offset, uint32_t size)
+{
+    auto it = _freeRanges.emplace(offset, size).first;
+    _freeSpace += size;
+
+    //merge with the following range
+    auto next = std::next(it);
+    if (next != _freeRanges.end() && it->first + it->second == next->first) {
+        it->second += next->second;
+        _freeRanges.erase(next);
+    }
+
+    //and with the previous one
+    if (it != _freeRanges.begin()) {
+        auto prev = std::prev(it);
+        if (prev->first + prev->second == it->first) {
+            prev->second += it->second;
+            _freeRanges.erase(it);
+        }
+    }
+}
+
+//0 when the point is inside the box
+static float distance_to_bounds(const glm::vec3& point, const AABB& bounds)
+{
+    const glm::vec3 closest = glm::clamp(point, bounds.min, bounds.max);
+    return glm::length(point - closest);
+}
+
+//what a mesh costs once resident: its vertices stay on the CPU, and live on the GPU both in a vertex buffer and in the arena
+static void mesh_footprint(size_t vertexCount, VertexFormat format, size_t& cpuBytes, size_t& gpuBytes)
+{
+    const size_t vertexBytes = vertexCount * sizeof(Vertex);
+    cpuBytes += vertexBytes;
+    gpuBytes += vertexBytes + vertexCount * vertex_format_stride(format) * sizeof(uint32_t);
+}
+
+//obj text per parsed vertex when the manifest has no vertex count. Faces are unrolled into 3 vertices each, so
+//the assets in the repo take 11 to 30 bytes of text per vertex, the low end keeps the guess from being too small
+static constexpr size_t OBJ_BYTES_PER_VERTEX = 12;
+
+WorldStreamer::~WorldStreamer()
+{
+    stop();
+}
+
+bool WorldStreamer::load_manifest(const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cout << "Failed to open world manifest " << path << std::endl;
+        return false;
+    }
+
+    const size_t slash = path.find_last_of("/\\");
+    const std::string directory = slash == std::string::npos ? "" : path.substr(0, slash + 1);
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        ++lineNumber;
+
+        std::istringstream tokens(line);
+        std::string keyword;
+        if (!(tokens >> keyword) || keyword[0] == '#') {
+            continue;
+        }
+
+        if (keyword == "cell") {
+            WorldCell cell;
+            if (!(tokens >> cell.name >> cell.bounds.min.x >> cell.bounds.min.y >> cell.bounds.min.z
+                         >> cell.bounds.max.x >> cell.bounds.max.y >> cell.bounds.max.z)) {
+                std::cout << path << ":" << lineNumber << ": malformed cell" << std::endl;
+                return false;
+            }
+            _cells.push_back(cell);
+        } else if (keyword == "mesh") {
+            CellAsset asset;
+            glm::vec3 translation;
+            float scale;
+            if (_cells.empty() || !(tokens >> asset.meshPath >> asset.material >> translation.x >> translation.y >> translation.z >> scale)) {
+                std::cout << path << ":" << lineNumber << ": malformed mesh" << std::endl;
+                return false;
+            }
+            if (!(tokens >> asset.vertexCount) && !tokens.eof()) {
+                std::cout << path << ":" << lineNumber << ": malformed vertex count" << std::endl;
+                return false;
+            }
+            asset.meshPath = directory + asset.meshPath;
+            asset.transform = glm::translate(translation) * glm::scale(glm::vec3{scale});
+            _cells.back().assets.push_back(asset);
+        } else {
+            std::cout << path << ":" << lineNumber << ": unknown entry " << keyword << std::endl;
+            return false;
+        }
+    }
+
+    //until a cell has been loaded once its size comes from the vertex counts of the manifest, or the obj file sizes
+    _status.assign(_cells.size(), CellStatus{});
+    for (size_t i = 0; i < _cells.size(); i++) {
+        for (const CellAsset& asset : _cells[i].assets) {
+            size_t vertexCount = asset.vertexCount;
+            if (vertexCount == 0) {
+                std::ifstream meshFile(asset.meshPath, std::ios::binary | std::ios::ate);
+                if (meshFile.is_open()) {
+                    vertexCount = static_cast<size_t>(meshFile.tellg()) / OBJ_BYTES_PER_VERTEX;
+                }
+            }
+            mesh_footprint(vertexCount, VertexFormat::Full, _status[i].cpuBytes, _status[i].gpuBytes);
+        }
+    }
+
+    return true;
+}
+
+void WorldStreamer::start(const StreamingSettings& settings)
+{
+    stop();
+
+    _settings = settings;
+    _stopping = false;
+    _worker = std::thread(&WorldStreamer::worker_loop, this);
+}
+
+void WorldStreamer::stop()
+{
+    if (!_worker.joinable()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _wakeWorker.notify_one();
+    _worker.join();
+}
+
+void WorldStreamer::release(CellStatus& status)
+{
+    _reservedCpuBytes -= status.cpuBytes;
+    _reservedGpuBytes -= status.gpuBytes;
+}
+
+bool WorldStreamer::make_room(float distance, size_t cpuBytes, size_t gpuBytes)
+{
+    while (_reservedCpuBytes + cpuBytes > _settings.cpuBudget || _reservedGpuBytes + gpuBytes > _settings.gpuBudget) {
+        int farthest = -1;
+        for (size_t i = 0; i < _status.size(); i++) {
+            const CellStatus& status = _status[i];
+            if (status.state != CellState::Resident || status.distance <= std::max(distance, _settings.loadRadius)) {
+                continue;
+            }
+            if (farthest < 0 || status.distance > _status[farthest].distance) {
+                farthest = static_cast<int>(i);
+            }
+        }
+
+        if (farthest < 0) {
+            return false;
+        }
+
+        _status[farthest].state = CellState::Unloaded;
+        release(_status[farthest]);
+        _unloads.push_back(farthest);
+    }
+    return true;
+}
+
+void WorldStreamer::update(const glm::vec3& cameraPosition)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    std::vector<uint32_t> candidates;
+    for (uint32_t i = 0; i < _cells.size(); i++) {
+        CellStatus& status = _status[i];
+        status.distance = distance_to_bounds(cameraPosition, _cells[i].bounds);
+
+        //the gap between the two radii keeps cells on the border from loading and unloading every frame
+        const bool outOfRange = status.distance > _settings.unloadRadius;
+        switch (status.state) {
+            case CellState::Unloaded:
+                if (status.distance <= _settings.loadRadius) {
+                    candidates.push_back(i);
+                }
+                break;
+            case CellState::Queued:
+            case CellState::Loading:
+                //a cell being parsed is dropped by the worker once it notices the state changed
+                if (outOfRange) {
+                    status.state = CellState::Unloaded;
+                    release(status);
+                }
+                break;
+            case CellState::Loaded:
+                if (outOfRange) {
+                    status.state = CellState::Unloaded;
+                    release(status);
+                    _loaded.erase(std::remove_if(_loaded.begin(), _loaded.end(), [=](const LoadedCell& loaded) {
+                        return loaded.cellIndex == i;
+                    }), _loaded.end());
+                }
+                break;
+            case CellState::Resident:
+                if (outOfRange) {
+                    status.state = CellState::Unloaded;
+                    release(status);
+                    _unloads.push_back(i);
+                }
+                break;
+            case CellState::Rejected:
+                if (outOfRange) {
+                    status.state = CellState::Unloaded;
+                }
+                break;
+        }
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [&](uint32_t l, uint32_t r) {
+        return _status[l].distance < _status[r].distance;
+    });
+
+    for (uint32_t cellIndex : candidates) {
+        CellStatus& status = _status[cellIndex];
+        //candidates are sorted, if the nearest one does not fit the farther ones won't either
+        if (!make_room(status.distance, status.cpuBytes, status.gpuBytes)) {
+            break;
+        }
+        status.state = CellState::Queued;
+        _reservedCpuBytes += status.cpuBytes;
+        _reservedGpuBytes += status.gpuBytes;
+    }
+
+    //the camera moved, so rebuild the queue with the new distances
+    _requests = {};
+    for (uint32_t i = 0; i < _cells.size(); i++) {
+        if (_status[i].state == CellState::Queued) {
+            _requests.push(LoadRequest{_status[i].distance, i});
+        }
+    }
+
+    if (!_requests.empty()) {
+        _wakeWorker.notify_one();
+    }
+}
+
+std::vector<uint32_t> WorldStreamer::take_unloads()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::vector<uint32_t> unloads;
+    unloads.swap(_unloads);
+    return unloads;
+}
+
+std::vector<LoadedCell> WorldStreamer::take_loaded(size_t maxBytes)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    std::vector<LoadedCell> taken;
+    size_t takenBytes = 0;
+    while (!_loaded.empty() && (taken.empty() || takenBytes + _status[_loaded.front().cellIndex].cpuBytes <= maxBytes)) {
+        const uint32_t cellIndex = _loaded.front().cellIndex;
+        takenBytes += _status[cellIndex].cpuBytes;
+        _status[cellIndex].state = CellState::Resident;
+
+        taken.push_back(std::move(_loaded.front()));
+        _loaded.erase(_loaded.begin());
+    }
+    return taken;
+}
+
+void WorldStreamer::reject_cell(uint32_t cellIndex)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    CellStatus& status = _status[cellIndex];
+    if (status.state == CellState::Resident) {
+        status.state = CellState::Rejected;
+        release(status);
+    }
+}
+
+bool WorldStreamer::has_results() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return !_loaded.empty() || !_unloads.empty();
+}
+
+StreamingStats WorldStreamer::stats() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    StreamingStats stats{};
+    for (const CellStatus& status : _status) {
+        if (status.state == CellState::Resident) {
+            ++stats.residentCells;
+        } else if (status.state == CellState::Queued || status.state == CellState::Loading || status.state == CellState::Loaded) {
+            ++stats.pendingCells;
+        }
+    }
+    stats.cpuBytes = _reservedCpuBytes;
+    stats.gpuBytes = _reservedGpuBytes;
+    return stats;
+}
+
+void WorldStreamer::worker_loop()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+        _wakeWorker.wait(lock, [&] { return _stopping || !_requests.empty(); });
+        if (_stopping) {
+            return;
+        }
+
+        const uint32_t cellIndex = _requests.top().cellIndex;
+        _requests.pop();
+        if (_status[cellIndex].state != CellState::Queued) {
+            continue;
+        }
+        _status[cellIndex].state = CellState::Loading;
+
+        //the cell list never changes once the worker runs, so it can be read without the lock
+        lock.unlock();
+
+        LoadedCell loaded;
+        loaded.cellIndex = cellIndex;
+        size_t cpuBytes = 0;
+        size_t gpuBytes = 0;
+        for (const CellAsset& asset : _cells[cellIndex].assets) {
+            StreamedMesh streamed;
+            if (!streamed.mesh.load_from_obj(asset.meshPath.c_str())) {
+                std::cout << "Failed to stream " << asset.meshPath << std::endl;
+                continue;
+            }
+            streamed.material = asset.material;
+            streamed.transform = asset.transform;
+            mesh_footprint(streamed.mesh._vertices.size(), streamed.mesh._vertexFormat, cpuBytes, gpuBytes);
+            loaded.meshes.push_back(std::move(streamed));
+        }
+
+        lock.lock();
+
+        CellStatus& status = _status[cellIndex];
+        if (status.state != CellState::Loading) {
+            //went out of range while parsing
+            continue;
+        }
+
+        //swap the estimate for the real size
+        release(status);
+        status.cpuBytes = cpuBytes;
+        status.gpuBytes = gpuBytes;
+        _reservedCpuBytes += cpuBytes;
+        _reservedGpuBytes += gpuBytes;
+
+        status.state = CellState::Loaded;
+        _loaded.push_back(std::move(loaded));
+    }
+}
+
+}
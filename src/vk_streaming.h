@@ -0,0 +1,167 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <map>
+#include <queue>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#include <vk_mesh.h>
+#include <glm/glm.hpp>
+
+namespace vkutil {
+
+//first fit allocator over a range of units, used to place streamed meshes inside the geometry arena
+class RangeAllocator {
+public:
+    void init(uint32_t capacity);
+
+    //returns false when no free range is big enough
+    bool allocate(uint32_t size, uint32_t& outOffset);
+    void free(uint32_t offset, uint32_t size);
+
+    uint32_t free_space() const { return _freeSpace; }
+
+private:
+    //offset -> size of every free range, neighbours are merged on free
+    std::map<uint32_t, uint32_t> _freeRanges;
+    uint32_t _freeSpace{0};
+};
+
+//one mesh placed in a cell, as listed in the manifest
+struct CellAsset {
+    std::string meshPath;
+    std::string material;
+    glm::mat4 transform;
+    //vertices of the parsed mesh, 0 when the manifest leaves it out
+    uint32_t vertexCount{0};
+};
+
+struct WorldCell {
+    std::string name;
+    AABB bounds;
+    std::vector<CellAsset> assets;
+};
+
+//a mesh of a cell parsed by the streaming thread, ready to be uploaded
+struct StreamedMesh {
+    Mesh mesh;
+    std::string material;
+    glm::mat4 transform;
+};
+
+struct LoadedCell {
+    uint32_t cellIndex;
+    std::vector<StreamedMesh> meshes;
+};
+
+struct StreamingSettings {
+    //cells closer than loadRadius get loaded, resident cells are only dropped past unloadRadius
+    float loadRadius{60.f};
+    float unloadRadius{80.f};
+
+    //memory the resident cells may use, vertex data kept on the CPU and vertex buffers + arena space on the GPU
+    size_t cpuBudget{256ull * 1024 * 1024};
+    size_t gpuBudget{256ull * 1024 * 1024};
+};
+
+struct StreamingStats {
+    uint32_t residentCells;
+    uint32_t pendingCells;
+    size_t cpuBytes;
+    size_t gpuBytes;
+};
+
+//decides which cells of a world should be resident from the camera position, and parses them on a worker thread.
+//Uploading and freeing GPU resources is left to the engine, see VulkanEngine::update_streaming
+class WorldStreamer {
+public:
+    ~WorldStreamer();
+
+    //manifest format, one entry per line, # starts a comment:
+    //  cell <name> <min x y z> <max x y z>
+    //  mesh <obj path relative to the manifest> <material> <translation x y z> <scale> [vertex count]
+    //mesh lines belong to the cell above them. The vertex count sizes the cell before its first load, without it
+    //the size is guessed from the obj file
+    bool load_manifest(const std::string& path);
+
+    void start(const StreamingSettings& settings);
+    void stop();
+
+    //queues loads nearest first and collects the cells to drop. Call once per frame from the render thread
+    void update(const glm::vec3& cameraPosition);
+
+    //cells that were resident and must be freed by the caller
+    std::vector<uint32_t> take_unloads();
+
+    //moves out parsed cells until about maxBytes of vertex data were taken. The caller then owns them and must
+    //either upload them or give them back through reject_cell
+    std::vector<LoadedCell> take_loaded(size_t maxBytes);
+
+    //the cell could not be made resident (out of GPU space), it won't be retried until the camera leaves its range
+    void reject_cell(uint32_t cellIndex);
+
+    StreamingStats stats() const;
+
+    //true when take_unloads or take_loaded have something to hand out
+    bool has_results() const;
+
+    const WorldCell& cell(uint32_t cellIndex) const { return _cells[cellIndex]; }
+    size_t cell_count() const { return _cells.size(); }
+
+    bool is_running() const { return _worker.joinable(); }
+
+private:
+    enum class CellState {
+        Unloaded,
+        Queued,
+        Loading,
+        Loaded,   //parsed, waiting in _loaded for the engine to take it
+        Resident,
+        Rejected,
+    };
+
+    struct CellStatus {
+        CellState state{CellState::Unloaded};
+        float distance{0.f};
+        //measured once the cell has been loaded, estimated from the manifest before that
+        size_t cpuBytes{0};
+        size_t gpuBytes{0};
+    };
+
+    struct LoadRequest {
+        float distance;
+        uint32_t cellIndex;
+
+        bool operator>(const LoadRequest& other) const { return distance > other.distance; }
+    };
+
+    void worker_loop();
+
+    //drops resident cells farther than distance and outside the load radius, farthest first, until the new cell fits
+    bool make_room(float distance, size_t cpuBytes, size_t gpuBytes);
+
+    void release(CellStatus& status);
+
+    std::vector<WorldCell> _cells;
+    std::vector<CellStatus> _status;
+
+    StreamingSettings _settings;
+
+    //bytes of every cell that is queued, loading or resident
+    size_t _reservedCpuBytes{0};
+    size_t _reservedGpuBytes{0};
+
+    std::priority_queue<LoadRequest, std::vector<LoadRequest>, std::greater<LoadRequest>> _requests;
+    std::vector<LoadedCell> _loaded;
+    std::vector<uint32_t> _unloads;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _wakeWorker;
+    bool _stopping{false};
+    std::thread _worker;
+};
+
+}
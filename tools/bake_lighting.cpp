@@ -0,0 +1,67 @@
+#include <vk_lightbake.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3) {
+        std::cout << "usage: " << argv[0] << " <mesh.obj> <output.light> [--chunk-size size] [--radius distance] [--rays-per-pass count]"
+            " [--max-passes count] [--tolerance change]" << std::endl;
+        return 1;
+    }
+
+    //the engine splits its big meshes with VulkanEngine::_meshChunkSize, the default has to match it
+    float chunkSize = 32.f;
+    vkutil::AoBakeSettings settings;
+    uint32_t maxPasses = 64;
+    float tolerance = 0.02f;
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--chunk-size") == 0 && i + 1 < argc) {
+            chunkSize = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--radius") == 0 && i + 1 < argc) {
+            settings.radius = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--rays-per-pass") == 0 && i + 1 < argc) {
+            settings.raysPerPass = static_cast<uint32_t>(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--max-passes") == 0 && i + 1 < argc) {
+            maxPasses = static_cast<uint32_t>(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+            tolerance = static_cast<float>(atof(argv[++i]));
+        }
+    }
+
+    Mesh mesh;
+    if (!mesh.load_from_obj(argv[1])) {
+        return 1;
+    }
+    mesh.build_chunks(chunkSize);
+
+    vkutil::JobSystem jobs;
+    jobs.start();
+
+    const auto start = std::chrono::steady_clock::now();
+    vkutil::AoBaker baker;
+    baker.init(mesh, settings);
+    std::cout << baker.point_count() << " sample points for " << mesh._vertices.size() << " vertices, "
+        << jobs.thread_count() << " threads" << std::endl;
+
+    //the file is rewritten after every pass, stopping the bake early still leaves a usable result
+    for (uint32_t pass = 0; pass < maxPasses; pass++) {
+        const float change = baker.refine(&jobs);
+        if (!vkutil::save_baked_lighting(argv[2], mesh, baker.vertex_light())) {
+            return 1;
+        }
+
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "pass " << pass + 1 << ": " << baker.rays_per_point() << " rays per point, largest change "
+            << change << ", " << seconds << " s" << std::endl;
+
+        //the first passes can look settled by chance, give every point a few rays before trusting the change
+        if (pass >= 3 && change < tolerance) {
+            break;
+        }
+    }
+    return 0;
+}
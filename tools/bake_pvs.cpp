@@ -0,0 +1,51 @@
+#include <vk_pvs.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3) {
+        std::cout << "usage: " << argv[0] << " <mesh.obj> <output.pvs> [--chunk-size size] [--cell-size size] [--samples count]" << std::endl;
+        return 1;
+    }
+
+    //the engine splits its big meshes with VulkanEngine::_meshChunkSize, the default has to match it
+    float chunkSize = 32.f;
+    vkutil::PvsSettings settings;
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--chunk-size") == 0 && i + 1 < argc) {
+            chunkSize = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--cell-size") == 0 && i + 1 < argc) {
+            settings.cellSize = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc) {
+            settings.samplesPerChunk = static_cast<uint32_t>(atoi(argv[++i]));
+        }
+    }
+
+    Mesh mesh;
+    if (!mesh.load_from_obj(argv[1])) {
+        return 1;
+    }
+    mesh.build_chunks(chunkSize);
+
+    vkutil::JobSystem jobs;
+    jobs.start();
+
+    const auto start = std::chrono::steady_clock::now();
+    vkutil::PotentiallyVisibleSet pvs;
+    pvs.bake(mesh, settings, &jobs);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    uint64_t visiblePairs = 0;
+    for (uint32_t cell = 0; cell < pvs.cell_count(); cell++) {
+        visiblePairs += pvs.visible_count(cell);
+    }
+    std::cout << pvs.cell_count() << " cells, " << pvs.chunk_count() << " chunks, "
+        << 100.0 * visiblePairs / (static_cast<double>(pvs.cell_count()) * pvs.chunk_count()) << "% visible, baked in "
+        << seconds << " s on " << jobs.thread_count() << " threads" << std::endl;
+
+    return pvs.save(argv[2]) ? 0 : 1;
+}
@@ -0,0 +1,23 @@
+#include <vk_scenefile.h>
+
+#include <chrono>
+#include <iostream>
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3) {
+        std::cout << "usage: " << argv[0] << " <input.scene> <output.bscene>" << std::endl;
+        return 1;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    vkutil::SceneDescription scene;
+    if (!vkutil::parse_scene_text(argv[1], scene) || !vkutil::save_scene(argv[2], scene)) {
+        return 1;
+    }
+    const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << scene.entities.size() << " entities, " << scene.meshes.size() << " meshes, " << scene.materials.size()
+        << " materials, converted in " << milliseconds << " ms" << std::endl;
+    return 0;
+}